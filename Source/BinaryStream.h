@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace util
+{
+	/**
+	 * @brief Writes the bytes of a trivially copyable value, the files are only read back on the same platform.
+	*/
+	template<typename T>
+	void WriteValue(std::ostream& _stream, const T& _value)
+	{
+		_stream.write(reinterpret_cast<const char*>(&_value), sizeof(T));
+	}
+
+	/**
+	 * @brief Writes the element count of a vector followed by its elements.
+	*/
+	template<typename T>
+	void WriteVector(std::ostream& _stream, const std::vector<T>& _values)
+	{
+		WriteValue<uint64_t>(_stream, _values.size());
+		_stream.write(reinterpret_cast<const char*>(_values.data()), _values.size() * sizeof(T));
+	}
+
+	inline void WriteString(std::ostream& _stream, const std::string& _value)
+	{
+		WriteValue<uint64_t>(_stream, _value.size());
+		_stream.write(_value.data(), _value.size());
+	}
+
+	template<typename T>
+	void ReadValue(std::istream& _stream, T& o_value)
+	{
+		_stream.read(reinterpret_cast<char*>(&o_value), sizeof(T));
+	}
+
+	/**
+	 * @brief Reads a vector written by WriteVector. Counts larger than the rest of the stream fail the stream instead of allocating.
+	*/
+	template<typename T>
+	void ReadVector(std::istream& _stream, std::vector<T>& o_values)
+	{
+		uint64_t size = 0;
+		ReadValue(_stream, size);
+		if (!_stream)
+			return;
+
+		const std::streampos position = _stream.tellg();
+		_stream.seekg(0, std::ios::end);
+		const std::streamoff remaining = _stream.tellg() - position;
+		_stream.seekg(position);
+		if (remaining < 0 || size > static_cast<uint64_t>(remaining) / sizeof(T))
+		{
+			_stream.setstate(std::ios::failbit);
+			return;
+		}
+
+		o_values.resize(size);
+		_stream.read(reinterpret_cast<char*>(o_values.data()), size * sizeof(T));
+	}
+
+	inline void ReadString(std::istream& _stream, std::string& o_value)
+	{
+		std::vector<char> characters;
+		ReadVector(_stream, characters);
+		o_value.assign(characters.begin(), characters.end());
+	}
+}
@@ -8,6 +8,7 @@ Context::Context()
 	m_database = std::make_shared<Database>();
 
 	connect(m_database.get(), &Database::featuresLoaded, this, &Context::onDatabaseLoaded);
+	connect(m_database.get(), &Database::snapshotLoaded, this, &Context::onSnapshotLoaded);
 }
 
 /**
@@ -35,6 +36,7 @@ ModelDescriptor& Context::GetActiveModel()
 void Context::SetEmbedding(std::vector<glm::vec2>& _embedding)
 {
 	m_embedding = _embedding;
+	m_database->SetEmbedding(m_embedding);
 
 	emit embeddingChanged();
 }
@@ -54,22 +56,26 @@ void Context::onDatabaseLoaded()
 	ComputeEmbedding();
 }
 
+void Context::onSnapshotLoaded()
+{
+	// A snapshot saved before the embedding was computed has none
+	std::vector<glm::vec2> embedding = m_database->GetEmbedding();
+	if (!embedding.empty() && embedding.size() == m_database->GetModelDatabase().size())
+		SetEmbedding(embedding);
+	else
+		ComputeEmbedding();
+}
+
 void Context::ComputeEmbedding()
 {
 	TsneAnalysis tsne(*this);
 
-	std::vector<float> features;
-
-	auto& modelDatabase = GetDatabase()->GetModelDatabase();
-	int numDimensions = 1;
-	for (ModelDescriptor& md : modelDatabase)
-	{
-		FeatureVector& fv = GetDatabase()->ComputeFeatureVector(md);
-		std::vector<float> floatVector = fv.AsFloatVector();
-		numDimensions = floatVector.size();
-		features.insert(features.end(), floatVector.begin(), floatVector.end());
-	}
-	tsne.initTSNE(features, numDimensions);
+	// The neighbourhoods are found with the composite shape distance the database is searched with,
+	// in one batch over all models instead of a FLANN search over the raw feature vectors
+	std::shared_ptr<Database> database = GetDatabase();
+	const int neighbourCount = std::min<int>(3 * tsne.perplexity(), database->GetModelDatabase().size() - 1);
+	const NeighbourMatrix neighbours = database->FindClosestShapesOfAll(neighbourCount, true);
+	tsne.initWithNeighbours(neighbours, database->GetFeatureMatrix().GetColumnCount());
 
 	tsne.run();
 }
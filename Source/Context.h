@@ -35,6 +35,7 @@ signals:
 
 private slots:
 	void onDatabaseLoaded();
+	void onSnapshotLoaded();
 
 private:
 	void ComputeEmbedding();
@@ -0,0 +1,51 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	kernels::CpuFeatures DetectCpuFeatures()
+	{
+		kernels::CpuFeatures features;
+#if !KERNELS_X86
+		return features;
+#elif defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return features;
+
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx)
+			return features;
+
+		// The OS has to save the ymm (and zmm) registers on context switches
+		const unsigned long long xcr0 = _xgetbv(0);
+		const bool ymmState = (xcr0 & 0x6) == 0x6;
+		const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+		__cpuidex(info, 7, 0);
+		features.avx2 = ymmState && (info[1] & (1 << 5)) != 0;
+		features.avx512 = zmmState && (info[1] & (1 << 16)) != 0;
+		return features;
+#else
+		__builtin_cpu_init();
+		features.avx2 = __builtin_cpu_supports("avx2");
+		features.avx512 = __builtin_cpu_supports("avx512f");
+		return features;
+#endif
+	}
+}
+
+namespace kernels
+{
+	const CpuFeatures& GetCpuFeatures()
+	{
+		static const CpuFeatures features = DetectCpuFeatures();
+		return features;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define KERNELS_X86 0
+#endif
+
+// MSVC exposes all intrinsics unconditionally, gcc and clang need the target enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define KERNEL_TARGET_AVX2
+#define KERNEL_TARGET_AVX512
+#else
+#define KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#define KERNEL_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace kernels
+{
+	/**
+	 * @brief Instruction sets the vectorized kernels can pick from.
+	*/
+	struct CpuFeatures
+	{
+		bool avx2 = false;
+		bool avx512 = false;
+	};
+
+	/**
+	 * @brief Returns the instruction sets that both the CPU and the OS support. They are detected on the first call.
+	*/
+	const CpuFeatures& GetCpuFeatures();
+}
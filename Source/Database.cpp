@@ -1,48 +1,246 @@
 #include "Database.h"
 
+#include "DatabaseSnapshot.h"
+#include "FeatureStore.h"
+
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <algorithm>
+#include <numeric>
+#include <unordered_set>
 
 #include "ModelLoader.h"
 #include "Model.h"
 #include "ModelSaver.h"
 #include "ModelAnalytics.h"
 #include "ModelProcessing.h"
+#include "HistogramDistance.h"
+#include "Parallel.h"
 
 #include "Evaluation/Evaluation.h"
+#include "Evaluation/Benchmarks.h"
 #include "Evaluation/DatabaseAnalytics.h"
 
-#include <flann/algorithms/kdtree_index.h>
-
 #include <QDebug>
 
 namespace fs = std::filesystem;
 
 namespace
 {
-	template <typename T>
-	std::vector<size_t> sortIndices(const std::vector<T>& v)
+	/** Number of candidates per requested neighbour the ANN index returns for exact re-ranking */
+	constexpr size_t ANN_CANDIDATE_FACTOR = 4;
+	/** Number of queries a worker searches for before it takes the next chunk */
+	constexpr size_t QUERY_GRAIN_SIZE = 16;
+	/** A filter that leaves at most one in this many models ranks them directly instead of scanning the feature matrix */
+	constexpr size_t SELECTIVE_FILTER_FACTOR = 8;
+
+	/**
+	 * @brief The store the features of all models are kept in, databases of per-model CSV files are converted to it once.
+	*/
+	io::FeatureStore OpenFeatureStore()
+	{
+		io::FeatureStore store(io::FEATURE_STORE_DIRECTORY);
+		if (!store.Exists() && fs::exists("FeatureDatabase"))
+		{
+			const size_t convertedCount = io::ConvertFeatureDatabase("FeatureDatabase", "DescriptorDatabase", store);
+			std::cout << "Converted the features of " << convertedCount << " models to " << io::FEATURE_STORE_DIRECTORY << std::endl;
+		}
+		return store;
+	}
+
+	/**
+	 * @brief The models of the rows an ANN index found, leaving out removed models.
+	*/
+	std::vector<int> GetModels(const std::vector<Neighbour>& _neighbours, const std::vector<int>& _idModels)
 	{
-		std::vector<size_t> idx(v.size());
-		std::iota(idx.begin(), idx.end(), 0);
+		std::vector<int> models;
+		models.reserve(_neighbours.size());
+		for (const Neighbour& neighbour : _neighbours)
+		{
+			if (_idModels[neighbour.index] >= 0)
+				models.push_back(_idModels[neighbour.index]);
+		}
+		return models;
+	}
+
+	/**
+	 * @brief Counting gate that bounds how many models are loaded in memory at the same time.
+	*/
+	class ModelSlots
+	{
+	public:
+		ModelSlots(unsigned int _slotCount) :
+			m_freeSlots(std::max(_slotCount, 1u))
+		{ }
+
+		/**
+		 * @brief Holds one of the slots for as long as it is in scope.
+		*/
+		class Lock
+		{
+		public:
+			Lock(ModelSlots& _slots) :
+				m_slots(_slots)
+			{
+				std::unique_lock<std::mutex> lock(m_slots.m_mutex);
+				m_slots.m_slotFreed.wait(lock, [this]() { return m_slots.m_freeSlots > 0; });
+				m_slots.m_freeSlots--;
+			}
 
-		std::stable_sort(idx.begin(), idx.end(),
-			[&v](size_t i1, size_t i2) {return v[i1] < v[i2]; });
+			~Lock()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_slots.m_mutex);
+					m_slots.m_freeSlots++;
+				}
+				m_slots.m_slotFreed.notify_one();
+			}
+
+		private:
+			ModelSlots& m_slots;
+		};
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_slotFreed;
+		unsigned int m_freeSlots;
+	};
+
+	/**
+	 * @brief Time in seconds spent in each of the processing stages of a single model.
+	*/
+	struct StageTimings
+	{
+		double load = 0;
+		double subdivide = 0;
+		double decimate = 0;
+		double remesh = 0;
+		double normalize = 0;
+		double save = 0;
+		bool processed = false;
+	};
+
+	class StageTimer
+	{
+	public:
+		StageTimer() :
+			m_last(std::chrono::steady_clock::now())
+		{ }
+
+		/**
+		 * @brief Returns the number of seconds since the previous lap (or construction) and starts a new lap.
+		*/
+		double Lap()
+		{
+			auto now = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(now - m_last).count();
+			m_last = now;
+			return seconds;
+		}
+
+	private:
+		std::chrono::steady_clock::time_point m_last;
+	};
+
+	void ReportProcessingTimings(const std::vector<StageTimings>& _timings, double _wallTime, unsigned int _threadCount)
+	{
+		StageTimings total;
+		int processedCount = 0;
+		for (const StageTimings& timing : _timings)
+		{
+			if (!timing.processed)
+				continue;
 
-		return idx;
+			total.load += timing.load;
+			total.subdivide += timing.subdivide;
+			total.decimate += timing.decimate;
+			total.remesh += timing.remesh;
+			total.normalize += timing.normalize;
+			total.save += timing.save;
+			processedCount++;
+		}
+
+		std::cout << "Processed " << processedCount << " models in " << _wallTime << "s on " << _threadCount << " threads ("
+			<< (_wallTime > 0 ? processedCount / _wallTime : 0) << " models/s)" << std::endl;
+
+		if (processedCount == 0)
+			return;
+
+		// Stage times are summed over all workers, so they can add up to more than the wall time
+		std::cout << "Load:      " << total.load << "s total, " << total.load / processedCount << "s per model" << std::endl;
+		std::cout << "Subdivide: " << total.subdivide << "s total, " << total.subdivide / processedCount << "s per model" << std::endl;
+		std::cout << "Decimate:  " << total.decimate << "s total, " << total.decimate / processedCount << "s per model" << std::endl;
+		std::cout << "Remesh:    " << total.remesh << "s total, " << total.remesh / processedCount << "s per model" << std::endl;
+		std::cout << "Normalize: " << total.normalize << "s total, " << total.normalize / processedCount << "s per model" << std::endl;
+		std::cout << "Save:      " << total.save << "s total, " << total.save / processedCount << "s per model" << std::endl;
 	}
 }
 
-Database::Database() :
-	m_index(flann::KDTreeIndexParams(4))
+Database::Database()
 {
+	m_index.index = CreateSearchIndex(m_indexSettings);
 	connect(this, &Database::featuresLoaded, this, &Database::OnFeaturesLoaded);
 }
 
 void Database::AddModel(ModelDescriptor _model)
 {
 	m_modelDatabase.push_back(_model);
+	m_attributeIndex.Add(m_modelDatabase.back());
+
+	// Until the features are loaded, the feature matrix and the index are built from all models at once
+	if (m_featureMatrix.GetColumnCount() == 0)
+		return;
+
+	FillFeatureRow(m_modelDatabase.back(), m_featureMatrix.AppendRow());
+	m_distanceBounds.AppendRow(m_featureMatrix.GetLayout(), m_featureMatrix.GetRow(m_featureMatrix.GetRowCount() - 1));
+	if (m_classCounts.find(_model.m_class) != m_classCounts.end())
+		m_classCounts[_model.m_class]++;
+	else
+		m_classCounts[_model.m_class] = 0;
+
+	if (m_index.index->GetSize() == 0)
+		return;
+
+	FinishANNIndexRebuild(false);
+	std::vector<float> embeddedRow(GetCumulativeLayout(m_featureMatrix.GetLayout()).GetColumnCount());
+	EmbedCumulative(m_featureMatrix.GetLayout(), m_featureMatrix.GetRow(m_featureMatrix.GetRowCount() - 1), m_featureWeights, embeddedRow.data());
+	m_index.Insert(embeddedRow.data());
+	if (m_rebuiltIndex.valid())
+		m_pendingUpdates.push_back({ -1, std::move(embeddedRow) });
+	MaintainANNIndex();
+}
+
+void Database::RemoveModel(size_t _index)
+{
+	if (_index >= m_modelDatabase.size())
+		return;
+
+	const std::string modelClass = m_modelDatabase[_index].m_class;
+	m_modelDatabase.erase(m_modelDatabase.begin() + _index);
+	m_attributeIndex.Remove(_index);
+	if (m_featureMatrix.GetColumnCount() == 0)
+		return;
+
+	m_featureMatrix.RemoveRow(_index);
+	m_distanceBounds.RemoveRow(_index);
+	auto classCount = m_classCounts.find(modelClass);
+	if (classCount != m_classCounts.end() && classCount->second == 0)
+		m_classCounts.erase(classCount);
+	else if (classCount != m_classCounts.end())
+		classCount->second--;
+
+	if (m_index.index->GetSize() == 0)
+		return;
+
+	FinishANNIndexRebuild(false);
+	m_index.Remove(_index);
+	if (m_rebuiltIndex.valid())
+		m_pendingUpdates.push_back({ static_cast<int>(_index), {} });
+	MaintainANNIndex();
 }
 
 std::vector<ModelDescriptor>& Database::GetModelDatabase()
@@ -57,25 +255,28 @@ std::unordered_map<std::string, int>& Database::GetClassCounts()
 
 ModelDescriptor Database::FindModelByName(const std::string& _name)
 {
-	for(auto md : m_modelDatabase)
+	const int model = m_attributeIndex.FindModel(_name);
+	if (model >= 0)
 	{
-		if(md.m_name == _name)
-		{
-			return md;
-		}
+		return m_modelDatabase[model];
 	}
 	std::cerr << "Could not find Model with name " << _name << "!";
 	return {};
 }
 
-void Database::ProcessAllModels()
+void Database::ProcessAllModels(const ProcessingSettings& _settings)
 {
-	const fs::path modifiedMeshesPath = fs::path("ModifiedMeshes");
-	const fs::path featureDatabasePath = fs::path("FeatureDatabase");
-	const fs::path descriptorDatabasePath = fs::path("DescriptorDatabase");
 	const fs::path savedMeshesPath = fs::path("SavedMeshes");
+	// Create the output directory up front so the workers never race on it
 	fs::create_directory(savedMeshesPath);
 
+	// Models that are in the feature store already are not processed again
+	std::vector<io::FeatureRecord> storedRecords;
+	OpenFeatureStore().Load(storedRecords);
+	std::unordered_set<std::string> storedKeys;
+	for (const io::FeatureRecord& record : storedRecords)
+		storedKeys.insert(record.key);
+
 	Features3D::globalBoundsA3.s = 0;
 	Features3D::globalBoundsA3.t = 3.14159f;
 	Features3D::globalBoundsD1.s = 0;
@@ -86,38 +287,77 @@ void Database::ProcessAllModels()
 	Features3D::globalBoundsD3.t = std::sqrt(2*std::sqrt(3) / 4.0f);
 	Features3D::globalBoundsD4.s = 0;
 	Features3D::globalBoundsD4.t = std::cbrt(1.0f/3.0f);
+	Features3D::shapeDistributionSettings = _settings.shapeDistributions;
 
-	for (ModelDescriptor& modelDescriptor : m_modelDatabase)
+	const unsigned int threadCount = _settings.threadCount == 0 ? util::DefaultThreadCount() : _settings.threadCount;
+	const unsigned int maxModelsInMemory = _settings.maxModelsInMemory == 0 ? threadCount : _settings.maxModelsInMemory;
+	ModelSlots modelSlots(maxModelsInMemory);
+
+	// Every model writes its timings to its own slot so no synchronization is needed
+	std::vector<StageTimings> timings(m_modelDatabase.size());
+
+	const auto start = std::chrono::steady_clock::now();
+
+	util::ParallelFor(m_modelDatabase.size(), 1, [&](size_t _begin, size_t _end)
 	{
-		if (fs::exists(featureDatabasePath / modelDescriptor.m_path.filename().replace_extension(".csv")) && fs::exists(descriptorDatabasePath / modelDescriptor.m_path.filename().replace_extension(".csv")))
+		for (size_t i = _begin; i < _end; i++)
 		{
-			continue;
-		}
-		
-		if(!fs::exists(savedMeshesPath / modelDescriptor.m_path.filename().replace_extension(".ply")))
-		{
-			modelDescriptor.m_model = ModelLoader::LoadModel(std::filesystem::path(modelDescriptor.m_path));
-			//proc::SubdivideModel(modelDescriptor);
-			//proc::CrunchModel(modelDescriptor);
-			proc::Remesh(modelDescriptor);
-			proc::Normalize(modelDescriptor);
-		}
-		else
-		{
-			modelDescriptor.m_model = LoadSavedModel(modelDescriptor.m_path);
-			if(modelDescriptor.m_model == nullptr)
+			ModelDescriptor& modelDescriptor = m_modelDatabase[i];
+			StageTimings& timing = timings[i];
+
+			if (storedKeys.count(io::GetFeatureKey(modelDescriptor.m_path)) > 0)
 			{
-				std::cerr << "Attempted to load saved model, but no model found" << std::endl;
 				continue;
 			}
+
+			ModelSlots::Lock slot(modelSlots);
+			StageTimer timer;
+
+			if (!fs::exists(savedMeshesPath / modelDescriptor.m_path.filename().replace_extension(".ply")))
+			{
+				modelDescriptor.m_model = ModelLoader::LoadModel(std::filesystem::path(modelDescriptor.m_path));
+				timing.load = timer.Lap();
+				if (modelDescriptor.m_model == nullptr)
+				{
+					continue;
+				}
+				if (_settings.minElementCount > 0)
+				{
+					proc::SubdivideModel(modelDescriptor, _settings.minElementCount);
+				}
+				timing.subdivide = timer.Lap();
+				if (_settings.maxFaceCount > 0)
+				{
+					proc::CrunchModel(modelDescriptor, _settings.maxFaceCount);
+				}
+				timing.decimate = timer.Lap();
+				proc::Remesh(modelDescriptor, _settings.remeshing);
+				timing.remesh = timer.Lap();
+			}
+			else
+			{
+				modelDescriptor.m_model = LoadSavedModel(modelDescriptor.m_path);
+				timing.load = timer.Lap();
+				if (modelDescriptor.m_model == nullptr)
+				{
+					std::cerr << "Attempted to load saved model, but no model found" << std::endl;
+					continue;
+				}
+			}
+
 			proc::Normalize(modelDescriptor);
+			timing.normalize = timer.Lap();
+
+			// Normalize already extracted the features of the normalized model
+			ModelSaver::SavePly(modelDescriptor, savedMeshesPath / modelDescriptor.m_path.filename().replace_extension(".ply"), false);
+			modelDescriptor.m_model = nullptr;
+			timing.save = timer.Lap();
+			timing.processed = true;
 		}
+	}, threadCount);
 
-		//modelDescriptor.UpdateBounds();
-		//modelDescriptor.UpdateFeatures();
-		ModelSaver::SavePly(modelDescriptor, savedMeshesPath / modelDescriptor.m_path.filename().replace_extension(".ply"));
-		modelDescriptor.m_model = nullptr;
-	}
+	const double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	ReportProcessingTimings(timings, wallTime, threadCount);
 
 	LoadFeatureDatabase();
 	//CompoundHistogramPerClass();
@@ -165,47 +405,12 @@ void Database::NormalizeAllModels()
 	scaleRecorder.saveData("scale.csv");
 }
 
-void Database::SortDatabase(SortingOptions _option)
-{
-	switch (_option)
-	{
-	case SortingOptions::VERTEX_COUNT:
-		std::sort(m_modelDatabase.begin(), m_modelDatabase.end(), [](const ModelDescriptor& _left, const ModelDescriptor& _right)
-	{
-				return _left.m_vertexCount < _right.m_vertexCount;
-	});
-		break;
-	case SortingOptions::FACE_COUNT:
-		std::sort(m_modelDatabase.begin(), m_modelDatabase.end(), [](const ModelDescriptor& _left, const ModelDescriptor& _right)
-			{
-				return _left.m_faceCount < _right.m_faceCount;
-			});
-		break;
-	case SortingOptions::BOUNDS:
-		std::sort(m_modelDatabase.begin(), m_modelDatabase.end(), [](const ModelDescriptor& _left, const ModelDescriptor& _right)
-			{
-				return glm::length(_left.m_bounds.max - _left.m_bounds.min) < glm::length(_right.m_bounds.max - _right.m_bounds.min);
-			});
-		break;
-	default:
-		break;
-	}
-}
-
 void Database::OnFeaturesLoaded()
 {
 	BuildANNIndex();
 	ComputeQualityMetrics();
 }
 
-void Database::ComputeFeatureVectors()
-{
-	for (ModelDescriptor& md : GetModelDatabase())
-	{
-		md.m_featureVector = std::make_shared<FeatureVector>(ComputeFeatureVector(md));
-	}
-}
-
 FeatureVector Database::ComputeFeatureVector(const ModelDescriptor& md)
 {
 	FeatureVector featureVector;
@@ -232,94 +437,361 @@ FeatureVector Database::ComputeFeatureVector(const ModelDescriptor& md)
 	return featureVector;
 }
 
+void Database::FillFeatureRow(const ModelDescriptor& _modelDescriptor, float* o_row) const
+{
+	const FeatureLayout& layout = m_featureMatrix.GetLayout();
+	const Features3D& features = _modelDescriptor.m_3DFeatures;
+
+	const DescriptorName scalars[] = { VOLUME_3D, SURFACE_AREA_3D, COMPACTNESS_3D, BOUNDS_AREA_3D, BOUNDS_VOLUME_3D, ECCENTRICITY_3D };
+	for (int i = 0; i < layout.scalarCount; i++)
+		o_row[i] = (features[scalars[i]] - m_singleFeatureAverage[scalars[i]]) / m_singleFeatureStddev[scalars[i]];
+
+	// Models without features get empty histograms
+	const HistogramFeature* histograms[] = { &features.a3, &features.d1, &features.d2, &features.d3, &features.d4 };
+	for (int h = 0; h < layout.histogramCount; h++)
+	{
+		float* bins = o_row + layout.GetHistogramOffset(h);
+		const int binCount = std::min(histograms[h]->m_numBins, layout.binCount);
+		for (int b = 0; b < layout.binCount; b++)
+			bins[b] = b < binCount ? (*histograms[h])[b] : 0.0f;
+	}
+}
+
+void Database::BuildFeatureMatrix()
+{
+	FeatureLayout layout;
+	layout.scalarCount = 6;
+	layout.histogramCount = 5;
+	for (const ModelDescriptor& modelDescriptor : m_modelDatabase)
+		layout.binCount = std::max(layout.binCount, modelDescriptor.m_3DFeatures.a3.m_numBins);
+
+	m_featureMatrix = FeatureMatrix(m_modelDatabase.size(), layout);
+	for (size_t i = 0; i < m_modelDatabase.size(); i++)
+		FillFeatureRow(m_modelDatabase[i], m_featureMatrix.GetRow(i));
+	m_distanceBounds = DistanceBounds(m_featureMatrix);
+	m_cascadeCalibrated = false;
+}
+
+void Database::SetIndexSettings(const IndexSettings& _settings)
+{
+	m_indexSettings = _settings;
+	const bool built = m_index.index->GetSize() > 0;
+	m_index.index = CreateSearchIndex(m_indexSettings);
+	if (built)
+		BuildANNIndex();
+}
+
 void Database::BuildANNIndex()
 {
-	auto& modelDatabase = GetModelDatabase();
+	// A rebuild that is still running would miss the latest changes, so it is waited for and dropped
+	m_rebuiltIndex = {};
+	m_pendingUpdates.clear();
+	if (m_featureMatrix.GetRowCount() == 0)
+		return;
+
+	// The index copies the embedded rows, so it has to be rebuilt whenever the matrix or the weights change
+	m_index.index->Build(EmbedCumulative(m_featureMatrix, m_featureWeights));
+	m_index.Reset();
+}
+
+void Database::WaitForANNIndexRebuild()
+{
+	FinishANNIndexRebuild(true);
+}
 
-	int numShapes = modelDatabase.size();
-	int numDims = modelDatabase[0].m_featureVector->AsFloatVector().size();
-	flann::Matrix<float> dataset = flann::Matrix<float>(new float[numShapes * numDims], numShapes, numDims);
+void Database::MaintainANNIndex()
+{
+	if (m_rebuiltIndex.valid() || m_index.updateCount <= m_indexSettings.rebuildThreshold * m_featureMatrix.GetRowCount())
+		return;
 
-	for (int i = 0; i < modelDatabase.size(); i++)
+	// The rows are embedded on this thread, so the rebuild only touches its own copy of them and its own index
+	std::unique_ptr<SearchIndex> index = CreateSearchIndex(m_indexSettings);
+	FeatureMatrix embedded = EmbedCumulative(m_featureMatrix, m_featureWeights);
+	m_rebuiltIndex = std::async(std::launch::async, [index = std::move(index), embedded = std::move(embedded)]() mutable
 	{
-		ModelDescriptor& md = modelDatabase[i];
+		index->Build(embedded);
+		return std::move(index);
+	});
+}
 
-		std::vector<float> floatVector = md.m_featureVector->AsFloatVector();
+void Database::FinishANNIndexRebuild(bool _wait)
+{
+	if (!m_rebuiltIndex.valid() || (!_wait && m_rebuiltIndex.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+		return;
 
-		for (int d = 0; d < numDims; d++)
-		{
-			dataset[i][d] = floatVector[d];
-		}
+	ModelIndex rebuilt;
+	rebuilt.index = m_rebuiltIndex.get();
+	rebuilt.Reset();
+	for (const IndexUpdate& update : m_pendingUpdates)
+	{
+		if (update.removedModel < 0)
+			rebuilt.Insert(update.embeddedRow.data());
+		else
+			rebuilt.Remove(update.removedModel);
 	}
+	m_pendingUpdates.clear();
+	m_index = std::move(rebuilt);
+}
 
-	// Construct an randomized kd-tree index using 4 kd-trees
-	m_index = flann::Index<flann::L2<float>>(dataset, flann::KDTreeIndexParams(4));
-	m_index.buildIndex();
+void Database::ModelIndex::Reset()
+{
+	models.resize(index->GetSize());
+	std::iota(models.begin(), models.end(), 0);
+	ids = models;
+	updateCount = 0;
 }
 
-std::vector<int> Database::FindClosestKNNShapes(ModelDescriptor& md, int k)
+void Database::ModelIndex::Insert(const float* _embeddedRow)
 {
-	auto& modelDatabase = GetModelDatabase();
-	FeatureVector fv1 = ComputeFeatureVector(md);
+	models.push_back(static_cast<int>(ids.size()));
+	ids.push_back(static_cast<int>(index->GetSize()));
+	index->Insert(_embeddedRow);
+	updateCount++;
+}
 
-	std::vector<float> distances(modelDatabase.size());
-	for (int i = 0; i < modelDatabase.size(); i++)
+void Database::ModelIndex::Remove(size_t _model)
+{
+	const int id = ids[_model];
+	index->Remove(id);
+	models[id] = -1;
+	ids.erase(ids.begin() + _model);
+
+	// The models after the removed one move up by one
+	for (int& model : models)
 	{
-		ModelDescriptor& md = modelDatabase[i];
-		FeatureVector fv2 = ComputeFeatureVector(md);
+		if (model > static_cast<int>(_model))
+			model--;
+	}
+	updateCount++;
+}
 
-		distances[i] = FeatureVectorDistance(fv1, fv2, m_hist_weights);
+std::vector<int> Database::FindClosestKNNShapes(ModelDescriptor& md, int k)
+{
+	std::vector<float> query(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, query.data());
+
+	const std::vector<Neighbour> neighbours = FindNearestNeighboursPruned(m_featureMatrix, m_distanceBounds, query.data(), k + 1, m_featureWeights);
+
+	std::vector<int> closestKIndices;
+	for (size_t i = 1; i < neighbours.size(); i++)
+		closestKIndices.push_back(neighbours[i].index);
+
+	return closestKIndices;
+}
+
+std::vector<int> Database::FindClosestKNNShapes(ModelDescriptor& md, int k, const ModelFilter& _filter)
+{
+	std::vector<float> query(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, query.data());
+
+	ModelFilter filter = _filter;
+	filter.excludedModel = m_attributeIndex.FindModel(md.m_name);
+	const std::vector<int> models = m_attributeIndex.Select(filter);
+
+	// Ranking the selected models costs one distance each, the scan bounds every model but computes few of them
+	std::vector<Neighbour> neighbours;
+	if (models.size() * SELECTIVE_FILTER_FACTOR <= m_featureMatrix.GetRowCount())
+		neighbours = RankRows(m_featureMatrix, query.data(), models, k, m_featureWeights);
+	else
+	{
+		std::vector<uint8_t> allowedRows(m_featureMatrix.GetRowCount(), 0);
+		for (int model : models)
+			allowedRows[model] = 1;
+		neighbours = FindNearestNeighboursPruned(m_featureMatrix, m_distanceBounds, query.data(), k, m_featureWeights, allowedRows);
 	}
 
-	std::vector<size_t> indices = sortIndices(distances);
+	std::vector<int> closestKIndices;
+	for (const Neighbour& neighbour : neighbours)
+		closestKIndices.push_back(neighbour.index);
+
+	return closestKIndices;
+}
+
+std::vector<int> Database::FindClosestKNNShapes(ModelDescriptor& md, int k, const QueryDistance& _distance)
+{
+	std::vector<float> query(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, query.data());
+
+	const std::vector<Neighbour> neighbours = FindNearestNeighboursPruned(m_featureMatrix, m_distanceBounds, query.data(), k + 1, _distance);
 
 	std::vector<int> closestKIndices;
-	for (int i = 0; i < k; i++)
-		closestKIndices.push_back(indices[i + 1]);
+	for (size_t i = 1; i < neighbours.size(); i++)
+		closestKIndices.push_back(neighbours[i].index);
 
 	return closestKIndices;
 }
 
 std::vector<int> Database::FindClosestANNShapes(ModelDescriptor& md, int k)
 {
-	FeatureVector fv = ComputeFeatureVector(md);
-	std::vector<float> floatVector = fv.AsFloatVector();
+	FinishANNIndexRebuild(false);
+	std::vector<float> floatVector(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, floatVector.data());
 
-	int numDims = floatVector.size();
-	flann::Matrix<float> query(floatVector.data(), 1, numDims);
-
-	std::vector<std::vector<int>> indices;
-	std::vector<std::vector<float>> dists;
-	// Do a knn search, using 128 checks
-	m_index.knnSearch(query, indices, dists, k+1, flann::SearchParams(128));
+	const std::vector<Neighbour> neighbours = SearchANNIndex(floatVector.data(), k + 1);
 
+	// The closest shape is the query itself
 	std::vector<int> closestKIndices;
-	for (int i = 1; i <= k; i++)
-		closestKIndices.push_back(indices[0][i]);
+	for (size_t i = 1; i < neighbours.size(); i++)
+		closestKIndices.push_back(neighbours[i].index);
 
 	return closestKIndices;
 }
 
+std::vector<Neighbour> Database::SearchANNIndex(const float* _query, size_t _k)
+{
+	std::vector<float> embeddedVector(GetCumulativeLayout(m_featureMatrix.GetLayout()).GetColumnCount());
+	EmbedCumulative(m_featureMatrix.GetLayout(), _query, m_featureWeights, embeddedVector.data());
+
+	// The embedded distance only approximates the composite distance, so a larger shortlist is searched and re-ranked exactly
+	const size_t candidateCount = std::min(ANN_CANDIDATE_FACTOR * _k, m_featureMatrix.GetRowCount());
+	const std::vector<Neighbour> candidates = m_index.index->Search(embeddedVector.data(), candidateCount);
+
+	return RankRows(m_featureMatrix, _query, GetModels(candidates, m_index.models), _k, m_featureWeights);
+}
+
 std::vector<int> Database::FindClosestANNShapesRadius(ModelDescriptor& md, float r)
 {
-	FeatureVector fv = ComputeFeatureVector(md);
-	std::vector<float> floatVector = fv.AsFloatVector();
-	qDebug() << r;
-	int numDims = floatVector.size();
-	flann::Matrix<float> query(floatVector.data(), 1, numDims);
-	qDebug() << numDims;
-	std::vector<std::vector<int>> indices;
-	std::vector<std::vector<float>> dists;
-	// Do a knn search, using 128 checks
-	m_index.radiusSearch(query, indices, dists, r, flann::SearchParams(128));
-	qDebug() << indices.size();
+	FinishANNIndexRebuild(false);
+	std::vector<float> floatVector(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, floatVector.data());
+	std::vector<float> embeddedVector(GetCumulativeLayout(m_featureMatrix.GetLayout()).GetColumnCount());
+	EmbedCumulative(m_featureMatrix.GetLayout(), floatVector.data(), m_featureWeights, embeddedVector.data());
+
+	// The embedded distance never exceeds the composite distance, so every shape within r is a candidate
+	const std::vector<Neighbour> candidates = m_index.index->SearchRadius(embeddedVector.data(), r);
+
+	const std::vector<Neighbour> neighbours = RankRows(m_featureMatrix, floatVector.data(), GetModels(candidates, m_index.models), candidates.size(), m_featureWeights);
+
+	// The closest shape is the query itself
 	std::vector<int> closestRIndices;
-	for (int i = 1; i <= indices.size(); i++)
-		closestRIndices.push_back(indices[0][i]);
+	for (size_t i = 1; i < neighbours.size() && neighbours[i].distance <= r; i++)
+		closestRIndices.push_back(neighbours[i].index);
 
 	return closestRIndices;
 }
 
+std::vector<int> Database::FindClosestCascadeShapes(ModelDescriptor& md, int k, CascadeStatistics* o_statistics)
+{
+	if (m_cascadeSettings.calibrate && !m_cascadeCalibrated)
+		CalibrateCascade();
+
+	std::vector<float> query(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, query.data());
+
+	const size_t candidateCount = std::min(static_cast<size_t>(std::ceil(m_cascadeSettings.candidateFactor * (k + 1))), m_featureMatrix.GetRowCount());
+	const std::vector<Neighbour> neighbours = FindNearestNeighboursCascade(m_featureMatrix, m_distanceBounds, query.data(), k + 1, candidateCount, m_featureWeights);
+
+	if (o_statistics != nullptr)
+	{
+		const std::vector<Neighbour> exact = FindNearestNeighboursPruned(m_featureMatrix, m_distanceBounds, query.data(), k + 1, m_featureWeights);
+		size_t found = 0;
+		for (const Neighbour& neighbour : exact)
+			found += std::find_if(neighbours.begin(), neighbours.end(), [&](const Neighbour& _result) { return _result.index == neighbour.index; }) != neighbours.end();
+
+		o_statistics->candidateCount = std::max(candidateCount, static_cast<size_t>(k + 1));
+		o_statistics->recall = exact.empty() ? 1.0f : static_cast<float>(found) / exact.size();
+	}
+
+	// The closest shape is the query itself
+	std::vector<int> closestKIndices;
+	for (size_t i = 1; i < neighbours.size(); i++)
+		closestKIndices.push_back(neighbours[i].index);
+
+	return closestKIndices;
+}
+
+std::vector<int> Database::FindClosestAnytimeShapes(ModelDescriptor& md, int k, std::chrono::steady_clock::time_point _deadline,
+	AnytimeStatistics* o_statistics)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<float> query(m_featureMatrix.GetColumnCount());
+	FillFeatureRow(md, query.data());
+
+	// The shortlist of the ANN index gives good results within a fraction of the budget, the rest of it refines them towards the exact ones.
+	// A finished rebuild is left for the next query, applying its pending updates could take the whole budget.
+	std::vector<int> candidates;
+	if (m_index.index->GetSize() > 0 && std::chrono::steady_clock::now() < _deadline)
+	{
+		std::vector<float> embeddedVector(GetCumulativeLayout(m_featureMatrix.GetLayout()).GetColumnCount());
+		EmbedCumulative(m_featureMatrix.GetLayout(), query.data(), m_featureWeights, embeddedVector.data());
+		const size_t candidateCount = std::min(ANN_CANDIDATE_FACTOR * (k + 1), m_featureMatrix.GetRowCount());
+		candidates = GetModels(m_index.index->Search(embeddedVector.data(), candidateCount), m_index.models);
+	}
+
+	const std::vector<Neighbour> neighbours = FindNearestNeighboursAnytime(m_featureMatrix, m_distanceBounds, query.data(), k + 1, m_featureWeights,
+		candidates, _deadline, o_statistics);
+	if (o_statistics != nullptr)
+		o_statistics->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// The closest shape is the query itself, its bound is zero so it is found in the first round
+	std::vector<int> closestKIndices;
+	for (size_t i = 1; i < neighbours.size(); i++)
+		closestKIndices.push_back(neighbours[i].index);
+
+	return closestKIndices;
+}
+
+void Database::SetCascadeSettings(const CascadeSettings& _settings)
+{
+	m_cascadeSettings = _settings;
+	m_cascadeCalibrated = false;
+}
+
+float Database::CalibrateCascade()
+{
+	const size_t rowCount = m_featureMatrix.GetRowCount();
+	const size_t k = static_cast<size_t>(std::max(m_cascadeSettings.calibrationK, 1)) + 1;
+	const size_t queryCount = std::min(static_cast<size_t>(std::max(m_cascadeSettings.calibrationQueryCount, 1)), rowCount);
+	if (queryCount == 0)
+		return m_cascadeSettings.candidateFactor;
+
+	// Models spread evenly over the database are searched like FindClosestCascadeShapes searches them, with the model itself as closest match
+	FeatureMatrix queries(queryCount, m_featureMatrix.GetLayout());
+	for (size_t q = 0; q < queryCount; q++)
+		std::copy_n(m_featureMatrix.GetRow(q * rowCount / queryCount), m_featureMatrix.GetColumnCount(), queries.GetRow(q));
+
+	const size_t candidateCount = CalibrateCandidateCount(m_featureMatrix, m_distanceBounds, queries, k, m_featureWeights, m_cascadeSettings.targetRecall);
+	m_cascadeSettings.candidateFactor = static_cast<float>(candidateCount) / k;
+	m_cascadeCalibrated = true;
+	return m_cascadeSettings.candidateFactor;
+}
+
+NeighbourMatrix Database::FindClosestShapes(const FeatureMatrix& _queries, int _k, bool _preciseKNN, unsigned int _threadCount)
+{
+	if (_preciseKNN)
+		return FindNearestNeighboursPruned(m_featureMatrix, m_distanceBounds, _queries, _k, m_featureWeights, _threadCount);
+
+	// Searches only read the index, so the queries are split over the pool
+	FinishANNIndexRebuild(false);
+	NeighbourMatrix neighbours(_queries.GetRowCount(), _k);
+	util::ParallelFor(_queries.GetRowCount(), QUERY_GRAIN_SIZE, [&](size_t _begin, size_t _end)
+	{
+		for (size_t q = _begin; q < _end; q++)
+			neighbours.SetNeighbours(q, SearchANNIndex(_queries.GetRow(q), _k));
+	}, _threadCount);
+	return neighbours;
+}
+
+NeighbourMatrix Database::FindClosestShapesOfAll(int _k, bool _preciseKNN, unsigned int _threadCount)
+{
+	// One extra neighbour is searched for, since every model usually finds itself first
+	const NeighbourMatrix neighbours = FindClosestShapes(m_featureMatrix, _k + 1, _preciseKNN, _threadCount);
+
+	NeighbourMatrix closestShapes(neighbours.GetQueryCount(), _k);
+	std::vector<Neighbour> row;
+	for (size_t q = 0; q < neighbours.GetQueryCount(); q++)
+	{
+		row.clear();
+		for (size_t i = 0; i < neighbours.GetNeighbourCount(q); i++)
+		{
+			if (neighbours.GetIndices(q)[i] != static_cast<int>(q))
+				row.push_back({ neighbours.GetIndices(q)[i], neighbours.GetDistances(q)[i] });
+		}
+		closestShapes.SetNeighbours(q, row);
+	}
+	return closestShapes;
+}
+
 void Database::ComputeQualityMetrics()
 {
 	//eval::ComputeMeanAveragePrecision(*this, true);
@@ -327,6 +799,21 @@ void Database::ComputeQualityMetrics()
 	//eval::WritePerformance(*this, true);
 	//eval::WriteNNResults(*this, false);
 	//eval::WriteNNResults(*this, true);
+	//eval::BenchmarkShapeKernels();
+	//eval::BenchmarkEigenSolver();
+	//eval::BenchmarkFeatureSearch();
+	//eval::BenchmarkHistogramDistances();
+	//eval::BenchmarkCumulativeEmbedding();
+	//eval::BenchmarkBatchSearch();
+	//eval::BenchmarkSearchIndexes();
+	//eval::BenchmarkIndexUpdates();
+	//eval::BenchmarkPrunedSearch();
+	//eval::BenchmarkVantagePointTree();
+	//eval::BenchmarkCascadeSearch();
+	//eval::BenchmarkFilteredSearch();
+	//eval::BenchmarkReweightedSearch();
+	//eval::BenchmarkAnytimeSearch();
+	//eval::WriteIndexComparison(*this);
 }
 
 void Database::ComputeFeatureStandardization(DescriptorName _descriptorName)
@@ -351,82 +838,36 @@ void Database::ComputeFeatureStandardization(DescriptorName _descriptorName)
 
 void Database::ComputeHistogramFeatureWeights()
 {
-	std::vector<float> distancesA3;
-	std::vector<float> distancesD1;
-	std::vector<float> distancesD2;
-	std::vector<float> distancesD3;
-	std::vector<float> distancesD4;
+	// The weight of a histogram is one over the standard deviation of its distances between all pairs of models
+	const FeatureLayout& layout = m_featureMatrix.GetLayout();
+	const size_t rowCount = m_featureMatrix.GetRowCount();
+	std::vector<float> distances(rowCount);
 
-	WassersteinDistance wasserstein;
-	for (int i = 0; i < m_modelDatabase.size(); i++)
+	m_featureWeights.histograms.clear();
+	for (int h = 0; h < layout.histogramCount; h++)
 	{
-		for (int j = i+1; j < m_modelDatabase.size(); j++)
+		const int offset = layout.GetHistogramOffset(h);
+		double sum = 0;
+		double sumOfSquares = 0;
+		size_t pairCount = 0;
+		for (size_t i = 0; i + 1 < rowCount; i++)
 		{
-			HistogramFeature& a = m_modelDatabase[i].m_3DFeatures.a3;
-			HistogramFeature& b = m_modelDatabase[j].m_3DFeatures.a3;
-			float distanceA3 = wasserstein.distance(a, b);
-
-			a = m_modelDatabase[i].m_3DFeatures.d1;
-			b = m_modelDatabase[j].m_3DFeatures.d1;
-			float distanceD1 = wasserstein.distance(a, b);
-
-			a = m_modelDatabase[i].m_3DFeatures.d2;
-			b = m_modelDatabase[j].m_3DFeatures.d2;
-			float distanceD2 = wasserstein.distance(a, b);
-
-			a = m_modelDatabase[i].m_3DFeatures.d3;
-			b = m_modelDatabase[j].m_3DFeatures.d3;
-			float distanceD3 = wasserstein.distance(a, b);
-
-			a = m_modelDatabase[i].m_3DFeatures.d4;
-			b = m_modelDatabase[j].m_3DFeatures.d4;
-			float distanceD4 = wasserstein.distance(a, b);
-
-			distancesA3.push_back(distanceA3);
-			distancesD1.push_back(distanceD1);
-			distancesD2.push_back(distanceD2);
-			distancesD3.push_back(distanceD3);
-			distancesD4.push_back(distanceD4);
+			// Row i against all rows after it, reading the same histogram of every row with the matrix stride
+			const size_t count = rowCount - i - 1;
+			HistogramDistances(HistogramMetric::EARTH_MOVERS, m_featureMatrix.GetRow(i) + offset, m_featureMatrix.GetRow(i + 1) + offset,
+				m_featureMatrix.GetStride(), count, layout.binCount, distances.data());
+			for (size_t j = 0; j < count; j++)
+			{
+				sum += distances[j];
+				sumOfSquares += static_cast<double>(distances[j]) * distances[j];
+			}
+			pairCount += count;
 		}
-	}
 
-	float averageA3 = 0, averageD1 = 0, averageD2 = 0, averageD3 = 0, averageD4 = 0;
-	float stddevA3 = 0, stddevD1 = 0, stddevD2 = 0, stddevD3 = 0, stddevD4 = 0;
-
-	for (int i = 0; i < distancesA3.size(); i++)
-	{
-		averageA3 += distancesA3[i];
-		averageD1 += distancesD1[i];
-		averageD2 += distancesD2[i];
-		averageD3 += distancesD3[i];
-		averageD4 += distancesD4[i];
+		const double mean = sum / pairCount;
+		const double variance = (sumOfSquares - sum * mean) / (pairCount - 1);
+		m_featureWeights.histograms.push_back(static_cast<float>(1 / std::sqrt(variance)));
 	}
-	averageA3 /= distancesA3.size();
-	averageD1 /= distancesA3.size();
-	averageD2 /= distancesA3.size();
-	averageD3 /= distancesA3.size();
-	averageD4 /= distancesA3.size();
-
-	for (int i = 0; i < distancesA3.size(); i++)
-	{
-		stddevA3 += pow(distancesA3[i] - averageA3, 2);
-		stddevD1 += pow(distancesD1[i] - averageD1, 2);
-		stddevD2 += pow(distancesD2[i] - averageD2, 2);
-		stddevD3 += pow(distancesD3[i] - averageD3, 2);
-		stddevD4 += pow(distancesD4[i] - averageD4, 2);
-	}
-
-	stddevA3 = sqrt(stddevA3 / (distancesA3.size() - 1));
-	stddevD1 = sqrt(stddevD1 / (distancesD1.size() - 1));
-	stddevD2 = sqrt(stddevD2 / (distancesD2.size() - 1));
-	stddevD3 = sqrt(stddevD3 / (distancesD3.size() - 1));
-	stddevD4 = sqrt(stddevD4 / (distancesD4.size() - 1));
-
-	m_hist_weights.push_back(1 / stddevA3);
-	m_hist_weights.push_back(1 / stddevD1);
-	m_hist_weights.push_back(1 / stddevD2);
-	m_hist_weights.push_back(1 / stddevD3);
-	m_hist_weights.push_back(1 / stddevD4);
 }
 
 void Database::ComputeClassCounts()
@@ -442,22 +883,29 @@ void Database::ComputeClassCounts()
 
 void Database::LoadFeatureDatabase()
 {
-	const fs::path featureDatabasePath = fs::path("FeatureDatabase");
-
-	if (!fs::exists(featureDatabasePath))
+	// The whole store is read column by column, instead of opening a feature and a descriptor file per model
+	std::vector<io::FeatureRecord> records;
+	if (!OpenFeatureStore().Load(records))
 	{
 		std::cerr << "Loaded database without any features, please process to compute features" << std::endl;
 		return;
 	}
 
+	std::unordered_map<std::string, const io::FeatureRecord*> recordsByKey;
+	for (const io::FeatureRecord& record : records)
+		recordsByKey[record.key] = &record;
+
 	for (ModelDescriptor& modelDescriptor : m_modelDatabase)
 	{
-		fs::path featurePath = featureDatabasePath / modelDescriptor.m_path.filename().replace_extension(".csv");
-		if (fs::exists(featurePath))
+		auto record = recordsByKey.find(io::GetFeatureKey(modelDescriptor.m_path));
+		if (record != recordsByKey.end())
 		{
-			modelDescriptor.m_3DFeatures = ModelLoader::LoadFeatures(featurePath);
+			modelDescriptor.m_3DFeatures = record->second->features;
+			modelDescriptor.m_vertexCount = record->second->vertexCount;
+			modelDescriptor.m_faceCount = record->second->faceCount;
 		}
 	}
+	m_attributeIndex.Build(m_modelDatabase);
 
 	// Standardize single features
 	ComputeFeatureStandardization(VOLUME_3D);
@@ -474,15 +922,85 @@ void Database::LoadFeatureDatabase()
 	//analytics::ComputeFeatureDistribution("bounds_volume_norm.csv", BOUNDS_VOLUME_3D, *this);
 	//analytics::ComputeFeatureDistribution("eccentricity_norm.csv", ECCENTRICITY_3D, *this);
 
+	BuildFeatureMatrix();
+
 	// Compute histogram distance weights
 	//ComputeHistogramFeatureWeights();
-	m_hist_weights = { 2.03818, 1.14862, 2.13344, 1.71947, 2.04633 }; // Precomputed distance weights
-
-	ComputeFeatureVectors();
+	m_featureWeights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f }; // Precomputed distance weights
 	ComputeClassCounts();
 	emit featuresLoaded();
 }
 
+bool Database::SaveSnapshot(const fs::path& _path, const std::vector<fs::path>& _sourceFiles)
+{
+	FinishANNIndexRebuild(true);
+
+	DatabaseSnapshot snapshot;
+	snapshot.models = m_modelDatabase;
+	snapshot.featureAverages = m_singleFeatureAverage;
+	snapshot.featureStddevs = m_singleFeatureStddev;
+	snapshot.featureWeights = m_featureWeights;
+	snapshot.indexModels = m_index.models;
+	snapshot.modelIds = m_index.ids;
+	snapshot.indexUpdateCount = m_index.updateCount;
+	if (m_embedding.size() == m_modelDatabase.size())
+		snapshot.embedding = m_embedding;
+
+	// The feature matrix and the index are lent to the snapshot instead of copied, an index that was never built is left out
+	snapshot.featureMatrix = std::move(m_featureMatrix);
+	if (m_index.index->GetSize() > 0)
+		snapshot.index = std::move(m_index.index);
+	const bool saved = io::SaveSnapshot(_path, snapshot, GetSnapshotSources(_sourceFiles));
+	m_featureMatrix = std::move(snapshot.featureMatrix);
+	if (snapshot.index)
+		m_index.index = std::move(snapshot.index);
+	return saved;
+}
+
+bool Database::LoadSnapshot(const fs::path& _path, const std::vector<fs::path>& _sourceFiles)
+{
+	DatabaseSnapshot snapshot;
+	if (!io::LoadSnapshot(_path, _sourceFiles, m_indexSettings, snapshot))
+		return false;
+
+	m_rebuiltIndex = {};
+	m_pendingUpdates.clear();
+	m_modelDatabase = std::move(snapshot.models);
+	m_attributeIndex.Build(m_modelDatabase);
+	m_singleFeatureAverage = snapshot.featureAverages;
+	m_singleFeatureStddev = snapshot.featureStddevs;
+	m_featureMatrix = std::move(snapshot.featureMatrix);
+	m_distanceBounds = DistanceBounds(m_featureMatrix);
+	m_cascadeCalibrated = false;
+	m_featureWeights = std::move(snapshot.featureWeights);
+	m_embedding = std::move(snapshot.embedding);
+	m_classCounts.clear();
+	ComputeClassCounts();
+
+	if (snapshot.index)
+	{
+		m_index.index = std::move(snapshot.index);
+		m_index.models = std::move(snapshot.indexModels);
+		m_index.ids = std::move(snapshot.modelIds);
+		m_index.updateCount = snapshot.indexUpdateCount;
+	}
+	else
+	{
+		m_index.index = CreateSearchIndex(m_indexSettings);
+		BuildANNIndex();
+	}
+	emit snapshotLoaded();
+	return true;
+}
+
+std::vector<fs::path> Database::GetSnapshotSources(const std::vector<fs::path>& _sourceFiles) const
+{
+	std::vector<fs::path> sources = _sourceFiles;
+	for (const fs::path& columnPath : io::FeatureStore(io::FEATURE_STORE_DIRECTORY).GetColumnPaths())
+		sources.push_back(columnPath);
+	return sources;
+}
+
 void Database::CompoundHistogramPerClass()
 {
 	const fs::path featureDatabasePath = fs::path("FeatureDatabase");
@@ -490,13 +1008,12 @@ void Database::CompoundHistogramPerClass()
 	std::map<std::string, std::vector<ModelDescriptor>> classMap;
 	for (ModelDescriptor& modelDescriptor : m_modelDatabase)
 	{
-		if(!fs::exists(featureDatabasePath / modelDescriptor.m_path.filename().replace_extension(".csv")))
+		// The features were loaded from the feature store, models without them are left out
+		if (modelDescriptor.m_3DFeatures.a3.m_numBins == 0)
 		{
 			continue;
 		}
 		
-		modelDescriptor.m_3DFeatures = ModelLoader::LoadFeatures(featureDatabasePath / modelDescriptor.m_path.filename().replace_extension(".csv"));
-		
 		if(classMap.find(modelDescriptor.m_class) == classMap.end())
 		{
 			classMap.insert({ modelDescriptor.m_class, std::vector<ModelDescriptor>() });
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "FeatureMatrix.h"
+#include "ModelAttributeIndex.h"
 #include "ModelDescriptor.h"
+#include "Remeshing.h"
+#include "SearchIndex.h"
 
 #include <QObject>
-#include <flann/flann.hpp>
+#include <future>
 #include <memory>
 #include <vector>
 #include <string>
@@ -17,6 +21,53 @@ namespace std {
 
 class Model;
 
+/**
+ * @brief Settings that control how Database::ProcessAllModels distributes the work.
+*/
+struct ProcessingSettings
+{
+	/** Number of worker threads that process models concurrently, 0 picks the hardware concurrency and 1 processes serially */
+	unsigned int threadCount = 0;
+	/** Maximum number of meshes that are kept in memory at once, 0 allows one mesh per worker thread */
+	unsigned int maxModelsInMemory = 0;
+	/** How the shape distributions of the processed models are extracted */
+	ShapeDistributionSettings shapeDistributions;
+	/** Models with fewer vertices or faces are subdivided until they have this many before they are remeshed, 0 never subdivides */
+	unsigned int minElementCount = 1000;
+	/** Models with more faces are simplified to this many faces before they are remeshed, 0 keeps every face */
+	unsigned int maxFaceCount = 40000;
+	/** How newly loaded models are remeshed before they are normalized */
+	proc::RemeshSettings remeshing;
+};
+
+/**
+ * @brief Settings of the two-stage search of Database::FindClosestCascadeShapes.
+*/
+struct CascadeSettings
+{
+	/** Number of candidates per requested neighbour that are re-ranked by the composite distance */
+	float candidateFactor = 8.0f;
+	/** Whether candidateFactor is replaced by the smallest factor that reaches targetRecall, before the first search after the features change */
+	bool calibrate = true;
+	/** Share of the exact nearest neighbours the candidates should hold */
+	float targetRecall = 0.95f;
+	/** Number of requested neighbours the factor is calibrated for */
+	int calibrationK = 10;
+	/** Number of models that are searched exactly to calibrate the factor */
+	int calibrationQueryCount = 200;
+};
+
+/**
+ * @brief What a search of Database::FindClosestCascadeShapes did.
+*/
+struct CascadeStatistics
+{
+	/** Number of candidates that were re-ranked */
+	size_t candidateCount = 0;
+	/** Share of the exact nearest neighbours among the results, measured with the exact search */
+	float recall = 0;
+};
+
 class Database : public QObject
 {
 	Q_OBJECT
@@ -24,19 +75,21 @@ public:
 	Database();
 	~Database() = default;
 
-	enum class SortingOptions
-	{
-		VERTEX_COUNT,
-		FACE_COUNT,
-		BOUNDS
-	};
-	
 	/**
 	 * @brief Adds a model to the database.
+	 *		  Once the features are loaded, the model also gets a row in the feature matrix and is inserted into the ANN index,
+	 *		  so its features have to be computed already. They are standardized with the averages of the loaded models.
 	 * @param _model The model to be added.
 	*/
 	void AddModel(ModelDescriptor _model);
 
+	/**
+	 * @brief Removes a model, the models after it move up by one. Its row leaves the feature matrix right away,
+	 *		  the ANN index only leaves it out of its results until it is rebuilt.
+	 * @param _index The index of the model in GetModelDatabase().
+	*/
+	void RemoveModel(size_t _index);
+
 	/**
 	 * @brief Returns the list of all models.
 	 * @return All of the models in this database.
@@ -47,30 +100,165 @@ public:
 
 	ModelDescriptor FindModelByName(const std::string& _name);
 
+	/**
+	 * @brief Finds a model by name in constant time, see ModelAttributeIndex.
+	 * @return The index of the model in GetModelDatabase(), -1 if there is none.
+	*/
+	int FindModelIndex(const std::string& _name) const { return m_attributeIndex.FindModel(_name); }
+
+	/**
+	 * @brief Returns the indices of all models sorted by an attribute, the models themselves stay in place.
+	*/
+	const std::vector<int>& GetSortedModels(ModelAttribute _attribute) const { return m_attributeIndex.GetSortedModels(_attribute); }
+
+	/**
+	 * @brief Finds the models that meet a filter with the secondary indexes, see ModelAttributeIndex::Select.
+	 * @return The indices of the models in increasing order.
+	*/
+	std::vector<int> SelectModels(const ModelFilter& _filter) const { return m_attributeIndex.Select(_filter); }
+
 	/**
 	 * @brief Goes through each model and subdivides it if it is necessary and normalises it.
+	 *		  Models are independent of each other, so they are processed concurrently on a pool of worker threads.
+	 *		  Throughput and the time spent in each stage are reported once all models have been processed.
+	 * @param _settings The thread count and the cap on the number of meshes that are in memory at once.
 	*/
-	void ProcessAllModels();
+	void ProcessAllModels(const ProcessingSettings& _settings = ProcessingSettings());
 	void RemeshAllModels();
 	void SaveAllModels();
 	void NormalizeAllModels();
 	
+	FeatureVector ComputeFeatureVector(const ModelDescriptor& md);
+
 	/**
-	 * @brief Sorts the model database on the given SortingOptions.
-	 * @param _option The sorting option, current supports Vertex count, Face count and AABB cross section.
+	 * @brief Writes the standardized feature vector of a model to a row with the layout of the feature matrix.
+	 * @param _modelDescriptor The model, which does not have to be part of the database.
+	 * @param o_row The row to write, GetFeatureMatrix().GetColumnCount() floats.
 	*/
-	void SortDatabase(SortingOptions _option);
+	void FillFeatureRow(const ModelDescriptor& _modelDescriptor, float* o_row) const;
 
-	FeatureVector ComputeFeatureVector(const ModelDescriptor& md);
+	/**
+	 * @brief Returns the standardized feature vectors of all models, row i belongs to model i. Built by LoadFeatureDatabase.
+	*/
+	const FeatureMatrix& GetFeatureMatrix() const { return m_featureMatrix; }
+	const FeatureWeights& GetFeatureWeights() const { return m_featureWeights; }
+	/**
+	 * @brief Returns the distance FindClosestKNNShapes ranks with, the Earth mover's distance for every histogram,
+	 *		  as a starting point for a distance picked per query.
+	*/
+	QueryDistance GetDefaultQueryDistance() const { return { m_featureWeights, {} }; }
+
+	/**
+	 * @brief Selects the ANN index backend and its parameters, an index that was already built is rebuilt with them.
+	*/
+	void SetIndexSettings(const IndexSettings& _settings);
+	const IndexSettings& GetIndexSettings() const { return m_indexSettings; }
 
 	void BuildANNIndex();
+
+	/**
+	 * @brief Waits for a background rebuild of the ANN index to finish and puts it in place, see IndexSettings::rebuildThreshold.
+	*/
+	void WaitForANNIndexRebuild();
+	/**
+	 * @brief Finds the k models closest to a model by computing the composite distance to every row of the feature matrix.
+	 * @return The indices of the closest models, closest first. The closest match, which is the model itself, is skipped.
+	*/
 	std::vector<int> FindClosestKNNShapes(ModelDescriptor& md, int k);
+
+	/**
+	 * @brief Finds the k models closest to a model among the models that meet a filter, e.g. of the same class or within a range of vertex counts.
+	 *		  The filter selects the models with the secondary indexes first. A selective filter only ranks its models, otherwise the
+	 *		  pruned exact search skips the other models while it scans, so there are k results whenever k models meet the filter.
+	 * @return The indices of the closest models, closest first. The model itself is left out if it is part of the database.
+	*/
+	std::vector<int> FindClosestKNNShapes(ModelDescriptor& md, int k, const ModelFilter& _filter);
+
+	/**
+	 * @brief Finds the k models closest to a model under a distance picked for this query, e.g. with more weight on D2
+	 *		  or the chi-square distance for one of the histograms, see GetDefaultQueryDistance.
+	 *		  The pruned search reads the same feature matrix and bounds as every other query, so nothing is rebuilt for a new distance.
+	 * @return The indices of the closest models, closest first. The closest match, which is the model itself, is skipped.
+	*/
+	std::vector<int> FindClosestKNNShapes(ModelDescriptor& md, int k, const QueryDistance& _distance);
 	std::vector<int> FindClosestANNShapes(ModelDescriptor& md, int k);
 	std::vector<int> FindClosestANNShapesRadius(ModelDescriptor& md, float r);
 
+	/**
+	 * @brief Finds the k models closest to a model in two stages. The models with the smallest lower bounds of the composite distance,
+	 *		  which only read the scalars and the mean of every histogram, are the candidates, and they are re-ranked by the composite distance.
+	 *		  See CascadeSettings for the number of candidates.
+	 * @param o_statistics The number of candidates and the recall of the results, which costs an exact search, may be null.
+	 * @return The indices of the closest models, closest first. The closest match, which is the model itself, is skipped.
+	*/
+	std::vector<int> FindClosestCascadeShapes(ModelDescriptor& md, int k, CascadeStatistics* o_statistics = nullptr);
+
+	/**
+	 * @brief Finds the k models closest to a model within a latency budget, see FindNearestNeighboursAnytime.
+	 *		  The results are refined until the deadline and are exact if the search finished before it.
+	 *		  The shortlist of the ANN index is searched first unless the deadline has passed, and that search cannot be interrupted.
+	 * @param _deadline The time the search has to return by. It overshoots by at most one shortlist search, the first block of bounds
+	 *		  and the k seeds.
+	 * @param o_statistics Whether the results are exact and how much work was done, may be null.
+	 * @return The indices of the closest models, closest first. The closest match, which is the model itself, is skipped.
+	*/
+	std::vector<int> FindClosestAnytimeShapes(ModelDescriptor& md, int k, std::chrono::steady_clock::time_point _deadline,
+		AnytimeStatistics* o_statistics = nullptr);
+
+	/**
+	 * @brief Changes how many candidates the two-stage search re-ranks, a factor that was calibrated before is calibrated again.
+	*/
+	void SetCascadeSettings(const CascadeSettings& _settings);
+	const CascadeSettings& GetCascadeSettings() const { return m_cascadeSettings; }
+
+	/**
+	 * @brief Sets the candidate factor of the two-stage search to the smallest one that reaches the target recall for a sample of the models,
+	 *		  see CalibrateCandidateCount.
+	 * @return The new factor.
+	*/
+	float CalibrateCascade();
+
+	/**
+	 * @brief Finds the closest models of a batch of feature rows at once, see FillFeatureRow.
+	 *		  The queries are split over a thread pool and each one is searched on its own, so the results do not depend on the number of threads.
+	 * @param _queries Rows with the layout of GetFeatureMatrix().
+	 * @param _k The number of models to find per query.
+	 * @param _preciseKNN Whether to search the feature matrix exactly, see FindNearestNeighboursPruned, or to search the ANN index and re-rank its candidates.
+	 * @param _threadCount The number of worker threads, 0 picks util::DefaultThreadCount().
+	 * @return The indices and composite distances of the closest models of every query, closest first.
+	*/
+	NeighbourMatrix FindClosestShapes(const FeatureMatrix& _queries, int _k, bool _preciseKNN, unsigned int _threadCount = 0);
+
+	/**
+	 * @brief Finds the closest models of every model in the database, see FindClosestShapes.
+	 * @return Row i holds the closest models of model i, the model itself is left out.
+	*/
+	NeighbourMatrix FindClosestShapesOfAll(int _k, bool _preciseKNN, unsigned int _threadCount = 0);
+
 	void ComputeQualityMetrics();
 	void LoadFeatureDatabase();
 
+	/**
+	 * @brief Writes the models, their features, the feature matrix, the ANN index and the embedding to one binary file, see io::SaveSnapshot.
+	 *		  The columns of the feature store are recorded as sources after _sourceFiles.
+	 * @param _sourceFiles The files the models were read from.
+	*/
+	bool SaveSnapshot(const std::filesystem::path& _path, const std::vector<std::filesystem::path>& _sourceFiles);
+
+	/**
+	 * @brief Replaces all models with a snapshot written by SaveSnapshot, unless any file it was made from changed since.
+	 *		  Nothing is computed again, only an ANN index of another backend is rebuilt. Emits snapshotLoaded instead of featuresLoaded.
+	 * @param _sourceFiles The files the snapshot has to be made from, the same that were passed to SaveSnapshot.
+	 * @return Whether the snapshot was loaded, the database is unchanged otherwise.
+	*/
+	bool LoadSnapshot(const std::filesystem::path& _path, const std::vector<std::filesystem::path>& _sourceFiles);
+
+	/**
+	 * @brief Keeps the 2D embedding of the models, so snapshots can restore it instead of computing it again.
+	*/
+	void SetEmbedding(const std::vector<glm::vec2>& _embedding) { m_embedding = _embedding; }
+	const std::vector<glm::vec2>& GetEmbedding() const { return m_embedding; }
+
 	Features3D& getFeatureAverages() { return m_singleFeatureAverage; }
 	Features3D& getFeatureStddevs() { return m_singleFeatureStddev; }
 
@@ -79,13 +267,34 @@ public slots:
 
 signals:
 	void featuresLoaded();
+	void snapshotLoaded();
 
 private:
 	void ComputeFeatureStandardization(DescriptorName _descriptorName);
 	void ComputeHistogramFeatureWeights();
 	void ComputeClassCounts();
-	void ComputeFeatureVectors();
+	void BuildFeatureMatrix();
+	/**
+	 * @brief Searches the ANN index for a shortlist of candidates and re-ranks them by the composite distance.
+	 * @param _query A row with the layout of the feature matrix.
+	*/
+	std::vector<Neighbour> SearchANNIndex(const float* _query, size_t _k);
+
+	/**
+	 * @brief Starts a background rebuild of the ANN index once enough models were added or removed since it was built.
+	*/
+	void MaintainANNIndex();
+	/**
+	 * @brief Replaces the ANN index with the one rebuilt in the background, after it caught up with the models that
+	 *		  were added and removed in the meantime.
+	 * @param _wait Whether to wait for the rebuild, otherwise an unfinished rebuild is left running.
+	*/
+	void FinishANNIndexRebuild(bool _wait);
 	void CompoundHistogramPerClass();
+	/**
+	 * @brief The files a snapshot of the models is made from, _sourceFiles followed by the columns of the feature store.
+	*/
+	std::vector<std::filesystem::path> GetSnapshotSources(const std::vector<std::filesystem::path>& _sourceFiles) const;
 	
 	std::shared_ptr<Model> LoadSavedModel(std::filesystem::path _modelFileName);
 	
@@ -95,8 +304,56 @@ private:
 	Features3D m_singleFeatureAverage;
 	Features3D m_singleFeatureStddev;
 
-	std::vector<float> m_hist_weights;
+	/** Standardized feature vectors of all models */
+	FeatureMatrix m_featureMatrix;
+	/** Name lookup and sorted secondary indexes over the models, kept in sync with m_modelDatabase */
+	ModelAttributeIndex m_attributeIndex;
+	/** Summaries of the rows of m_featureMatrix for the exact search, kept in sync with it */
+	DistanceBounds m_distanceBounds;
+	FeatureWeights m_featureWeights;
+
+	/**
+	 * @brief An ANN index and which model every row of it belongs to. Added models get new ids and removed ones leave gaps,
+	 *		  so the ids only match the models right after the index is built.
+	*/
+	struct ModelIndex
+	{
+		std::unique_ptr<SearchIndex> index;
+		/** Model of every id of the index, -1 for removed models */
+		std::vector<int> models;
+		/** Id of every model */
+		std::vector<int> ids;
+		/** Number of models added or removed since the index was built */
+		size_t updateCount = 0;
+
+		/** Matches id i with model i, for an index that was just built */
+		void Reset();
+		void Insert(const float* _embeddedRow);
+		void Remove(size_t _model);
+	};
+
+	/**
+	 * @brief A model added or removed while the ANN index is rebuilt in the background, the rebuilt index replays it.
+	*/
+	struct IndexUpdate
+	{
+		/** The removed model, or -1 if a model was added */
+		int removedModel;
+		/** Embedded row of the added model */
+		std::vector<float> embeddedRow;
+	};
+
+	IndexSettings m_indexSettings;
+	/** ANN search index over the rows of m_featureMatrix embedded by EmbedCumulative, its L1 distance approximates the composite distance from below */
+	ModelIndex m_index;
+	/** The ANN index that is being rebuilt, invalid when no rebuild is running */
+	std::future<std::unique_ptr<SearchIndex>> m_rebuiltIndex;
+	std::vector<IndexUpdate> m_pendingUpdates;
+
+	CascadeSettings m_cascadeSettings;
+	/** Whether the candidate factor of the two-stage search was calibrated for the current features */
+	bool m_cascadeCalibrated = false;
 
-	/** ANN search index*/
-	flann::Index<flann::L2<float>> m_index;
+	/** 2D embedding of the models, only valid while it has one point per model */
+	std::vector<glm::vec2> m_embedding;
 };
@@ -0,0 +1,290 @@
+#include "DatabaseSnapshot.h"
+
+#include "BinaryStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr char SNAPSHOT_MAGIC[4] = { 'M', 'S', 'D', 'B' };
+	/** Raised whenever the content of the snapshot or the meaning of the features change, older snapshots are then rebuilt */
+	constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+	/**
+	 * @brief What a snapshot remembers of a file it was made from, a missing file has size -1.
+	*/
+	struct SourceFile
+	{
+		std::string path;
+		int64_t size;
+		int64_t modificationTime;
+
+		bool operator==(const SourceFile& _other) const
+		{
+			return path == _other.path && size == _other.size && modificationTime == _other.modificationTime;
+		}
+	};
+
+	SourceFile GetSourceFile(const fs::path& _path)
+	{
+		SourceFile sourceFile = { _path.string(), -1, 0 };
+		std::error_code error;
+		const uintmax_t size = fs::file_size(_path, error);
+		if (error)
+			return sourceFile;
+
+		const fs::file_time_type modificationTime = fs::last_write_time(_path, error);
+		if (error)
+			return sourceFile;
+
+		sourceFile.size = static_cast<int64_t>(size);
+		sourceFile.modificationTime = static_cast<int64_t>(modificationTime.time_since_epoch().count());
+		return sourceFile;
+	}
+
+	void WriteHistogram(std::ostream& _stream, const HistogramFeature& _histogram)
+	{
+		util::WriteValue<int32_t>(_stream, _histogram.m_numBins);
+		util::WriteValue(_stream, _histogram.m_min);
+		util::WriteValue(_stream, _histogram.m_max);
+		util::WriteValue<int32_t>(_stream, _histogram.m_sampleCount);
+		util::WriteValue<uint64_t>(_stream, _histogram.size());
+		_stream.write(reinterpret_cast<const char*>(_histogram.data()), _histogram.size() * sizeof(float));
+	}
+
+	/** @return False if the stream failed or the bin count does not match the values */
+	bool ReadHistogram(std::istream& _stream, HistogramFeature& o_histogram)
+	{
+		int32_t binCount = 0;
+		int32_t sampleCount = 0;
+		std::vector<float> values;
+		util::ReadValue(_stream, binCount);
+		util::ReadValue(_stream, o_histogram.m_min);
+		util::ReadValue(_stream, o_histogram.m_max);
+		util::ReadValue(_stream, sampleCount);
+		util::ReadVector(_stream, values);
+		if (!_stream || binCount < 0 || static_cast<size_t>(binCount) != values.size())
+			return false;
+
+		o_histogram.m_numBins = binCount;
+		o_histogram.m_sampleCount = sampleCount;
+		o_histogram.resize(binCount);
+		std::copy(values.begin(), values.end(), o_histogram.data());
+		return true;
+	}
+
+	void WriteFeatures(std::ostream& _stream, const Features3D& _features)
+	{
+		// Sorted by descriptor, so the same features always give the same bytes
+		std::vector<std::pair<int32_t, float>> scalars(_features.m_singleFeatures.begin(), _features.m_singleFeatures.end());
+		std::sort(scalars.begin(), scalars.end());
+		util::WriteVector(_stream, scalars);
+		util::WriteValue(_stream, _features.bounds);
+		for (const HistogramFeature* histogram : { &_features.a3, &_features.d1, &_features.d2, &_features.d3, &_features.d4 })
+			WriteHistogram(_stream, *histogram);
+	}
+
+	bool ReadFeatures(std::istream& _stream, Features3D& o_features)
+	{
+		std::vector<std::pair<int32_t, float>> scalars;
+		util::ReadVector(_stream, scalars);
+		o_features.m_singleFeatures.clear();
+		for (const std::pair<int32_t, float>& scalar : scalars)
+			o_features.m_singleFeatures[static_cast<DescriptorName>(scalar.first)] = scalar.second;
+
+		util::ReadValue(_stream, o_features.bounds);
+		for (HistogramFeature* histogram : { &o_features.a3, &o_features.d1, &o_features.d2, &o_features.d3, &o_features.d4 })
+		{
+			if (!ReadHistogram(_stream, *histogram))
+				return false;
+		}
+		return true;
+	}
+
+	void WriteModel(std::ostream& _stream, const ModelDescriptor& _model)
+	{
+		util::WriteString(_stream, _model.m_name);
+		util::WriteString(_stream, _model.m_path.string());
+		util::WriteString(_stream, _model.m_class);
+		util::WriteValue<uint64_t>(_stream, _model.m_vertexCount);
+		util::WriteValue<uint64_t>(_stream, _model.m_faceCount);
+		util::WriteValue(_stream, _model.m_bounds);
+		WriteFeatures(_stream, _model.m_3DFeatures);
+	}
+
+	bool ReadModel(std::istream& _stream, ModelDescriptor& o_model)
+	{
+		std::string path;
+		uint64_t vertexCount = 0;
+		uint64_t faceCount = 0;
+		util::ReadString(_stream, o_model.m_name);
+		util::ReadString(_stream, path);
+		util::ReadString(_stream, o_model.m_class);
+		util::ReadValue(_stream, vertexCount);
+		util::ReadValue(_stream, faceCount);
+		util::ReadValue(_stream, o_model.m_bounds);
+		if (!ReadFeatures(_stream, o_model.m_3DFeatures))
+			return false;
+
+		o_model.m_path = path;
+		o_model.m_vertexCount = vertexCount;
+		o_model.m_faceCount = faceCount;
+		return true;
+	}
+
+	void WriteFeatureMatrix(std::ostream& _stream, const FeatureMatrix& _matrix)
+	{
+		const FeatureLayout& layout = _matrix.GetLayout();
+		util::WriteValue<int32_t>(_stream, layout.scalarCount);
+		util::WriteValue<int32_t>(_stream, layout.histogramCount);
+		util::WriteValue<int32_t>(_stream, layout.binCount);
+		util::WriteValue<uint64_t>(_stream, _matrix.GetRowCount() * _matrix.GetStride());
+		if (_matrix.GetRowCount() > 0)
+			_stream.write(reinterpret_cast<const char*>(_matrix.GetRow(0)), _matrix.GetRowCount() * _matrix.GetStride() * sizeof(float));
+	}
+
+	bool ReadFeatureMatrix(std::istream& _stream, FeatureMatrix& o_matrix)
+	{
+		int32_t scalarCount = 0;
+		int32_t histogramCount = 0;
+		int32_t binCount = 0;
+		std::vector<float> rows;
+		util::ReadValue(_stream, scalarCount);
+		util::ReadValue(_stream, histogramCount);
+		util::ReadValue(_stream, binCount);
+		util::ReadVector(_stream, rows);
+		if (!_stream || scalarCount < 0 || histogramCount < 0 || binCount < 0 || scalarCount + histogramCount * binCount == 0)
+			return false;
+
+		FeatureLayout layout;
+		layout.scalarCount = scalarCount;
+		layout.histogramCount = histogramCount;
+		layout.binCount = binCount;
+		o_matrix = FeatureMatrix(0, layout);
+		if (rows.size() % o_matrix.GetStride() != 0)
+			return false;
+
+		o_matrix = FeatureMatrix(rows.size() / o_matrix.GetStride(), layout);
+		if (!rows.empty())
+			std::memcpy(o_matrix.GetRow(0), rows.data(), rows.size() * sizeof(float));
+		return true;
+	}
+}
+
+namespace io
+{
+	bool SaveSnapshot(const fs::path& _path, const DatabaseSnapshot& _snapshot, const std::vector<fs::path>& _sourceFiles)
+	{
+		std::ofstream file(_path, std::ios::binary);
+		file.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+		util::WriteValue(file, SNAPSHOT_VERSION);
+
+		util::WriteValue<uint64_t>(file, _sourceFiles.size());
+		for (const fs::path& sourcePath : _sourceFiles)
+		{
+			const SourceFile sourceFile = GetSourceFile(sourcePath);
+			util::WriteString(file, sourceFile.path);
+			util::WriteValue(file, sourceFile.size);
+			util::WriteValue(file, sourceFile.modificationTime);
+		}
+
+		util::WriteValue<uint64_t>(file, _snapshot.models.size());
+		for (const ModelDescriptor& model : _snapshot.models)
+			WriteModel(file, model);
+		WriteFeatures(file, _snapshot.featureAverages);
+		WriteFeatures(file, _snapshot.featureStddevs);
+		WriteFeatureMatrix(file, _snapshot.featureMatrix);
+		util::WriteValue(file, _snapshot.featureWeights.scalar);
+		util::WriteVector(file, _snapshot.featureWeights.histograms);
+
+		// The index is written as one block, so a snapshot with another backend can skip it
+		std::ostringstream index;
+		if (_snapshot.index)
+			_snapshot.index->Write(index);
+		util::WriteString(file, index.str());
+		util::WriteVector(file, _snapshot.indexModels);
+		util::WriteVector(file, _snapshot.modelIds);
+		util::WriteValue(file, _snapshot.indexUpdateCount);
+
+		util::WriteVector(file, _snapshot.embedding);
+		return static_cast<bool>(file);
+	}
+
+	bool LoadSnapshot(const fs::path& _path, const std::vector<fs::path>& _requiredSources, const IndexSettings& _indexSettings, DatabaseSnapshot& o_snapshot)
+	{
+		std::ifstream file(_path, std::ios::binary);
+		char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+		uint32_t version = 0;
+		uint64_t sourceCount = 0;
+		file.read(magic, sizeof(magic));
+		util::ReadValue(file, version);
+		util::ReadValue(file, sourceCount);
+		if (!file || std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 || version != SNAPSHOT_VERSION || sourceCount < _requiredSources.size())
+			return false;
+
+		// The source files are checked before the rest of the snapshot is read, so a stale snapshot costs little
+		for (uint64_t i = 0; i < sourceCount; i++)
+		{
+			SourceFile sourceFile;
+			util::ReadString(file, sourceFile.path);
+			util::ReadValue(file, sourceFile.size);
+			util::ReadValue(file, sourceFile.modificationTime);
+			if (!file || (i < _requiredSources.size() && sourceFile.path != _requiredSources[i].string()) || !(GetSourceFile(sourceFile.path) == sourceFile))
+				return false;
+		}
+
+		// The rest is read at once and parsed from memory
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+
+		uint64_t modelCount = 0;
+		util::ReadValue(buffer, modelCount);
+		if (!buffer)
+			return false;
+
+		o_snapshot.models.clear();
+		for (uint64_t i = 0; i < modelCount; i++)
+		{
+			o_snapshot.models.emplace_back();
+			if (!ReadModel(buffer, o_snapshot.models.back()))
+				return false;
+		}
+		if (!ReadFeatures(buffer, o_snapshot.featureAverages) || !ReadFeatures(buffer, o_snapshot.featureStddevs)
+			|| !ReadFeatureMatrix(buffer, o_snapshot.featureMatrix) || o_snapshot.featureMatrix.GetRowCount() != modelCount)
+			return false;
+		util::ReadValue(buffer, o_snapshot.featureWeights.scalar);
+		util::ReadVector(buffer, o_snapshot.featureWeights.histograms);
+
+		std::string index;
+		util::ReadString(buffer, index);
+		util::ReadVector(buffer, o_snapshot.indexModels);
+		util::ReadVector(buffer, o_snapshot.modelIds);
+		util::ReadValue(buffer, o_snapshot.indexUpdateCount);
+		util::ReadVector(buffer, o_snapshot.embedding);
+		if (!buffer || static_cast<int>(o_snapshot.featureWeights.histograms.size()) != o_snapshot.featureMatrix.GetLayout().histogramCount
+			|| (!o_snapshot.embedding.empty() && o_snapshot.embedding.size() != modelCount))
+			return false;
+
+		// An index of another backend, or one that does not match the models, is left out and the database builds a new one
+		o_snapshot.index = CreateSearchIndex(_indexSettings);
+		std::istringstream indexStream(index);
+		const bool validIds = o_snapshot.modelIds.size() == modelCount
+			&& std::all_of(o_snapshot.modelIds.begin(), o_snapshot.modelIds.end(), [&](int _id) { return _id >= 0 && static_cast<size_t>(_id) < o_snapshot.indexModels.size(); })
+			&& std::all_of(o_snapshot.indexModels.begin(), o_snapshot.indexModels.end(), [&](int _model) { return _model >= -1 && static_cast<uint64_t>(_model + 1) <= modelCount; });
+		const size_t dimension = GetCumulativeLayout(o_snapshot.featureMatrix.GetLayout()).GetColumnCount();
+		if (index.empty() || !validIds || !o_snapshot.index->Read(indexStream) || o_snapshot.index->GetSize() != o_snapshot.indexModels.size()
+			|| (o_snapshot.index->GetSize() > 0 && o_snapshot.index->GetDimension() != dimension))
+		{
+			o_snapshot.index.reset();
+			o_snapshot.indexModels.clear();
+			o_snapshot.modelIds.clear();
+			o_snapshot.indexUpdateCount = 0;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "FeatureMatrix.h"
+#include "ModelDescriptor.h"
+#include "SearchIndex.h"
+
+#include <glm/glm.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Everything the database derives from the classification, descriptor and feature files of a model collection,
+ *		  so it can be restored from one binary file instead of parsing thousands of text files and rebuilding the index.
+*/
+struct DatabaseSnapshot
+{
+	std::vector<ModelDescriptor> models;
+	Features3D featureAverages;
+	Features3D featureStddevs;
+	/** Standardized feature vectors, row i belongs to model i */
+	FeatureMatrix featureMatrix;
+	FeatureWeights featureWeights;
+
+	/** The ANN index over the embedded rows, null if the database had not built one or it has a different backend */
+	std::unique_ptr<SearchIndex> index;
+	/** Model of every id of the index, -1 for removed models */
+	std::vector<int> indexModels;
+	/** Id of every model in the index */
+	std::vector<int> modelIds;
+	/** Number of models added or removed since the index was built */
+	uint64_t indexUpdateCount = 0;
+
+	/** 2D embedding of the models, empty if none was computed */
+	std::vector<glm::vec2> embedding;
+};
+
+namespace io
+{
+	/**
+	 * @brief Writes a snapshot together with the size and modification time of the files it was made from.
+	 * @param _sourceFiles The files the snapshot was made from, files that do not exist are recorded as missing.
+	 * @return Whether the file could be written.
+	*/
+	bool SaveSnapshot(const std::filesystem::path& _path, const DatabaseSnapshot& _snapshot, const std::vector<std::filesystem::path>& _sourceFiles);
+
+	/**
+	 * @brief Reads a snapshot written by SaveSnapshot, unless it is stale.
+	 *		  A snapshot is stale when it was written by another version, was made from other files than the required ones,
+	 *		  or when any file it was made from changed size or modification time, appeared or disappeared since.
+	 * @param _requiredSources Files the snapshot has to be made from, in the order they were passed to SaveSnapshot.
+	 * @param _indexSettings The backend of an index in the snapshot has to match, its search settings are applied.
+	 * @return Whether the snapshot was read, o_snapshot is unspecified otherwise.
+	*/
+	bool LoadSnapshot(const std::filesystem::path& _path, const std::vector<std::filesystem::path>& _requiredSources, const IndexSettings& _indexSettings,
+		DatabaseSnapshot& o_snapshot);
+}
@@ -0,0 +1,333 @@
+#include "Decimation.h"
+
+#include "HalfEdgeMesh.h"
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	/** Weight of the planes that hold boundary edges in place, relative to the planes of the faces */
+	constexpr double BOUNDARY_WEIGHT = 100.0;
+
+	/** The optimal position is only used if the quadric is this far from singular, relative to its scale */
+	constexpr double SINGULAR_TOLERANCE = 1e-9;
+
+	/**
+	 * @brief Symmetric 4x4 matrix Q of the error v^T Q v of a position v = (x, y, z, 1), stored as its upper triangle.
+	*/
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+
+		/**
+		 * @brief The weighted squared distance to the plane n . p + d = 0, n must have unit length.
+		*/
+		static Quadric FromPlane(const glm::dvec3& _normal, double _d, double _weight)
+		{
+			Quadric quadric;
+			quadric.a2 = _weight * _normal.x * _normal.x;
+			quadric.ab = _weight * _normal.x * _normal.y;
+			quadric.ac = _weight * _normal.x * _normal.z;
+			quadric.ad = _weight * _normal.x * _d;
+			quadric.b2 = _weight * _normal.y * _normal.y;
+			quadric.bc = _weight * _normal.y * _normal.z;
+			quadric.bd = _weight * _normal.y * _d;
+			quadric.c2 = _weight * _normal.z * _normal.z;
+			quadric.cd = _weight * _normal.z * _d;
+			quadric.d2 = _weight * _d * _d;
+			return quadric;
+		}
+
+		Quadric& operator+=(const Quadric& _other)
+		{
+			a2 += _other.a2; ab += _other.ab; ac += _other.ac; ad += _other.ad;
+			b2 += _other.b2; bc += _other.bc; bd += _other.bd;
+			c2 += _other.c2; cd += _other.cd;
+			d2 += _other.d2;
+			return *this;
+		}
+
+		double Evaluate(const glm::dvec3& _p) const
+		{
+			return a2 * _p.x * _p.x + 2 * ab * _p.x * _p.y + 2 * ac * _p.x * _p.z + 2 * ad * _p.x
+				+ b2 * _p.y * _p.y + 2 * bc * _p.y * _p.z + 2 * bd * _p.y
+				+ c2 * _p.z * _p.z + 2 * cd * _p.z
+				+ d2;
+		}
+
+		/**
+		 * @brief Finds the position with the smallest error by solving A p = -b.
+		 * @return Whether the system was well conditioned enough to solve.
+		*/
+		bool Minimize(glm::dvec3& o_position) const
+		{
+			const glm::dmat3 a(a2, ab, ac, ab, b2, bc, ac, bc, c2);
+			const double scale = a2 + b2 + c2;
+			const double determinant = glm::determinant(a);
+			if (!(std::abs(determinant) > SINGULAR_TOLERANCE * scale * scale * scale))
+				return false;
+
+			o_position = -(glm::inverse(a) * glm::dvec3(ad, bd, cd));
+			return true;
+		}
+	};
+
+	/**
+	 * @brief Binary min heap of edges that knows where every edge is, so the cost of an edge can be changed in place.
+	*/
+	class EdgeHeap
+	{
+	public:
+		explicit EdgeHeap(int _edgeCount) :
+			m_cost(_edgeCount, 0),
+			m_position(_edgeCount, HalfEdgeMesh::INVALID)
+		{ }
+
+		bool IsEmpty() const { return m_heap.empty(); }
+
+		/**
+		 * @brief Inserts the edge, or moves it if it is already in the heap.
+		*/
+		void Update(int _edge, double _cost)
+		{
+			m_cost[_edge] = _cost;
+			if (m_position[_edge] == HalfEdgeMesh::INVALID)
+			{
+				m_position[_edge] = static_cast<int>(m_heap.size());
+				m_heap.push_back(_edge);
+			}
+			SiftDown(SiftUp(m_position[_edge]));
+		}
+
+		int Pop()
+		{
+			const int edge = m_heap[0];
+			Swap(0, static_cast<int>(m_heap.size()) - 1);
+			m_heap.pop_back();
+			m_position[edge] = HalfEdgeMesh::INVALID;
+			if (!m_heap.empty())
+				SiftDown(0);
+			return edge;
+		}
+
+	private:
+		void Swap(int _i, int _j)
+		{
+			std::swap(m_heap[_i], m_heap[_j]);
+			m_position[m_heap[_i]] = _i;
+			m_position[m_heap[_j]] = _j;
+		}
+
+		int SiftUp(int _index)
+		{
+			while (_index > 0)
+			{
+				const int parent = (_index - 1) / 2;
+				if (m_cost[m_heap[parent]] <= m_cost[m_heap[_index]])
+					break;
+				Swap(_index, parent);
+				_index = parent;
+			}
+			return _index;
+		}
+
+		void SiftDown(int _index)
+		{
+			const int size = static_cast<int>(m_heap.size());
+			while (true)
+			{
+				int smallest = _index;
+				for (int child = 2 * _index + 1; child <= 2 * _index + 2 && child < size; child++)
+					if (m_cost[m_heap[child]] < m_cost[m_heap[smallest]])
+						smallest = child;
+				if (smallest == _index)
+					return;
+				Swap(_index, smallest);
+				_index = smallest;
+			}
+		}
+
+		std::vector<int> m_heap;
+		/** Cost of every edge, indexed by edge */
+		std::vector<double> m_cost;
+		/** Index of every edge in m_heap, INVALID if it is not in the heap */
+		std::vector<int> m_position;
+	};
+
+	/**
+	 * @brief State of one simplification run, the half-edge mesh with the quadric of every vertex and the collapse queue.
+	*/
+	class Decimator
+	{
+	public:
+		explicit Decimator(const Mesh& _mesh) :
+			m_mesh(_mesh),
+			m_quadrics(m_mesh.GetVertexCount()),
+			m_targets(m_mesh.GetEdgeCount()),
+			m_heap(m_mesh.GetEdgeCount()),
+			m_faceCount(0)
+		{
+			for (int f = 0; f < m_mesh.GetFaceCount(); f++)
+			{
+				if (m_mesh.IsDeletedFace(f))
+					continue;
+				m_faceCount++;
+
+				// Area weighted, so the error of a large face counts more than that of a sliver
+				const int halfEdge = m_mesh.FaceHalfEdge(f);
+				const glm::dvec3 areaNormal = glm::dvec3(m_mesh.FaceAreaNormal(f));
+				const double doubleArea = glm::length(areaNormal);
+				if (doubleArea == 0)
+					continue;
+				const glm::dvec3 normal = areaNormal / doubleArea;
+				const Quadric quadric = Quadric::FromPlane(normal, -glm::dot(normal, glm::dvec3(m_mesh.Position(m_mesh.Source(halfEdge)))), 0.5 * doubleArea);
+				m_quadrics[m_mesh.Source(halfEdge)] += quadric;
+				m_quadrics[m_mesh.Target(halfEdge)] += quadric;
+				m_quadrics[m_mesh.Target(m_mesh.Next(halfEdge))] += quadric;
+			}
+
+			// Planes through the boundary edges, perpendicular to their face
+			for (int h = 0; h < 2 * m_mesh.GetEdgeCount(); h++)
+			{
+				if (!m_mesh.IsBoundaryHalfEdge(m_mesh.Twin(h)))
+					continue;
+
+				const glm::dvec3 p0 = glm::dvec3(m_mesh.Position(m_mesh.Source(h)));
+				const glm::dvec3 edge = glm::dvec3(m_mesh.Position(m_mesh.Target(h))) - p0;
+				const glm::dvec3 perpendicular = glm::cross(edge, glm::dvec3(m_mesh.FaceAreaNormal(m_mesh.Face(h))));
+				const double length = glm::length(perpendicular);
+				if (length == 0)
+					continue;
+				const glm::dvec3 normal = perpendicular / length;
+				const Quadric quadric = Quadric::FromPlane(normal, -glm::dot(normal, p0), BOUNDARY_WEIGHT * glm::dot(edge, edge));
+				m_quadrics[m_mesh.Source(h)] += quadric;
+				m_quadrics[m_mesh.Target(h)] += quadric;
+			}
+
+			for (int e = 0; e < m_mesh.GetEdgeCount(); e++)
+				UpdateEdge(e);
+		}
+
+		void Run(size_t _targetFaceCount)
+		{
+			while (m_faceCount > _targetFaceCount && !m_heap.IsEmpty())
+			{
+				// Edges that cannot be collapsed now leave the queue, until a collapse next to them changes their cost
+				const int edge = m_heap.Pop();
+				if (m_mesh.IsDeletedEdge(edge))
+					continue;
+
+				const glm::vec3 target = m_targets[edge];
+				int halfEdge = 2 * edge;
+				if (!CanCollapse(halfEdge, target))
+				{
+					halfEdge = m_mesh.Twin(halfEdge);
+					if (!CanCollapse(halfEdge, target))
+						continue;
+				}
+
+				const int kept = m_mesh.Target(halfEdge);
+				const int removed = m_mesh.Source(halfEdge);
+				m_faceCount -= (m_mesh.IsBoundaryHalfEdge(halfEdge) ? 0 : 1) + (m_mesh.IsBoundaryHalfEdge(m_mesh.Twin(halfEdge)) ? 0 : 1);
+				m_quadrics[kept] += m_quadrics[removed];
+				m_mesh.Collapse(halfEdge);
+				m_mesh.Position(kept) = target;
+
+				m_mesh.ForEachOutgoing(kept, [&](int _outgoing) { UpdateEdge(_outgoing / 2); });
+			}
+		}
+
+		void ToMesh(Mesh& o_mesh) const
+		{
+			m_mesh.ToMesh(o_mesh);
+		}
+
+	private:
+		void UpdateEdge(int _edge)
+		{
+			if (m_mesh.IsDeletedEdge(_edge))
+				return;
+
+			const int v0 = m_mesh.Source(2 * _edge);
+			const int v1 = m_mesh.Target(2 * _edge);
+			Quadric quadric = m_quadrics[v0];
+			quadric += m_quadrics[v1];
+
+			// Fall back to the best of the end points and the midpoint if the optimum is not well defined
+			glm::dvec3 target;
+			if (!quadric.Minimize(target))
+			{
+				const glm::dvec3 p0 = glm::dvec3(m_mesh.Position(v0));
+				const glm::dvec3 p1 = glm::dvec3(m_mesh.Position(v1));
+				const glm::dvec3 candidates[3] = { p0, p1, 0.5 * (p0 + p1) };
+				target = candidates[0];
+				for (const glm::dvec3& candidate : candidates)
+					if (quadric.Evaluate(candidate) < quadric.Evaluate(target))
+						target = candidate;
+			}
+
+			m_targets[_edge] = glm::vec3(target);
+			m_heap.Update(_edge, quadric.Evaluate(target));
+		}
+
+		bool CanCollapse(int _halfEdge, const glm::vec3& _target) const
+		{
+			return m_mesh.IsCollapseOk(_halfEdge)
+				&& !TurnsOver(m_mesh.Source(_halfEdge), m_mesh.Target(_halfEdge), _target)
+				&& !TurnsOver(m_mesh.Target(_halfEdge), m_mesh.Source(_halfEdge), _target);
+		}
+
+		/**
+		 * @brief Whether a face around the vertex that survives the collapse turns over or vanishes when the vertex moves to _target.
+		*/
+		bool TurnsOver(int _vertex, int _other, const glm::vec3& _target) const
+		{
+			const glm::vec3& position = m_mesh.Position(_vertex);
+			bool turnsOver = false;
+			m_mesh.ForEachOutgoing(_vertex, [&](int _outgoing)
+			{
+				if (turnsOver || m_mesh.IsBoundaryHalfEdge(_outgoing))
+					return;
+
+				const int n1 = m_mesh.Target(_outgoing);
+				const int n2 = m_mesh.Target(m_mesh.Next(_outgoing));
+				if (n1 == _other || n2 == _other)
+					return;
+
+				const glm::vec3& p1 = m_mesh.Position(n1);
+				const glm::vec3& p2 = m_mesh.Position(n2);
+				const glm::vec3 before = glm::cross(p1 - position, p2 - position);
+				const glm::vec3 after = glm::cross(p1 - _target, p2 - _target);
+				turnsOver = glm::dot(before, after) < 0 || after == glm::vec3(0);
+			});
+			return turnsOver;
+		}
+
+		HalfEdgeMesh m_mesh;
+		std::vector<Quadric> m_quadrics;
+		/** Position the vertices of every edge merge into */
+		std::vector<glm::vec3> m_targets;
+		EdgeHeap m_heap;
+		size_t m_faceCount;
+	};
+}
+
+namespace proc
+{
+	void DecimateQuadric(Mesh& _mesh, size_t _targetFaceCount)
+	{
+		if (_mesh.faces.size() <= _targetFaceCount)
+			return;
+
+		Decimator decimator(_mesh);
+		decimator.Run(_targetFaceCount);
+		decimator.ToMesh(_mesh);
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+struct Mesh;
+
+namespace proc
+{
+	/**
+	 * @brief Simplifies a mesh to a face budget by collapsing edges in the order of their quadric error (Garland & Heckbert 1997).
+	 *		  Each vertex accumulates the area weighted planes of its faces, and boundary edges add perpendicular planes so holes
+	 *		  keep their shape. The merged vertex moves to the position that minimizes the error of both quadrics.
+	 *		  Collapses that would make the mesh non-manifold or turn a face over are skipped.
+	 * @param _mesh The mesh to simplify. Duplicate vertices are welded first, the result has vertex normals but no texture coordinates.
+	 * @param _targetFaceCount The number of faces to stop at. Meshes that already have at most this many faces are left untouched.
+	 * @remark The collapse queue is an indexed heap with one entry per edge, so memory stays linear in the size of the input.
+	 *		   Only touches the given mesh, so separate meshes can be simplified concurrently.
+	*/
+	void DecimateQuadric(Mesh& _mesh, size_t _targetFaceCount);
+}
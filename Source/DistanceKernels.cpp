@@ -0,0 +1,285 @@
+#include "DistanceKernels.h"
+
+#include "CpuFeatures.h"
+#include "FeatureMatrix.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	//////////////////////////////////////////////////////////////////////////
+	// Scalar
+	//////////////////////////////////////////////////////////////////////////
+
+	/**
+	 * @brief The weighted Earth mover's distance between histogram h of a row and of the query, the term it adds to the composite distance.
+	*/
+	inline float HistogramDistanceTerm(const float* _row, const FeatureLayout& _layout, const float* _query, const FeatureWeights& _weights, int _histogram)
+	{
+		// The cumulative sums of both histograms end at 1, so the last bin never adds to the distance
+		const int offset = _layout.GetHistogramOffset(_histogram);
+		float cumulative = 0;
+		float emd = 0;
+		for (int b = 0; b < _layout.binCount - 1; b++)
+		{
+			cumulative += _query[offset + b] - _row[offset + b];
+			emd += std::abs(cumulative);
+		}
+		return _weights.histograms[_histogram] * emd;
+	}
+
+	void CompositeDistanceScalar(const float* _rows, size_t _stride, size_t _rowCount, const FeatureLayout& _layout,
+		const float* _query, const FeatureWeights& _weights, float* o_distances)
+	{
+		assert(_weights.histograms.size() >= static_cast<size_t>(_layout.histogramCount));
+
+		for (size_t i = 0; i < _rowCount; i++)
+		{
+			const float* row = _rows + i * _stride;
+			float distance = kernels::ScalarDistanceTerm(row, _layout, _query, _weights);
+			for (int h = 0; h < _layout.histogramCount; h++)
+				distance += HistogramDistanceTerm(row, _layout, _query, _weights, h);
+			o_distances[i] = distance;
+		}
+	}
+
+	void EarthMoversScalar(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			const float* histogram = _histograms + i * _stride;
+			float cumulative = 0;
+			float emd = 0;
+			for (int b = 0; b < _binCount - 1; b++)
+			{
+				cumulative += _query[b] - histogram[b];
+				emd += std::abs(cumulative);
+			}
+			o_distances[i] = emd;
+		}
+	}
+
+	void ChiSquareScalar(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			const float* histogram = _histograms + i * _stride;
+			float chiSquare = 0;
+			for (int b = 0; b < _binCount; b++)
+			{
+				const float difference = _query[b] - histogram[b];
+				const float sum = _query[b] + histogram[b];
+				chiSquare += sum > 0 ? difference * difference / sum : 0.0f;
+			}
+			o_distances[i] = 0.5f * chiSquare;
+		}
+	}
+
+	void JensenShannonScalar(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			const float* histogram = _histograms + i * _stride;
+			float divergence = 0;
+			for (int b = 0; b < _binCount; b++)
+			{
+				// Empty bins add nothing, the limit of p log p for p -> 0
+				const float mean = 0.5f * (_query[b] + histogram[b]);
+				if (_query[b] > 0)
+					divergence += _query[b] * std::log(_query[b] / mean);
+				if (histogram[b] > 0)
+					divergence += histogram[b] * std::log(histogram[b] / mean);
+			}
+			o_distances[i] = 0.5f * divergence;
+		}
+	}
+
+	void IntersectionScalar(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			const float* histogram = _histograms + i * _stride;
+			float intersection = 0;
+			for (int b = 0; b < _binCount; b++)
+				intersection += std::min(_query[b], histogram[b]);
+			o_distances[i] = 1.0f - intersection;
+		}
+	}
+
+	const kernels::DistanceKernels SCALAR_KERNELS = { "scalar", 1, CompositeDistanceScalar, EarthMoversScalar, ChiSquareScalar, JensenShannonScalar, IntersectionScalar };
+
+#if KERNELS_X86
+	//////////////////////////////////////////////////////////////////////////
+	// AVX2, one row per lane
+	//////////////////////////////////////////////////////////////////////////
+
+	KERNEL_TARGET_AVX2 inline __m256 Abs8(__m256 _x)
+	{
+		return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _x);
+	}
+
+	KERNEL_TARGET_AVX2 inline __m256i RowOffsets8(size_t _stride)
+	{
+		return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(_stride)));
+	}
+
+	KERNEL_TARGET_AVX2 void CompositeDistanceAvx2(const float* _rows, size_t _stride, size_t _rowCount, const FeatureLayout& _layout,
+		const float* _query, const FeatureWeights& _weights, float* o_distances)
+	{
+		assert(_weights.histograms.size() >= static_cast<size_t>(_layout.histogramCount));
+
+		// Lane i reads column c of row i, so the columns of eight rows are gathered into one register
+		const __m256i rowOffsets = RowOffsets8(_stride);
+
+		size_t i = 0;
+		for (; i + 8 <= _rowCount; i += 8)
+		{
+			const float* rows = _rows + i * _stride;
+
+			__m256 sum = _mm256_setzero_ps();
+			for (int c = 0; c < _layout.scalarCount; c++)
+			{
+				const __m256 difference = _mm256_sub_ps(_mm256_set1_ps(_query[c]), _mm256_i32gather_ps(rows + c, rowOffsets, 4));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(difference, difference));
+			}
+			__m256 distance = _mm256_mul_ps(_mm256_set1_ps(_weights.scalar), _mm256_sqrt_ps(sum));
+
+			for (int h = 0; h < _layout.histogramCount; h++)
+			{
+				const int offset = _layout.GetHistogramOffset(h);
+				__m256 cumulative = _mm256_setzero_ps();
+				__m256 emd = _mm256_setzero_ps();
+				for (int b = 0; b < _layout.binCount - 1; b++)
+				{
+					const __m256 difference = _mm256_sub_ps(_mm256_set1_ps(_query[offset + b]), _mm256_i32gather_ps(rows + offset + b, rowOffsets, 4));
+					cumulative = _mm256_add_ps(cumulative, difference);
+					emd = _mm256_add_ps(emd, Abs8(cumulative));
+				}
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(_weights.histograms[h]), emd));
+			}
+
+			_mm256_storeu_ps(o_distances + i, distance);
+		}
+
+		// The scalar tail and the code after it use SSE instructions, which stall on some CPUs while the upper ymm halves are dirty
+		_mm256_zeroupper();
+		CompositeDistanceScalar(_rows + i * _stride, _stride, _rowCount - i, _layout, _query, _weights, o_distances + i);
+	}
+
+	KERNEL_TARGET_AVX2 void EarthMoversAvx2(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		const __m256i rowOffsets = RowOffsets8(_stride);
+		size_t i = 0;
+		for (; i + 8 <= _count; i += 8)
+		{
+			const float* histograms = _histograms + i * _stride;
+			__m256 cumulative = _mm256_setzero_ps();
+			__m256 emd = _mm256_setzero_ps();
+			for (int b = 0; b < _binCount - 1; b++)
+			{
+				cumulative = _mm256_add_ps(cumulative, _mm256_sub_ps(_mm256_set1_ps(_query[b]), _mm256_i32gather_ps(histograms + b, rowOffsets, 4)));
+				emd = _mm256_add_ps(emd, Abs8(cumulative));
+			}
+			_mm256_storeu_ps(o_distances + i, emd);
+		}
+		_mm256_zeroupper();
+		EarthMoversScalar(_histograms + i * _stride, _stride, _count - i, _binCount, _query, o_distances + i);
+	}
+
+	KERNEL_TARGET_AVX2 void ChiSquareAvx2(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		const __m256i rowOffsets = RowOffsets8(_stride);
+		size_t i = 0;
+		for (; i + 8 <= _count; i += 8)
+		{
+			const float* histograms = _histograms + i * _stride;
+			__m256 chiSquare = _mm256_setzero_ps();
+			for (int b = 0; b < _binCount; b++)
+			{
+				const __m256 query = _mm256_set1_ps(_query[b]);
+				const __m256 histogram = _mm256_i32gather_ps(histograms + b, rowOffsets, 4);
+				const __m256 difference = _mm256_sub_ps(query, histogram);
+				const __m256 sum = _mm256_add_ps(query, histogram);
+				// Bins that are empty in both divide 0 by 0, the mask zeroes the NaN
+				const __m256 nonEmpty = _mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_GT_OQ);
+				chiSquare = _mm256_add_ps(chiSquare, _mm256_and_ps(nonEmpty, _mm256_div_ps(_mm256_mul_ps(difference, difference), sum)));
+			}
+			_mm256_storeu_ps(o_distances + i, _mm256_mul_ps(_mm256_set1_ps(0.5f), chiSquare));
+		}
+		_mm256_zeroupper();
+		ChiSquareScalar(_histograms + i * _stride, _stride, _count - i, _binCount, _query, o_distances + i);
+	}
+
+	KERNEL_TARGET_AVX2 void IntersectionAvx2(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances)
+	{
+		const __m256i rowOffsets = RowOffsets8(_stride);
+		size_t i = 0;
+		for (; i + 8 <= _count; i += 8)
+		{
+			const float* histograms = _histograms + i * _stride;
+			__m256 intersection = _mm256_setzero_ps();
+			for (int b = 0; b < _binCount; b++)
+				intersection = _mm256_add_ps(intersection, _mm256_min_ps(_mm256_set1_ps(_query[b]), _mm256_i32gather_ps(histograms + b, rowOffsets, 4)));
+			_mm256_storeu_ps(o_distances + i, _mm256_sub_ps(_mm256_set1_ps(1.0f), intersection));
+		}
+		_mm256_zeroupper();
+		IntersectionScalar(_histograms + i * _stride, _stride, _count - i, _binCount, _query, o_distances + i);
+	}
+
+	const kernels::DistanceKernels AVX2_KERNELS = { "avx2", 8, CompositeDistanceAvx2, EarthMoversAvx2, ChiSquareAvx2, JensenShannonScalar, IntersectionAvx2 };
+#endif
+}
+
+namespace kernels
+{
+	const DistanceKernels& GetDistanceKernels()
+	{
+#if KERNELS_X86
+		if (GetCpuFeatures().avx2)
+			return AVX2_KERNELS;
+#endif
+		return SCALAR_KERNELS;
+	}
+
+	const DistanceKernels& GetScalarDistanceKernels()
+	{
+		return SCALAR_KERNELS;
+	}
+
+	std::vector<const DistanceKernels*> GetSupportedDistanceKernels()
+	{
+		std::vector<const DistanceKernels*> supported = { &SCALAR_KERNELS };
+#if KERNELS_X86
+		if (GetCpuFeatures().avx2)
+			supported.push_back(&AVX2_KERNELS);
+#endif
+		return supported;
+	}
+
+	float ScalarDistanceTerm(const float* _row, const FeatureLayout& _layout, const float* _query, const FeatureWeights& _weights)
+	{
+		float sum = 0;
+		for (int c = 0; c < _layout.scalarCount; c++)
+		{
+			const float difference = _query[c] - _row[c];
+			sum += difference * difference;
+		}
+		return _weights.scalar * std::sqrt(sum);
+	}
+
+	bool CompositeDistanceBelow(const float* _row, const FeatureLayout& _layout, const float* _query, const FeatureWeights& _weights,
+		float _threshold, float& o_distance)
+	{
+		float distance = ScalarDistanceTerm(_row, _layout, _query, _weights);
+		for (int h = 0; h < _layout.histogramCount; h++)
+		{
+			distance += HistogramDistanceTerm(_row, _layout, _query, _weights, h);
+			if (distance > _threshold)
+				return false;
+		}
+		o_distance = distance;
+		return true;
+	}
+}
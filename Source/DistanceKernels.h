@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct FeatureLayout;
+struct FeatureWeights;
+
+namespace kernels
+{
+	/**
+	 * @brief Computes the composite shape distance from a query to consecutive rows of a feature matrix,
+	 *		  weights.scalar * |q_s - r_s| + sum over the histograms h of weights.histograms[h] * EMD(q_h, r_h).
+	 *		  The histograms have unit mass on the same bins, so their Earth mover's distance is the L1 distance of their cumulative sums.
+	 * @param _rows The first row to compute the distance to.
+	 * @param _stride The number of floats from the start of one row to the next.
+	 * @param _rowCount The number of rows.
+	 * @param _layout Where the scalars and histograms are stored in the rows and the query.
+	 * @param _query The feature vector to compute the distances from.
+	 * @param _weights The weights of the scalar block and of every histogram.
+	 * @param o_distances The distance to every row.
+	*/
+	using CompositeDistanceKernel = void(*)(const float* _rows, size_t _stride, size_t _rowCount, const FeatureLayout& _layout,
+		const float* _query, const FeatureWeights& _weights, float* o_distances);
+
+	/**
+	 * @brief Computes the distance from a query histogram to consecutive histograms, which all have unit mass and the same bins.
+	 * @param _histograms The first histogram to compute the distance to.
+	 * @param _stride The number of floats from the start of one histogram to the next, e.g. the stride of a feature matrix.
+	 * @param _count The number of histograms.
+	 * @param _binCount The number of bins of the query and of every histogram.
+	 * @param _query The histogram to compute the distances from.
+	 * @param o_distances The distance to every histogram.
+	*/
+	using HistogramDistanceKernel = void(*)(const float* _histograms, size_t _stride, size_t _count, int _binCount, const float* _query, float* o_distances);
+
+	/**
+	 * @brief Set of distance kernels for one instruction set. Every implementation evaluates the same operations in the same order,
+	 *		  without fused multiply-adds, so all of them produce bit-identical distances.
+	*/
+	struct DistanceKernels
+	{
+		const char* name;
+		/** Number of rows processed per instruction */
+		int laneCount;
+		CompositeDistanceKernel composite;
+		/** Earth mover's distance, the L1 distance of the cumulative sums */
+		HistogramDistanceKernel earthMovers;
+		/** Symmetric chi-square distance, 1/2 sum (a - b)^2 / (a + b) over the bins that are not empty in both */
+		HistogramDistanceKernel chiSquare;
+		/** Jensen-Shannon divergence in nats, evaluated with std::log by every set so the results stay identical */
+		HistogramDistanceKernel jensenShannon;
+		/** One minus the histogram intersection, 1 - sum min(a, b) */
+		HistogramDistanceKernel intersection;
+	};
+
+	/**
+	 * @brief Returns the fastest kernels supported by the CPU.
+	*/
+	const DistanceKernels& GetDistanceKernels();
+
+	/**
+	 * @brief Returns the portable scalar kernels that every other implementation has to match.
+	*/
+	const DistanceKernels& GetScalarDistanceKernels();
+
+	/**
+	 * @brief Returns all kernels the CPU can run, starting with the scalar ones.
+	*/
+	std::vector<const DistanceKernels*> GetSupportedDistanceKernels();
+
+	/**
+	 * @brief The first term of the composite distance, weights.scalar times the Euclidean distance between the scalars of a row and the query.
+	*/
+	float ScalarDistanceTerm(const float* _row, const FeatureLayout& _layout, const float* _query, const FeatureWeights& _weights);
+
+	/**
+	 * @brief Computes the composite distance from a query to one row with the scalar kernel, but stops once the terms added so far exceed a threshold.
+	 *		  The terms are non-negative and added in the same order as by every kernel set, so a completed distance is bit-identical to theirs
+	 *		  and an abandoned one is larger than the threshold.
+	 * @return Whether the distance was completed, o_distance is only written then.
+	*/
+	bool CompositeDistanceBelow(const float* _row, const FeatureLayout& _layout, const float* _query, const FeatureWeights& _weights,
+		float _threshold, float& o_distance);
+}
@@ -0,0 +1,1290 @@
+#include "Benchmarks.h"
+
+#include "DistanceKernels.h"
+#include "Feature.h"
+#include "FeatureMatrix.h"
+#include "HistogramDistance.h"
+#include "HistogramKernels.h"
+#include "HnswIndex.h"
+#include "IvfPqIndex.h"
+#include "ModelAttributeIndex.h"
+#include "ModelUtil.h"
+#include "Parallel.h"
+#include "VantagePointTree.h"
+#include "VertexSampler.h"
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <glm/glm.hpp>
+#include <flann/flann.hpp>
+#include <metrics/wasserstein.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	constexpr int BENCHMARK_BIN_COUNT = 10;
+	constexpr uint64_t BENCHMARK_SEED = 0x5EED;
+
+	/** Number of kernels in a ShapeKernels set */
+	constexpr int KERNEL_COUNT = 5;
+	const char* KERNEL_NAMES[KERNEL_COUNT] = { "a3", "d1", "d2", "d3", "d4" };
+	/** Bin sizes of the global bounds used by Database::ProcessAllModels, so the values spread over all bins */
+	constexpr float KERNEL_BIN_SIZES[KERNEL_COUNT] = { 0.314159f, 0.0708f, 0.1733f, 0.0932f, 0.0694f };
+
+	kernels::BinKernel GetKernel(const kernels::ShapeKernels& _kernels, int _index)
+	{
+		const kernels::BinKernel kernelArray[KERNEL_COUNT] = { _kernels.a3, _kernels.d1, _kernels.d2, _kernels.d3, _kernels.d4 };
+		return kernelArray[_index];
+	}
+
+	float RandomCoordinate(RandomGenerator& _generator)
+	{
+		// Uniform in [-0.5, 0.5), the unit cube the normalized models are scaled to
+		return static_cast<float>(_generator.Next() >> 40) / static_cast<float>(1 << 24) - 0.5f;
+	}
+
+	/**
+	 * @brief Fills blocks with random tuples of varying length. Some tuples get coinciding vertices to exercise the degenerate cases.
+	*/
+	std::vector<SampleBlock> CreateRandomBlocks(int _blockCount)
+	{
+		RandomGenerator generator(BENCHMARK_SEED);
+		std::vector<SampleBlock> blocks(_blockCount);
+		for (SampleBlock& block : blocks)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				for (int i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+				{
+					block.x[j][i] = RandomCoordinate(generator);
+					block.y[j][i] = RandomCoordinate(generator);
+					block.z[j][i] = RandomCoordinate(generator);
+				}
+			}
+
+			for (int i = 0; i < SAMPLE_BLOCK_SIZE; i += 7)
+			{
+				block.x[1][i] = block.x[0][i];
+				block.y[1][i] = block.y[0][i];
+				block.z[1][i] = block.z[0][i];
+			}
+
+			// Mostly full blocks, the rest tests the scalar tails of the vector kernels
+			const uint32_t length = generator.NextBelow(2 * SAMPLE_BLOCK_SIZE);
+			block.count = length < SAMPLE_BLOCK_SIZE ? static_cast<int>(length) + 1 : SAMPLE_BLOCK_SIZE;
+		}
+		return blocks;
+	}
+
+	/** Relative tolerance of the eigenvalues, and of the eigenvectors of eigenvalues that are this far apart */
+	constexpr double EIGEN_TOLERANCE = 1e-9;
+
+	/**
+	 * @brief Creates random covariance matrices B B^T. Some get two or three equal eigenvalues, like models with a symmetry axis.
+	*/
+	std::vector<glm::dmat3> CreateRandomCovariances(int _matrixCount)
+	{
+		RandomGenerator generator(BENCHMARK_SEED);
+		std::vector<glm::dmat3> matrices(_matrixCount);
+		for (int m = 0; m < _matrixCount; m++)
+		{
+			glm::dmat3 b;
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					b[i][j] = RandomCoordinate(generator);
+			matrices[m] = b * glm::transpose(b);
+
+			if (m % 16 == 0)
+				matrices[m] = glm::dmat3(RandomCoordinate(generator) + 1.0);
+			else if (m % 16 == 1)
+				matrices[m] = glm::dmat3(1.0) + glm::outerProduct(b[0], b[0]);
+		}
+		return matrices;
+	}
+
+	/**
+	 * @brief The general solver util::ComputeEigenVectors used before, including its sort through temporaries.
+	*/
+	void SolveWithEigen(const glm::dmat3& _matrix, glm::dvec3& o_eigenValues, glm::dmat3& o_eigenVectors)
+	{
+		Eigen::Matrix3d matrix;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				matrix(i, j) = _matrix[j][i];
+
+		Eigen::EigenSolver<Eigen::Matrix3d> solver(matrix);
+		Eigen::Matrix3d eVectors = solver.eigenvectors().real();
+		Eigen::Vector3d eValues = solver.eigenvalues().real();
+
+		std::vector<int> sortedIndices = { 0, 1, 2 };
+		std::vector<double> eigenValues = { eValues.x(), eValues.y(), eValues.z() };
+		std::sort(std::begin(sortedIndices), std::end(sortedIndices), [&](int i1, int i2) { return eigenValues[i1] > eigenValues[i2]; });
+
+		for (int i = 0; i < 3; i++)
+		{
+			o_eigenValues[i] = eigenValues[sortedIndices[i]];
+			o_eigenVectors[i] = glm::dvec3(eVectors(0, sortedIndices[i]), eVectors(1, sortedIndices[i]), eVectors(2, sortedIndices[i]));
+		}
+	}
+
+	bool EigenSolutionsMatch(const glm::dvec3& _values, const glm::dmat3& _vectors, const glm::dvec3& _referenceValues, const glm::dmat3& _referenceVectors)
+	{
+		const double scale = std::max(std::abs(_referenceValues[0]), 1e-300);
+		for (int i = 0; i < 3; i++)
+		{
+			if (std::abs(_values[i] - _referenceValues[i]) > EIGEN_TOLERANCE * scale)
+				return false;
+
+			// An eigenvector is only defined up to its sign, and not at all within an eigenspace of equal eigenvalues
+			const bool distinct = (i == 0 || _referenceValues[i - 1] - _referenceValues[i] > EIGEN_TOLERANCE * 1e3 * scale)
+				&& (i == 2 || _referenceValues[i] - _referenceValues[i + 1] > EIGEN_TOLERANCE * 1e3 * scale);
+			if (distinct && std::abs(glm::dot(_vectors[i], _referenceVectors[i])) < 1 - 1e-6)
+				return false;
+		}
+		return true;
+	}
+
+	template <typename Solver>
+	double TimeEigenSolver(const std::vector<glm::dmat3>& _matrices, Solver _solver)
+	{
+		// Summing the eigenvalues keeps the solver from being optimized away
+		double checksum = 0;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (const glm::dmat3& matrix : _matrices)
+		{
+			glm::dvec3 eigenValues;
+			glm::dmat3 eigenVectors;
+			_solver(matrix, eigenValues, eigenVectors);
+			checksum += eigenValues[0] + eigenVectors[0][0];
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		volatile double sink = checksum;
+		(void)sink;
+		return std::chrono::duration<double, std::nano>(end - begin).count() / _matrices.size();
+	}
+	/** Layout of the feature vectors of Database: six scalars and the A3, D1, D2, D3 and D4 histograms */
+	const FeatureLayout BENCHMARK_LAYOUT = { 6, 5, BENCHMARK_BIN_COUNT };
+	/** The old search ranks the matrix rows through FeatureVectors, which is too slow for the full matrix */
+	constexpr int FEATURE_VECTOR_ROW_COUNT = 2000;
+	constexpr int BENCHMARK_NEIGHBOUR_COUNT = 10;
+
+	/**
+	 * @brief Fills a matrix with standardized scalars in [-2, 2) and random histograms with unit mass.
+	*/
+	FeatureMatrix CreateRandomFeatureMatrix(int _rowCount, uint64_t _seed)
+	{
+		RandomGenerator generator(_seed);
+		FeatureMatrix matrix(_rowCount, BENCHMARK_LAYOUT);
+		for (int i = 0; i < _rowCount; i++)
+		{
+			float* row = matrix.GetRow(i);
+			for (int c = 0; c < BENCHMARK_LAYOUT.scalarCount; c++)
+				row[c] = 4 * RandomCoordinate(generator);
+
+			for (int h = 0; h < BENCHMARK_LAYOUT.histogramCount; h++)
+			{
+				float* bins = row + BENCHMARK_LAYOUT.GetHistogramOffset(h);
+				float sum = 0;
+				for (int b = 0; b < BENCHMARK_LAYOUT.binCount; b++)
+				{
+					bins[b] = RandomCoordinate(generator) + 0.5f;
+					sum += bins[b];
+				}
+				for (int b = 0; b < BENCHMARK_LAYOUT.binCount; b++)
+					bins[b] /= sum;
+			}
+		}
+		return matrix;
+	}
+
+	/**
+	 * @brief Builds the FeatureVector of a row the way Database::ComputeFeatureVector does.
+	*/
+	FeatureVector ToFeatureVector(const float* _row)
+	{
+		FeatureVector featureVector;
+		Feature scalars(BENCHMARK_LAYOUT.scalarCount);
+		for (int c = 0; c < BENCHMARK_LAYOUT.scalarCount; c++)
+			scalars[c] = _row[c];
+		featureVector.AddFeature(scalars);
+
+		for (int h = 0; h < BENCHMARK_LAYOUT.histogramCount; h++)
+		{
+			HistogramFeature histogram(BENCHMARK_LAYOUT.binCount);
+			for (int b = 0; b < BENCHMARK_LAYOUT.binCount; b++)
+				histogram[b] = _row[BENCHMARK_LAYOUT.GetHistogramOffset(h) + b];
+			featureVector.AddFeature(histogram);
+		}
+		return featureVector;
+	}
+
+	constexpr int METRIC_COUNT = 4;
+	const HistogramMetric METRICS[METRIC_COUNT] = { HistogramMetric::EARTH_MOVERS, HistogramMetric::CHI_SQUARE, HistogramMetric::JENSEN_SHANNON, HistogramMetric::INTERSECTION };
+	const char* METRIC_NAMES[METRIC_COUNT] = { "emd", "chi-square", "jensen-shannon", "intersection" };
+	/** Number of pairs compared with the general Wasserstein distance, which allocates and sorts for every pair */
+	constexpr int WASSERSTEIN_PAIR_COUNT = 10000;
+	/** The closed form sums in float, the general distance in float with the weights normalized by their sum */
+	constexpr float WASSERSTEIN_TOLERANCE = 1e-5f;
+
+	kernels::HistogramDistanceKernel GetKernel(const kernels::DistanceKernels& _kernels, int _index)
+	{
+		const kernels::HistogramDistanceKernel kernelArray[METRIC_COUNT] = { _kernels.earthMovers, _kernels.chiSquare, _kernels.jensenShannon, _kernels.intersection };
+		return kernelArray[_index];
+	}
+
+	/**
+	 * @brief Creates contiguous random histograms with unit mass. Every seventh bin is empty, to test the bins chi-square
+	 *		  and Jensen-Shannon skip.
+	*/
+	std::vector<float> CreateRandomHistograms(int _histogramCount, uint64_t _seed)
+	{
+		RandomGenerator generator(_seed);
+		std::vector<float> histograms(static_cast<size_t>(_histogramCount) * BENCHMARK_BIN_COUNT);
+		for (size_t i = 0; i < histograms.size(); i += BENCHMARK_BIN_COUNT)
+		{
+			float sum = 0;
+			for (int b = 0; b < BENCHMARK_BIN_COUNT; b++)
+			{
+				histograms[i + b] = (i + b) % 7 == 0 ? 0.0f : RandomCoordinate(generator) + 0.5f;
+				sum += histograms[i + b];
+			}
+			for (int b = 0; b < BENCHMARK_BIN_COUNT; b++)
+				histograms[i + b] /= sum;
+		}
+		return histograms;
+	}
+
+	/**
+	 * @brief The general Wasserstein distance between weighted bin indices, the way WassersteinDistance computed it before.
+	*/
+	float GeneralWasserstein(const float* _a, const float* _b)
+	{
+		std::vector<float> av(BENCHMARK_BIN_COUNT);
+		std::vector<float> aw(BENCHMARK_BIN_COUNT);
+		std::vector<float> bv(BENCHMARK_BIN_COUNT);
+		std::vector<float> bw(BENCHMARK_BIN_COUNT);
+		for (int i = 0; i < BENCHMARK_BIN_COUNT; i++)
+		{
+			av[i] = bv[i] = static_cast<float>(i);
+			aw[i] = _a[i];
+			bw[i] = _b[i];
+		}
+		return wasserstein(av, aw, bv, bw);
+	}
+
+	/** Same candidate factor and number of checks as Database::FindClosestANNShapes */
+	constexpr int ANN_CANDIDATE_FACTOR = 4;
+	constexpr int ANN_CHECKS = 128;
+	/** The embedded distance sums in a different order than the composite distance */
+	constexpr float EMBEDDING_TOLERANCE = 1e-4f;
+
+	float L1Distance(const float* _a, const float* _b, int _begin, int _end)
+	{
+		float distance = 0;
+		for (int c = _begin; c < _end; c++)
+			distance += std::abs(_a[c] - _b[c]);
+		return distance;
+	}
+
+	/**
+	 * @brief The closest rows by the L1 distance, found by comparing the query with every row.
+	*/
+	std::vector<Neighbour> ScanL1(const FeatureMatrix& _rows, const float* _query, size_t _k)
+	{
+		std::vector<Neighbour> neighbours(_rows.GetRowCount());
+		for (size_t i = 0; i < _rows.GetRowCount(); i++)
+			neighbours[i] = { static_cast<int>(i), L1Distance(_query, _rows.GetRow(i), 0, static_cast<int>(_rows.GetColumnCount())) };
+		std::partial_sort(neighbours.begin(), neighbours.begin() + std::min(_k, neighbours.size()), neighbours.end());
+		neighbours.resize(std::min(_k, neighbours.size()));
+		return neighbours;
+	}
+
+	bool SameNeighbours(const std::vector<Neighbour>& _a, const std::vector<Neighbour>& _b)
+	{
+		return _a.size() == _b.size() && std::equal(_a.begin(), _a.end(), _b.begin(), [](const Neighbour& _left, const Neighbour& _right)
+		{
+			return _left.index == _right.index && _left.distance == _right.distance;
+		});
+	}
+
+	/**
+	 * @brief Number of the exact neighbours that are among the approximate ones.
+	*/
+	int CountHits(const std::vector<Neighbour>& _exact, const std::vector<int>& _approximate)
+	{
+		int hits = 0;
+		for (const Neighbour& neighbour : _exact)
+			hits += std::find(_approximate.begin(), _approximate.end(), neighbour.index) != _approximate.end();
+		return hits;
+	}
+
+	int CountHits(const std::vector<Neighbour>& _exact, const std::vector<Neighbour>& _approximate)
+	{
+		std::vector<int> indices;
+		for (const Neighbour& neighbour : _approximate)
+			indices.push_back(neighbour.index);
+		return CountHits(_exact, indices);
+	}
+
+	/**
+	 * @brief The search setting of the backend in the settings, e.g. "ef=64".
+	*/
+	std::string DescribeSearchSetting(const IndexSettings& _settings)
+	{
+		switch (_settings.backend)
+		{
+		case IndexBackend::KD_FOREST:
+			return "checks=" + std::to_string(_settings.checks);
+		case IndexBackend::IVF_PQ:
+			return "probes=" + std::to_string(_settings.probeCount);
+		case IndexBackend::HNSW:
+		default:
+			return "ef=" + std::to_string(_settings.ef);
+		}
+	}
+}
+
+namespace eval
+{
+	bool BenchmarkShapeKernels(int _blockCount)
+	{
+		const std::vector<SampleBlock> blocks = CreateRandomBlocks(_blockCount);
+		const std::vector<const kernels::ShapeKernels*> supported = kernels::GetSupportedShapeKernels();
+		const kernels::ShapeKernels& scalar = kernels::GetScalarShapeKernels();
+
+		size_t sampleCount = 0;
+		for (const SampleBlock& block : blocks)
+			sampleCount += block.count;
+
+		std::cout << "Shape distribution kernels, selected: " << kernels::GetShapeKernels().name << std::endl;
+
+		bool allMatch = true;
+		for (const kernels::ShapeKernels* shapeKernels : supported)
+		{
+			for (int k = 0; k < KERNEL_COUNT; k++)
+			{
+				const kernels::BinKernel kernel = GetKernel(*shapeKernels, k);
+				const kernels::BinKernel reference = GetKernel(scalar, k);
+
+				// Every block is binned separately so a mismatch points at the block that caused it
+				int mismatches = 0;
+				for (const SampleBlock& block : blocks)
+				{
+					uint32_t bins[BENCHMARK_BIN_COUNT] = {};
+					uint32_t referenceBins[BENCHMARK_BIN_COUNT] = {};
+					const int valid = kernel(block, block.count, KERNEL_BIN_SIZES[k], BENCHMARK_BIN_COUNT, bins);
+					const int referenceValid = reference(block, block.count, KERNEL_BIN_SIZES[k], BENCHMARK_BIN_COUNT, referenceBins);
+					if (valid != referenceValid || std::memcmp(bins, referenceBins, sizeof(bins)) != 0)
+						mismatches++;
+				}
+				allMatch &= mismatches == 0;
+
+				uint32_t bins[BENCHMARK_BIN_COUNT] = {};
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				for (const SampleBlock& block : blocks)
+					kernel(block, block.count, KERNEL_BIN_SIZES[k], BENCHMARK_BIN_COUNT, bins);
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+				const double seconds = std::chrono::duration<double>(end - begin).count();
+				std::cout << shapeKernels->name << ' ' << KERNEL_NAMES[k] << ": " << sampleCount / seconds / 1e6 << " Msamples/s, "
+					<< (mismatches == 0 ? "matches scalar" : std::to_string(mismatches) + " mismatching blocks") << std::endl;
+			}
+		}
+		return allMatch;
+	}
+
+	bool BenchmarkEigenSolver(int _matrixCount)
+	{
+		const std::vector<glm::dmat3> matrices = CreateRandomCovariances(_matrixCount);
+
+		int mismatches = 0;
+		for (const glm::dmat3& matrix : matrices)
+		{
+			glm::dvec3 eigenValues, referenceValues;
+			glm::dmat3 eigenVectors, referenceVectors;
+			util::SolveSymmetricEigen(matrix, eigenValues, eigenVectors);
+			SolveWithEigen(matrix, referenceValues, referenceVectors);
+			if (!EigenSolutionsMatch(eigenValues, eigenVectors, referenceValues, referenceVectors))
+				mismatches++;
+		}
+
+		const double jacobiTime = TimeEigenSolver(matrices, util::SolveSymmetricEigen);
+		const double eigenTime = TimeEigenSolver(matrices, SolveWithEigen);
+
+		std::cout << "Symmetric 3x3 eigensolver: " << jacobiTime << " ns/matrix, Eigen::EigenSolver: " << eigenTime << " ns/matrix, "
+			<< eigenTime / jacobiTime << "x speedup, "
+			<< (mismatches == 0 ? "solutions match" : std::to_string(mismatches) + " mismatching matrices") << std::endl;
+		return mismatches == 0;
+	}
+
+	bool BenchmarkFeatureSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const FeatureMatrix queries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		std::cout << "Feature distance kernels, selected: " << kernels::GetDistanceKernels().name << std::endl;
+
+		bool allMatch = true;
+		std::vector<float> distances(_rowCount);
+		std::vector<float> referenceDistances(_rowCount);
+		for (const kernels::DistanceKernels* distanceKernels : kernels::GetSupportedDistanceKernels())
+		{
+			int mismatches = 0;
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			for (int q = 0; q < _queryCount; q++)
+			{
+				distanceKernels->composite(matrix.GetRow(0), matrix.GetStride(), _rowCount, BENCHMARK_LAYOUT, queries.GetRow(q), weights, distances.data());
+				kernels::GetScalarDistanceKernels().composite(matrix.GetRow(0), matrix.GetStride(), _rowCount, BENCHMARK_LAYOUT, queries.GetRow(q), weights, referenceDistances.data());
+				if (std::memcmp(distances.data(), referenceDistances.data(), _rowCount * sizeof(float)) != 0)
+					mismatches++;
+			}
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			allMatch &= mismatches == 0;
+
+			// Timed again without the reference, so only the kernel itself is measured
+			begin = std::chrono::steady_clock::now();
+			for (int q = 0; q < _queryCount; q++)
+				distanceKernels->composite(matrix.GetRow(0), matrix.GetStride(), _rowCount, BENCHMARK_LAYOUT, queries.GetRow(q), weights, distances.data());
+			end = std::chrono::steady_clock::now();
+
+			const double seconds = std::chrono::duration<double>(end - begin).count();
+			std::cout << distanceKernels->name << " composite: " << static_cast<double>(_rowCount) * _queryCount / seconds / 1e6 << " Mdistances/s, "
+				<< (mismatches == 0 ? "matches scalar" : std::to_string(mismatches) + " mismatching queries") << std::endl;
+		}
+
+		// The old search built a FeatureVector per row and query, computed the distance to every row and sorted all of them
+		const int rowCount = std::min(_rowCount, FEATURE_VECTOR_ROW_COUNT);
+		const int queryCount = std::min(_queryCount, 10);
+		const FeatureMatrix subset = CreateRandomFeatureMatrix(rowCount, BENCHMARK_SEED);
+		int differentNeighbours = 0;
+		double matrixSeconds = 0;
+		double featureVectorSeconds = 0;
+		for (int q = 0; q < queryCount; q++)
+		{
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			const std::vector<Neighbour> neighbours = FindNearestNeighbours(matrix, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights);
+			matrixSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			begin = std::chrono::steady_clock::now();
+			const FeatureVector query = ToFeatureVector(queries.GetRow(q));
+			std::vector<float> oldDistances(rowCount);
+			for (int i = 0; i < rowCount; i++)
+				oldDistances[i] = FeatureVectorDistance(query, ToFeatureVector(matrix.GetRow(i)), weights.histograms);
+			std::vector<int> order(rowCount);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](int _a, int _b) { return oldDistances[_a] < oldDistances[_b]; });
+			featureVectorSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			// Both searches have to agree on the rows the old search could see, the subset has the same first rows as the matrix
+			const std::vector<Neighbour> subsetNeighbours = FindNearestNeighbours(subset, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights);
+			for (int i = 0; i < BENCHMARK_NEIGHBOUR_COUNT; i++)
+				differentNeighbours += subsetNeighbours[i].index != order[i];
+		}
+		allMatch &= differentNeighbours == 0;
+
+		std::cout << "Exact " << BENCHMARK_NEIGHBOUR_COUNT << "-NN: " << matrixSeconds / queryCount * 1e3 << " ms/query over " << _rowCount << " rows, FeatureVectors: "
+			<< featureVectorSeconds / queryCount * 1e3 << " ms/query over " << rowCount << " rows, "
+			<< (featureVectorSeconds / rowCount) / (matrixSeconds / _rowCount) << "x speedup per row, "
+			<< (differentNeighbours == 0 ? "same neighbours" : std::to_string(differentNeighbours) + " different neighbours") << std::endl;
+		return allMatch;
+	}
+
+	bool BenchmarkHistogramDistances(int _histogramCount)
+	{
+		const std::vector<float> histograms = CreateRandomHistograms(_histogramCount, BENCHMARK_SEED);
+		const std::vector<float> query = CreateRandomHistograms(1, BENCHMARK_SEED + 1);
+		const kernels::DistanceKernels& scalar = kernels::GetScalarDistanceKernels();
+
+		std::cout << "Histogram distance kernels, selected: " << kernels::GetDistanceKernels().name << std::endl;
+
+		bool allMatch = true;
+		std::vector<float> distances(_histogramCount);
+		std::vector<float> referenceDistances(_histogramCount);
+		for (const kernels::DistanceKernels* distanceKernels : kernels::GetSupportedDistanceKernels())
+		{
+			for (int m = 0; m < METRIC_COUNT; m++)
+			{
+				const kernels::HistogramDistanceKernel kernel = GetKernel(*distanceKernels, m);
+				GetKernel(scalar, m)(histograms.data(), BENCHMARK_BIN_COUNT, _histogramCount, BENCHMARK_BIN_COUNT, query.data(), referenceDistances.data());
+
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				kernel(histograms.data(), BENCHMARK_BIN_COUNT, _histogramCount, BENCHMARK_BIN_COUNT, query.data(), distances.data());
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+				const bool match = std::memcmp(distances.data(), referenceDistances.data(), _histogramCount * sizeof(float)) == 0;
+				allMatch &= match;
+
+				const double seconds = std::chrono::duration<double>(end - begin).count();
+				std::cout << distanceKernels->name << ' ' << METRIC_NAMES[m] << ": " << _histogramCount / seconds / 1e6 << " Mdistances/s, "
+					<< (match ? "matches scalar" : "differs from scalar") << std::endl;
+			}
+		}
+
+		// Every pair the general distance is computed for is also computed in closed form, so both loops do the same work
+		const int pairCount = std::min(_histogramCount - 1, WASSERSTEIN_PAIR_COUNT);
+		float maxDifference = 0;
+		double checksum = 0;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < pairCount; i++)
+			checksum += GeneralWasserstein(&histograms[i * BENCHMARK_BIN_COUNT], &histograms[(i + 1) * BENCHMARK_BIN_COUNT]);
+		const double generalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < pairCount; i++)
+			checksum += HistogramDistance(HistogramMetric::EARTH_MOVERS, &histograms[i * BENCHMARK_BIN_COUNT], &histograms[(i + 1) * BENCHMARK_BIN_COUNT], BENCHMARK_BIN_COUNT);
+		const double closedFormSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		for (int i = 0; i < pairCount; i++)
+		{
+			const float* a = &histograms[i * BENCHMARK_BIN_COUNT];
+			const float* b = &histograms[(i + 1) * BENCHMARK_BIN_COUNT];
+			maxDifference = std::max(maxDifference, std::abs(HistogramDistance(HistogramMetric::EARTH_MOVERS, a, b, BENCHMARK_BIN_COUNT) - GeneralWasserstein(a, b)));
+		}
+		allMatch &= maxDifference <= WASSERSTEIN_TOLERANCE;
+
+		volatile double sink = checksum;
+		(void)sink;
+		std::cout << "Closed form EMD: " << closedFormSeconds / pairCount * 1e9 << " ns/pair, general Wasserstein: " << generalSeconds / pairCount * 1e9
+			<< " ns/pair, " << generalSeconds / closedFormSeconds << "x speedup, largest difference " << maxDifference << std::endl;
+		return allMatch;
+	}
+
+	bool BenchmarkCumulativeEmbedding(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const FeatureMatrix queries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		const FeatureMatrix embedded = EmbedCumulative(matrix, weights);
+		const FeatureMatrix embeddedQueries = EmbedCumulative(queries, weights);
+		const FeatureLayout& embeddedLayout = embedded.GetLayout();
+
+		// The histogram columns have to give the weighted Earth mover's distance and all columns a lower bound of the composite distance
+		float maxHistogramError = 0;
+		int boundViolations = 0;
+		std::vector<float> distances(_rowCount);
+		for (int q = 0; q < _queryCount; q++)
+		{
+			kernels::GetScalarDistanceKernels().composite(matrix.GetRow(0), matrix.GetStride(), _rowCount, BENCHMARK_LAYOUT, queries.GetRow(q), weights, distances.data());
+			for (int i = 0; i < _rowCount; i++)
+			{
+				float histogramDistance = 0;
+				for (int h = 0; h < BENCHMARK_LAYOUT.histogramCount; h++)
+				{
+					const int offset = BENCHMARK_LAYOUT.GetHistogramOffset(h);
+					histogramDistance += weights.histograms[h] * HistogramDistance(HistogramMetric::EARTH_MOVERS, queries.GetRow(q) + offset, matrix.GetRow(i) + offset, BENCHMARK_BIN_COUNT);
+				}
+				const float embeddedHistogramDistance = L1Distance(embeddedQueries.GetRow(q), embedded.GetRow(i), embeddedLayout.scalarCount, embeddedLayout.GetColumnCount());
+				maxHistogramError = std::max(maxHistogramError, std::abs(embeddedHistogramDistance - histogramDistance));
+
+				const float embeddedDistance = L1Distance(embeddedQueries.GetRow(q), embedded.GetRow(i), 0, embeddedLayout.GetColumnCount());
+				if (embeddedDistance > distances[i] * (1 + EMBEDDING_TOLERANCE) + EMBEDDING_TOLERANCE)
+					boundViolations++;
+			}
+		}
+		const bool valid = maxHistogramError <= EMBEDDING_TOLERANCE && boundViolations == 0;
+
+		// The old index searched the raw rows with L2, which ranks the histograms by bin-wise differences instead of the EMD
+		flann::Matrix<float> rawDataset(const_cast<float*>(matrix.GetRow(0)), _rowCount, matrix.GetColumnCount(), matrix.GetStride() * sizeof(float));
+		flann::Index<flann::L2<float>> rawIndex(rawDataset, flann::KDTreeIndexParams(4));
+		rawIndex.buildIndex();
+		flann::Matrix<float> embeddedDataset(const_cast<float*>(embedded.GetRow(0)), _rowCount, embedded.GetColumnCount(), embedded.GetStride() * sizeof(float));
+		flann::Index<flann::L1<float>> embeddedIndex(embeddedDataset, flann::KDTreeIndexParams(4));
+		embeddedIndex.buildIndex();
+
+		int rawHits = 0;
+		int embeddedHits = 0;
+		double rawSeconds = 0;
+		double embeddedSeconds = 0;
+		for (int q = 0; q < _queryCount; q++)
+		{
+			const std::vector<Neighbour> exact = FindNearestNeighbours(matrix, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights);
+			std::vector<std::vector<int>> indices;
+			std::vector<std::vector<float>> dists;
+
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			flann::Matrix<float> rawQuery(const_cast<float*>(queries.GetRow(q)), 1, queries.GetColumnCount());
+			rawIndex.knnSearch(rawQuery, indices, dists, BENCHMARK_NEIGHBOUR_COUNT, flann::SearchParams(ANN_CHECKS));
+			rawSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			rawHits += CountHits(exact, indices[0]);
+
+			begin = std::chrono::steady_clock::now();
+			flann::Matrix<float> embeddedQuery(const_cast<float*>(embeddedQueries.GetRow(q)), 1, embeddedQueries.GetColumnCount());
+			embeddedIndex.knnSearch(embeddedQuery, indices, dists, ANN_CANDIDATE_FACTOR * BENCHMARK_NEIGHBOUR_COUNT, flann::SearchParams(ANN_CHECKS));
+			const std::vector<Neighbour> reranked = RankRows(matrix, queries.GetRow(q), indices[0], BENCHMARK_NEIGHBOUR_COUNT, weights);
+			embeddedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			std::vector<int> rerankedIndices;
+			for (const Neighbour& neighbour : reranked)
+				rerankedIndices.push_back(neighbour.index);
+			embeddedHits += CountHits(exact, rerankedIndices);
+		}
+
+		const double neighbourCount = static_cast<double>(_queryCount) * BENCHMARK_NEIGHBOUR_COUNT;
+		std::cout << "Cumulative embedding: largest EMD error " << maxHistogramError << ", "
+			<< (boundViolations == 0 ? "lower bound holds" : std::to_string(boundViolations) + " lower bound violations") << std::endl;
+		std::cout << "Recall@" << BENCHMARK_NEIGHBOUR_COUNT << " over " << _rowCount << " rows, raw L2 index: " << rawHits / neighbourCount
+			<< " (" << rawSeconds / _queryCount * 1e3 << " ms/query), embedded L1 index with re-ranking: " << embeddedHits / neighbourCount
+			<< " (" << embeddedSeconds / _queryCount * 1e3 << " ms/query)" << std::endl;
+		return valid;
+	}
+
+	bool BenchmarkBatchSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const FeatureMatrix queries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		NeighbourMatrix reference(_queryCount, BENCHMARK_NEIGHBOUR_COUNT);
+		for (int q = 0; q < _queryCount; q++)
+			reference.SetNeighbours(q, FindNearestNeighbours(matrix, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights));
+		const double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		bool allMatch = true;
+		const unsigned int threadCounts[] = { 1, util::DefaultThreadCount() };
+		for (unsigned int threadCount : threadCounts)
+		{
+			begin = std::chrono::steady_clock::now();
+			const NeighbourMatrix neighbours = FindNearestNeighbours(matrix, queries, BENCHMARK_NEIGHBOUR_COUNT, weights, threadCount);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			const size_t entryCount = static_cast<size_t>(_queryCount) * BENCHMARK_NEIGHBOUR_COUNT;
+			const bool match = std::memcmp(neighbours.GetIndices(0), reference.GetIndices(0), entryCount * sizeof(int)) == 0
+				&& std::memcmp(neighbours.GetDistances(0), reference.GetDistances(0), entryCount * sizeof(float)) == 0;
+			allMatch &= match;
+
+			std::cout << "Batch " << BENCHMARK_NEIGHBOUR_COUNT << "-NN on " << threadCount << " threads: " << _queryCount / seconds << " queries/s, "
+				<< serialSeconds / seconds << "x the query loop, " << (match ? "same neighbours" : "different neighbours") << std::endl;
+		}
+		return allMatch;
+	}
+
+	bool BenchmarkSearchIndexes(int _rowCount, int _queryCount)
+	{
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+		const FeatureMatrix rows = EmbedCumulative(CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED), weights);
+		const FeatureMatrix queries = EmbedCumulative(CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1), weights);
+
+		std::vector<std::vector<Neighbour>> exact(_queryCount);
+		for (int q = 0; q < _queryCount; q++)
+			exact[q] = ScanL1(rows, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT);
+
+		std::vector<IndexSettings> settings;
+		for (int checks : { 32, 128, 512 })
+		{
+			IndexSettings kdForest;
+			kdForest.backend = IndexBackend::KD_FOREST;
+			kdForest.checks = checks;
+			settings.push_back(kdForest);
+		}
+		for (int ef : { 16, 64, 256 })
+		{
+			IndexSettings hnsw;
+			hnsw.backend = IndexBackend::HNSW;
+			hnsw.ef = ef;
+			settings.push_back(hnsw);
+		}
+		for (int probeCount : { 4, 16, 64 })
+		{
+			IndexSettings ivfPq;
+			ivfPq.backend = IndexBackend::IVF_PQ;
+			ivfPq.probeCount = probeCount;
+			settings.push_back(ivfPq);
+		}
+
+		const double neighbourCount = static_cast<double>(_queryCount) * BENCHMARK_NEIGHBOUR_COUNT;
+		for (const IndexSettings& setting : settings)
+		{
+			std::unique_ptr<SearchIndex> index = CreateSearchIndex(setting);
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			index->Build(rows);
+			const double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			int hits = 0;
+			int shortlistHits = 0;
+			double searchSeconds = 0;
+			for (int q = 0; q < _queryCount; q++)
+			{
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> neighbours = index->Search(queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT);
+				searchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+				hits += CountHits(exact[q], neighbours);
+
+				// The database re-ranks a shortlist with the exact distance, so an exact neighbour in the shortlist is found
+				shortlistHits += CountHits(exact[q], index->Search(queries.GetRow(q), ANN_CANDIDATE_FACTOR * BENCHMARK_NEIGHBOUR_COUNT));
+			}
+
+			std::cout << index->GetName() << ' ' << DescribeSearchSetting(setting) << ": recall@" << BENCHMARK_NEIGHBOUR_COUNT << ' ' << hits / neighbourCount
+				<< ", in the shortlist " << shortlistHits / neighbourCount << ", " << searchSeconds / _queryCount * 1e6 << " us/query, "
+				<< static_cast<double>(index->GetMemoryUsage()) / _rowCount << " bytes/row, built in " << buildSeconds << " s" << std::endl;
+		}
+
+		// Building inserts the rows in order, so inserting the second half into a graph of the first half gives the same graph
+		const int halfCount = _rowCount / 2;
+		FeatureMatrix firstHalf(halfCount, rows.GetLayout());
+		std::memcpy(firstHalf.GetRow(0), rows.GetRow(0), halfCount * rows.GetStride() * sizeof(float));
+		HnswIndex built(16, 200, 64);
+		built.Build(rows);
+		HnswIndex incremental(16, 200, 64);
+		incremental.Build(firstHalf);
+		for (int i = halfCount; i < _rowCount; i++)
+			incremental.Insert(rows.GetRow(i));
+
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / "hnsw_benchmark.bin";
+		HnswIndex loaded(4, 10, 64);
+		const bool saved = built.Save(path) && loaded.Load(path);
+		std::filesystem::remove(path);
+
+		int incrementalMismatches = 0;
+		int loadedMismatches = 0;
+		for (int q = 0; q < _queryCount; q++)
+		{
+			const std::vector<Neighbour> neighbours = built.Search(queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT);
+			incrementalMismatches += !SameNeighbours(neighbours, incremental.Search(queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT));
+			loadedMismatches += !SameNeighbours(neighbours, loaded.Search(queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT));
+		}
+
+		std::cout << "HNSW incremental inserts: " << (incrementalMismatches == 0 ? "same neighbours" : std::to_string(incrementalMismatches) + " mismatching queries")
+			<< ", save and load: " << (!saved ? "failed" : loadedMismatches == 0 ? "same neighbours" : std::to_string(loadedMismatches) + " mismatching queries") << std::endl;
+
+		// The quantizers are trained on the rows of the first build, so only a saved and loaded index is compared
+		IvfPqIndex compressed(0, 16, 17);
+		compressed.Build(rows);
+		IvfPqIndex loadedCompressed(1, 16, 1);
+		const bool savedCompressed = compressed.Save(path) && loadedCompressed.Load(path);
+		std::filesystem::remove(path);
+
+		int loadedCompressedMismatches = 0;
+		for (int q = 0; q < _queryCount; q++)
+			loadedCompressedMismatches += !SameNeighbours(compressed.Search(queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT), loadedCompressed.Search(queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT));
+
+		std::cout << "IVF-PQ save and load: " << (!savedCompressed ? "failed" : loadedCompressedMismatches == 0 ? "same neighbours" : std::to_string(loadedCompressedMismatches) + " mismatching queries")
+			<< ", " << static_cast<double>(compressed.GetMemoryUsage()) / _rowCount << " bytes/row against " << rows.GetColumnCount() * sizeof(float) << " for the rows" << std::endl;
+		return saved && incrementalMismatches == 0 && loadedMismatches == 0 && savedCompressed && loadedCompressedMismatches == 0;
+	}
+
+	bool BenchmarkIndexUpdates(int _rowCount, int _queryCount)
+	{
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+		const FeatureMatrix rows = EmbedCumulative(CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED), weights);
+		const FeatureMatrix queries = EmbedCumulative(CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1), weights);
+
+		// The index is built over the first half, the second half is inserted and then a random quarter of all rows is removed
+		const int halfCount = _rowCount / 2;
+		FeatureMatrix firstHalf(halfCount, rows.GetLayout());
+		std::memcpy(firstHalf.GetRow(0), rows.GetRow(0), halfCount * rows.GetStride() * sizeof(float));
+
+		RandomGenerator generator(BENCHMARK_SEED + 2);
+		std::vector<int> order(_rowCount);
+		std::iota(order.begin(), order.end(), 0);
+		for (int i = 0; i < _rowCount / 4; i++)
+			std::swap(order[i], order[i + generator.NextBelow(static_cast<uint32_t>(_rowCount - i))]);
+		const std::vector<int> removed(order.begin(), order.begin() + _rowCount / 4);
+
+		// The exact neighbours among the rows that are left
+		FeatureMatrix liveRows(_rowCount - removed.size(), rows.GetLayout());
+		std::vector<int> liveIds;
+		std::vector<uint8_t> isRemoved(_rowCount, 0);
+		for (int id : removed)
+			isRemoved[id] = 1;
+		for (int i = 0; i < _rowCount; i++)
+		{
+			if (!isRemoved[i])
+			{
+				std::memcpy(liveRows.GetRow(liveIds.size()), rows.GetRow(i), rows.GetStride() * sizeof(float));
+				liveIds.push_back(i);
+			}
+		}
+		std::vector<std::vector<Neighbour>> exact(_queryCount);
+		for (int q = 0; q < _queryCount; q++)
+		{
+			exact[q] = ScanL1(liveRows, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT);
+			for (Neighbour& neighbour : exact[q])
+				neighbour.index = liveIds[neighbour.index];
+		}
+
+		bool valid = true;
+		const IndexBackend backends[] = { IndexBackend::KD_FOREST, IndexBackend::HNSW, IndexBackend::IVF_PQ };
+		for (IndexBackend backend : backends)
+		{
+			IndexSettings settings;
+			settings.backend = backend;
+			std::unique_ptr<SearchIndex> index = CreateSearchIndex(settings);
+			index->Build(firstHalf);
+
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			for (int i = halfCount; i < _rowCount; i++)
+				index->Insert(rows.GetRow(i));
+			const double insertSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			begin = std::chrono::steady_clock::now();
+			for (int id : removed)
+				index->Remove(id);
+			const double removeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			std::unique_ptr<SearchIndex> rebuilt = CreateSearchIndex(settings);
+			begin = std::chrono::steady_clock::now();
+			rebuilt->Build(liveRows);
+			const double rebuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			const std::filesystem::path path = std::filesystem::temp_directory_path() / "index_updates_benchmark.bin";
+			std::unique_ptr<SearchIndex> loaded = CreateSearchIndex(settings);
+			const bool saved = index->Save(path) && loaded->Load(path);
+			std::filesystem::remove(path);
+
+			int hits = 0;
+			int rebuiltHits = 0;
+			int removedResults = 0;
+			int loadedMismatches = 0;
+			for (int q = 0; q < _queryCount; q++)
+			{
+				const std::vector<Neighbour> candidates = index->Search(queries.GetRow(q), ANN_CANDIDATE_FACTOR * BENCHMARK_NEIGHBOUR_COUNT);
+				for (const Neighbour& candidate : candidates)
+					removedResults += isRemoved[candidate.index];
+				hits += CountHits(exact[q], candidates);
+
+				// FLANN draws new random trees when a kd-forest is loaded, so it only has to leave out the same rows
+				const std::vector<Neighbour> loadedCandidates = loaded->Search(queries.GetRow(q), ANN_CANDIDATE_FACTOR * BENCHMARK_NEIGHBOUR_COUNT);
+				if (backend == IndexBackend::KD_FOREST)
+					loadedMismatches += std::any_of(loadedCandidates.begin(), loadedCandidates.end(), [&](const Neighbour& _candidate) { return isRemoved[_candidate.index] != 0; });
+				else
+					loadedMismatches += !SameNeighbours(candidates, loadedCandidates);
+
+				std::vector<Neighbour> rebuiltCandidates = rebuilt->Search(queries.GetRow(q), ANN_CANDIDATE_FACTOR * BENCHMARK_NEIGHBOUR_COUNT);
+				for (Neighbour& candidate : rebuiltCandidates)
+					candidate.index = liveIds[candidate.index];
+				rebuiltHits += CountHits(exact[q], rebuiltCandidates);
+			}
+			valid &= index->GetRemovedCount() == removed.size() && removedResults == 0 && saved && loadedMismatches == 0;
+
+			const double neighbourCount = static_cast<double>(_queryCount) * BENCHMARK_NEIGHBOUR_COUNT;
+			std::cout << index->GetName() << ": " << insertSeconds / (_rowCount - halfCount) * 1e6 << " us/insert, " << removeSeconds / removed.size() * 1e6
+				<< " us/removal, rebuild " << rebuildSeconds << " s; shortlist recall " << hits / neighbourCount << " after the updates, "
+				<< rebuiltHits / neighbourCount << " rebuilt; " << removedResults << " removed rows found, save and load: "
+				<< (!saved ? "failed" : loadedMismatches == 0 ? (backend == IndexBackend::KD_FOREST ? "no removed rows" : "same neighbours") : std::to_string(loadedMismatches) + " mismatching queries") << std::endl;
+		}
+		return valid;
+	}
+
+	bool BenchmarkPrunedSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const DistanceBounds bounds(matrix);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		// Rows of the matrix as queries are searched for like Database::FindClosestShapesOfAll does
+		FeatureMatrix rowQueries(_queryCount, BENCHMARK_LAYOUT);
+		for (int q = 0; q < _queryCount; q++)
+			std::memcpy(rowQueries.GetRow(q), matrix.GetRow(static_cast<size_t>(q) * _rowCount / _queryCount), matrix.GetStride() * sizeof(float));
+		const FeatureMatrix randomQueries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+
+		bool allMatch = true;
+		const std::pair<const char*, const FeatureMatrix*> querySets[] = { { "random queries", &randomQueries }, { "queries from the rows", &rowQueries } };
+		for (const auto& [name, queries] : querySets)
+		{
+			double scanSeconds = 0;
+			double prunedSeconds = 0;
+			int mismatches = 0;
+			PruningStatistics statistics;
+			for (int q = 0; q < _queryCount; q++)
+			{
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> neighbours = FindNearestNeighbours(matrix, queries->GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights);
+				scanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> prunedNeighbours = FindNearestNeighboursPruned(matrix, bounds, queries->GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights, &statistics);
+				prunedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				// Same rows and bit-identical distances
+				mismatches += !SameNeighbours(neighbours, prunedNeighbours);
+			}
+			allMatch &= mismatches == 0;
+
+			const double rowCount = static_cast<double>(statistics.GetRowCount());
+			std::cout << "Pruned exact " << BENCHMARK_NEIGHBOUR_COUNT << "-NN, " << name << ": " << prunedSeconds / _queryCount * 1e3 << " ms/query, scan "
+				<< scanSeconds / _queryCount * 1e3 << " ms/query; " << 100 * statistics.boundPruned / rowCount << "% of the rows pruned by their bound, "
+				<< 100 * statistics.abandoned / rowCount << "% abandoned, " << 100 * statistics.computed / rowCount << "% computed, "
+				<< (mismatches == 0 ? "same neighbours" : std::to_string(mismatches) + " mismatching queries") << std::endl;
+		}
+		return allMatch;
+	}
+
+	bool BenchmarkVantagePointTree(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		VantagePointTree tree;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		tree.Build(matrix, weights, 1);
+		const double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		begin = std::chrono::steady_clock::now();
+		tree.Build(matrix, weights);
+		const double parallelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		std::cout << "Vantage point tree over " << _rowCount << " rows: built in " << serialSeconds * 1e3 << " ms on one thread, "
+			<< parallelSeconds * 1e3 << " ms on " << util::DefaultThreadCount() << ", " << tree.GetMemoryUsage() / static_cast<double>(_rowCount) << " bytes per row" << std::endl;
+
+		std::stringstream stream;
+		VantagePointTree loadedTree;
+		bool allMatch = tree.Write(stream) && loadedTree.Read(stream) && loadedTree.GetSize() == tree.GetSize();
+
+		FeatureMatrix rowQueries(_queryCount, BENCHMARK_LAYOUT);
+		for (int q = 0; q < _queryCount; q++)
+			std::memcpy(rowQueries.GetRow(q), matrix.GetRow(static_cast<size_t>(q) * _rowCount / _queryCount), matrix.GetStride() * sizeof(float));
+		const FeatureMatrix randomQueries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+
+		const kernels::DistanceKernels& distanceKernels = kernels::GetDistanceKernels();
+		std::vector<float> distances(matrix.GetRowCount());
+		const std::pair<const char*, const FeatureMatrix*> querySets[] = { { "random queries", &randomQueries }, { "queries from the rows", &rowQueries } };
+		for (const auto& [name, queries] : querySets)
+		{
+			double scanSeconds = 0;
+			double treeSeconds = 0;
+			double radiusSeconds = 0;
+			size_t distanceCount = 0;
+			size_t radiusDistanceCount = 0;
+			int mismatches = 0;
+			for (int q = 0; q < _queryCount; q++)
+			{
+				const float* query = queries->GetRow(q);
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> neighbours = FindNearestNeighbours(matrix, query, BENCHMARK_NEIGHBOUR_COUNT, weights);
+				scanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> treeNeighbours = tree.Search(query, BENCHMARK_NEIGHBOUR_COUNT, &distanceCount);
+				treeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				// The radius of the k-th neighbour, so the range search returns the same rows plus any ties
+				const float radius = neighbours.back().distance;
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> radiusNeighbours = tree.SearchRadius(query, radius, &radiusDistanceCount);
+				radiusSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				distanceKernels.composite(matrix.GetRow(0), matrix.GetStride(), matrix.GetRowCount(), matrix.GetLayout(), query, weights, distances.data());
+				std::vector<Neighbour> scanRadiusNeighbours;
+				for (size_t i = 0; i < distances.size(); i++)
+				{
+					if (distances[i] <= radius)
+						scanRadiusNeighbours.push_back({ static_cast<int>(i), distances[i] });
+				}
+				std::sort(scanRadiusNeighbours.begin(), scanRadiusNeighbours.end());
+
+				mismatches += !SameNeighbours(neighbours, treeNeighbours) || !SameNeighbours(scanRadiusNeighbours, radiusNeighbours)
+					|| !SameNeighbours(neighbours, loadedTree.Search(query, BENCHMARK_NEIGHBOUR_COUNT));
+			}
+			allMatch &= mismatches == 0;
+
+			std::cout << "Vantage point tree " << BENCHMARK_NEIGHBOUR_COUNT << "-NN, " << name << ": " << treeSeconds / _queryCount * 1e3 << " ms/query, scan "
+				<< scanSeconds / _queryCount * 1e3 << " ms/query; " << static_cast<double>(distanceCount) / _queryCount << " distances per query of "
+				<< _rowCount << " (" << 100.0 * distanceCount / _queryCount / _rowCount << "%); range search " << radiusSeconds / _queryCount * 1e3 << " ms/query, "
+				<< static_cast<double>(radiusDistanceCount) / _queryCount << " distances per query, "
+				<< (mismatches == 0 ? "same neighbours" : std::to_string(mismatches) + " mismatching queries") << std::endl;
+		}
+		return allMatch;
+	}
+
+	bool BenchmarkCascadeSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const DistanceBounds bounds(matrix);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		// Rows of the matrix, like Database::CalibrateCascade, and the rows halfway between them to test on
+		FeatureMatrix calibrationQueries(_queryCount, BENCHMARK_LAYOUT);
+		FeatureMatrix testQueries(_queryCount, BENCHMARK_LAYOUT);
+		for (int q = 0; q < _queryCount; q++)
+		{
+			const size_t row = static_cast<size_t>(q) * _rowCount / _queryCount;
+			std::memcpy(calibrationQueries.GetRow(q), matrix.GetRow(row), matrix.GetStride() * sizeof(float));
+			std::memcpy(testQueries.GetRow(q), matrix.GetRow(std::min(row + _rowCount / _queryCount / 2, matrix.GetRowCount() - 1)), matrix.GetStride() * sizeof(float));
+		}
+
+		const auto measureRecall = [&](const FeatureMatrix& _queries, size_t _candidateCount, double& o_cascadeSeconds, double& o_exactSeconds)
+		{
+			size_t found = 0;
+			size_t total = 0;
+			o_cascadeSeconds = 0;
+			o_exactSeconds = 0;
+			for (size_t q = 0; q < _queries.GetRowCount(); q++)
+			{
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> exact = FindNearestNeighboursPruned(matrix, bounds, _queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights);
+				o_exactSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> cascade = FindNearestNeighboursCascade(matrix, bounds, _queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, _candidateCount, weights);
+				o_cascadeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				for (const Neighbour& neighbour : exact)
+					found += std::find_if(cascade.begin(), cascade.end(), [&](const Neighbour& _result) { return _result.index == neighbour.index; }) != cascade.end();
+				total += exact.size();
+			}
+			return static_cast<double>(found) / total;
+		};
+
+		bool allReached = true;
+		for (float targetRecall : { 0.9f, 0.95f, 0.99f })
+		{
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			const size_t candidateCount = CalibrateCandidateCount(matrix, bounds, calibrationQueries, BENCHMARK_NEIGHBOUR_COUNT, weights, targetRecall);
+			const double calibrationSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			double cascadeSeconds;
+			double exactSeconds;
+			const double calibrationRecall = measureRecall(calibrationQueries, candidateCount, cascadeSeconds, exactSeconds);
+			const double testRecall = measureRecall(testQueries, candidateCount, cascadeSeconds, exactSeconds);
+			allReached &= static_cast<float>(calibrationRecall) >= targetRecall;
+
+			std::cout << "Cascade " << BENCHMARK_NEIGHBOUR_COUNT << "-NN, target recall " << targetRecall << ": " << candidateCount << " candidates ("
+				<< static_cast<double>(candidateCount) / BENCHMARK_NEIGHBOUR_COUNT << " per neighbour, calibrated in " << calibrationSeconds * 1e3 << " ms), recall "
+				<< calibrationRecall << " on the calibration rows and " << testRecall << " on other rows, " << cascadeSeconds / _queryCount * 1e3
+				<< " ms/query, exact " << exactSeconds / _queryCount * 1e3 << " ms/query" << std::endl;
+		}
+		return allReached;
+	}
+
+	bool BenchmarkFilteredSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const DistanceBounds bounds(matrix);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		// Attributes spread like the ones of the models, a few dozen classes and element counts over two orders of magnitude
+		constexpr int CLASS_COUNT = 40;
+		RandomGenerator generator(BENCHMARK_SEED + 2);
+		std::vector<ModelDescriptor> models(_rowCount);
+		for (int i = 0; i < _rowCount; i++)
+		{
+			models[i].m_name = "m" + std::to_string(i);
+			models[i].m_class = "class" + std::to_string(generator.NextBelow(CLASS_COUNT));
+			models[i].m_vertexCount = 100 + generator.NextBelow(20000);
+			models[i].m_faceCount = 2 * models[i].m_vertexCount + generator.NextBelow(100);
+			models[i].m_bounds.max = glm::vec3(RandomCoordinate(generator), RandomCoordinate(generator), RandomCoordinate(generator)) + 0.5f;
+		}
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		ModelAttributeIndex attributeIndex;
+		attributeIndex.Build(models);
+		std::cout << "Attribute index over " << _rowCount << " models built in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() * 1e3 << " ms" << std::endl;
+
+		bool allMatch = attributeIndex.FindModel("m" + std::to_string(_rowCount / 2)) == _rowCount / 2 && attributeIndex.FindModel("none") == -1;
+
+		ModelFilter sameClass;
+		sameClass.modelClass = "class7";
+		ModelFilter vertexRange;
+		vertexRange.minVertexCount = 5000;
+		vertexRange.maxVertexCount = 6000;
+		ModelFilter largeModels;
+		largeModels.minVertexCount = 2000;
+		largeModels.minBoundsDiagonal = 0.5f;
+		const std::pair<const char*, ModelFilter> filters[] = { { "same class", sameClass }, { "vertex count in [5000, 6000]", vertexRange },
+			{ "at least 2000 vertices and a diagonal of 0.5", largeModels } };
+
+		const FeatureMatrix queries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+		for (const auto& [name, filter] : filters)
+		{
+			begin = std::chrono::steady_clock::now();
+			const std::vector<int> selected = attributeIndex.Select(filter);
+			const double selectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+			begin = std::chrono::steady_clock::now();
+			std::vector<int> scanned;
+			for (int i = 0; i < _rowCount; i++)
+			{
+				const ModelDescriptor& model = models[i];
+				const float diagonal = ModelAttributeIndex::GetBoundsDiagonal(model);
+				if ((filter.modelClass.empty() || model.m_class == filter.modelClass) && model.m_vertexCount >= filter.minVertexCount
+					&& model.m_vertexCount <= filter.maxVertexCount && model.m_faceCount >= filter.minFaceCount && model.m_faceCount <= filter.maxFaceCount
+					&& diagonal >= filter.minBoundsDiagonal && diagonal <= filter.maxBoundsDiagonal)
+					scanned.push_back(i);
+			}
+			const double scanSelectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			allMatch &= selected == scanned;
+
+			std::vector<uint8_t> allowedRows(_rowCount, 0);
+			for (int model : selected)
+				allowedRows[model] = 1;
+
+			// Scanning everything and filtering the result needs all rows, or it could return fewer than k models
+			double filteredSeconds = 0;
+			double postFilterSeconds = 0;
+			int mismatches = 0;
+			for (int q = 0; q < _queryCount; q++)
+			{
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> filtered = FindNearestNeighboursPruned(matrix, bounds, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights, allowedRows);
+				filteredSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				begin = std::chrono::steady_clock::now();
+				std::vector<Neighbour> postFiltered;
+				for (const Neighbour& neighbour : FindNearestNeighbours(matrix, queries.GetRow(q), matrix.GetRowCount(), weights))
+				{
+					if (allowedRows[neighbour.index] && postFiltered.size() < BENCHMARK_NEIGHBOUR_COUNT)
+						postFiltered.push_back(neighbour);
+				}
+				postFilterSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+				mismatches += !SameNeighbours(postFiltered, filtered);
+			}
+			allMatch &= mismatches == 0;
+
+			std::cout << "Filter " << name << ": " << selected.size() << " models selected in " << selectSeconds * 1e3 << " ms, testing every model "
+				<< scanSelectSeconds * 1e3 << " ms" << (selected == scanned ? "" : " (different models)") << "; filtered search " << filteredSeconds / _queryCount * 1e3
+				<< " ms/query, filtering a full ranking " << postFilterSeconds / _queryCount * 1e3 << " ms/query, "
+				<< (mismatches == 0 ? "same neighbours" : std::to_string(mismatches) + " mismatching queries") << std::endl;
+		}
+		return allMatch;
+	}
+
+	bool BenchmarkReweightedSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const DistanceBounds bounds(matrix);
+		const FeatureMatrix queries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+
+		QueryDistance defaultDistance;
+		defaultDistance.weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+		QueryDistance emphasizeD2 = defaultDistance;
+		emphasizeD2.weights.histograms[2] *= 4;
+		QueryDistance histogramsOnly = defaultDistance;
+		histogramsOnly.weights.scalar = 0;
+		QueryDistance mixedMetrics = defaultDistance;
+		mixedMetrics.metrics = { HistogramMetric::CHI_SQUARE, HistogramMetric::EARTH_MOVERS, HistogramMetric::EARTH_MOVERS,
+			HistogramMetric::JENSEN_SHANNON, HistogramMetric::INTERSECTION };
+		const std::pair<const char*, const QueryDistance*> distances[] = { { "default", &defaultDistance }, { "D2 weighted four times", &emphasizeD2 },
+			{ "histograms only", &histogramsOnly }, { "chi-square A3, Jensen-Shannon D3, intersection D4", &mixedMetrics } };
+
+		bool allMatch = true;
+		for (const auto& [name, distance] : distances)
+		{
+			double scanSeconds = 0;
+			double prunedSeconds = 0;
+			int mismatches = 0;
+			PruningStatistics statistics;
+			for (int q = 0; q < _queryCount; q++)
+			{
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> neighbours = FindNearestNeighbours(matrix, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, *distance);
+				scanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				begin = std::chrono::steady_clock::now();
+				const std::vector<Neighbour> prunedNeighbours = FindNearestNeighboursPruned(matrix, bounds, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, *distance, &statistics);
+				prunedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				mismatches += !SameNeighbours(neighbours, prunedNeighbours);
+				// The default distance has to rank like the fixed weights of the kernels
+				if (distance == &defaultDistance)
+					mismatches += !SameNeighbours(neighbours, FindNearestNeighbours(matrix, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, defaultDistance.weights));
+			}
+			allMatch &= mismatches == 0;
+
+			const double rowCount = static_cast<double>(statistics.GetRowCount());
+			std::cout << "Reweighted exact " << BENCHMARK_NEIGHBOUR_COUNT << "-NN, " << name << ": " << prunedSeconds / _queryCount * 1e3 << " ms/query, scan "
+				<< scanSeconds / _queryCount * 1e3 << " ms/query; " << 100 * statistics.boundPruned / rowCount << "% of the rows pruned by their bound, "
+				<< 100 * statistics.abandoned / rowCount << "% abandoned, " << 100 * statistics.computed / rowCount << "% computed, "
+				<< (mismatches == 0 ? "same neighbours" : std::to_string(mismatches) + " mismatching queries") << std::endl;
+		}
+		return allMatch;
+	}
+
+	bool BenchmarkAnytimeSearch(int _rowCount, int _queryCount)
+	{
+		const FeatureMatrix matrix = CreateRandomFeatureMatrix(_rowCount, BENCHMARK_SEED);
+		const DistanceBounds bounds(matrix);
+		const FeatureMatrix queries = CreateRandomFeatureMatrix(_queryCount, BENCHMARK_SEED + 1);
+		FeatureWeights weights;
+		weights.histograms = { 2.03818f, 1.14862f, 2.13344f, 1.71947f, 2.04633f };
+
+		NeighbourMatrix exact(_queryCount, BENCHMARK_NEIGHBOUR_COUNT);
+		for (int q = 0; q < _queryCount; q++)
+			exact.SetNeighbours(q, FindNearestNeighbours(matrix, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights));
+
+		// The shortlists of an HNSW graph over the embedded rows, like Database::FindClosestAnytimeShapes takes them
+		std::unique_ptr<SearchIndex> index = CreateSearchIndex(IndexSettings());
+		index->Build(EmbedCumulative(matrix, weights));
+		const FeatureMatrix embeddedQueries = EmbedCumulative(queries, weights);
+
+		bool allMatch = true;
+		const int budgetsMicroseconds[] = { -1, 20, 50, 100, 200, 500, 10000 };
+		for (bool shortlist : { false, true })
+		{
+			for (int budget : budgetsMicroseconds)
+			{
+				double seconds = 0;
+				double maxSeconds = 0;
+				int exactCount = 0;
+				int mismatches = 0;
+				size_t hits = 0;
+				size_t certain = 0;
+				size_t boundedRows = 0;
+				size_t computed = 0;
+				for (int q = 0; q < _queryCount; q++)
+				{
+					const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+					const std::chrono::steady_clock::time_point deadline = begin + std::chrono::microseconds(budget);
+					std::vector<int> candidates;
+					if (shortlist && std::chrono::steady_clock::now() < deadline)
+					{
+						for (const Neighbour& candidate : index->Search(embeddedQueries.GetRow(q), 4 * BENCHMARK_NEIGHBOUR_COUNT))
+							candidates.push_back(candidate.index);
+					}
+					AnytimeStatistics statistics;
+					const std::vector<Neighbour> neighbours = FindNearestNeighboursAnytime(matrix, bounds, queries.GetRow(q), BENCHMARK_NEIGHBOUR_COUNT, weights,
+						candidates, deadline, &statistics);
+					const double querySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+					seconds += querySeconds;
+					maxSeconds = std::max(maxSeconds, querySeconds);
+
+					std::vector<Neighbour> exactNeighbours(exact.GetNeighbourCount(q));
+					for (size_t i = 0; i < exactNeighbours.size(); i++)
+						exactNeighbours[i] = { exact.GetIndices(q)[i], exact.GetDistances(q)[i] };
+
+					// The certain neighbours have to be the leading exact ones, all of them if the search finished
+					const std::vector<Neighbour> certainNeighbours(neighbours.begin(), neighbours.begin() + statistics.certainCount);
+					const std::vector<Neighbour> leadingNeighbours(exactNeighbours.begin(), exactNeighbours.begin() + std::min(statistics.certainCount, exactNeighbours.size()));
+					mismatches += !SameNeighbours(certainNeighbours, leadingNeighbours) || (statistics.exact && !SameNeighbours(neighbours, exactNeighbours));
+
+					std::vector<int> indices;
+					for (const Neighbour& neighbour : neighbours)
+						indices.push_back(neighbour.index);
+					hits += CountHits(exactNeighbours, indices);
+					exactCount += statistics.exact;
+					certain += statistics.certainCount;
+					boundedRows += statistics.boundedRows;
+					computed += statistics.pruning.computed + statistics.pruning.abandoned;
+				}
+				allMatch &= mismatches == 0;
+
+				std::cout << "Anytime " << BENCHMARK_NEIGHBOUR_COUNT << "-NN" << (shortlist ? " from an HNSW shortlist" : "") << ", budget " << budget << " us: "
+					<< seconds / _queryCount * 1e6 << " us/query, at most " << maxSeconds * 1e6 << " us; " << 100.0 * exactCount / _queryCount << "% exact, recall "
+					<< static_cast<double>(hits) / (_queryCount * BENCHMARK_NEIGHBOUR_COUNT) << ", " << static_cast<double>(certain) / _queryCount << " certain neighbours, "
+					<< 100.0 * boundedRows / (static_cast<double>(_queryCount) * _rowCount) << "% of the rows bounded, " << static_cast<double>(computed) / _queryCount
+					<< " distances per query" << (mismatches == 0 ? "" : ", " + std::to_string(mismatches) + " mismatching queries") << std::endl;
+			}
+		}
+		return allMatch;
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+namespace eval
+{
+	/**
+	 * @brief Runs every shape distribution kernel set the CPU supports on random sample blocks, checks that the histograms
+	 *		  are bit-identical to the scalar kernels and prints the throughput of each set.
+	 * @param _blockCount The number of random blocks to bin.
+	 * @return Whether all kernel sets matched the scalar kernels.
+	*/
+	bool BenchmarkShapeKernels(int _blockCount = 4096);
+
+	/**
+	 * @brief Solves random covariance matrices with util::SolveSymmetricEigen and with the general Eigen solver it replaced,
+	 *		  checks that both find the same eigenvalues and eigenvectors and prints the time per matrix of each.
+	 * @param _matrixCount The number of random matrices to solve.
+	 * @return Whether the solutions matched.
+	*/
+	bool BenchmarkEigenSolver(int _matrixCount = 100000);
+
+	/**
+	 * @brief Runs every composite distance kernel set the CPU supports over a random feature matrix, checks that the distances
+	 *		  are bit-identical to the scalar kernels and prints the throughput of each set. Also compares the exact k-NN scan
+	 *		  over the matrix with ranking FeatureVectors by FeatureVectorDistance, which it replaced.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries to scan the matrix for.
+	 * @return Whether all kernel sets matched the scalar kernels and both searches found the same neighbours.
+	*/
+	bool BenchmarkFeatureSearch(int _rowCount = 100000, int _queryCount = 100);
+
+	/**
+	 * @brief Runs every histogram distance kernel set the CPU supports on random histograms, checks that the distances are
+	 *		  bit-identical to the scalar kernels and prints the throughput of each metric. Also compares the closed form
+	 *		  Earth mover's distance with the general Wasserstein distance WassersteinDistance used before.
+	 * @param _histogramCount The number of random histograms to compare a query against.
+	 * @return Whether all kernel sets matched the scalar kernels and the closed form matched the general distance.
+	*/
+	bool BenchmarkHistogramDistances(int _histogramCount = 100000);
+
+	/**
+	 * @brief Checks that the L1 distance between rows embedded by EmbedCumulative gives the weighted Earth mover's distance
+	 *		  of the histograms and never exceeds the composite distance. Also compares the recall of the old L2 kd-tree index
+	 *		  over the raw rows with the L1 index over the embedded rows followed by exact re-ranking, as the database searches.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries.
+	 * @return Whether the embedding matched the distance it approximates.
+	*/
+	bool BenchmarkCumulativeEmbedding(int _rowCount = 20000, int _queryCount = 100);
+
+	/**
+	 * @brief Runs the batch k-NN search over a random feature matrix on one thread and on all threads, checks that both give
+	 *		  the same neighbours as searching for every query on its own and prints the throughput of each.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries in the batch.
+	 * @return Whether all searches found the same neighbours.
+	*/
+	bool BenchmarkBatchSearch(int _rowCount = 20000, int _queryCount = 1000);
+
+	/**
+	 * @brief Builds the kd-forest, HNSW and IVF-PQ indexes over random embedded feature vectors and prints the recall of their
+	 *		  L1 neighbours against a linear scan, both directly and within the re-ranked shortlist, the build time, the time per
+	 *		  query and the memory per row for a few settings of each.
+	 *		  Also checks that inserting rows one by one gives the same HNSW graph as building it at once, and that
+	 *		  saved and loaded indexes find the same neighbours.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries.
+	 * @return Whether the incremental, the loaded and the original indexes found the same neighbours.
+	*/
+	bool BenchmarkSearchIndexes(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Builds every index backend over half of a set of random embedded feature vectors, inserts the other half and removes
+	 *		  a random quarter of all rows. Prints the time per insert and removal against a full rebuild, and the recall of
+	 *		  the shortlist over the remaining rows of the updated and of the rebuilt index.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries.
+	 * @return Whether no removed row was found, and a saved and loaded index found the same rows. A loaded kd-forest has new
+	 *		   random trees, so it only has to leave out the removed rows.
+	*/
+	bool BenchmarkIndexUpdates(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Searches a random feature matrix with the pruned exact k-NN search and with the full scan, for random queries and for
+	 *		  rows of the matrix. Checks that both find the same neighbours with bit-identical distances and prints the time per query
+	 *		  and the share of the rows that were pruned by their lower bound, abandoned early and computed in full.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries of each kind.
+	 * @return Whether both searches found the same neighbours.
+	*/
+	bool BenchmarkPrunedSearch(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Builds a vantage point tree over a random feature matrix on one thread and on all threads, and searches it for random
+	 *		  queries and rows of the matrix. Checks the k-NN search against the full scan and the range search, with the distance
+	 *		  of the k-th neighbour as radius, against filtering all distances. Prints the build times, the time per query and the
+	 *		  number of distances each query computed against the row count a linear scan computes.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of queries of each kind.
+	 * @return Whether all searches found the same rows with the same distances as the scan, and a saved and loaded tree did too.
+	*/
+	bool BenchmarkVantagePointTree(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Calibrates the candidate pool of the two-stage search over a random feature matrix for a few target recalls on a sample
+	 *		  of its rows, and prints the pool size, the recall on the sample and on other rows, and the time per query against the
+	 *		  pruned exact search.
+	 * @param _rowCount The number of random feature vectors.
+	 * @param _queryCount The number of calibration queries and of test queries.
+	 * @return Whether the calibrated pools reached their target recall on the sample they were calibrated on.
+	*/
+	bool BenchmarkCascadeSearch(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Gives the rows of a random feature matrix random classes, vertex counts, face counts and bounds, and searches them with
+	 *		  a few filters. Checks the models the secondary indexes select against testing every model, and the filtered pruned search
+	 *		  against scanning all rows and filtering the result. Prints the time per selection and per query of both.
+	 * @param _rowCount The number of random models.
+	 * @param _queryCount The number of queries per filter.
+	 * @return Whether the selections and the neighbours were the same.
+	*/
+	bool BenchmarkFilteredSearch(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Searches a random feature matrix under a few distances picked per query, other weights and other histogram metrics,
+	 *		  with the pruned search over one set of bounds, and checks the neighbours against scanning every row with the same distance.
+	 *		  Also checks that the default distance finds the same neighbours as the fixed weights. Prints the time per query and
+	 *		  the share of the rows every distance prunes.
+	 * @param _rowCount The number of random rows.
+	 * @param _queryCount The number of queries per distance.
+	 * @return Whether the neighbours were the same for every distance.
+	*/
+	bool BenchmarkReweightedSearch(int _rowCount = 20000, int _queryCount = 200);
+
+	/**
+	 * @brief Searches a random feature matrix with the anytime search under a range of latency budgets, from one that has passed
+	 *		  before the search starts to one that lets every query finish, on its own and from the shortlist of an HNSW index.
+	 *		  Prints the time per query including the shortlist, the share of exact results, the recall and the work done per budget.
+	 *		  Checks exact results and the certain part of approximate ones against the scan.
+	 * @param _rowCount The number of random rows.
+	 * @param _queryCount The number of queries per budget.
+	 * @return Whether every result that was reported exact, and the certain part of the others, matched the scan.
+	*/
+	bool BenchmarkAnytimeSearch(int _rowCount = 20000, int _queryCount = 200);
+}
@@ -1,8 +1,11 @@
 #include "Evaluation.h"
 
 #include "Database.h"
+#include "SearchIndex.h"
 
+#include <algorithm>
 #include <fstream>
+#include <iostream>
 #include <random>
 #include <chrono>
 
@@ -15,7 +18,11 @@ namespace eval
 		std::vector<float> precisions;
 		std::vector<float> recalls;
 
-		for (int k = 1; k <= 30; k++)
+		// The closest k shapes are the first k of the closest 30, so all values of k share one batch of queries
+		const int maxK = 30;
+		const NeighbourMatrix neighbours = database.FindClosestShapesOfAll(maxK, preciseKNN);
+
+		for (int k = 1; k <= maxK; k++)
 		{
 			std::cout << "K=" << k << std::endl;
 			float averagePrecision = 0;
@@ -26,16 +33,12 @@ namespace eval
 				ModelDescriptor& md = modelDatabase[i];
 
 				int correct = 0;
-				std::vector<int> closestShapes;
-
-				if (preciseKNN)
-					closestShapes = database.FindClosestKNNShapes(md, k);
-				else
-					closestShapes = database.FindClosestANNShapes(md, k);
+				const int* closestShapes = neighbours.GetIndices(i);
+				const int closestCount = std::min<int>(k, neighbours.GetNeighbourCount(i));
 
-				for (int index : closestShapes)
+				for (int j = 0; j < closestCount; j++)
 				{
-					ModelDescriptor& shape = modelDatabase[index];
+					ModelDescriptor& shape = modelDatabase[closestShapes[j]];
 
 					if (md.m_class == shape.m_class)
 						correct++;
@@ -112,17 +115,11 @@ namespace eval
 		for (int k = 1; k < 31; k++)
 		{
 			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-			for (ModelDescriptor& md : modelDatabase)
-			{
-				if (preciseKNN)
-					database.FindClosestKNNShapes(md, k);
-				else
-					database.FindClosestANNShapes(md, k);
-			}
+			database.FindClosestShapesOfAll(k, preciseKNN);
 			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
 			float timing = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / modelDatabase.size();
 			timings.push_back(timing);
-			std::cout << "Average NN query time = " << timing << "[microseconds] for k=" << k << std::endl;
+			std::cout << "Average NN query time = " << timing << "[microseconds] for k=" << k << " in a batch over all models" << std::endl;
 		}
 	}
 
@@ -147,17 +144,13 @@ namespace eval
 		std::ofstream confusionFile;
 		confusionFile.open(confusionFileName);
 
+		const NeighbourMatrix neighbours = database.FindClosestShapesOfAll(k, preciseKNN);
+
 		for (int i = 0; i < modelDatabase.size(); i++)
 		{
 			ModelDescriptor& md = modelDatabase[i];
 
-			int correct = 0;
-			std::vector<int> closestShapes;
-
-			if (preciseKNN)
-				closestShapes = database.FindClosestKNNShapes(md, k);
-			else
-				closestShapes = database.FindClosestANNShapes(md, k);
+			const std::vector<int> closestShapes(neighbours.GetIndices(i), neighbours.GetIndices(i) + neighbours.GetNeighbourCount(i));
 
 			confusionFile << md.m_class;
 			std::vector<std::string> closestClasses(closestShapes.size());
@@ -180,4 +173,86 @@ namespace eval
 
 		confusionFile.close();
 	}
+
+	void WriteIndexComparison(Database& database)
+	{
+		const FeatureMatrix& featureMatrix = database.GetFeatureMatrix();
+		const FeatureWeights& weights = database.GetFeatureWeights();
+		const FeatureMatrix embedded = EmbedCumulative(featureMatrix, weights);
+		const int modelCount = featureMatrix.GetRowCount();
+		const int k = 10;
+		// Same shortlist as Database::FindClosestANNShapes
+		const int candidateCount = 4 * (k + 1);
+
+		const NeighbourMatrix exact = database.FindClosestShapesOfAll(k, true);
+
+		std::vector<IndexSettings> settings;
+		for (int checks : { 16, 32, 64, 128, 256, 512, 1024 })
+		{
+			IndexSettings kdForest;
+			kdForest.backend = IndexBackend::KD_FOREST;
+			kdForest.checks = checks;
+			settings.push_back(kdForest);
+		}
+		for (int ef : { 10, 20, 40, 80, 160, 320 })
+		{
+			IndexSettings hnsw;
+			hnsw.backend = IndexBackend::HNSW;
+			hnsw.ef = ef;
+			settings.push_back(hnsw);
+		}
+		for (int probeCount : { 1, 2, 4, 8, 16, 32 })
+		{
+			IndexSettings ivfPq;
+			ivfPq.backend = IndexBackend::IVF_PQ;
+			ivfPq.probeCount = probeCount;
+			settings.push_back(ivfPq);
+		}
+
+		std::ofstream comparisonFile;
+		comparisonFile.open("Evaluation/index_comparison.csv");
+		comparisonFile << "backend,parameter,recall,query_microseconds,build_seconds,bytes_per_model\n";
+
+		for (const IndexSettings& setting : settings)
+		{
+			std::unique_ptr<SearchIndex> index = CreateSearchIndex(setting);
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			index->Build(embedded);
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			const double buildSeconds = std::chrono::duration<double>(end - begin).count();
+
+			int hits = 0;
+			int relevant = 0;
+			begin = std::chrono::steady_clock::now();
+			for (int i = 0; i < modelCount; i++)
+			{
+				const std::vector<Neighbour> candidates = index->Search(embedded.GetRow(i), candidateCount);
+				std::vector<int> candidateIndices;
+				for (const Neighbour& candidate : candidates)
+				{
+					if (candidate.index != i)
+						candidateIndices.push_back(candidate.index);
+				}
+				const std::vector<Neighbour> closest = RankRows(featureMatrix, featureMatrix.GetRow(i), candidateIndices, k, weights);
+
+				for (int j = 0; j < exact.GetNeighbourCount(i); j++)
+				{
+					const int exactIndex = exact.GetIndices(i)[j];
+					hits += std::find_if(closest.begin(), closest.end(), [exactIndex](const Neighbour& _neighbour) { return _neighbour.index == exactIndex; }) != closest.end();
+					relevant++;
+				}
+			}
+			end = std::chrono::steady_clock::now();
+			const double queryMicroseconds = std::chrono::duration<double, std::micro>(end - begin).count() / modelCount;
+
+			const int parameter = setting.backend == IndexBackend::KD_FOREST ? setting.checks : setting.backend == IndexBackend::IVF_PQ ? setting.probeCount : setting.ef;
+			const float recall = relevant > 0 ? (float)hits / relevant : 0.0f;
+			const double bytesPerModel = modelCount > 0 ? static_cast<double>(index->GetMemoryUsage()) / modelCount : 0.0;
+			comparisonFile << index->GetName() << ',' << parameter << ',' << recall << ',' << queryMicroseconds << ',' << buildSeconds << ',' << bytesPerModel << '\n';
+			std::cout << index->GetName() << ' ' << parameter << ": recall@" << k << " = " << recall << ", " << queryMicroseconds << "[microseconds] per query, "
+				<< bytesPerModel << " bytes per model" << std::endl;
+		}
+
+		comparisonFile.close();
+	}
 }
@@ -7,4 +7,10 @@ namespace eval
 	void ComputeMeanAveragePrecision(Database& database, bool preciseKNN = false);
 	void WritePerformance(Database& database, bool preciseKNN = false);
 	void WriteNNResults(Database& database, bool preciseKNN = false);
+	/**
+	 * @brief Builds the kd-forest, HNSW and IVF-PQ indexes over the features of the database with a range of search settings and
+	 *		  writes the recall@10 of the re-ranked ANN search against the exact search, the time per query, the build time and
+	 *		  the index memory per model of each to Evaluation/index_comparison.csv.
+	*/
+	void WriteIndexComparison(Database& database);
 }
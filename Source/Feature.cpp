@@ -1,5 +1,7 @@
 #include "Feature.h"
 
+#include "HistogramDistance.h"
+
 #include <metrics/wasserstein.h>
 
 #include <cassert>
@@ -41,6 +43,10 @@ float WassersteinDistance::distance(const Feature& f1, const Feature& f2)
 	const HistogramFeature& hf1 = (const HistogramFeature&) f1;
 	const HistogramFeature& hf2 = (const HistogramFeature&) f2;
 
+	if (hf1.m_numBins == hf2.m_numBins)
+		return HistogramDistance(HistogramMetric::EARTH_MOVERS, hf1.data(), hf2.data(), hf1.m_numBins);
+
+	// Histograms on different bins need the general distance between weighted point sets
 	std::vector<float> av(hf1.m_numBins);
 	std::vector<float> aw(hf1.m_numBins);
 	std::vector<float> bv(hf2.m_numBins);
@@ -96,7 +102,7 @@ std::vector<float> FeatureVector::AsFloatVector() const
 }
 
 #include <QDebug>
-float FeatureVectorDistance(const FeatureVector& fv1, const FeatureVector& fv2, std::vector<float> hist_weights)
+float FeatureVectorDistance(const FeatureVector& fv1, const FeatureVector& fv2, const std::vector<float>& hist_weights)
 {
 	EuclideanDistance euclidean;
 	WassersteinDistance wasserstein;
@@ -16,6 +16,9 @@ public:
 	float& operator[](int i) { return m_values[i]; }
 	const float& operator[](int i) const { return m_values[i]; }
 
+	float* data() { return m_values.data(); }
+	const float* data() const { return m_values.data(); }
+
 private:
 	std::vector<float> m_values;
 };
@@ -27,12 +30,15 @@ public:
 		Feature(numBins),
 		m_numBins(numBins),
 		m_min(0),
-		m_max(0)
+		m_max(0),
+		m_sampleCount(0)
 	{ }
 
 	int m_numBins;
 	float m_min;
 	float m_max;
+	/** Number of samples the histogram was estimated from, 0 if unknown */
+	int m_sampleCount;
 };
 
 class DistanceFunction
@@ -53,6 +59,10 @@ public:
 	float distance(const Feature& f1, const Feature& f2) override;
 };
 
+/**
+ * @brief Earth mover's distance between two HistogramFeatures. Histograms on the same bins are compared in closed form,
+ *		  see HistogramDistance, which assumes they are normalized like the extracted shape distributions.
+*/
 class WassersteinDistance : public DistanceFunction
 {
 public:
@@ -72,7 +82,7 @@ private:
 	std::vector<float> m_weights;
 	std::vector<HistogramFeature> m_histogramFeatures;
 
-	friend float FeatureVectorDistance(const FeatureVector& fv1, const FeatureVector& fv2, std::vector<float> hist_weights);
+	friend float FeatureVectorDistance(const FeatureVector& fv1, const FeatureVector& fv2, const std::vector<float>& hist_weights);
 };
 
-float FeatureVectorDistance(const FeatureVector& fv1, const FeatureVector& fv2, std::vector<float> hist_weights);
+float FeatureVectorDistance(const FeatureVector& fv1, const FeatureVector& fv2, const std::vector<float>& hist_weights);
@@ -1,9 +1,13 @@
 #include "FeatureExtraction.h"
 
 #include "Feature.h"
+#include "HistogramKernels.h"
+#include "VertexSampler.h"
 
-constexpr int HISTOGRAM_ITERATIONS = 100000;
-constexpr size_t HISTOGRAM_BIN_SIZE = 10;
+#include <algorithm>
+#include <memory>
+
+constexpr int HISTOGRAM_BIN_SIZE = 10;
 constexpr double M_PI = 3.14159265358979323846;  /* pi */
 
 namespace
@@ -26,13 +30,6 @@ namespace
 		return ExtractTriangleArea(v0, v1, v2);
 	}
 
-	void ProcessBins(Feature& feature)
-	{
-		for (int i = 0; i < HISTOGRAM_BIN_SIZE; i++)
-		{
-			feature[i] /= static_cast<double>(HISTOGRAM_ITERATIONS);
-		}
-	}
 }
 
 float ExtractSurfaceArea(ModelDescriptor& _modelDescriptor)
@@ -110,303 +107,240 @@ float ExtractVolume(const ModelDescriptor& _modelDescriptor)
 	return vol;
 }
 
-int GetRandomIndex(const ModelDescriptor& _modelDescriptor)
+namespace
 {
-	return rand() % _modelDescriptor.m_vertexCount;
-}
+	/** The tuple size needed by every shape distribution, in ShapeDistribution order */
+	constexpr int TUPLE_SIZES[SHAPE_DISTRIBUTION_COUNT] = { 3, 1, 2, 3, 4 };
 
-void GetRandomVertices(const ModelDescriptor& _modelDescriptor, int _count, int* _meshPositions, glm::vec3* o_randomVertices)
-{
-	int* indices = new int[_count];
-	for (int i = 0; i < _count; i++)
-	{
-		int randomIndex = -1;
-		while(true)
-		{
-			randomIndex = GetRandomIndex(_modelDescriptor);
-			bool unique = true;
-			for (int j = 0; j < i; j++)
-			{
-				if (randomIndex == indices[j])
-				{
-					unique = false;
-					break;
-				}
-			}
+	/** Stream id of the generator that feeds the fused extraction, the independent streams use the ShapeDistribution values */
+	constexpr uint64_t FUSED_STREAM = SHAPE_DISTRIBUTION_COUNT;
 
-			if(unique)
-			{
-				break;
-			}
-		}
+	/** Give up on a histogram after drawing this many times the requested number of samples (e.g. when all vertices coincide) */
+	constexpr int MAX_DRAW_FACTOR = 4;
 
-		int subIndex = randomIndex;
-		indices[i] = subIndex;
-		for (int k = 0; k < _modelDescriptor.m_model->m_meshes.size(); k++)
-		{
-			if (subIndex - (_meshPositions[k]) < _modelDescriptor.m_model->m_meshes[k].positions.size())
-			{
-				o_randomVertices[i] = _modelDescriptor.m_model->m_meshes[k].positions[subIndex];
-				break;
-			}
-			subIndex -= _meshPositions[k];
-		}
-	}
-	delete[] indices;
-	indices = nullptr;
-}
-
-void GetMeshPositions(const Model& _model, int* meshPositions)
-{
-	size_t vertexCount = 0;
-	meshPositions[0] = 0;
-	for (size_t i = 0; i < _model.m_meshes.size(); i++)
+	/**
+	 * @brief Unnormalized histogram and the number of samples that were added to it.
+	*/
+	struct HistogramCounts
 	{
-		if (i != _model.m_meshes.size() - 1)
-		{
-			meshPositions[i + 1] = vertexCount + _model.m_meshes[i].positions.size();
-		}
-		vertexCount += _model.m_meshes[i].positions.size();
+		uint32_t bins[HISTOGRAM_BIN_SIZE] = {};
+		int sampleCount = 0;
+	};
+
+	/**
+	 * @brief Sampling progress of one histogram. The histogram is filled up to its next checkpoint, where it either
+	 *		  stops or moves the checkpoint further. Without adaptive sampling the only checkpoint is the maximum budget.
+	*/
+	struct SamplingState
+	{
+		HistogramCounts counts;
+		SampleBudget budget;
+		int checkpoint = 0;
+		bool converged = false;
+		/** Normalized histogram at the previous checkpoint */
+		float previous[HISTOGRAM_BIN_SIZE] = {};
+		bool hasPrevious = false;
+
+		int Needed() const { return converged ? 0 : checkpoint - counts.sampleCount; }
+	};
+
+	void StartSampling(SamplingState& _state, const SampleBudget& _budget, bool _adaptive)
+	{
+		_state.budget = _budget;
+		_state.budget.maxSamples = std::max(_state.budget.maxSamples, 1);
+		_state.checkpoint = _adaptive ? std::clamp(_budget.minSamples / 2, 1, _state.budget.maxSamples) : _state.budget.maxSamples;
 	}
-}
 
-HistogramFeature ExtractA3(const ModelDescriptor& _modelDescriptor)
-{
-	//The size of each of the bins.
-	const float binSize = M_PI / HISTOGRAM_BIN_SIZE;
-
-	//Get the start positions for each mesh so that we can pick a random vertex out of all meshes.
-	int* meshPositions = new int[_modelDescriptor.m_model->m_meshes.size()];;
-	GetMeshPositions(*_modelDescriptor.m_model, meshPositions);
-
-	//Create all bins for the histogram.
-	HistogramFeature a3Feature(HISTOGRAM_BIN_SIZE);
-	a3Feature.m_min = 0;
-	a3Feature.m_max = M_PI;
-
-	//Iterate for a while, each time picking three random vertices and extracting the angle between them.
-	glm::vec3 randomVertices[3];
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
+	/**
+	 * @brief Called when a histogram reached its checkpoint. Compares the histogram to the one at the previous checkpoint
+	 *		  and either marks it as converged or doubles the checkpoint.
+	*/
+	void ReachCheckpoint(SamplingState& _state, float _tolerance)
 	{
-		//Get three random vertices.
-		GetRandomVertices(_modelDescriptor, 3, meshPositions, randomVertices);
-
-		//calculate the difference of two of the vertices with the third vertex.
-		glm::vec3 u = randomVertices[0] - randomVertices[1];
-		glm::vec3 v = randomVertices[2] - randomVertices[1];
-
-		//Calculate the angle.
-		const float length = (glm::length(u) * glm::length(v));
-		const float dt = glm::dot(u, v);
-		const float angle = std::acos(dt / length);
-
-		if (std::isnan(angle))
+		if (_state.counts.sampleCount >= _state.budget.maxSamples)
 		{
-			i--;
-			continue;
+			_state.converged = true;
+			return;
 		}
 
-		//Find the bin it fits in by first dividing by the bin size and then flooring the result by casting it to an int.
-		int bin = static_cast<int>(angle / binSize);
-		if (bin >= HISTOGRAM_BIN_SIZE)
+		float current[HISTOGRAM_BIN_SIZE];
+		float change = 0;
+		for (int i = 0; i < HISTOGRAM_BIN_SIZE; i++)
 		{
-			// TODO Report violation in log
-			bin = HISTOGRAM_BIN_SIZE - 1;
+			current[i] = _state.counts.bins[i] / static_cast<float>(std::max(_state.counts.sampleCount, 1));
+			change += std::abs(current[i] - _state.previous[i]);
 		}
-		a3Feature[bin] += 1;
-	}
 
-	ProcessBins(a3Feature);
-
-	delete[] meshPositions;
-	return a3Feature;
-}
-
-HistogramFeature ExtractD1(const ModelDescriptor& _modelDescriptor)
-{
-	//assume barycenter is at 0
-	//TODO(Resul): Do we want to set this to the actual barycenter?
-	const glm::vec3 barycenter{ 0 };
-
-	//Get the start positions for each mesh so that we can pick a random vertex out of all meshes.
-	int* meshPositions = new int[_modelDescriptor.m_model->m_meshes.size()];
-	GetMeshPositions(*_modelDescriptor.m_model, meshPositions);
-
-	//Create all bins for the histogram.
-	HistogramFeature d1Feature(HISTOGRAM_BIN_SIZE);
-	d1Feature.m_min = 0;
-	d1Feature.m_max = Features3D::globalBoundsD1.t;
-	
-	//Get the bin size
-	const float binSize = Features3D::globalBoundsD1.t / HISTOGRAM_BIN_SIZE;
-
-	//Iterate for a while, each time picking a random vertex and extracting the distance between it and the barycenter.
-	glm::vec3 randomVertex;
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
-	{
-		GetRandomVertices(_modelDescriptor, 1, meshPositions, &randomVertex);
-
-		for (int j = 0; j < _modelDescriptor.m_model->m_meshes.size(); j++)
+		if (_state.hasPrevious && _state.counts.sampleCount >= _state.budget.minSamples && change < _tolerance)
 		{
-			glm::vec3 diff = randomVertex - barycenter;
-			const float distance = glm::length(diff);
-			int bin = static_cast<int>(distance / binSize);
-			if (bin >= HISTOGRAM_BIN_SIZE)
-			{
-				// TODO Report violation in log
-				bin = HISTOGRAM_BIN_SIZE - 1;
-			}
-			d1Feature[bin]++;
+			_state.converged = true;
+			return;
 		}
+
+		std::copy(current, current + HISTOGRAM_BIN_SIZE, _state.previous);
+		_state.hasPrevious = true;
+		_state.checkpoint = std::min(std::max(_state.checkpoint * 2, _state.budget.minSamples), _state.budget.maxSamples);
 	}
 
-	ProcessBins(d1Feature);
-	delete[] meshPositions;
-	return d1Feature;
-}
+	/**
+	 * @brief Everything needed to fill the histogram of one shape distribution.
+	*/
+	struct DistributionBinning
+	{
+		kernels::BinKernel bin;
+		float binSize;
+		float min;
+		float max;
+	};
 
-HistogramFeature ExtractD2(const ModelDescriptor& _modelDescriptor)
-{
-	//Get the start positions for each mesh so that we can pick a random vertex out of all meshes.
-	int* meshPositions = new int[_modelDescriptor.m_model->m_meshes.size()];
-	GetMeshPositions(*_modelDescriptor.m_model, meshPositions);
-
-	//Add small epsilon so that we include all vertices.
-	const float maxDistance = Features3D::globalBoundsD2.t;
-	//Calculate the bin size.
-	const float binSize = maxDistance / HISTOGRAM_BIN_SIZE;
-
-	//Create all bins for the histogram.
-	HistogramFeature d2Feature(HISTOGRAM_BIN_SIZE);
-	d2Feature.m_min = 0;
-	d2Feature.m_max = maxDistance;
-	
-	//Iterate for a while, each time picking two random vertices and extracting the distance between them.
-	glm::vec3 randomVertices[2];
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
+	DistributionBinning GetBinning(ShapeDistribution _distribution)
 	{
-		GetRandomVertices(_modelDescriptor, 2, meshPositions, randomVertices);
-		
-		//Calculate distance between the two vertices
-		glm::vec3 diff = randomVertices[0] - randomVertices[1];
-		const float distance = glm::length(diff);
-
-		//Add one to the correct bin
-		int bin = static_cast<int>(distance / binSize);
-		if (bin >= HISTOGRAM_BIN_SIZE)
+		//Picks the vectorized kernels when the CPU supports them, they produce the same histograms as the scalar ones.
+		const kernels::ShapeKernels& shapeKernels = kernels::GetShapeKernels();
+		switch (_distribution)
 		{
-			// TODO Report violation in log
-			bin = HISTOGRAM_BIN_SIZE - 1;
+		case A3_DISTRIBUTION:
+			return { shapeKernels.a3, static_cast<float>(M_PI / HISTOGRAM_BIN_SIZE), 0, static_cast<float>(M_PI) };
+		case D1_DISTRIBUTION:
+			return { shapeKernels.d1, Features3D::globalBoundsD1.t / HISTOGRAM_BIN_SIZE, 0, Features3D::globalBoundsD1.t };
+		case D2_DISTRIBUTION:
+			return { shapeKernels.d2, Features3D::globalBoundsD2.t / HISTOGRAM_BIN_SIZE, 0, Features3D::globalBoundsD2.t };
+		case D3_DISTRIBUTION:
+			//Add small epsilon so that we include all samples.
+			return { shapeKernels.d3, static_cast<float>(Features3D::globalBoundsD3.t + 0.001) / HISTOGRAM_BIN_SIZE, 0, Features3D::globalBoundsD3.t };
+		case D4_DISTRIBUTION:
+		default:
+			return { shapeKernels.d4, static_cast<float>(Features3D::globalBoundsD4.t + 0.001) / HISTOGRAM_BIN_SIZE, 0, Features3D::globalBoundsD4.t };
 		}
-		d2Feature[bin]++;
 	}
 
-	ProcessBins(d2Feature);
-	return d2Feature;
-}
-
-HistogramFeature ExtractD3(const ModelDescriptor& _modelDescriptor)
-{
-	//Get the start positions for each mesh so that we can pick a random vertex out of all meshes.
-	int* meshPositions = new int[_modelDescriptor.m_model->m_meshes.size()];
-	GetMeshPositions(*_modelDescriptor.m_model, meshPositions);
-
-	//Add small epsilon so that we include all vertices.
-	const float minArea = 0;
-	const float maxArea = Features3D::globalBoundsD3.t;
-
-	//Get all random triangle areas and the max and min areas
-	float* triangleAreas = new float[HISTOGRAM_ITERATIONS];
-	glm::vec3 randomVertices[3];
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
+	/**
+	 * @brief Fills the histograms of the given shape distributions from one stream of random vertex tuples.
+	 *		  Every tuple is shared by all distributions, each one using as many of its vertices as it needs.
+	 * @param _sampler The sampler to draw the vertex tuples from.
+	 * @param _generator The generator that drives the sampler.
+	 * @param _settings The sample budgets and whether to stop at convergence.
+	 * @param _distributions The shape distributions to extract.
+	 * @param _distributionCount The number of shape distributions to extract.
+	 * @param o_features The histograms, one for every requested shape distribution.
+	*/
+	void ExtractDistributions(const VertexSampler& _sampler, RandomGenerator& _generator, const ShapeDistributionSettings& _settings,
+		const ShapeDistribution* _distributions, int _distributionCount, HistogramFeature* o_features)
 	{
-		GetRandomVertices(_modelDescriptor, 3, meshPositions, randomVertices);
+		DistributionBinning binnings[SHAPE_DISTRIBUTION_COUNT];
+		SamplingState states[SHAPE_DISTRIBUTION_COUNT];
 
+		int tupleSize = 1;
+		int maxSamples = 1;
+		for (int d = 0; d < _distributionCount; d++)
+		{
+			binnings[d] = GetBinning(_distributions[d]);
+			StartSampling(states[d], _settings.budgets[_distributions[d]], _settings.adaptiveSampling);
+			tupleSize = std::max(tupleSize, TUPLE_SIZES[_distributions[d]]);
+			maxSamples = std::max(maxSamples, states[d].budget.maxSamples);
+		}
 
-		float area = std::sqrt(ExtractTriangleArea(randomVertices[0], randomVertices[1], randomVertices[2]));
-		triangleAreas[i] = area;
+		if (_sampler.GetVertexCount() > 0)
+		{
+			std::unique_ptr<SampleBlock> block = std::make_unique<SampleBlock>();
+			const int maxDraws = maxSamples * MAX_DRAW_FACTOR;
 
-		//maxArea = std::max(maxArea, area);
-		//minArea = std::min(minArea, area);
-	}
+			for (int draws = 0; draws < maxDraws;)
+			{
+				//Draw only as many tuples as the furthest behind histogram needs to reach its checkpoint.
+				int needed = 0;
+				for (int d = 0; d < _distributionCount; d++)
+					needed = std::max(needed, states[d].Needed());
+				if (needed == 0)
+					break;
 
-	//Calculate the bin sizes
-	const float distance = maxArea - minArea + 0.001;
-	const float binSize = (distance) / HISTOGRAM_BIN_SIZE;
+				const int tupleCount = std::min({ needed, SAMPLE_BLOCK_SIZE, maxDraws - draws });
+				_sampler.FillBlock(_generator, tupleSize, tupleCount, *block);
+				draws += tupleCount;
 
-	//Create all bins for the histogram.
-	HistogramFeature d3Feature(HISTOGRAM_BIN_SIZE);
-	d3Feature.m_min = minArea;
-	d3Feature.m_max = maxArea;
+				//Every histogram takes the tuples it still needs from the block.
+				for (int d = 0; d < _distributionCount; d++)
+				{
+					SamplingState& state = states[d];
+					const int count = std::min(tupleCount, state.Needed());
+					if (count <= 0)
+						continue;
+
+					state.counts.sampleCount += binnings[d].bin(*block, count, binnings[d].binSize, HISTOGRAM_BIN_SIZE, state.counts.bins);
+					if (state.counts.sampleCount >= state.checkpoint)
+						ReachCheckpoint(state, _settings.convergenceTolerance);
+				}
+			}
+		}
 
-	//Add to the correct bins
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
-	{
-		int bin = static_cast<int>(triangleAreas[i] / binSize);
-		if (bin >= HISTOGRAM_BIN_SIZE)
+		for (int d = 0; d < _distributionCount; d++)
 		{
-			// TODO Report violation in log
-			bin = HISTOGRAM_BIN_SIZE - 1;
+			const HistogramCounts& counts = states[d].counts;
+			HistogramFeature& feature = o_features[d];
+			feature = HistogramFeature(HISTOGRAM_BIN_SIZE);
+			feature.m_min = binnings[d].min;
+			feature.m_max = binnings[d].max;
+			feature.m_sampleCount = counts.sampleCount;
+
+			for (int i = 0; i < HISTOGRAM_BIN_SIZE; i++)
+				feature[i] = counts.sampleCount > 0 ? counts.bins[i] / static_cast<double>(counts.sampleCount) : 0;
 		}
-		d3Feature[bin]++;
 	}
 
-	ProcessBins(d3Feature);
-
-	delete[] triangleAreas;
-	delete[] meshPositions;
-	return d3Feature;
+	HistogramFeature ExtractDistribution(const VertexSampler& _sampler, RandomGenerator& _generator, const ShapeDistributionSettings& _settings, ShapeDistribution _distribution)
+	{
+		HistogramFeature feature(HISTOGRAM_BIN_SIZE);
+		ExtractDistributions(_sampler, _generator, _settings, &_distribution, 1, &feature);
+		return feature;
+	}
 }
 
-HistogramFeature ExtractD4(const ModelDescriptor& _modelDescriptor)
+HistogramFeature ExtractA3(const VertexSampler& _sampler, RandomGenerator& _generator)
 {
-	//Get the start positions for each mesh so that we can pick a random vertex out of all meshes.
-	int* meshPositions = new int[_modelDescriptor.m_model->m_meshes.size()];
-	GetMeshPositions(*_modelDescriptor.m_model, meshPositions);
-
-	//Add small epsilon so that we include all vertices.
-	const float minVolume = 0;
-	const float maxVolume = Features3D::globalBoundsD4.t;
-
+	return ExtractDistribution(_sampler, _generator, ShapeDistributionSettings(), A3_DISTRIBUTION);
+}
 
-	//Get all random tet volumes so that we know what the min and max are.
-	float* tetVolumes = new float[HISTOGRAM_ITERATIONS];
-	glm::vec3 randomVertices[4];
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
-	{
-		GetRandomVertices(_modelDescriptor, 4, meshPositions, randomVertices);
+HistogramFeature ExtractD1(const VertexSampler& _sampler, RandomGenerator& _generator)
+{
+	return ExtractDistribution(_sampler, _generator, ShapeDistributionSettings(), D1_DISTRIBUTION);
+}
 
-		float volume = std::cbrt(ExtractVolumeOfTetrahedron(randomVertices[0], randomVertices[1], randomVertices[2], randomVertices[3]));
-		tetVolumes[i] = volume;
+HistogramFeature ExtractD2(const VertexSampler& _sampler, RandomGenerator& _generator)
+{
+	return ExtractDistribution(_sampler, _generator, ShapeDistributionSettings(), D2_DISTRIBUTION);
+}
 
-		//maxVolume = std::max(maxVolume, volume);
-		//minVolume = std::min(minVolume, volume);
-	}
+HistogramFeature ExtractD3(const VertexSampler& _sampler, RandomGenerator& _generator)
+{
+	return ExtractDistribution(_sampler, _generator, ShapeDistributionSettings(), D3_DISTRIBUTION);
+}
 
-	//Calculate the bin size.
-	const float distance = maxVolume - minVolume + 0.001;
-	const float binSize = (distance) / HISTOGRAM_BIN_SIZE;
+HistogramFeature ExtractD4(const VertexSampler& _sampler, RandomGenerator& _generator)
+{
+	return ExtractDistribution(_sampler, _generator, ShapeDistributionSettings(), D4_DISTRIBUTION);
+}
 
-	//Create all bins for the histogram.
-	HistogramFeature d4Feature(HISTOGRAM_BIN_SIZE);
-	d4Feature.m_min = minVolume;
-	d4Feature.m_max = maxVolume;
+void ExtractShapeDistributions(const VertexSampler& _sampler, uint64_t _seed, const ShapeDistributionSettings& _settings, Features3D& o_features)
+{
+	HistogramFeature* features[SHAPE_DISTRIBUTION_COUNT] = { &o_features.a3, &o_features.d1, &o_features.d2, &o_features.d3, &o_features.d4 };
 
-	//Go over all volumes and add them to their correct bins.
-	for (int i = 0; i < HISTOGRAM_ITERATIONS; i++)
+	if (_settings.independentStreams)
 	{
-		int bin = static_cast<int>(tetVolumes[i] / binSize);
-		if (bin >= HISTOGRAM_BIN_SIZE)
+		//Every distribution draws its own tuples from its own stream.
+		for (int d = 0; d < SHAPE_DISTRIBUTION_COUNT; d++)
 		{
-			// TODO Report violation in log
-			bin = HISTOGRAM_BIN_SIZE - 1;
+			RandomGenerator generator(_seed, d);
+			*features[d] = ExtractDistribution(_sampler, generator, _settings, static_cast<ShapeDistribution>(d));
 		}
-		d4Feature[bin]++;
+		return;
 	}
 
-	ProcessBins(d4Feature);
+	const ShapeDistribution distributions[SHAPE_DISTRIBUTION_COUNT] = { A3_DISTRIBUTION, D1_DISTRIBUTION, D2_DISTRIBUTION, D3_DISTRIBUTION, D4_DISTRIBUTION };
+	HistogramFeature fused[SHAPE_DISTRIBUTION_COUNT] = { HistogramFeature(0), HistogramFeature(0), HistogramFeature(0), HistogramFeature(0), HistogramFeature(0) };
+
+	RandomGenerator generator(_seed, FUSED_STREAM);
+	ExtractDistributions(_sampler, generator, _settings, distributions, SHAPE_DISTRIBUTION_COUNT, fused);
 
-	delete[] meshPositions;
-	delete[] tetVolumes;
-	return d4Feature;
+	for (int d = 0; d < SHAPE_DISTRIBUTION_COUNT; d++)
+		*features[d] = fused[d];
 }
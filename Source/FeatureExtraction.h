@@ -7,14 +7,27 @@
 
 class Feature;
 class HistogramFeature;
+class VertexSampler;
+class RandomGenerator;
 
 float ExtractSurfaceArea(ModelDescriptor& _modelDescriptor);
 float ExtractAABBArea(ModelDescriptor& _modelDescriptor);
 float ExtractAABBVolume(ModelDescriptor& _modelDescriptor);
 std::vector<double> ExtractFaceAreas(const ModelDescriptor& _modelDescriptor);
 float ExtractVolume(const ModelDescriptor& _modelDescriptor);
-HistogramFeature ExtractA3(const ModelDescriptor& _modelDescriptor);
-HistogramFeature ExtractD1(const ModelDescriptor& _modelDescriptor);
-HistogramFeature ExtractD2(const ModelDescriptor& _modelDescriptor);
-HistogramFeature ExtractD3(const ModelDescriptor& _modelDescriptor);
-HistogramFeature ExtractD4(const ModelDescriptor& _modelDescriptor);
+HistogramFeature ExtractA3(const VertexSampler& _sampler, RandomGenerator& _generator);
+HistogramFeature ExtractD1(const VertexSampler& _sampler, RandomGenerator& _generator);
+HistogramFeature ExtractD2(const VertexSampler& _sampler, RandomGenerator& _generator);
+HistogramFeature ExtractD3(const VertexSampler& _sampler, RandomGenerator& _generator);
+HistogramFeature ExtractD4(const VertexSampler& _sampler, RandomGenerator& _generator);
+
+/**
+ * @brief Extracts all five shape distributions of a model at once.
+ *		  By default one stream of 4-vertex tuples is drawn and every tuple contributes to all histograms in the same pass,
+ *		  which needs far fewer random vertex fetches than extracting the distributions one by one.
+ * @param _sampler The sampler over the vertices of the model.
+ * @param _seed The seed of the random streams, derived from the model so the result is reproducible.
+ * @param _settings Whether the distributions share their samples or use independent streams, and how many samples they use.
+ * @param o_features The features to store the histograms in.
+*/
+void ExtractShapeDistributions(const VertexSampler& _sampler, uint64_t _seed, const ShapeDistributionSettings& _settings, Features3D& o_features);
@@ -0,0 +1,809 @@
+#include "FeatureMatrix.h"
+
+#include "DistanceKernels.h"
+#include "HistogramDistance.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace
+{
+	/** Number of rows whose distances are computed before they are offered to the heap, small enough to stay in the L1 cache */
+	constexpr size_t SCAN_BLOCK_SIZE = 256;
+	/** Number of queries a worker scans the matrix for before it takes the next chunk */
+	constexpr size_t QUERY_GRAIN_SIZE = 16;
+	/** Number of rows an anytime search ranks between two looks at the clock, which takes about as long as a few distances */
+	constexpr size_t DEADLINE_CHECK_INTERVAL = 64;
+	/**
+	 * Relative slack of the lower bounds of the composite distance. The bounds hold for real numbers, the slack covers the rounding
+	 * of the bounds and of the distance the kernels compute, so a bound never exceeds that distance
+	 */
+	constexpr float BOUND_SLACK = 1e-4f;
+
+	/**
+	 * @brief Lower bound of the Earth mover's distance between two histograms from the totals of their cumulative sums.
+	*/
+	float EarthMoversLowerBound(float _queryTotal, float _rowTotal)
+	{
+		const float slack = BOUND_SLACK * (1 + std::abs(_queryTotal) + std::abs(_rowTotal));
+		return std::max(std::abs(_queryTotal - _rowTotal) - slack, 0.0f);
+	}
+
+	/**
+	 * @brief Lower bound of a histogram distance from the lower bound of the Earth mover's distance, for histograms of unit mass.
+	 *		  Every cumulative difference is at most the total variation t = 1/2 |a - b|_1, so t >= EMD / (binCount - 1), and
+	 *		  the intersection distance is t, the chi-square distance at least t^2 by Cauchy-Schwarz and the Jensen-Shannon
+	 *		  divergence at least t^2 / 2 by Pinsker's inequality.
+	*/
+	float MetricLowerBound(HistogramMetric _metric, float _earthMoversBound, int _binCount)
+	{
+		if (_metric == HistogramMetric::EARTH_MOVERS)
+			return _earthMoversBound;
+
+		const float variation = _earthMoversBound / std::max(_binCount - 1, 1);
+		float bound;
+		switch (_metric)
+		{
+		case HistogramMetric::CHI_SQUARE:
+			bound = variation * variation;
+			break;
+		case HistogramMetric::JENSEN_SHANNON:
+			bound = 0.5f * variation * variation;
+			break;
+		case HistogramMetric::INTERSECTION:
+		default:
+			bound = variation;
+			break;
+		}
+		// Absolute slack, the kernels of these metrics round the bins of the whole histogram
+		return std::max(bound - BOUND_SLACK, 0.0f);
+	}
+
+	/**
+	 * @brief Computes the scalar term of the lower bound of the composite distance from a query to a block of rows, see ComputeLowerBounds.
+	*/
+	void ComputeScalarLowerBounds(const DistanceBounds& _bounds, const FeatureLayout& _layout, const float* _query, float _scalarWeight,
+		size_t _begin, size_t _count, float* o_bounds)
+	{
+		float sums[SCAN_BLOCK_SIZE] = {};
+		for (int c = 0; c < _layout.scalarCount; c++)
+		{
+			const float* scalars = _bounds.GetScalars(c) + _begin;
+			for (size_t i = 0; i < _count; i++)
+			{
+				const float difference = _query[c] - scalars[i];
+				sums[i] += difference * difference;
+			}
+		}
+
+		// The scalar term is scaled down by the slack as well, in case it is rounded differently than by the kernels
+		const float scalarWeight = (1 - BOUND_SLACK) * _scalarWeight;
+		for (size_t i = 0; i < _count; i++)
+			o_bounds[i] = scalarWeight * std::sqrt(sums[i]);
+	}
+
+	/**
+	 * @brief Computes the lower bound of the composite distance from a query to a block of rows, see DistanceBounds.
+	 *		  The bounds are computed column by column, so the loops run over consecutive rows.
+	 * @param _queryTotals The totals of the cumulative sums of the query, see DistanceBounds::ComputeCumulativeTotals.
+	 * @param _count At most SCAN_BLOCK_SIZE rows.
+	*/
+	void ComputeLowerBounds(const DistanceBounds& _bounds, const FeatureLayout& _layout, const float* _query, const float* _queryTotals,
+		const FeatureWeights& _weights, size_t _begin, size_t _count, float* o_bounds)
+	{
+		ComputeScalarLowerBounds(_bounds, _layout, _query, _weights.scalar, _begin, _count, o_bounds);
+		for (int h = 0; h < _layout.histogramCount; h++)
+		{
+			const float* totals = _bounds.GetCumulativeTotals(h) + _begin;
+			for (size_t i = 0; i < _count; i++)
+				o_bounds[i] += _weights.histograms[h] * EarthMoversLowerBound(_queryTotals[h], totals[i]);
+		}
+	}
+
+	/**
+	 * @brief Computes the lower bound of a distance picked per query from a block of rows, see ComputeLowerBounds and MetricLowerBound.
+	*/
+	void ComputeLowerBounds(const DistanceBounds& _bounds, const FeatureLayout& _layout, const float* _query, const float* _queryTotals,
+		const QueryDistance& _distance, size_t _begin, size_t _count, float* o_bounds)
+	{
+		ComputeScalarLowerBounds(_bounds, _layout, _query, _distance.weights.scalar, _begin, _count, o_bounds);
+		for (int h = 0; h < _layout.histogramCount; h++)
+		{
+			const HistogramMetric metric = _distance.GetMetric(h);
+			const float weight = _distance.weights.histograms[h];
+			const float* totals = _bounds.GetCumulativeTotals(h) + _begin;
+			if (metric == HistogramMetric::EARTH_MOVERS)
+			{
+				for (size_t i = 0; i < _count; i++)
+					o_bounds[i] += weight * EarthMoversLowerBound(_queryTotals[h], totals[i]);
+			}
+			else
+			{
+				for (size_t i = 0; i < _count; i++)
+					o_bounds[i] += weight * MetricLowerBound(metric, EarthMoversLowerBound(_queryTotals[h], totals[i]), _layout.binCount);
+			}
+		}
+	}
+
+	/**
+	 * @brief Computes the distance picked per query from a query to one row, but stops once the terms added so far exceed a threshold,
+	 *		  see kernels::CompositeDistanceBelow. The terms are added in the same order, so with the Earth mover's distance for every
+	 *		  histogram a completed distance is bit-identical to the one of the kernels.
+	 * @return Whether the distance was completed, o_distance is only written then.
+	*/
+	bool DistanceBelow(const float* _row, const FeatureLayout& _layout, const float* _query, const QueryDistance& _distance,
+		float _threshold, float& o_distance)
+	{
+		float distance = kernels::ScalarDistanceTerm(_row, _layout, _query, _distance.weights);
+		for (int h = 0; h < _layout.histogramCount; h++)
+		{
+			const int offset = _layout.GetHistogramOffset(h);
+			distance += _distance.weights.histograms[h] * HistogramDistance(_distance.GetMetric(h), _query + offset, _row + offset, _layout.binCount);
+			if (distance > _threshold)
+				return false;
+		}
+		o_distance = distance;
+		return true;
+	}
+
+	/** The distance of the kernels under the same name as the distance picked per query, for SearchPruned */
+	bool DistanceBelow(const float* _row, const FeatureLayout& _layout, const float* _query, const FeatureWeights& _weights, float _threshold, float& o_distance)
+	{
+		return kernels::CompositeDistanceBelow(_row, _layout, _query, _weights, _threshold, o_distance);
+	}
+
+	/**
+	 * @brief Offers a candidate to a max heap of the best _k neighbours so far.
+	*/
+	void OfferNeighbour(std::vector<Neighbour>& _heap, size_t _k, const Neighbour& _candidate)
+	{
+		if (_heap.size() == _k && !(_candidate < _heap.front()))
+			return;
+
+		_heap.push_back(_candidate);
+		std::push_heap(_heap.begin(), _heap.end());
+		if (_heap.size() > _k)
+		{
+			std::pop_heap(_heap.begin(), _heap.end());
+			_heap.pop_back();
+		}
+	}
+
+	/**
+	 * @brief The pruned search of FindNearestNeighboursPruned, over the rows a filter allows.
+	 * @param _weights The distance, FeatureWeights or QueryDistance.
+	 * @param _allowedRows One entry per row, non-zero for the rows that can be returned, null to allow every row.
+	*/
+	template<typename Distance>
+	std::vector<Neighbour> SearchPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+		const Distance& _weights, const uint8_t* _allowedRows, PruningStatistics* o_statistics)
+	{
+		assert(_bounds.GetRowCount() == _matrix.GetRowCount());
+
+		const FeatureLayout& layout = _matrix.GetLayout();
+		const size_t rowCount = _matrix.GetRowCount();
+
+		std::vector<Neighbour> heap;
+		heap.reserve(_k + 1);
+		if (_k == 0 || rowCount == 0)
+			return heap;
+
+		std::vector<float> queryTotals(layout.histogramCount);
+		DistanceBounds::ComputeCumulativeTotals(layout, _query, queryTotals.data());
+
+		// The rows with the k smallest bounds are collected on the way, as a max heap like the neighbours
+		std::vector<float> lowerBounds(rowCount);
+		std::vector<Neighbour> seeds;
+		seeds.reserve(_k + 1);
+		for (size_t begin = 0; begin < rowCount; begin += SCAN_BLOCK_SIZE)
+		{
+			const size_t count = std::min(SCAN_BLOCK_SIZE, rowCount - begin);
+			float* bounds = lowerBounds.data() + begin;
+			ComputeLowerBounds(_bounds, layout, _query, queryTotals.data(), _weights, begin, count, bounds);
+			for (size_t i = 0; i < count; i++)
+			{
+				if ((_allowedRows == nullptr || _allowedRows[begin + i]) && (seeds.size() < _k || bounds[i] < seeds.front().distance))
+					OfferNeighbour(seeds, _k, { static_cast<int>(begin + i), bounds[i] });
+			}
+		}
+
+		PruningStatistics statistics;
+		const auto visit = [&](size_t _row)
+		{
+			// Rows whose bound equals the k-th best distance can still win the tie on their index
+			const float threshold = heap.size() == _k ? heap.front().distance : std::numeric_limits<float>::infinity();
+			float distance;
+			if (_allowedRows != nullptr && !_allowedRows[_row])
+				statistics.filtered++;
+			else if (lowerBounds[_row] > threshold)
+				statistics.boundPruned++;
+			else if (!DistanceBelow(_matrix.GetRow(_row), layout, _query, _weights, threshold, distance))
+				statistics.abandoned++;
+			else
+			{
+				statistics.computed++;
+				OfferNeighbour(heap, _k, { static_cast<int>(_row), distance });
+			}
+		};
+
+		// The rows with the smallest bounds go first, so the k-th best distance is tight from the start, the rest follow in memory order
+		std::sort(seeds.begin(), seeds.end(), [](const Neighbour& _left, const Neighbour& _right) { return _left.index < _right.index; });
+		for (const Neighbour& seed : seeds)
+			visit(static_cast<size_t>(seed.index));
+
+		auto nextSeed = seeds.begin();
+		for (size_t i = 0; i < rowCount; i++)
+		{
+			if (nextSeed != seeds.end() && static_cast<size_t>(nextSeed->index) == i)
+				++nextSeed;
+			else
+				visit(i);
+		}
+
+		if (o_statistics != nullptr)
+			*o_statistics += statistics;
+		std::sort_heap(heap.begin(), heap.end());
+		return heap;
+	}
+}
+
+NeighbourMatrix::NeighbourMatrix() :
+	m_queryCount(0),
+	m_k(0)
+{ }
+
+NeighbourMatrix::NeighbourMatrix(size_t _queryCount, size_t _k) :
+	m_queryCount(_queryCount),
+	m_k(_k),
+	m_indices(_queryCount * _k, -1),
+	m_distances(_queryCount * _k, std::numeric_limits<float>::infinity())
+{ }
+
+size_t NeighbourMatrix::GetNeighbourCount(size_t _query) const
+{
+	const int* indices = GetIndices(_query);
+	return std::find(indices, indices + m_k, -1) - indices;
+}
+
+void NeighbourMatrix::SetNeighbours(size_t _query, const std::vector<Neighbour>& _neighbours)
+{
+	const size_t count = std::min(_neighbours.size(), m_k);
+	for (size_t i = 0; i < m_k; i++)
+	{
+		m_indices[_query * m_k + i] = i < count ? _neighbours[i].index : -1;
+		m_distances[_query * m_k + i] = i < count ? _neighbours[i].distance : std::numeric_limits<float>::infinity();
+	}
+}
+
+FeatureMatrix::FeatureMatrix() :
+	m_rowCount(0),
+	m_capacity(0),
+	m_stride(0)
+{ }
+
+FeatureMatrix::FeatureMatrix(size_t _rowCount, const FeatureLayout& _layout) :
+	m_rowCount(_rowCount),
+	m_capacity(_rowCount),
+	m_layout(_layout)
+{
+	constexpr size_t floatsPerAlignment = ROW_ALIGNMENT / sizeof(float);
+	m_stride = (GetColumnCount() + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+
+	const size_t byteCount = std::max<size_t>(m_rowCount * m_stride * sizeof(float), ROW_ALIGNMENT);
+	m_data.reset(static_cast<float*>(::operator new(byteCount, std::align_val_t(ROW_ALIGNMENT))));
+	std::memset(m_data.get(), 0, byteCount);
+}
+
+float* FeatureMatrix::AppendRow()
+{
+	if (m_rowCount == m_capacity)
+	{
+		const size_t capacity = std::max<size_t>(2 * m_capacity, 16);
+		const size_t byteCount = capacity * m_stride * sizeof(float);
+		std::unique_ptr<float[], AlignedDeleter> data(static_cast<float*>(::operator new(byteCount, std::align_val_t(ROW_ALIGNMENT))));
+		std::memset(data.get(), 0, byteCount);
+		std::memcpy(data.get(), m_data.get(), m_rowCount * m_stride * sizeof(float));
+		m_data = std::move(data);
+		m_capacity = capacity;
+	}
+
+	float* row = GetRow(m_rowCount++);
+	std::memset(row, 0, m_stride * sizeof(float));
+	return row;
+}
+
+void FeatureMatrix::RemoveRow(size_t _row)
+{
+	std::memmove(GetRow(_row), GetRow(_row + 1), (m_rowCount - _row - 1) * m_stride * sizeof(float));
+	m_rowCount--;
+}
+
+void FeatureMatrix::AlignedDeleter::operator()(float* _data) const
+{
+	::operator delete(_data, std::align_val_t(ROW_ALIGNMENT));
+}
+
+std::vector<Neighbour> FindNearestNeighbours(const FeatureMatrix& _matrix, const float* _query, size_t _k, const FeatureWeights& _weights)
+{
+	const kernels::DistanceKernels& distanceKernels = kernels::GetDistanceKernels();
+
+	// Max heap of the best candidates so far, its top is the candidate that is replaced next
+	std::vector<Neighbour> heap;
+	heap.reserve(_k + 1);
+	if (_k == 0)
+		return heap;
+
+	float distances[SCAN_BLOCK_SIZE];
+	for (size_t begin = 0; begin < _matrix.GetRowCount(); begin += SCAN_BLOCK_SIZE)
+	{
+		const size_t count = std::min(SCAN_BLOCK_SIZE, _matrix.GetRowCount() - begin);
+		distanceKernels.composite(_matrix.GetRow(begin), _matrix.GetStride(), count, _matrix.GetLayout(), _query, _weights, distances);
+
+		for (size_t i = 0; i < count; i++)
+			OfferNeighbour(heap, _k, { static_cast<int>(begin + i), distances[i] });
+	}
+
+	std::sort_heap(heap.begin(), heap.end());
+	return heap;
+}
+
+std::vector<Neighbour> FindNearestNeighbours(const FeatureMatrix& _matrix, const float* _query, size_t _k, const QueryDistance& _distance)
+{
+	const FeatureLayout& layout = _matrix.GetLayout();
+	assert(_distance.weights.histograms.size() >= static_cast<size_t>(layout.histogramCount));
+
+	std::vector<Neighbour> heap;
+	heap.reserve(_k + 1);
+	if (_k == 0)
+		return heap;
+
+	// Block by block and histogram by histogram, so every histogram is compared with the kernel of its metric
+	float distances[SCAN_BLOCK_SIZE];
+	float histogramDistances[SCAN_BLOCK_SIZE];
+	for (size_t begin = 0; begin < _matrix.GetRowCount(); begin += SCAN_BLOCK_SIZE)
+	{
+		const size_t count = std::min(SCAN_BLOCK_SIZE, _matrix.GetRowCount() - begin);
+		for (size_t i = 0; i < count; i++)
+			distances[i] = kernels::ScalarDistanceTerm(_matrix.GetRow(begin + i), layout, _query, _distance.weights);
+
+		for (int h = 0; h < layout.histogramCount; h++)
+		{
+			const int offset = layout.GetHistogramOffset(h);
+			HistogramDistances(_distance.GetMetric(h), _query + offset, _matrix.GetRow(begin) + offset, _matrix.GetStride(), count, layout.binCount, histogramDistances);
+			for (size_t i = 0; i < count; i++)
+				distances[i] += _distance.weights.histograms[h] * histogramDistances[i];
+		}
+
+		for (size_t i = 0; i < count; i++)
+			OfferNeighbour(heap, _k, { static_cast<int>(begin + i), distances[i] });
+	}
+
+	std::sort_heap(heap.begin(), heap.end());
+	return heap;
+}
+
+NeighbourMatrix FindNearestNeighbours(const FeatureMatrix& _matrix, const FeatureMatrix& _queries, size_t _k, const FeatureWeights& _weights, unsigned int _threadCount)
+{
+	NeighbourMatrix neighbours(_queries.GetRowCount(), _k);
+	util::ParallelFor(_queries.GetRowCount(), QUERY_GRAIN_SIZE, [&](size_t _begin, size_t _end)
+	{
+		for (size_t q = _begin; q < _end; q++)
+			neighbours.SetNeighbours(q, FindNearestNeighbours(_matrix, _queries.GetRow(q), _k, _weights));
+	}, _threadCount);
+	return neighbours;
+}
+
+DistanceBounds::DistanceBounds() :
+	m_scalarCount(0)
+{ }
+
+DistanceBounds::DistanceBounds(const FeatureMatrix& _matrix) :
+	m_scalarCount(_matrix.GetLayout().scalarCount),
+	m_columns(m_scalarCount + _matrix.GetLayout().histogramCount, std::vector<float>(_matrix.GetRowCount()))
+{
+	std::vector<float> totals(_matrix.GetLayout().histogramCount);
+	for (size_t i = 0; i < _matrix.GetRowCount(); i++)
+	{
+		const float* row = _matrix.GetRow(i);
+		ComputeCumulativeTotals(_matrix.GetLayout(), row, totals.data());
+		for (int c = 0; c < m_scalarCount; c++)
+			m_columns[c][i] = row[c];
+		for (size_t h = 0; h < totals.size(); h++)
+			m_columns[m_scalarCount + h][i] = totals[h];
+	}
+}
+
+void DistanceBounds::AppendRow(const FeatureLayout& _layout, const float* _row)
+{
+	m_scalarCount = _layout.scalarCount;
+	m_columns.resize(_layout.scalarCount + _layout.histogramCount);
+
+	std::vector<float> totals(_layout.histogramCount);
+	ComputeCumulativeTotals(_layout, _row, totals.data());
+	for (int c = 0; c < m_scalarCount; c++)
+		m_columns[c].push_back(_row[c]);
+	for (size_t h = 0; h < totals.size(); h++)
+		m_columns[m_scalarCount + h].push_back(totals[h]);
+}
+
+void DistanceBounds::RemoveRow(size_t _row)
+{
+	for (std::vector<float>& column : m_columns)
+		column.erase(column.begin() + _row);
+}
+
+void DistanceBounds::ComputeCumulativeTotals(const FeatureLayout& _layout, const float* _row, float* o_totals)
+{
+	// Summed in double, so the rounding of the totals stays far below the slack of the bound
+	for (int h = 0; h < _layout.histogramCount; h++)
+	{
+		const float* bins = _row + _layout.GetHistogramOffset(h);
+		double cumulative = 0;
+		double total = 0;
+		for (int b = 0; b < _layout.binCount - 1; b++)
+		{
+			cumulative += bins[b];
+			total += cumulative;
+		}
+		o_totals[h] = static_cast<float>(total);
+	}
+}
+
+PruningStatistics& PruningStatistics::operator+=(const PruningStatistics& _other)
+{
+	boundPruned += _other.boundPruned;
+	abandoned += _other.abandoned;
+	computed += _other.computed;
+	filtered += _other.filtered;
+	return *this;
+}
+
+std::vector<Neighbour> FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, PruningStatistics* o_statistics)
+{
+	return SearchPruned(_matrix, _bounds, _query, _k, _weights, nullptr, o_statistics);
+}
+
+std::vector<Neighbour> FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, const std::vector<uint8_t>& _allowedRows, PruningStatistics* o_statistics)
+{
+	assert(_allowedRows.size() == _matrix.GetRowCount());
+	return SearchPruned(_matrix, _bounds, _query, _k, _weights, _allowedRows.data(), o_statistics);
+}
+
+std::vector<Neighbour> FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const QueryDistance& _distance, PruningStatistics* o_statistics)
+{
+	assert(_distance.weights.scalar >= 0 && _distance.weights.histograms.size() >= static_cast<size_t>(_matrix.GetLayout().histogramCount));
+	assert(std::all_of(_distance.weights.histograms.begin(), _distance.weights.histograms.end(), [](float _weight) { return _weight >= 0; }));
+	return SearchPruned(_matrix, _bounds, _query, _k, _distance, nullptr, o_statistics);
+}
+
+NeighbourMatrix FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const FeatureMatrix& _queries, size_t _k,
+	const FeatureWeights& _weights, unsigned int _threadCount, PruningStatistics* o_statistics)
+{
+	NeighbourMatrix neighbours(_queries.GetRowCount(), _k);
+	std::vector<PruningStatistics> statistics(_queries.GetRowCount());
+	util::ParallelFor(_queries.GetRowCount(), QUERY_GRAIN_SIZE, [&](size_t _begin, size_t _end)
+	{
+		for (size_t q = _begin; q < _end; q++)
+			neighbours.SetNeighbours(q, FindNearestNeighboursPruned(_matrix, _bounds, _queries.GetRow(q), _k, _weights, &statistics[q]));
+	}, _threadCount);
+
+	if (o_statistics != nullptr)
+	{
+		for (const PruningStatistics& queryStatistics : statistics)
+			*o_statistics += queryStatistics;
+	}
+	return neighbours;
+}
+
+std::vector<Neighbour> FindLowestBounds(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _count,
+	const FeatureWeights& _weights)
+{
+	assert(_bounds.GetRowCount() == _matrix.GetRowCount());
+
+	const FeatureLayout& layout = _matrix.GetLayout();
+	const size_t rowCount = _matrix.GetRowCount();
+
+	std::vector<Neighbour> heap;
+	heap.reserve(_count + 1);
+	if (_count == 0 || rowCount == 0)
+		return heap;
+
+	std::vector<float> queryTotals(layout.histogramCount);
+	DistanceBounds::ComputeCumulativeTotals(layout, _query, queryTotals.data());
+
+	float bounds[SCAN_BLOCK_SIZE];
+	for (size_t begin = 0; begin < rowCount; begin += SCAN_BLOCK_SIZE)
+	{
+		const size_t count = std::min(SCAN_BLOCK_SIZE, rowCount - begin);
+		ComputeLowerBounds(_bounds, layout, _query, queryTotals.data(), _weights, begin, count, bounds);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (heap.size() < _count || bounds[i] < heap.front().distance)
+				OfferNeighbour(heap, _count, { static_cast<int>(begin + i), bounds[i] });
+		}
+	}
+
+	std::sort_heap(heap.begin(), heap.end());
+	return heap;
+}
+
+std::vector<Neighbour> FindNearestNeighboursCascade(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	size_t _candidateCount, const FeatureWeights& _weights)
+{
+	const std::vector<Neighbour> candidates = FindLowestBounds(_matrix, _bounds, _query, std::max(_candidateCount, _k), _weights);
+
+	std::vector<int> rows(candidates.size());
+	for (size_t i = 0; i < candidates.size(); i++)
+		rows[i] = candidates[i].index;
+	return RankRows(_matrix, _query, rows, _k, _weights);
+}
+
+std::vector<Neighbour> FindNearestNeighboursAnytime(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, std::chrono::steady_clock::time_point _deadline, AnytimeStatistics* o_statistics)
+{
+	return FindNearestNeighboursAnytime(_matrix, _bounds, _query, _k, _weights, {}, _deadline, o_statistics);
+}
+
+std::vector<Neighbour> FindNearestNeighboursAnytime(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, const std::vector<int>& _candidates, std::chrono::steady_clock::time_point _deadline, AnytimeStatistics* o_statistics)
+{
+	assert(_bounds.GetRowCount() == _matrix.GetRowCount());
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const FeatureLayout& layout = _matrix.GetLayout();
+	const size_t rowCount = _matrix.GetRowCount();
+
+	AnytimeStatistics statistics;
+	std::vector<Neighbour> heap;
+	heap.reserve(_k + 1);
+	if (_k == 0 || rowCount == 0)
+	{
+		statistics.exact = true;
+		if (o_statistics != nullptr)
+			*o_statistics = statistics;
+		return heap;
+	}
+
+	// The candidates are ranked before any bound is known until the deadline passes, every row is visited once
+	std::vector<uint8_t> visited(rowCount, 0);
+	for (size_t c = 0; c < _candidates.size(); c++)
+	{
+		if (c % DEADLINE_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() >= _deadline)
+			break;
+
+		const int candidate = _candidates[c];
+		assert(candidate >= 0 && static_cast<size_t>(candidate) < rowCount);
+		if (visited[candidate])
+			continue;
+		visited[candidate] = 1;
+
+		const float threshold = heap.size() == _k ? heap.front().distance : std::numeric_limits<float>::infinity();
+		float distance;
+		if (!kernels::CompositeDistanceBelow(_matrix.GetRow(candidate), layout, _query, _weights, threshold, distance))
+			statistics.pruning.abandoned++;
+		else
+		{
+			statistics.pruning.computed++;
+			OfferNeighbour(heap, _k, { candidate, distance });
+		}
+	}
+
+	std::vector<float> queryTotals(layout.histogramCount);
+	DistanceBounds::ComputeCumulativeTotals(layout, _query, queryTotals.data());
+
+	// The bounds of every block and their minimum, and the rows with the k smallest bounds as seeds like in the pruned search
+	std::vector<float> lowerBounds(rowCount);
+	std::vector<float> blockBounds;
+	std::vector<Neighbour> seeds;
+	seeds.reserve(_k + 1);
+	size_t boundedRows = 0;
+	do
+	{
+		const size_t count = std::min(SCAN_BLOCK_SIZE, rowCount - boundedRows);
+		float* bounds = lowerBounds.data() + boundedRows;
+		ComputeLowerBounds(_bounds, layout, _query, queryTotals.data(), _weights, boundedRows, count, bounds);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!visited[boundedRows + i] && (seeds.size() < _k || bounds[i] < seeds.front().distance))
+				OfferNeighbour(seeds, _k, { static_cast<int>(boundedRows + i), bounds[i] });
+		}
+		blockBounds.push_back(*std::min_element(bounds, bounds + count));
+		boundedRows += count;
+	} while (boundedRows < rowCount && std::chrono::steady_clock::now() < _deadline);
+
+	// Rows of the blocks that were bounded and are still to be visited
+	size_t unvisitedRows = static_cast<size_t>(std::count(visited.begin(), visited.begin() + boundedRows, 0));
+
+	const auto visit = [&](size_t _row)
+	{
+		visited[_row] = 1;
+		unvisitedRows--;
+
+		const float threshold = heap.size() == _k ? heap.front().distance : std::numeric_limits<float>::infinity();
+		float distance;
+		if (lowerBounds[_row] > threshold)
+			statistics.pruning.boundPruned++;
+		else if (!kernels::CompositeDistanceBelow(_matrix.GetRow(_row), layout, _query, _weights, threshold, distance))
+			statistics.pruning.abandoned++;
+		else
+		{
+			statistics.pruning.computed++;
+			OfferNeighbour(heap, _k, { static_cast<int>(_row), distance });
+		}
+	};
+
+	// The seeds go next, even past the deadline, so there are results however late the search started
+	for (const Neighbour& seed : seeds)
+		visit(static_cast<size_t>(seed.index));
+
+	// The blocks go in the order of their smallest bound, once it exceeds the k-th best distance no row left can be closer
+	std::vector<int> blockOrder(blockBounds.size());
+	for (size_t b = 0; b < blockOrder.size(); b++)
+		blockOrder[b] = static_cast<int>(b);
+	std::sort(blockOrder.begin(), blockOrder.end(), [&](int _left, int _right)
+	{
+		return blockBounds[_left] < blockBounds[_right] || (blockBounds[_left] == blockBounds[_right] && _left < _right);
+	});
+
+	size_t nextBlock = 0;
+	size_t nextRow = 0;
+	bool timedOut = false;
+	for (; nextBlock < blockOrder.size(); nextBlock++)
+	{
+		if (heap.size() == _k && blockBounds[blockOrder[nextBlock]] > heap.front().distance)
+		{
+			statistics.pruning.boundPruned += unvisitedRows;
+			nextBlock = blockOrder.size();
+			break;
+		}
+
+		const size_t begin = static_cast<size_t>(blockOrder[nextBlock]) * SCAN_BLOCK_SIZE;
+		const size_t end = std::min(begin + SCAN_BLOCK_SIZE, boundedRows);
+		for (nextRow = begin; nextRow < end; nextRow++)
+		{
+			if ((nextRow - begin) % DEADLINE_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() >= _deadline)
+			{
+				timedOut = true;
+				break;
+			}
+			if (!visited[nextRow])
+				visit(nextRow);
+		}
+		if (timedOut)
+			break;
+	}
+
+	std::sort_heap(heap.begin(), heap.end());
+
+	statistics.boundedRows = boundedRows;
+	statistics.exact = boundedRows == rowCount && nextBlock == blockOrder.size();
+	if (statistics.exact)
+		statistics.certainCount = heap.size();
+	else if (boundedRows == rowCount)
+	{
+		// A row that was left out is at least as far as the smallest bound of the rest of its block or of the blocks after it
+		float smallestBound = nextBlock + 1 < blockOrder.size() ? blockBounds[blockOrder[nextBlock + 1]] : std::numeric_limits<float>::infinity();
+		const size_t end = std::min(static_cast<size_t>(blockOrder[nextBlock]) * SCAN_BLOCK_SIZE + SCAN_BLOCK_SIZE, boundedRows);
+		for (size_t row = nextRow; row < end; row++)
+		{
+			if (!visited[row])
+				smallestBound = std::min(smallestBound, lowerBounds[row]);
+		}
+
+		// A row as far as the bound could still win the tie on its index
+		while (statistics.certainCount < heap.size() && heap[statistics.certainCount].distance < smallestBound)
+			statistics.certainCount++;
+	}
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (o_statistics != nullptr)
+		*o_statistics = statistics;
+	return heap;
+}
+
+size_t CalibrateCandidateCount(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const FeatureMatrix& _queries, size_t _k,
+	const FeatureWeights& _weights, float _targetRecall, unsigned int _threadCount)
+{
+	const FeatureLayout& layout = _matrix.GetLayout();
+	const size_t rowCount = _matrix.GetRowCount();
+	if (_k == 0 || rowCount == 0 || _queries.GetRowCount() == 0)
+		return _k;
+
+	// The position of every exact neighbour in the order of the bounds is the smallest pool that contains it
+	std::vector<std::vector<size_t>> queryPositions(_queries.GetRowCount());
+	util::ParallelFor(_queries.GetRowCount(), 1, [&](size_t _begin, size_t _end)
+	{
+		std::vector<float> lowerBounds(rowCount);
+		std::vector<float> queryTotals(layout.histogramCount);
+		for (size_t q = _begin; q < _end; q++)
+		{
+			const float* query = _queries.GetRow(q);
+			DistanceBounds::ComputeCumulativeTotals(layout, query, queryTotals.data());
+			for (size_t begin = 0; begin < rowCount; begin += SCAN_BLOCK_SIZE)
+				ComputeLowerBounds(_bounds, layout, query, queryTotals.data(), _weights, begin, std::min(SCAN_BLOCK_SIZE, rowCount - begin), lowerBounds.data() + begin);
+
+			for (const Neighbour& neighbour : FindNearestNeighboursPruned(_matrix, _bounds, query, _k, _weights))
+			{
+				const Neighbour bound = { neighbour.index, lowerBounds[neighbour.index] };
+				size_t position = 0;
+				for (size_t i = 0; i < rowCount; i++)
+					position += Neighbour{ static_cast<int>(i), lowerBounds[i] } < bound;
+				queryPositions[q].push_back(position);
+			}
+		}
+	}, _threadCount);
+
+	std::vector<size_t> positions;
+	for (const std::vector<size_t>& queryPosition : queryPositions)
+		positions.insert(positions.end(), queryPosition.begin(), queryPosition.end());
+
+	// The pool has to reach past the position of the target share of the neighbours
+	const size_t requiredCount = static_cast<size_t>(std::ceil(std::clamp(_targetRecall, 0.0f, 1.0f) * positions.size()));
+	if (requiredCount == 0)
+		return _k;
+	std::nth_element(positions.begin(), positions.begin() + (requiredCount - 1), positions.end());
+	return std::clamp(positions[requiredCount - 1] + 1, _k, rowCount);
+}
+
+std::vector<Neighbour> RankRows(const FeatureMatrix& _matrix, const float* _query, const std::vector<int>& _rows, size_t _k, const FeatureWeights& _weights)
+{
+	// The rows are scattered, so each one is its own batch of the scalar kernel
+	const kernels::DistanceKernels& distanceKernels = kernels::GetScalarDistanceKernels();
+
+	std::vector<Neighbour> neighbours(_rows.size());
+	for (size_t i = 0; i < _rows.size(); i++)
+	{
+		neighbours[i].index = _rows[i];
+		distanceKernels.composite(_matrix.GetRow(_rows[i]), _matrix.GetStride(), 1, _matrix.GetLayout(), _query, _weights, &neighbours[i].distance);
+	}
+
+	const size_t k = std::min(_k, neighbours.size());
+	std::partial_sort(neighbours.begin(), neighbours.begin() + k, neighbours.end());
+	neighbours.resize(k);
+	return neighbours;
+}
+
+FeatureLayout GetCumulativeLayout(const FeatureLayout& _layout)
+{
+	FeatureLayout layout = _layout;
+	layout.binCount = std::max(_layout.binCount - 1, 0);
+	return layout;
+}
+
+void EmbedCumulative(const FeatureLayout& _layout, const float* _row, const FeatureWeights& _weights, float* o_row)
+{
+	const FeatureLayout cumulativeLayout = GetCumulativeLayout(_layout);
+
+	const float scalarWeight = _layout.scalarCount > 0 ? _weights.scalar / std::sqrt(static_cast<float>(_layout.scalarCount)) : 0.0f;
+	for (int c = 0; c < _layout.scalarCount; c++)
+		o_row[c] = scalarWeight * _row[c];
+
+	// The last cumulative sum is the mass of the histogram, which is the same for all of them
+	for (int h = 0; h < _layout.histogramCount; h++)
+	{
+		const float* bins = _row + _layout.GetHistogramOffset(h);
+		float* cumulativeBins = o_row + cumulativeLayout.GetHistogramOffset(h);
+		float cumulative = 0;
+		for (int b = 0; b < cumulativeLayout.binCount; b++)
+		{
+			cumulative += bins[b];
+			cumulativeBins[b] = _weights.histograms[h] * cumulative;
+		}
+	}
+}
+
+FeatureMatrix EmbedCumulative(const FeatureMatrix& _matrix, const FeatureWeights& _weights)
+{
+	FeatureMatrix embedded(_matrix.GetRowCount(), GetCumulativeLayout(_matrix.GetLayout()));
+	for (size_t i = 0; i < _matrix.GetRowCount(); i++)
+		EmbedCumulative(_matrix.GetLayout(), _matrix.GetRow(i), _weights, embedded.GetRow(i));
+	return embedded;
+}
@@ -0,0 +1,378 @@
+#pragma once
+
+#include "HistogramDistance.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Where the blocks of a feature vector are stored within a row of a FeatureMatrix.
+ *		  A row holds the standardized scalar features followed by the histograms, in the order of FeatureVector::AsFloatVector.
+*/
+struct FeatureLayout
+{
+	/** Number of standardized scalar features at the start of every row */
+	int scalarCount = 0;
+	/** Number of histograms that follow the scalars */
+	int histogramCount = 0;
+	/** Number of bins of every histogram */
+	int binCount = 0;
+
+	int GetColumnCount() const { return scalarCount + histogramCount * binCount; }
+	int GetHistogramOffset(int _histogram) const { return scalarCount + _histogram * binCount; }
+};
+
+/**
+ * @brief Weights of the blocks of the composite shape distance, see FeatureVectorDistance.
+*/
+struct FeatureWeights
+{
+	/** Weight of the Euclidean distance between the scalar features */
+	float scalar = 2.0f;
+	/** Weight of the Earth mover's distance between every pair of histograms */
+	std::vector<float> histograms;
+};
+
+/**
+ * @brief A composite distance picked per query, weights.scalar * |q_s - r_s| + sum over the histograms h of
+ *		  weights.histograms[h] * metric_h(q_h, r_h), e.g. with more weight on D2 or the chi-square distance for A3.
+ *		  The weights have to be non-negative. Searches with it read the same matrix and DistanceBounds as the fixed distance.
+*/
+struct QueryDistance
+{
+	FeatureWeights weights;
+	/** Metric of every histogram, histograms without an entry use the Earth mover's distance */
+	std::vector<HistogramMetric> metrics;
+
+	HistogramMetric GetMetric(int _histogram) const
+	{
+		return static_cast<size_t>(_histogram) < metrics.size() ? metrics[_histogram] : HistogramMetric::EARTH_MOVERS;
+	}
+};
+
+/**
+ * @brief Result of a nearest neighbour search, a row of the searched matrix and its distance to the query.
+*/
+struct Neighbour
+{
+	int index;
+	float distance;
+
+	/** Orders by distance, ties are broken by index so results do not depend on the order rows are visited in */
+	bool operator<(const Neighbour& _other) const
+	{
+		return distance < _other.distance || (distance == _other.distance && index < _other.index);
+	}
+};
+
+/**
+ * @brief Results of a batch of nearest neighbour searches, the neighbours of every query in one row of _k entries.
+ *		  Queries with fewer than _k neighbours are padded with index -1 and an infinite distance.
+*/
+class NeighbourMatrix
+{
+public:
+	NeighbourMatrix();
+	NeighbourMatrix(size_t _queryCount, size_t _k);
+
+	size_t GetQueryCount() const { return m_queryCount; }
+	size_t GetK() const { return m_k; }
+
+	/** Indices of the neighbours of a query, closest first */
+	const int* GetIndices(size_t _query) const { return m_indices.data() + _query * m_k; }
+	/** Distances of the neighbours of a query, in the same order as their indices */
+	const float* GetDistances(size_t _query) const { return m_distances.data() + _query * m_k; }
+	/** Number of neighbours that were found for a query, the rest of its row is padding */
+	size_t GetNeighbourCount(size_t _query) const;
+
+	/**
+	 * @brief Stores the first _k neighbours of a query and pads the rest of its row.
+	*/
+	void SetNeighbours(size_t _query, const std::vector<Neighbour>& _neighbours);
+
+private:
+	size_t m_queryCount;
+	size_t m_k;
+	std::vector<int> m_indices;
+	std::vector<float> m_distances;
+};
+
+/**
+ * @brief Feature vectors of all models in one contiguous block, one row per model.
+ *		  Every row starts on a 64 byte boundary and is padded with zeros to a multiple of 64 bytes,
+ *		  so the distance kernels can use aligned loads and rows never share a cache line.
+*/
+class FeatureMatrix
+{
+public:
+	static constexpr size_t ROW_ALIGNMENT = 64;
+
+	FeatureMatrix();
+	FeatureMatrix(size_t _rowCount, const FeatureLayout& _layout);
+
+	size_t GetRowCount() const { return m_rowCount; }
+	size_t GetColumnCount() const { return static_cast<size_t>(m_layout.GetColumnCount()); }
+	/** Number of floats from the start of one row to the next */
+	size_t GetStride() const { return m_stride; }
+	const FeatureLayout& GetLayout() const { return m_layout; }
+
+	float* GetRow(size_t _row) { return m_data.get() + _row * m_stride; }
+	const float* GetRow(size_t _row) const { return m_data.get() + _row * m_stride; }
+
+	/**
+	 * @brief Adds a row of zeros at the end. The capacity doubles when it runs out, so pointers to rows are invalidated.
+	 * @return The new row.
+	*/
+	float* AppendRow();
+
+	/**
+	 * @brief Removes a row and moves the rows after it up by one.
+	*/
+	void RemoveRow(size_t _row);
+
+private:
+	struct AlignedDeleter
+	{
+		void operator()(float* _data) const;
+	};
+
+	std::unique_ptr<float[], AlignedDeleter> m_data;
+	size_t m_rowCount;
+	/** Number of rows m_data has room for */
+	size_t m_capacity;
+	size_t m_stride;
+	FeatureLayout m_layout;
+};
+
+/**
+ * @brief Finds the rows closest to the query by scanning the whole matrix with the fastest distance kernel the CPU supports.
+ *		  Only the best _k candidates are kept in a bounded heap, so the rest of the distances are never sorted.
+ * @param _matrix The feature vectors to search.
+ * @param _query A row with the layout of the matrix, it does not have to be aligned.
+ * @param _k The number of neighbours to return.
+ * @param _weights The weights of the distance, one per histogram of the layout.
+ * @return The min(_k, row count) closest rows, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighbours(const FeatureMatrix& _matrix, const float* _query, size_t _k, const FeatureWeights& _weights);
+
+/**
+ * @brief Finds the rows closest to the query under a distance picked per query by scanning the whole matrix.
+ *		  Every histogram is compared with the kernel of its metric, see HistogramDistances. With the Earth mover's distance
+ *		  for every histogram the neighbours and their distances are the same as with the overload for FeatureWeights.
+ * @return The min(_k, row count) closest rows, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighbours(const FeatureMatrix& _matrix, const float* _query, size_t _k, const QueryDistance& _distance);
+
+/**
+ * @brief Finds the rows closest to every row of _queries, see the overload for a single query.
+ *		  The queries are split over a thread pool and each one is scanned on its own, so the results do not depend on the number of threads.
+ * @param _matrix The feature vectors to search.
+ * @param _queries The queries, with the layout of the matrix.
+ * @param _k The number of neighbours to return per query.
+ * @param _weights The weights of the distance, one per histogram of the layout.
+ * @param _threadCount The number of worker threads, 0 picks util::DefaultThreadCount().
+ * @return The min(_k, row count) closest rows of every query.
+*/
+NeighbourMatrix FindNearestNeighbours(const FeatureMatrix& _matrix, const FeatureMatrix& _queries, size_t _k, const FeatureWeights& _weights, unsigned int _threadCount = 0);
+
+/**
+ * @brief Per-row summaries of a feature matrix that bound the composite distance from below without reading the histograms.
+ *		  The Earth mover's distance between two histograms is the L1 distance of their cumulative sums, so it is at least the
+ *		  absolute difference of the totals of their cumulative sums, which is the difference of their means in bins.
+ *		  The summaries are stored column by column, a copy of every scalar followed by the totals of every histogram,
+ *		  so a search reads a fraction of the matrix and bounds consecutive rows with vector instructions.
+*/
+class DistanceBounds
+{
+public:
+	DistanceBounds();
+	explicit DistanceBounds(const FeatureMatrix& _matrix);
+
+	size_t GetRowCount() const { return m_columns.empty() ? 0 : m_columns.front().size(); }
+	/** Scalar c of every row, the same values as in the matrix */
+	const float* GetScalars(int _scalar) const { return m_columns[_scalar].data(); }
+	/** Total of the cumulative sums of histogram h of every row */
+	const float* GetCumulativeTotals(int _histogram) const { return m_columns[m_scalarCount + _histogram].data(); }
+
+	/**
+	 * @brief Adds the summary of a row at the end, like FeatureMatrix::AppendRow.
+	*/
+	void AppendRow(const FeatureLayout& _layout, const float* _row);
+
+	/**
+	 * @brief Removes the summary of a row, like FeatureMatrix::RemoveRow.
+	*/
+	void RemoveRow(size_t _row);
+
+	/**
+	 * @brief Computes the totals of the cumulative sums of every histogram of a row.
+	 * @param o_totals _layout.histogramCount values.
+	*/
+	static void ComputeCumulativeTotals(const FeatureLayout& _layout, const float* _row, float* o_totals);
+
+private:
+	int m_scalarCount;
+	std::vector<std::vector<float>> m_columns;
+};
+
+/**
+ * @brief How many rows a pruned search ruled out, see FindNearestNeighboursPruned.
+*/
+struct PruningStatistics
+{
+	/** Rows ruled out by their lower bound without reading their histograms */
+	size_t boundPruned = 0;
+	/** Rows whose distance was abandoned once it exceeded the k-th best distance so far */
+	size_t abandoned = 0;
+	/** Rows whose full distance was computed */
+	size_t computed = 0;
+	/** Rows left out by a filter */
+	size_t filtered = 0;
+
+	size_t GetRowCount() const { return boundPruned + abandoned + computed + filtered; }
+	PruningStatistics& operator+=(const PruningStatistics& _other);
+};
+
+/**
+ * @brief Finds the same neighbours with the same distances as FindNearestNeighbours, but skips rows that cannot be among them.
+ *		  A row is ruled out when a lower bound of its distance, the scalar term plus the mean bound of every histogram, exceeds
+ *		  the k-th best distance so far. The distance of every other row is abandoned as soon as its partial sum exceeds it.
+ *		  The rows with the smallest bounds are computed first, so the k-th best distance is tight from the start.
+ * @param _bounds The summaries of the rows of _matrix.
+ * @param o_statistics Incremented by the number of rows that were pruned, abandoned and computed, may be null.
+ * @return The min(_k, row count) closest rows, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, PruningStatistics* o_statistics = nullptr);
+
+/**
+ * @brief Finds the closest rows among the rows a filter allows with the pruned search. The filter is applied in the scan, rows it
+ *		  leaves out are never computed, so a filter never reduces the number of results below _k like filtering the results would.
+ * @param _allowedRows One entry per row of _matrix, non-zero for the rows that can be returned.
+ * @return The min(_k, number of allowed rows) closest allowed rows, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, const std::vector<uint8_t>& _allowedRows, PruningStatistics* o_statistics = nullptr);
+
+/**
+ * @brief Finds the same neighbours with the same distances as FindNearestNeighbours under a distance picked per query.
+ *		  The bounds do not depend on the weights, so the same DistanceBounds serve every distance and nothing is rebuilt per query.
+ *		  Histograms with the Earth mover's distance are bounded like by the overload for FeatureWeights. For histograms of unit mass
+ *		  the same bound limits their total variation, which bounds the other metrics, but less tightly, so fewer rows are pruned.
+ * @param o_statistics Incremented by the number of rows that were pruned, abandoned and computed, may be null.
+ * @return The min(_k, row count) closest rows, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const QueryDistance& _distance, PruningStatistics* o_statistics = nullptr);
+
+/**
+ * @brief Finds the closest rows of every row of _queries with the pruned search, see the overload for a single query and
+ *		  the batch overload of FindNearestNeighbours.
+ * @param o_statistics Incremented by the statistics of all queries, may be null.
+*/
+NeighbourMatrix FindNearestNeighboursPruned(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const FeatureMatrix& _queries, size_t _k,
+	const FeatureWeights& _weights, unsigned int _threadCount = 0, PruningStatistics* o_statistics = nullptr);
+
+/**
+ * @brief Ranks all rows by the lower bound of their composite distance to the query, see DistanceBounds, without reading their histograms.
+ * @param _bounds The summaries of the rows of _matrix.
+ * @return The min(_count, row count) rows with the smallest bounds and their bound, smallest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindLowestBounds(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _count,
+	const FeatureWeights& _weights);
+
+/**
+ * @brief Two-stage search, takes the rows with the smallest lower bounds as candidates, see FindLowestBounds, and re-ranks them
+ *		  by the composite distance, see RankRows. The bounds only approximate the order of the distances, so the result is
+ *		  approximate unless the pool holds every row.
+ * @param _candidateCount The size of the candidate pool, at least _k rows are re-ranked.
+ * @return The min(_k, row count) closest candidates, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighboursCascade(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	size_t _candidateCount, const FeatureWeights& _weights);
+
+/**
+ * @brief Finds the smallest candidate pool of FindNearestNeighboursCascade that holds a share of the exact neighbours of a set of queries.
+ *		  Every query is searched exactly, and the pool has to reach as far in the order of the bounds as the target share of the neighbours.
+ * @param _queries Queries like the ones the cascade search will be used for, e.g. a sample of the rows.
+ * @param _targetRecall The share of the exact _k nearest neighbours of all queries the pool has to hold.
+ * @param _threadCount The number of worker threads, 0 picks util::DefaultThreadCount().
+ * @return The pool size, between _k and the row count.
+*/
+size_t CalibrateCandidateCount(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const FeatureMatrix& _queries, size_t _k,
+	const FeatureWeights& _weights, float _targetRecall, unsigned int _threadCount = 0);
+
+/**
+ * @brief How far an anytime search got before its deadline, see FindNearestNeighboursAnytime.
+*/
+struct AnytimeStatistics
+{
+	/** Whether the search finished before the deadline, so the neighbours are the exact ones */
+	bool exact = false;
+	/** Number of leading neighbours that are certainly the exact ones, because no row left out can be closer, all of them if exact */
+	size_t certainCount = 0;
+	/** Rows whose lower bound was computed before the deadline, only they can be found */
+	size_t boundedRows = 0;
+	/** How the rows were ruled out or computed, rows the deadline left out are not counted */
+	PruningStatistics pruning;
+	/** Time the search took, for Database::FindClosestAnytimeShapes including the shortlist of the ANN index */
+	double seconds = 0;
+};
+
+/**
+ * @brief Finds the closest rows like FindNearestNeighboursPruned, but returns the best rows found so far when a deadline passes.
+ *		  The search bounds the rows block by block, see DistanceBounds, ranks the rows with the k smallest bounds first and then
+ *		  refines them with the blocks in the order of their smallest bound, with the same pruning and early abandoning as the pruned search.
+ *		  Once the smallest bound of the next block exceeds the k-th best distance, no row left can be closer and the results are exact.
+ *		  The deadline is checked every few dozen rows. The first block of bounds and the k seeds are always computed,
+ *		  so a query that starts late still returns _k rows, a few microseconds past the deadline.
+ * @param _deadline The time the search stops refining its results.
+ * @param o_statistics Whether the results are exact and how much work was done, may be null.
+ * @return The min(_k, row count) closest rows found, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> FindNearestNeighboursAnytime(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, std::chrono::steady_clock::time_point _deadline, AnytimeStatistics* o_statistics = nullptr);
+
+/**
+ * @brief Anytime search that ranks a set of candidate rows first, e.g. the shortlist of an ANN index, so the results are as good as
+ *		  the candidates before the first row is bounded, and refines them like the overload without candidates.
+ * @param _candidates Rows of _matrix, they are ranked until the deadline passes and the rest are searched like any other row.
+*/
+std::vector<Neighbour> FindNearestNeighboursAnytime(const FeatureMatrix& _matrix, const DistanceBounds& _bounds, const float* _query, size_t _k,
+	const FeatureWeights& _weights, const std::vector<int>& _candidates, std::chrono::steady_clock::time_point _deadline, AnytimeStatistics* o_statistics = nullptr);
+
+/**
+ * @brief Ranks a subset of the rows by the composite distance, e.g. to re-rank the candidates of an approximate search exactly.
+ * @param _matrix The feature vectors the rows belong to.
+ * @param _query A row with the layout of the matrix.
+ * @param _rows The indices of the rows to rank.
+ * @param _k The number of neighbours to return.
+ * @param _weights The weights of the distance.
+ * @return The min(_k, _rows.size()) closest of the rows, closest first, ties ordered by index.
+*/
+std::vector<Neighbour> RankRows(const FeatureMatrix& _matrix, const float* _query, const std::vector<int>& _rows, size_t _k, const FeatureWeights& _weights);
+
+/**
+ * @brief Layout of the rows of EmbedCumulative, the histograms lose their last bin.
+*/
+FeatureLayout GetCumulativeLayout(const FeatureLayout& _layout);
+
+/**
+ * @brief Embeds a feature vector so the L1 distance between two embedded vectors approximates the composite distance.
+ *		  Every histogram is replaced by its cumulative sums times its weight, which makes the L1 distance between them exactly
+ *		  the weighted Earth mover's distance. The scalars are scaled by weights.scalar / sqrt(scalarCount), since
+ *		  |x|_1 / sqrt(n) <= |x|_2 the embedded distance never exceeds the composite distance.
+ * @param _layout The layout of the feature vector.
+ * @param _row The feature vector to embed.
+ * @param _weights The weights of the distance to approximate.
+ * @param o_row The embedded vector, with the layout GetCumulativeLayout(_layout).
+*/
+void EmbedCumulative(const FeatureLayout& _layout, const float* _row, const FeatureWeights& _weights, float* o_row);
+
+/**
+ * @brief Embeds every row of a matrix, see the overload for a single row.
+*/
+FeatureMatrix EmbedCumulative(const FeatureMatrix& _matrix, const FeatureWeights& _weights);
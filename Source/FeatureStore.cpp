@@ -0,0 +1,393 @@
+#include "FeatureStore.h"
+
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr char COLUMN_MAGIC[4] = { 'M', 'S', 'F', 'C' };
+	constexpr uint32_t COLUMN_VERSION = 1;
+	/** Written as a native integer, so it reads back differently on a machine with another byte order */
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+	/** Number of characters per key, including the terminating zero */
+	constexpr uint32_t KEY_WIDTH = 64;
+	/** Number of elements a histogram record has after its bins, its min and max */
+	constexpr uint32_t HISTOGRAM_EXTRA_WIDTH = 2;
+
+	const DescriptorName SCALARS[] = { VOLUME_3D, SURFACE_AREA_3D, COMPACTNESS_3D, BOUNDS_AREA_3D, BOUNDS_VOLUME_3D, ECCENTRICITY_3D };
+	const char* const SCALAR_NAMES[] = { "volume", "surface_area", "compactness", "bounds_area", "bounds_volume", "eccentricity" };
+	constexpr int SCALAR_COUNT = sizeof(SCALARS) / sizeof(SCALARS[0]);
+
+	/** The histograms in ShapeDistribution order */
+	HistogramFeature Features3D::* const HISTOGRAMS[] = { &Features3D::a3, &Features3D::d1, &Features3D::d2, &Features3D::d3, &Features3D::d4 };
+	const char* const HISTOGRAM_NAMES[] = { "a3", "d1", "d2", "d3", "d4" };
+
+	/**
+	 * @brief The columns of a store in the order they are written, the key column goes last so its record count is the count of the store.
+	*/
+	enum ColumnIndex
+	{
+		VERTEX_COUNT_COLUMN,
+		FACE_COUNT_COLUMN,
+		SCALAR_COLUMNS,
+		HISTOGRAM_COLUMNS = SCALAR_COLUMNS + SCALAR_COUNT,
+		BIN_COUNT_COLUMN = HISTOGRAM_COLUMNS + SHAPE_DISTRIBUTION_COUNT,
+		SAMPLE_COUNT_COLUMN,
+		KEY_COLUMN,
+		COLUMN_COUNT
+	};
+
+	enum class ColumnType : uint32_t
+	{
+		INT32,
+		FLOAT32,
+		CHAR
+	};
+
+	struct ColumnHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t byteOrder;
+		ColumnType type;
+		/** Number of elements per record */
+		uint32_t width;
+		uint32_t reserved;
+		uint64_t recordCount;
+		char name[32];
+	};
+	static_assert(sizeof(ColumnHeader) == 64, "The records of a column start at byte 64");
+
+	/**
+	 * @brief The schema of a column and the bytes of its records in memory.
+	*/
+	struct Column
+	{
+		std::string name;
+		ColumnType type;
+		/** Number of elements per record, 0 if it is taken from the file */
+		uint32_t width;
+		std::vector<char> records;
+
+		Column() :
+			type(ColumnType::INT32),
+			width(0)
+		{ }
+
+		Column(std::string _name, ColumnType _type, uint32_t _width) :
+			name(std::move(_name)),
+			type(_type),
+			width(_width)
+		{ }
+
+		size_t GetRecordSize() const { return width * (type == ColumnType::CHAR ? 1 : 4); }
+
+		template<typename T>
+		void AppendElement(T _value)
+		{
+			const char* bytes = reinterpret_cast<const char*>(&_value);
+			records.insert(records.end(), bytes, bytes + sizeof(T));
+		}
+
+		template<typename T>
+		T GetElement(size_t _record, size_t _element) const
+		{
+			T value;
+			std::memcpy(&value, records.data() + _record * GetRecordSize() + _element * sizeof(T), sizeof(T));
+			return value;
+		}
+	};
+
+	/**
+	 * @param _binCount The number of bins of the histogram columns, 0 if it is taken from the files.
+	*/
+	std::vector<Column> CreateColumns(uint32_t _binCount)
+	{
+		std::vector<Column> columns(COLUMN_COUNT);
+		columns[VERTEX_COUNT_COLUMN] = Column("vertex_count", ColumnType::INT32, 1);
+		columns[FACE_COUNT_COLUMN] = Column("face_count", ColumnType::INT32, 1);
+		for (int s = 0; s < SCALAR_COUNT; s++)
+			columns[SCALAR_COLUMNS + s] = Column(SCALAR_NAMES[s], ColumnType::FLOAT32, 1);
+		for (int h = 0; h < SHAPE_DISTRIBUTION_COUNT; h++)
+			columns[HISTOGRAM_COLUMNS + h] = Column(HISTOGRAM_NAMES[h], ColumnType::FLOAT32, _binCount == 0 ? 0 : _binCount + HISTOGRAM_EXTRA_WIDTH);
+		columns[BIN_COUNT_COLUMN] = Column("bin_counts", ColumnType::INT32, SHAPE_DISTRIBUTION_COUNT);
+		columns[SAMPLE_COUNT_COLUMN] = Column("sample_counts", ColumnType::INT32, SHAPE_DISTRIBUTION_COUNT);
+		columns[KEY_COLUMN] = Column("key", ColumnType::CHAR, KEY_WIDTH);
+		return columns;
+	}
+
+	fs::path GetColumnPath(const fs::path& _directory, const Column& _column)
+	{
+		return _directory / (_column.name + ".col");
+	}
+
+	bool ReadHeader(std::istream& _stream, const Column& _column, ColumnHeader& o_header)
+	{
+		_stream.read(reinterpret_cast<char*>(&o_header), sizeof(o_header));
+		return _stream && std::memcmp(o_header.magic, COLUMN_MAGIC, sizeof(COLUMN_MAGIC)) == 0 && o_header.version == COLUMN_VERSION
+			&& o_header.byteOrder == BYTE_ORDER_MARK && o_header.type == _column.type && (_column.width == 0 || o_header.width == _column.width)
+			&& o_header.width > 0 && std::strncmp(o_header.name, _column.name.c_str(), sizeof(o_header.name)) == 0;
+	}
+
+	/**
+	 * @brief Reads the first records of a column in one read.
+	 * @param _column Its schema, a width of 0 is taken from the file.
+	*/
+	bool ReadColumn(const fs::path& _path, uint64_t _recordCount, Column& _column)
+	{
+		std::ifstream file(_path, std::ios::binary);
+		ColumnHeader header;
+		if (!ReadHeader(file, _column, header) || header.recordCount < _recordCount)
+			return false;
+
+		_column.width = header.width;
+		std::error_code error;
+		const uintmax_t fileSize = fs::file_size(_path, error);
+		if (error || fileSize < sizeof(ColumnHeader) + _recordCount * _column.GetRecordSize())
+			return false;
+
+		_column.records.resize(_recordCount * _column.GetRecordSize());
+		file.read(_column.records.data(), _column.records.size());
+		return static_cast<bool>(file);
+	}
+
+	/**
+	 * @brief Writes the records of a column after its first _firstRecord records, creating the file if _firstRecord is 0.
+	*/
+	bool WriteColumn(const fs::path& _path, uint64_t _firstRecord, const Column& _column)
+	{
+		ColumnHeader header = {};
+		std::memcpy(header.magic, COLUMN_MAGIC, sizeof(COLUMN_MAGIC));
+		header.version = COLUMN_VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		header.type = _column.type;
+		header.width = _column.width;
+		header.recordCount = _firstRecord + _column.records.size() / _column.GetRecordSize();
+		std::strncpy(header.name, _column.name.c_str(), sizeof(header.name) - 1);
+
+		if (_firstRecord == 0)
+		{
+			std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(_column.records.data(), _column.records.size());
+			return static_cast<bool>(file);
+		}
+
+		// Records after the count of the store are left over from an interrupted append and are overwritten
+		std::fstream file(_path, std::ios::binary | std::ios::in | std::ios::out);
+		ColumnHeader existing;
+		if (!ReadHeader(file, _column, existing) || existing.recordCount < _firstRecord)
+			return false;
+
+		file.seekp(sizeof(ColumnHeader) + _firstRecord * _column.GetRecordSize());
+		file.write(_column.records.data(), _column.records.size());
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return static_cast<bool>(file);
+	}
+
+	/**
+	 * @brief The number of records of a store, 0 if it has none.
+	*/
+	uint64_t GetRecordCount(const fs::path& _directory)
+	{
+		const Column key = CreateColumns(0)[KEY_COLUMN];
+		std::ifstream file(GetColumnPath(_directory, key), std::ios::binary);
+		ColumnHeader header;
+		return ReadHeader(file, key, header) ? header.recordCount : 0;
+	}
+}
+
+namespace io
+{
+	std::string GetFeatureKey(const fs::path& _modelPath)
+	{
+		return _modelPath.stem().string();
+	}
+
+	FeatureStore::FeatureStore(fs::path _directory) :
+		m_directory(std::move(_directory))
+	{ }
+
+	bool FeatureStore::Exists() const
+	{
+		return GetRecordCount(m_directory) > 0;
+	}
+
+	std::vector<fs::path> FeatureStore::GetColumnPaths() const
+	{
+		std::vector<fs::path> paths;
+		for (const Column& column : CreateColumns(0))
+			paths.push_back(GetColumnPath(m_directory, column));
+		return paths;
+	}
+
+	bool FeatureStore::Append(const std::vector<FeatureRecord>& _records) const
+	{
+		if (_records.empty())
+			return true;
+
+		// A store that has records keeps the bin count of its histogram columns
+		const uint64_t recordCount = GetRecordCount(m_directory);
+		uint32_t binCount = 1;
+		if (recordCount > 0)
+		{
+			Column histogram = CreateColumns(0)[HISTOGRAM_COLUMNS];
+			std::ifstream file(GetColumnPath(m_directory, histogram), std::ios::binary);
+			ColumnHeader header;
+			if (!ReadHeader(file, histogram, header) || header.width < HISTOGRAM_EXTRA_WIDTH)
+				return false;
+			binCount = header.width - HISTOGRAM_EXTRA_WIDTH;
+		}
+		else
+		{
+			for (const FeatureRecord& record : _records)
+				for (HistogramFeature Features3D::* histogram : HISTOGRAMS)
+					binCount = std::max<uint32_t>(binCount, (record.features.*histogram).m_numBins);
+		}
+
+		std::vector<Column> columns = CreateColumns(binCount);
+		for (const FeatureRecord& record : _records)
+		{
+			if (record.key.size() >= KEY_WIDTH)
+			{
+				std::cerr << "Feature key " << record.key << " is too long" << std::endl;
+				return false;
+			}
+
+			columns[VERTEX_COUNT_COLUMN].AppendElement<int32_t>(record.vertexCount);
+			columns[FACE_COUNT_COLUMN].AppendElement<int32_t>(record.faceCount);
+			for (int s = 0; s < SCALAR_COUNT; s++)
+				columns[SCALAR_COLUMNS + s].AppendElement<float>(record.features[SCALARS[s]]);
+
+			for (int h = 0; h < SHAPE_DISTRIBUTION_COUNT; h++)
+			{
+				const HistogramFeature& histogram = record.features.*HISTOGRAMS[h];
+				const uint32_t histogramBins = static_cast<uint32_t>(std::max(histogram.m_numBins, 0));
+				if (histogramBins > binCount || histogram.size() < histogramBins)
+				{
+					std::cerr << "Histogram " << HISTOGRAM_NAMES[h] << " of " << record.key << " has more bins than the feature store" << std::endl;
+					return false;
+				}
+
+				Column& column = columns[HISTOGRAM_COLUMNS + h];
+				for (uint32_t b = 0; b < binCount; b++)
+					column.AppendElement<float>(b < histogramBins ? histogram[b] : 0.0f);
+				column.AppendElement<float>(histogram.m_min);
+				column.AppendElement<float>(histogram.m_max);
+				columns[BIN_COUNT_COLUMN].AppendElement<int32_t>(histogram.m_numBins);
+				columns[SAMPLE_COUNT_COLUMN].AppendElement<int32_t>(histogram.m_sampleCount);
+			}
+
+			char key[KEY_WIDTH] = {};
+			std::memcpy(key, record.key.data(), record.key.size());
+			columns[KEY_COLUMN].records.insert(columns[KEY_COLUMN].records.end(), key, key + KEY_WIDTH);
+		}
+
+		std::error_code error;
+		fs::create_directories(m_directory, error);
+		for (const Column& column : columns)
+		{
+			if (!WriteColumn(GetColumnPath(m_directory, column), recordCount, column))
+			{
+				std::cerr << "Could not write " << GetColumnPath(m_directory, column) << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool FeatureStore::Load(std::vector<FeatureRecord>& o_records) const
+	{
+		const uint64_t recordCount = GetRecordCount(m_directory);
+		if (recordCount == 0)
+			return false;
+
+		std::vector<Column> columns = CreateColumns(0);
+		for (Column& column : columns)
+		{
+			if (!ReadColumn(GetColumnPath(m_directory, column), recordCount, column))
+				return false;
+		}
+		for (int h = 0; h < SHAPE_DISTRIBUTION_COUNT; h++)
+		{
+			if (columns[HISTOGRAM_COLUMNS + h].width < HISTOGRAM_EXTRA_WIDTH)
+				return false;
+		}
+
+		o_records.clear();
+		std::unordered_map<std::string, size_t> recordIndices;
+		for (size_t i = 0; i < recordCount; i++)
+		{
+			const char* key = columns[KEY_COLUMN].records.data() + i * KEY_WIDTH;
+			FeatureRecord record;
+			record.key.assign(key, std::find(key, key + KEY_WIDTH, '\0'));
+			record.vertexCount = columns[VERTEX_COUNT_COLUMN].GetElement<int32_t>(i, 0);
+			record.faceCount = columns[FACE_COUNT_COLUMN].GetElement<int32_t>(i, 0);
+			for (int s = 0; s < SCALAR_COUNT; s++)
+				record.features[SCALARS[s]] = columns[SCALAR_COLUMNS + s].GetElement<float>(i, 0);
+
+			for (int h = 0; h < SHAPE_DISTRIBUTION_COUNT; h++)
+			{
+				const Column& column = columns[HISTOGRAM_COLUMNS + h];
+				const int storedBins = static_cast<int>(column.width - HISTOGRAM_EXTRA_WIDTH);
+				const int binCount = std::clamp(columns[BIN_COUNT_COLUMN].GetElement<int32_t>(i, h), 0, storedBins);
+				HistogramFeature& histogram = record.features.*HISTOGRAMS[h];
+				histogram.m_numBins = binCount;
+				histogram.resize(binCount);
+				for (int b = 0; b < binCount; b++)
+					histogram[b] = column.GetElement<float>(i, b);
+				histogram.m_min = column.GetElement<float>(i, storedBins);
+				histogram.m_max = column.GetElement<float>(i, storedBins + 1);
+				histogram.m_sampleCount = columns[SAMPLE_COUNT_COLUMN].GetElement<int32_t>(i, h);
+			}
+
+			auto index = recordIndices.find(record.key);
+			if (index != recordIndices.end())
+				o_records[index->second] = std::move(record);
+			else
+			{
+				recordIndices[record.key] = o_records.size();
+				o_records.push_back(std::move(record));
+			}
+		}
+		return true;
+	}
+
+	size_t ConvertFeatureDatabase(const fs::path& _featureDirectory, const fs::path& _descriptorDirectory, const FeatureStore& _store)
+	{
+		// Sorted by key, so converting the same files always writes the same store
+		std::map<std::string, FeatureRecord> records;
+		std::error_code error;
+		for (const fs::directory_entry& entry : fs::directory_iterator(_featureDirectory, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".csv")
+				records[entry.path().stem().string()].features = ModelLoader::LoadFeatures(entry.path());
+		}
+		for (const fs::directory_entry& entry : fs::directory_iterator(_descriptorDirectory, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".csv")
+			{
+				FeatureRecord& record = records[entry.path().stem().string()];
+				ModelLoader::LoadDescriptorData(entry.path(), record.vertexCount, record.faceCount);
+			}
+		}
+
+		std::vector<FeatureRecord> converted;
+		converted.reserve(records.size());
+		for (auto& [key, record] : records)
+		{
+			record.key = key;
+			converted.push_back(std::move(record));
+		}
+		return _store.Append(converted) ? converted.size() : 0;
+	}
+}
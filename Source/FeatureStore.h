@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ModelDescriptor.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace io
+{
+	/** Directory the features of all models are stored in, next to the executable */
+	constexpr const char* FEATURE_STORE_DIRECTORY = "FeatureStore";
+
+	/**
+	 * @brief The descriptor data and features of one model in a FeatureStore.
+	*/
+	struct FeatureRecord
+	{
+		/** Identifies the model, see GetFeatureKey */
+		std::string key;
+		int vertexCount = 0;
+		int faceCount = 0;
+		Features3D features;
+	};
+
+	/**
+	 * @brief The key of a model in a FeatureStore, the name of its file without extension like the CSV files were named.
+	*/
+	std::string GetFeatureKey(const std::filesystem::path& _modelPath);
+
+	/**
+	 * @brief Stores the features of all models column by column, one file per descriptor in a directory.
+	 *		  Every file starts with a 64 byte header holding its schema, the element type and number of elements per record,
+	 *		  and its record count, followed by fixed-width records in the byte order of the machine, which is little-endian on
+	 *		  every platform the tree builds for. Record i of a column starts at byte 64 + i * record size, so a column can be read
+	 *		  in one sequential read or mapped into memory as an array.
+	 * @remark Records are only appended, a model that is stored again gets a new record that replaces the old one when loading.
+	 *		   The key column is written last and its record count is the count of the store, so an append that was interrupted
+	 *		   is ignored when loading and overwritten by the next append.
+	*/
+	class FeatureStore
+	{
+	public:
+		explicit FeatureStore(std::filesystem::path _directory);
+
+		/**
+		 * @brief Whether the store holds any records.
+		*/
+		bool Exists() const;
+
+		/**
+		 * @brief The files of all columns, whether they exist or not.
+		*/
+		std::vector<std::filesystem::path> GetColumnPaths() const;
+
+		/**
+		 * @brief Appends the records to every column, creating them if the store is empty.
+		 *		  The histogram columns get room for the most bins of the first records that are appended.
+		 * @return Whether the records were written, false if a key is longer than 63 characters or a histogram has more bins than the store.
+		*/
+		bool Append(const std::vector<FeatureRecord>& _records) const;
+
+		/**
+		 * @brief Reads every column in one go.
+		 * @param o_records One record per key, the last one that was appended for it, in the order the keys were first appended.
+		 * @return Whether the store exists and all of its columns are valid.
+		*/
+		bool Load(std::vector<FeatureRecord>& o_records) const;
+
+	private:
+		std::filesystem::path m_directory;
+	};
+
+	/**
+	 * @brief Appends the per-model CSV files of a feature and a descriptor directory to a store, sorted by key.
+	 *		  Models with only one of the two files get default features or zero vertex and face counts.
+	 * @return The number of models that were converted, 0 if the store could not be written.
+	*/
+	size_t ConvertFeatureDatabase(const std::filesystem::path& _featureDirectory, const std::filesystem::path& _descriptorDirectory,
+		const FeatureStore& _store);
+}
@@ -0,0 +1,534 @@
+#include "HalfEdgeMesh.h"
+
+#include "Model.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	/**
+	 * @brief Hashes the bit pattern of a position, so only exactly equal positions are welded.
+	*/
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& _position) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &_position, sizeof(bits));
+
+			uint64_t hash = 14695981039346656037ull;
+			for (uint32_t word : bits)
+			{
+				hash ^= word;
+				hash *= 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	/**
+	 * @brief The vertices of a face in ascending order, so a face is found regardless of its orientation.
+	*/
+	struct TriangleKey
+	{
+		int vertices[3];
+
+		bool operator==(const TriangleKey& _other) const
+		{
+			return vertices[0] == _other.vertices[0] && vertices[1] == _other.vertices[1] && vertices[2] == _other.vertices[2];
+		}
+	};
+
+	struct TriangleKeyHash
+	{
+		size_t operator()(const TriangleKey& _key) const
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (int vertex : _key.vertices)
+			{
+				hash ^= static_cast<uint32_t>(vertex);
+				hash *= 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	uint64_t EdgeKey(int _from, int _to)
+	{
+		return static_cast<uint64_t>(std::min(_from, _to)) << 32 | static_cast<uint32_t>(std::max(_from, _to));
+	}
+}
+
+HalfEdgeMesh::HalfEdgeMesh(const Mesh& _mesh)
+{
+	// Weld vertices at the same position, adding zero turns -0 into +0 so both hash the same
+	std::unordered_map<glm::vec3, int, PositionHash> weldedVertices;
+	weldedVertices.reserve(_mesh.positions.size());
+	std::vector<int> remap(_mesh.positions.size());
+	for (size_t i = 0; i < _mesh.positions.size(); i++)
+	{
+		const glm::vec3 position = _mesh.positions[i] + glm::vec3(0.0f);
+		auto inserted = weldedVertices.emplace(position, static_cast<int>(m_positions.size()));
+		if (inserted.second)
+			m_positions.push_back(position);
+		remap[i] = inserted.first->second;
+	}
+	m_vertexOutgoing.assign(m_positions.size(), INVALID);
+
+	std::unordered_map<uint64_t, int> edges;
+	edges.reserve(_mesh.faces.size() * 3 / 2);
+	std::unordered_set<TriangleKey, TriangleKeyHash> triangles;
+	triangles.reserve(_mesh.faces.size());
+
+	auto findHalfEdge = [&](int _from, int _to)
+	{
+		auto edge = edges.find(EdgeKey(_from, _to));
+		return edge == edges.end() ? INVALID : 2 * edge->second + (_from > _to ? 1 : 0);
+	};
+	auto isFree = [&](int _from, int _to)
+	{
+		const int halfEdge = findHalfEdge(_from, _to);
+		return halfEdge == INVALID || m_halfEdgeFace[halfEdge] == INVALID;
+	};
+	auto getHalfEdge = [&](int _from, int _to)
+	{
+		const int halfEdge = findHalfEdge(_from, _to);
+		if (halfEdge != INVALID)
+			return halfEdge;
+
+		const int added = AddEdge(std::min(_from, _to), std::max(_from, _to));
+		edges.emplace(EdgeKey(_from, _to), added / 2);
+		return added + (_from > _to ? 1 : 0);
+	};
+
+	for (const ::Face& face : _mesh.faces)
+	{
+		int a = remap[face.indices[0]];
+		int b = remap[face.indices[1]];
+		int c = remap[face.indices[2]];
+		if (a == b || b == c || c == a)
+			continue;
+		if (glm::cross(m_positions[b] - m_positions[a], m_positions[c] - m_positions[a]) == glm::vec3(0))
+			continue;
+
+		TriangleKey key{ { a, b, c } };
+		std::sort(std::begin(key.vertices), std::end(key.vertices));
+		if (!triangles.insert(key).second)
+			continue;
+
+		// Faces that disagree with the orientation of their neighbours are turned around, if that does not help they are dropped
+		if (!isFree(a, b) || !isFree(b, c) || !isFree(c, a))
+		{
+			std::swap(b, c);
+			if (!isFree(a, b) || !isFree(b, c) || !isFree(c, a))
+				continue;
+		}
+
+		const int ab = getHalfEdge(a, b);
+		const int bc = getHalfEdge(b, c);
+		const int ca = getHalfEdge(c, a);
+		SetFace(AddFace(), ab, bc, ca);
+	}
+
+	LinkFans();
+}
+
+void HalfEdgeMesh::ToMesh(Mesh& o_mesh) const
+{
+	o_mesh.positions.clear();
+	o_mesh.normals.clear();
+	o_mesh.texCoords.clear();
+	o_mesh.faces.clear();
+
+	std::vector<int> remap(m_positions.size(), INVALID);
+	for (int v = 0; v < GetVertexCount(); v++)
+	{
+		if (IsDeletedVertex(v))
+			continue;
+		remap[v] = static_cast<int>(o_mesh.positions.size());
+		o_mesh.positions.push_back(m_positions[v]);
+	}
+
+	o_mesh.normals.assign(o_mesh.positions.size(), glm::vec3(0));
+	for (int f = 0; f < GetFaceCount(); f++)
+	{
+		if (IsDeletedFace(f))
+			continue;
+
+		const int halfEdge = m_faceHalfEdge[f];
+		::Face face;
+		face.indices[0] = remap[Source(halfEdge)];
+		face.indices[1] = remap[Target(halfEdge)];
+		face.indices[2] = remap[Target(Next(halfEdge))];
+		o_mesh.faces.push_back(face);
+
+		const glm::vec3 normal = FaceAreaNormal(f);
+		for (unsigned int index : face.indices)
+			o_mesh.normals[index] += normal;
+	}
+
+	for (glm::vec3& normal : o_mesh.normals)
+	{
+		const float length = glm::length(normal);
+		if (length > 0)
+			normal /= length;
+	}
+}
+
+int HalfEdgeMesh::Valence(int _vertex) const
+{
+	int valence = 0;
+	ForEachOutgoing(_vertex, [&](int) { valence++; });
+	return valence;
+}
+
+glm::vec3 HalfEdgeMesh::FaceAreaNormal(int _face) const
+{
+	const int halfEdge = m_faceHalfEdge[_face];
+	const glm::vec3& p0 = m_positions[Source(halfEdge)];
+	const glm::vec3& p1 = m_positions[Target(halfEdge)];
+	const glm::vec3& p2 = m_positions[Target(Next(halfEdge))];
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+glm::vec3 HalfEdgeMesh::VertexNormal(int _vertex) const
+{
+	glm::vec3 normal(0);
+	ForEachOutgoing(_vertex, [&](int _halfEdge)
+	{
+		if (!IsBoundaryHalfEdge(_halfEdge))
+			normal += FaceAreaNormal(Face(_halfEdge));
+	});
+
+	const float length = glm::length(normal);
+	return length > 0 ? normal / length : normal;
+}
+
+int HalfEdgeMesh::SplitEdge(int _edge, const glm::vec3& _position)
+{
+	// h goes from a to b and o back, c and d are the vertices opposite to the edge in the faces of h and o
+	const int h = 2 * _edge;
+	const int o = h + 1;
+	const int b = Target(h);
+	const int hNext = Next(h);
+	const int hPrev = Prev(h);
+	const int oNext = Next(o);
+	const int oPrev = Prev(o);
+	const int hFace = Face(h);
+	const int oFace = Face(o);
+
+	// h becomes a -> m and o becomes m -> a, the new edge g covers m -> b
+	const int m = AddVertex(_position);
+	const int g = AddEdge(m, b);
+	m_halfEdgeTarget[h] = m;
+
+	if (hFace != INVALID)
+	{
+		const int k = AddEdge(m, Target(hNext));
+		SetFace(hFace, h, k, hPrev);
+		SetFace(AddFace(), g, hNext, Twin(k));
+	}
+	else
+	{
+		Link(h, g);
+		Link(g, hNext);
+	}
+
+	if (oFace != INVALID)
+	{
+		const int l = AddEdge(m, Target(oNext));
+		SetFace(oFace, o, oNext, Twin(l));
+		SetFace(AddFace(), Twin(g), l, oPrev);
+	}
+	else
+	{
+		Link(oPrev, Twin(g));
+		Link(Twin(g), o);
+	}
+
+	m_vertexOutgoing[m] = oFace == INVALID ? o : g;
+	if (m_vertexOutgoing[b] == o)
+		m_vertexOutgoing[b] = Twin(g);
+
+	return m;
+}
+
+bool HalfEdgeMesh::IsCollapseOk(int _halfEdge) const
+{
+	if (IsDeletedEdge(_halfEdge / 2))
+		return false;
+
+	const int h = _halfEdge;
+	const int o = Twin(h);
+	const int removed = Target(o);
+	const int kept = Target(h);
+
+	// The other two edges of a face next to the edge may not both be boundary edges, the face would vanish completely
+	int left = INVALID;
+	int right = INVALID;
+	if (!IsBoundaryHalfEdge(h))
+	{
+		left = Target(Next(h));
+		if (IsBoundaryHalfEdge(Twin(Next(h))) && IsBoundaryHalfEdge(Twin(Prev(h))))
+			return false;
+	}
+	if (!IsBoundaryHalfEdge(o))
+	{
+		right = Target(Next(o));
+		if (IsBoundaryHalfEdge(Twin(Next(o))) && IsBoundaryHalfEdge(Twin(Prev(o))))
+			return false;
+	}
+	if (left == right)
+		return false;
+
+	// An interior edge between two boundary vertices would pinch the surface
+	if (IsBoundaryVertex(removed) && IsBoundaryVertex(kept) && !IsBoundaryHalfEdge(h) && !IsBoundaryHalfEdge(o))
+		return false;
+
+	// Link condition, the vertices opposite to the edge must be the only shared neighbours
+	bool linked = true;
+	ForEachOutgoing(removed, [&](int _removedHalfEdge)
+	{
+		const int neighbour = Target(_removedHalfEdge);
+		if (!linked || neighbour == left || neighbour == right)
+			return;
+		ForEachOutgoing(kept, [&](int _keptHalfEdge)
+		{
+			if (Target(_keptHalfEdge) == neighbour)
+				linked = false;
+		});
+	});
+	return linked;
+}
+
+void HalfEdgeMesh::Collapse(int _halfEdge)
+{
+	const int h = _halfEdge;
+	const int o = Twin(h);
+	const int hNext = Next(h);
+	const int hPrev = Prev(h);
+	const int oNext = Next(o);
+	const int oPrev = Prev(o);
+	const int hFace = Face(h);
+	const int oFace = Face(o);
+	const int kept = Target(h);
+	const int removed = Target(o);
+
+	ForEachOutgoing(removed, [&](int _outgoing) { m_halfEdgeTarget[Twin(_outgoing)] = kept; });
+
+	Link(hPrev, hNext);
+	Link(oPrev, oNext);
+	if (hFace != INVALID)
+		m_faceHalfEdge[hFace] = hNext;
+	if (oFace != INVALID)
+		m_faceHalfEdge[oFace] = oNext;
+
+	if (m_vertexOutgoing[kept] == o)
+		m_vertexOutgoing[kept] = hNext;
+	AdjustOutgoing(kept);
+
+	m_vertexOutgoing[removed] = INVALID;
+	m_edgeDeleted[h / 2] = 1;
+
+	// The faces next to the edge are left with two half-edges each
+	if (Next(Next(hNext)) == hNext)
+		CollapseLoop(Next(hNext));
+	if (Next(Next(oNext)) == oNext)
+		CollapseLoop(oNext);
+}
+
+bool HalfEdgeMesh::IsFlipOk(int _edge) const
+{
+	if (IsDeletedEdge(_edge) || IsBoundaryEdge(_edge))
+		return false;
+
+	const int c = Target(Next(2 * _edge));
+	const int d = Target(Next(2 * _edge + 1));
+	if (c == d)
+		return false;
+
+	bool exists = false;
+	ForEachOutgoing(c, [&](int _halfEdge) { exists |= Target(_halfEdge) == d; });
+	return !exists;
+}
+
+void HalfEdgeMesh::Flip(int _edge)
+{
+	const int a0 = 2 * _edge;
+	const int b0 = a0 + 1;
+	const int a1 = Next(a0);
+	const int a2 = Next(a1);
+	const int b1 = Next(b0);
+	const int b2 = Next(b1);
+	const int va0 = Target(a0);
+	const int vb0 = Target(b0);
+	const int aFace = Face(a0);
+	const int bFace = Face(b0);
+
+	m_halfEdgeTarget[a0] = Target(a1);
+	m_halfEdgeTarget[b0] = Target(b1);
+	SetFace(aFace, a0, a2, b1);
+	SetFace(bFace, b0, b2, a1);
+
+	if (m_vertexOutgoing[va0] == b0)
+		m_vertexOutgoing[va0] = a1;
+	if (m_vertexOutgoing[vb0] == a0)
+		m_vertexOutgoing[vb0] = b1;
+}
+
+int HalfEdgeMesh::AddVertex(const glm::vec3& _position)
+{
+	m_positions.push_back(_position);
+	m_vertexOutgoing.push_back(INVALID);
+	return static_cast<int>(m_positions.size()) - 1;
+}
+
+int HalfEdgeMesh::AddEdge(int _from, int _to)
+{
+	const int halfEdge = static_cast<int>(m_halfEdgeTarget.size());
+	m_halfEdgeTarget.push_back(_to);
+	m_halfEdgeTarget.push_back(_from);
+	m_halfEdgeNext.resize(m_halfEdgeTarget.size(), INVALID);
+	m_halfEdgePrev.resize(m_halfEdgeTarget.size(), INVALID);
+	m_halfEdgeFace.resize(m_halfEdgeTarget.size(), INVALID);
+	m_edgeDeleted.push_back(0);
+	return halfEdge;
+}
+
+int HalfEdgeMesh::AddFace()
+{
+	m_faceHalfEdge.push_back(INVALID);
+	return static_cast<int>(m_faceHalfEdge.size()) - 1;
+}
+
+void HalfEdgeMesh::SetFace(int _face, int _h0, int _h1, int _h2)
+{
+	Link(_h0, _h1);
+	Link(_h1, _h2);
+	Link(_h2, _h0);
+	m_halfEdgeFace[_h0] = _face;
+	m_halfEdgeFace[_h1] = _face;
+	m_halfEdgeFace[_h2] = _face;
+	m_faceHalfEdge[_face] = _h0;
+}
+
+void HalfEdgeMesh::Link(int _halfEdge, int _next)
+{
+	m_halfEdgeNext[_halfEdge] = _next;
+	m_halfEdgePrev[_next] = _halfEdge;
+}
+
+void HalfEdgeMesh::AdjustOutgoing(int _vertex)
+{
+	int boundary = INVALID;
+	ForEachOutgoing(_vertex, [&](int _halfEdge)
+	{
+		if (IsBoundaryHalfEdge(_halfEdge))
+			boundary = _halfEdge;
+	});
+	if (boundary != INVALID)
+		m_vertexOutgoing[_vertex] = boundary;
+}
+
+void HalfEdgeMesh::CollapseLoop(int _halfEdge)
+{
+	const int h0 = _halfEdge;
+	const int h1 = Next(h0);
+	const int o0 = Twin(h0);
+	const int o1 = Twin(h1);
+	const int v0 = Target(h0);
+	const int v1 = Target(h1);
+	const int hFace = Face(h0);
+	const int oFace = Face(o0);
+
+	// h1 takes the place of the twin of h0 in the face on the other side
+	Link(h1, Next(o0));
+	Link(Prev(o0), h1);
+	m_halfEdgeFace[h1] = oFace;
+
+	m_vertexOutgoing[v0] = h1;
+	AdjustOutgoing(v0);
+	m_vertexOutgoing[v1] = o1;
+	AdjustOutgoing(v1);
+
+	if (oFace != INVALID && m_faceHalfEdge[oFace] == o0)
+		m_faceHalfEdge[oFace] = h1;
+	if (hFace != INVALID)
+		m_faceHalfEdge[hFace] = INVALID;
+	m_edgeDeleted[h0 / 2] = 1;
+}
+
+void HalfEdgeMesh::LinkFans()
+{
+	const int vertexCount = GetVertexCount();
+	const int halfEdgeCount = static_cast<int>(m_halfEdgeTarget.size());
+
+	// Outgoing half-edges grouped by their source vertex
+	std::vector<int> offsets(vertexCount + 1, 0);
+	for (int h = 0; h < halfEdgeCount; h++)
+		offsets[Source(h) + 1]++;
+	for (int v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<int> outgoing(halfEdgeCount);
+	std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+	for (int h = 0; h < halfEdgeCount; h++)
+		outgoing[cursor[Source(h)]++] = h;
+
+	std::vector<uint8_t> visited(halfEdgeCount, 0);
+	std::vector<int> fan;
+	for (int v = 0; v < vertexCount; v++)
+	{
+		bool firstFan = true;
+
+		// Fans that end at the boundary start at their outgoing boundary half-edge, the closed fans are what remains
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int i = offsets[v]; i < offsets[v + 1]; i++)
+			{
+				const int start = outgoing[i];
+				if (visited[start] || (pass == 0 && !IsBoundaryHalfEdge(start)))
+					continue;
+
+				fan.clear();
+				int halfEdge = start;
+				if (pass == 0)
+				{
+					while (true)
+					{
+						visited[halfEdge] = 1;
+						fan.push_back(halfEdge);
+						if (IsBoundaryHalfEdge(Twin(halfEdge)))
+							break;
+						halfEdge = Next(Twin(halfEdge));
+					}
+					// The boundary half-edge that enters the vertex continues with the one that leaves it
+					Link(Twin(halfEdge), start);
+				}
+				else
+				{
+					do
+					{
+						visited[halfEdge] = 1;
+						fan.push_back(halfEdge);
+						halfEdge = Next(Twin(halfEdge));
+					} while (halfEdge != start);
+				}
+
+				// Every fan after the first one gets its own copy of the vertex
+				int fanVertex = v;
+				if (!firstFan)
+				{
+					const glm::vec3 position = m_positions[v];
+					fanVertex = AddVertex(position);
+					for (int fanHalfEdge : fan)
+						m_halfEdgeTarget[Twin(fanHalfEdge)] = fanVertex;
+				}
+				m_vertexOutgoing[fanVertex] = start;
+				firstFan = false;
+			}
+		}
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct Mesh;
+
+/**
+ * @brief Half-edge representation of a triangle mesh for local edits such as edge splits, collapses and flips.
+ *
+ * Half-edges are stored in pairs, so edge e consists of the half-edges 2e and 2e + 1 and the twin of half-edge h is h ^ 1.
+ * Boundaries are closed by boundary half-edges that have no face, so every half-edge has a twin, a next and a previous half-edge.
+ * The outgoing half-edge of a boundary vertex is always a boundary half-edge.
+ * Removed elements are only flagged as deleted and keep their index, ToMesh compacts the remaining ones.
+ * @remark The mesh owns all of its data, so separate meshes can be edited on separate threads.
+*/
+class HalfEdgeMesh
+{
+public:
+	/** Index of a missing vertex, half-edge or face */
+	static constexpr int INVALID = -1;
+
+	/**
+	 * @brief Builds the half-edge mesh of a triangle mesh. Vertices at exactly the same position are welded,
+	 *		  faces without area, duplicate faces and faces that would make an edge non-manifold are dropped,
+	 *		  and vertices where several separate fans of faces meet are split into one vertex per fan.
+	*/
+	explicit HalfEdgeMesh(const Mesh& _mesh);
+
+	/**
+	 * @brief Writes the vertices and faces that are not deleted to a mesh, with area weighted vertex normals.
+	*/
+	void ToMesh(Mesh& o_mesh) const;
+
+	/** Number of vertices, edges and faces, including deleted ones */
+	int GetVertexCount() const { return static_cast<int>(m_positions.size()); }
+	int GetEdgeCount() const { return static_cast<int>(m_halfEdgeTarget.size() / 2); }
+	int GetFaceCount() const { return static_cast<int>(m_faceHalfEdge.size()); }
+
+	bool IsDeletedVertex(int _vertex) const { return m_vertexOutgoing[_vertex] == INVALID; }
+	bool IsDeletedEdge(int _edge) const { return m_edgeDeleted[_edge] != 0; }
+	bool IsDeletedFace(int _face) const { return m_faceHalfEdge[_face] == INVALID; }
+
+	glm::vec3& Position(int _vertex) { return m_positions[_vertex]; }
+	const glm::vec3& Position(int _vertex) const { return m_positions[_vertex]; }
+
+	int Twin(int _halfEdge) const { return _halfEdge ^ 1; }
+	int Next(int _halfEdge) const { return m_halfEdgeNext[_halfEdge]; }
+	int Prev(int _halfEdge) const { return m_halfEdgePrev[_halfEdge]; }
+	int Target(int _halfEdge) const { return m_halfEdgeTarget[_halfEdge]; }
+	int Source(int _halfEdge) const { return m_halfEdgeTarget[_halfEdge ^ 1]; }
+	int Face(int _halfEdge) const { return m_halfEdgeFace[_halfEdge]; }
+	int Outgoing(int _vertex) const { return m_vertexOutgoing[_vertex]; }
+	int FaceHalfEdge(int _face) const { return m_faceHalfEdge[_face]; }
+
+	bool IsBoundaryHalfEdge(int _halfEdge) const { return m_halfEdgeFace[_halfEdge] == INVALID; }
+	bool IsBoundaryEdge(int _edge) const { return IsBoundaryHalfEdge(2 * _edge) || IsBoundaryHalfEdge(2 * _edge + 1); }
+	bool IsBoundaryVertex(int _vertex) const { return IsBoundaryHalfEdge(m_vertexOutgoing[_vertex]); }
+
+	/**
+	 * @brief Calls _callback(h) for every half-edge h that leaves the vertex, going around it.
+	*/
+	template <typename Callback>
+	void ForEachOutgoing(int _vertex, Callback _callback) const
+	{
+		const int first = m_vertexOutgoing[_vertex];
+		int halfEdge = first;
+		do
+		{
+			_callback(halfEdge);
+			halfEdge = Next(Twin(halfEdge));
+		} while (halfEdge != first);
+	}
+
+	/** Number of edges that meet in the vertex */
+	int Valence(int _vertex) const;
+
+	/** Normal of a face, its length is twice the area of the face */
+	glm::vec3 FaceAreaNormal(int _face) const;
+
+	/** Unit normal of a vertex, weighted by the areas of the faces around it */
+	glm::vec3 VertexNormal(int _vertex) const;
+
+	/**
+	 * @brief Splits an edge and the one or two faces next to it by inserting a vertex.
+	 *		  The half of the edge towards the target of half-edge 2 * _edge becomes the first newly added edge.
+	 * @return The new vertex.
+	*/
+	int SplitEdge(int _edge, const glm::vec3& _position);
+
+	/**
+	 * @brief Returns whether collapsing the half-edge keeps the mesh a manifold, which requires the one-rings of both vertices
+	 *		  to share only the vertices opposite to the edge.
+	*/
+	bool IsCollapseOk(int _halfEdge) const;
+
+	/**
+	 * @brief Removes the source vertex of the half-edge by merging it into the target vertex, which keeps its position.
+	 *		  The faces next to the edge are deleted, and of the two other edges of each of those faces only the one
+	 *		  that leaves the target vertex (on the face side of the half-edge) or enters it (on the twin side) remains.
+	*/
+	void Collapse(int _halfEdge);
+
+	/**
+	 * @brief Returns whether the edge can be flipped: it must have a face on both sides and the flipped edge must not exist yet.
+	*/
+	bool IsFlipOk(int _edge) const;
+
+	/**
+	 * @brief Replaces the edge by the other diagonal of the quad formed by its two faces.
+	*/
+	void Flip(int _edge);
+
+private:
+	int AddVertex(const glm::vec3& _position);
+	/** Adds the half-edge pair of a new edge, the first half-edge goes from _from to _to */
+	int AddEdge(int _from, int _to);
+	int AddFace();
+	/** Links three half-edges into a loop that forms the face */
+	void SetFace(int _face, int _h0, int _h1, int _h2);
+	void Link(int _halfEdge, int _next);
+	/** Makes a boundary half-edge the outgoing half-edge of a vertex if it has one */
+	void AdjustOutgoing(int _vertex);
+	/** Removes a face that a collapse reduced to two half-edges */
+	void CollapseLoop(int _halfEdge);
+	/** Splits vertices where several fans of faces meet and links the boundary half-edges */
+	void LinkFans();
+
+	std::vector<glm::vec3> m_positions;
+	std::vector<int> m_vertexOutgoing;
+
+	std::vector<int> m_halfEdgeTarget;
+	std::vector<int> m_halfEdgeNext;
+	std::vector<int> m_halfEdgePrev;
+	std::vector<int> m_halfEdgeFace;
+	std::vector<uint8_t> m_edgeDeleted;
+
+	std::vector<int> m_faceHalfEdge;
+};
@@ -0,0 +1,35 @@
+#include "HistogramDistance.h"
+
+#include "DistanceKernels.h"
+
+namespace
+{
+	kernels::HistogramDistanceKernel GetKernel(const kernels::DistanceKernels& _kernels, HistogramMetric _metric)
+	{
+		switch (_metric)
+		{
+		case HistogramMetric::CHI_SQUARE:
+			return _kernels.chiSquare;
+		case HistogramMetric::JENSEN_SHANNON:
+			return _kernels.jensenShannon;
+		case HistogramMetric::INTERSECTION:
+			return _kernels.intersection;
+		case HistogramMetric::EARTH_MOVERS:
+		default:
+			return _kernels.earthMovers;
+		}
+	}
+}
+
+float HistogramDistance(HistogramMetric _metric, const float* _a, const float* _b, int _binCount)
+{
+	// A single pair cannot fill the lanes of the vector kernels
+	float distance;
+	GetKernel(kernels::GetScalarDistanceKernels(), _metric)(_b, 0, 1, _binCount, _a, &distance);
+	return distance;
+}
+
+void HistogramDistances(HistogramMetric _metric, const float* _query, const float* _histograms, size_t _stride, size_t _count, int _binCount, float* o_distances)
+{
+	GetKernel(kernels::GetDistanceKernels(), _metric)(_histograms, _stride, _count, _binCount, _query, o_distances);
+}
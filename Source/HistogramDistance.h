@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Distances between histograms with unit mass on the same bins, like the shape distributions of Features3D.
+*/
+enum class HistogramMetric
+{
+	/** Earth mover's distance (1D Wasserstein) in units of bins, the L1 distance of the cumulative sums */
+	EARTH_MOVERS,
+	/** Symmetric chi-square distance, 1/2 sum (a - b)^2 / (a + b) */
+	CHI_SQUARE,
+	/** Jensen-Shannon divergence in nats, at most log 2 */
+	JENSEN_SHANNON,
+	/** One minus the histogram intersection, 1 - sum min(a, b) */
+	INTERSECTION
+};
+
+/**
+ * @brief Computes the distance between two histograms without allocating.
+ * @param _metric The distance to compute.
+ * @param _a The bins of the first histogram.
+ * @param _b The bins of the second histogram.
+ * @param _binCount The number of bins of both histograms.
+*/
+float HistogramDistance(HistogramMetric _metric, const float* _a, const float* _b, int _binCount);
+
+/**
+ * @brief Computes the distance from one histogram to many with the fastest kernels the CPU supports.
+ * @param _metric The distance to compute.
+ * @param _query The bins of the histogram to compute the distances from.
+ * @param _histograms The bins of the first histogram to compute the distance to.
+ * @param _stride The number of floats from the start of one histogram to the next, e.g. the stride of a FeatureMatrix
+ *				  to compare against the same histogram of every row.
+ * @param _count The number of histograms.
+ * @param _binCount The number of bins of every histogram.
+ * @param o_distances The distance to every histogram.
+*/
+void HistogramDistances(HistogramMetric _metric, const float* _query, const float* _histograms, size_t _stride, size_t _count, int _binCount, float* o_distances);
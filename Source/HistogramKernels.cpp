@@ -0,0 +1,614 @@
+#include "HistogramKernels.h"
+
+#include "CpuFeatures.h"
+#include "VertexSampler.h"
+
+#include <bitset>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Abramowitz & Stegun 4.4.45: acos(x) ~ sqrt(1 - x) * (c0 + c1 x + c2 x^2 + c3 x^3) for x in [0, 1]
+	constexpr float ACOS_C0 = 1.5707288f;
+	constexpr float ACOS_C1 = -0.2121144f;
+	constexpr float ACOS_C2 = 0.0742610f;
+	constexpr float ACOS_C3 = -0.0187293f;
+	constexpr float PI_F = 3.14159265f;
+	constexpr float ONE_THIRD = 1.0f / 3.0f;
+	constexpr float ONE_SIXTH_DIVISOR = 6.0f;
+	/** Added to a third of the float bits to get a first estimate of the cube root */
+	constexpr int32_t CBRT_MAGIC = 709921077;
+	constexpr int CBRT_NEWTON_STEPS = 3;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Scalar reference implementation, every vector path evaluates exactly these operations in this order
+	//////////////////////////////////////////////////////////////////////////
+
+	inline float ApproxAcos(float _x)
+	{
+		const float ax = std::fabs(_x);
+		float poly = ACOS_C3 * ax;
+		poly = (poly + ACOS_C2) * ax;
+		poly = (poly + ACOS_C1) * ax;
+		poly = poly + ACOS_C0;
+		const float r = std::sqrt(1.0f - ax) * poly;
+		return _x < 0.0f ? PI_F - r : r;
+	}
+
+	inline float ApproxCbrt(float _x)
+	{
+		int32_t bits;
+		std::memcpy(&bits, &_x, sizeof(bits));
+		bits = static_cast<int32_t>(static_cast<float>(bits) * ONE_THIRD) + CBRT_MAGIC;
+		float y;
+		std::memcpy(&y, &bits, sizeof(y));
+
+		for (int i = 0; i < CBRT_NEWTON_STEPS; i++)
+			y = ((y + y) + _x / (y * y)) * ONE_THIRD;
+		return y;
+	}
+
+	inline int ToBin(float _value, float _binSize, int _binCount)
+	{
+		// Written as comparisons so NaN and overflow behave like the vector min instructions
+		float q = _value / _binSize;
+		const float limit = static_cast<float>(_binCount);
+		q = q < limit ? q : limit;
+		const int bin = static_cast<int>(q);
+		return bin < _binCount - 1 ? bin : _binCount - 1;
+	}
+
+	int BinA3Scalar(const SampleBlock& _block, int _begin, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		int valid = 0;
+		for (int i = _begin; i < _count; i++)
+		{
+			const float ux = _block.x[0][i] - _block.x[1][i];
+			const float uy = _block.y[0][i] - _block.y[1][i];
+			const float uz = _block.z[0][i] - _block.z[1][i];
+			const float vx = _block.x[2][i] - _block.x[1][i];
+			const float vy = _block.y[2][i] - _block.y[1][i];
+			const float vz = _block.z[2][i] - _block.z[1][i];
+
+			const float lu = std::sqrt(ux * ux + uy * uy + uz * uz);
+			const float lv = std::sqrt(vx * vx + vy * vy + vz * vz);
+			const float length = lu * lv;
+			const float dt = ux * vx + uy * vy + uz * vz;
+
+			// Coinciding vertices have no angle
+			if (!(length > 0.0f))
+				continue;
+
+			float c = dt / length;
+			c = c < 1.0f ? c : 1.0f;
+			c = c > -1.0f ? c : -1.0f;
+
+			o_bins[ToBin(ApproxAcos(c), _binSize, _binCount)]++;
+			valid++;
+		}
+		return valid;
+	}
+
+	int BinD1Scalar(const SampleBlock& _block, int _begin, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		for (int i = _begin; i < _count; i++)
+		{
+			const float x = _block.x[0][i];
+			const float y = _block.y[0][i];
+			const float z = _block.z[0][i];
+			o_bins[ToBin(std::sqrt(x * x + y * y + z * z), _binSize, _binCount)]++;
+		}
+		return _count - _begin;
+	}
+
+	int BinD2Scalar(const SampleBlock& _block, int _begin, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		for (int i = _begin; i < _count; i++)
+		{
+			const float x = _block.x[0][i] - _block.x[1][i];
+			const float y = _block.y[0][i] - _block.y[1][i];
+			const float z = _block.z[0][i] - _block.z[1][i];
+			o_bins[ToBin(std::sqrt(x * x + y * y + z * z), _binSize, _binCount)]++;
+		}
+		return _count - _begin;
+	}
+
+	int BinD3Scalar(const SampleBlock& _block, int _begin, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		for (int i = _begin; i < _count; i++)
+		{
+			const float ax = _block.x[1][i] - _block.x[0][i];
+			const float ay = _block.y[1][i] - _block.y[0][i];
+			const float az = _block.z[1][i] - _block.z[0][i];
+			const float bx = _block.x[2][i] - _block.x[0][i];
+			const float by = _block.y[2][i] - _block.y[0][i];
+			const float bz = _block.z[2][i] - _block.z[0][i];
+
+			const float cx = ay * bz - az * by;
+			const float cy = az * bx - ax * bz;
+			const float cz = ax * by - ay * bx;
+
+			const float area = 0.5f * std::sqrt(cx * cx + cy * cy + cz * cz);
+			o_bins[ToBin(std::sqrt(area), _binSize, _binCount)]++;
+		}
+		return _count - _begin;
+	}
+
+	int BinD4Scalar(const SampleBlock& _block, int _begin, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		for (int i = _begin; i < _count; i++)
+		{
+			const float ax = _block.x[0][i] - _block.x[3][i];
+			const float ay = _block.y[0][i] - _block.y[3][i];
+			const float az = _block.z[0][i] - _block.z[3][i];
+			const float bx = _block.x[1][i] - _block.x[3][i];
+			const float by = _block.y[1][i] - _block.y[3][i];
+			const float bz = _block.z[1][i] - _block.z[3][i];
+			const float cx = _block.x[2][i] - _block.x[3][i];
+			const float cy = _block.y[2][i] - _block.y[3][i];
+			const float cz = _block.z[2][i] - _block.z[3][i];
+
+			const float nx = by * cz - bz * cy;
+			const float ny = bz * cx - bx * cz;
+			const float nz = bx * cy - by * cx;
+
+			const float volume = std::fabs(ax * nx + ay * ny + az * nz) / ONE_SIXTH_DIVISOR;
+			o_bins[ToBin(ApproxCbrt(volume), _binSize, _binCount)]++;
+		}
+		return _count - _begin;
+	}
+
+	int BinA3ScalarKernel(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins) { return BinA3Scalar(_block, 0, _count, _binSize, _binCount, o_bins); }
+	int BinD1ScalarKernel(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins) { return BinD1Scalar(_block, 0, _count, _binSize, _binCount, o_bins); }
+	int BinD2ScalarKernel(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins) { return BinD2Scalar(_block, 0, _count, _binSize, _binCount, o_bins); }
+	int BinD3ScalarKernel(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins) { return BinD3Scalar(_block, 0, _count, _binSize, _binCount, o_bins); }
+	int BinD4ScalarKernel(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins) { return BinD4Scalar(_block, 0, _count, _binSize, _binCount, o_bins); }
+
+	const kernels::ShapeKernels SCALAR_KERNELS = { "scalar", 1, BinA3ScalarKernel, BinD1ScalarKernel, BinD2ScalarKernel, BinD3ScalarKernel, BinD4ScalarKernel };
+
+	/**
+	 * @brief Histograms with one row per lane, so lanes never write to the same counter.
+	 *		  The extra bin of every row collects the lanes that did not produce a valid value.
+	*/
+	template<int LANES>
+	struct LaneHistograms
+	{
+		uint32_t counts[LANES][kernels::MAX_KERNEL_BINS + 1];
+
+		LaneHistograms(int _binCount)
+		{
+			for (int lane = 0; lane < LANES; lane++)
+				std::memset(counts[lane], 0, sizeof(uint32_t) * (_binCount + 1));
+		}
+
+		void Add(const int32_t* _bins)
+		{
+			for (int lane = 0; lane < LANES; lane++)
+				counts[lane][_bins[lane]]++;
+		}
+
+		void Reduce(int _binCount, uint32_t* o_bins) const
+		{
+			for (int lane = 0; lane < LANES; lane++)
+				for (int bin = 0; bin < _binCount; bin++)
+					o_bins[bin] += counts[lane][bin];
+		}
+	};
+
+#if KERNELS_X86
+	//////////////////////////////////////////////////////////////////////////
+	// AVX2, 8 tuples per instruction
+	//////////////////////////////////////////////////////////////////////////
+
+	KERNEL_TARGET_AVX2 inline __m256 Load8(const float* _data, int _index) { return _mm256_load_ps(_data + _index); }
+
+	KERNEL_TARGET_AVX2 inline __m256 Length8(__m256 _x, __m256 _y, __m256 _z)
+	{
+		return _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_x, _x), _mm256_mul_ps(_y, _y)), _mm256_mul_ps(_z, _z)));
+	}
+
+	KERNEL_TARGET_AVX2 inline __m256 Abs8(__m256 _x)
+	{
+		return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _x);
+	}
+
+	KERNEL_TARGET_AVX2 inline __m256 Acos8(__m256 _x)
+	{
+		const __m256 ax = Abs8(_x);
+		__m256 poly = _mm256_mul_ps(_mm256_set1_ps(ACOS_C3), ax);
+		poly = _mm256_mul_ps(_mm256_add_ps(poly, _mm256_set1_ps(ACOS_C2)), ax);
+		poly = _mm256_mul_ps(_mm256_add_ps(poly, _mm256_set1_ps(ACOS_C1)), ax);
+		poly = _mm256_add_ps(poly, _mm256_set1_ps(ACOS_C0));
+		const __m256 r = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), ax)), poly);
+		const __m256 negative = _mm256_cmp_ps(_x, _mm256_setzero_ps(), _CMP_LT_OQ);
+		return _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(PI_F), r), negative);
+	}
+
+	KERNEL_TARGET_AVX2 inline __m256 Cbrt8(__m256 _x)
+	{
+		const __m256 third = _mm256_set1_ps(ONE_THIRD);
+		__m256i bits = _mm256_castps_si256(_x);
+		bits = _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(bits), third)), _mm256_set1_epi32(CBRT_MAGIC));
+		__m256 y = _mm256_castsi256_ps(bits);
+
+		for (int i = 0; i < CBRT_NEWTON_STEPS; i++)
+			y = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(y, y), _mm256_div_ps(_x, _mm256_mul_ps(y, y))), third);
+		return y;
+	}
+
+	KERNEL_TARGET_AVX2 inline __m256i ToBin8(__m256 _value, __m256 _binSize, int _binCount)
+	{
+		__m256 q = _mm256_div_ps(_value, _binSize);
+		q = _mm256_min_ps(q, _mm256_set1_ps(static_cast<float>(_binCount)));
+		return _mm256_min_epi32(_mm256_cvttps_epi32(q), _mm256_set1_epi32(_binCount - 1));
+	}
+
+	KERNEL_TARGET_AVX2 inline void AddBins8(LaneHistograms<8>& _histograms, __m256i _bins)
+	{
+		alignas(32) int32_t bins[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(bins), _bins);
+		_histograms.Add(bins);
+	}
+
+	KERNEL_TARGET_AVX2 int BinA3Avx2(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<8> histograms(_binCount);
+		const __m256 binSize = _mm256_set1_ps(_binSize);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 minusOne = _mm256_set1_ps(-1.0f);
+		const __m256i invalidBin = _mm256_set1_epi32(_binCount);
+
+		int valid = 0;
+		const int vectorCount = _count & ~7;
+		for (int i = 0; i < vectorCount; i += 8)
+		{
+			const __m256 x1 = Load8(_block.x[1], i), y1 = Load8(_block.y[1], i), z1 = Load8(_block.z[1], i);
+			const __m256 ux = _mm256_sub_ps(Load8(_block.x[0], i), x1);
+			const __m256 uy = _mm256_sub_ps(Load8(_block.y[0], i), y1);
+			const __m256 uz = _mm256_sub_ps(Load8(_block.z[0], i), z1);
+			const __m256 vx = _mm256_sub_ps(Load8(_block.x[2], i), x1);
+			const __m256 vy = _mm256_sub_ps(Load8(_block.y[2], i), y1);
+			const __m256 vz = _mm256_sub_ps(Load8(_block.z[2], i), z1);
+
+			const __m256 length = _mm256_mul_ps(Length8(ux, uy, uz), Length8(vx, vy, vz));
+			const __m256 dt = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ux, vx), _mm256_mul_ps(uy, vy)), _mm256_mul_ps(uz, vz));
+			const __m256 validMask = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+			__m256 c = _mm256_div_ps(dt, length);
+			c = _mm256_max_ps(_mm256_min_ps(c, one), minusOne);
+
+			const __m256i bins = ToBin8(Acos8(c), binSize, _binCount);
+			AddBins8(histograms, _mm256_blendv_epi8(invalidBin, bins, _mm256_castps_si256(validMask)));
+			valid += static_cast<int>(std::bitset<8>(_mm256_movemask_ps(validMask)).count());
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return valid + BinA3Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX2 int BinD1Avx2(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<8> histograms(_binCount);
+		const __m256 binSize = _mm256_set1_ps(_binSize);
+
+		const int vectorCount = _count & ~7;
+		for (int i = 0; i < vectorCount; i += 8)
+			AddBins8(histograms, ToBin8(Length8(Load8(_block.x[0], i), Load8(_block.y[0], i), Load8(_block.z[0], i)), binSize, _binCount));
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD1Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX2 int BinD2Avx2(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<8> histograms(_binCount);
+		const __m256 binSize = _mm256_set1_ps(_binSize);
+
+		const int vectorCount = _count & ~7;
+		for (int i = 0; i < vectorCount; i += 8)
+		{
+			const __m256 x = _mm256_sub_ps(Load8(_block.x[0], i), Load8(_block.x[1], i));
+			const __m256 y = _mm256_sub_ps(Load8(_block.y[0], i), Load8(_block.y[1], i));
+			const __m256 z = _mm256_sub_ps(Load8(_block.z[0], i), Load8(_block.z[1], i));
+			AddBins8(histograms, ToBin8(Length8(x, y, z), binSize, _binCount));
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD2Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX2 int BinD3Avx2(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<8> histograms(_binCount);
+		const __m256 binSize = _mm256_set1_ps(_binSize);
+		const __m256 half = _mm256_set1_ps(0.5f);
+
+		const int vectorCount = _count & ~7;
+		for (int i = 0; i < vectorCount; i += 8)
+		{
+			const __m256 x0 = Load8(_block.x[0], i), y0 = Load8(_block.y[0], i), z0 = Load8(_block.z[0], i);
+			const __m256 ax = _mm256_sub_ps(Load8(_block.x[1], i), x0);
+			const __m256 ay = _mm256_sub_ps(Load8(_block.y[1], i), y0);
+			const __m256 az = _mm256_sub_ps(Load8(_block.z[1], i), z0);
+			const __m256 bx = _mm256_sub_ps(Load8(_block.x[2], i), x0);
+			const __m256 by = _mm256_sub_ps(Load8(_block.y[2], i), y0);
+			const __m256 bz = _mm256_sub_ps(Load8(_block.z[2], i), z0);
+
+			const __m256 cx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+			const __m256 cy = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+			const __m256 cz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+
+			const __m256 area = _mm256_mul_ps(half, Length8(cx, cy, cz));
+			AddBins8(histograms, ToBin8(_mm256_sqrt_ps(area), binSize, _binCount));
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD3Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX2 int BinD4Avx2(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<8> histograms(_binCount);
+		const __m256 binSize = _mm256_set1_ps(_binSize);
+		const __m256 divisor = _mm256_set1_ps(ONE_SIXTH_DIVISOR);
+
+		const int vectorCount = _count & ~7;
+		for (int i = 0; i < vectorCount; i += 8)
+		{
+			const __m256 x3 = Load8(_block.x[3], i), y3 = Load8(_block.y[3], i), z3 = Load8(_block.z[3], i);
+			const __m256 ax = _mm256_sub_ps(Load8(_block.x[0], i), x3);
+			const __m256 ay = _mm256_sub_ps(Load8(_block.y[0], i), y3);
+			const __m256 az = _mm256_sub_ps(Load8(_block.z[0], i), z3);
+			const __m256 bx = _mm256_sub_ps(Load8(_block.x[1], i), x3);
+			const __m256 by = _mm256_sub_ps(Load8(_block.y[1], i), y3);
+			const __m256 bz = _mm256_sub_ps(Load8(_block.z[1], i), z3);
+			const __m256 cx = _mm256_sub_ps(Load8(_block.x[2], i), x3);
+			const __m256 cy = _mm256_sub_ps(Load8(_block.y[2], i), y3);
+			const __m256 cz = _mm256_sub_ps(Load8(_block.z[2], i), z3);
+
+			const __m256 nx = _mm256_sub_ps(_mm256_mul_ps(by, cz), _mm256_mul_ps(bz, cy));
+			const __m256 ny = _mm256_sub_ps(_mm256_mul_ps(bz, cx), _mm256_mul_ps(bx, cz));
+			const __m256 nz = _mm256_sub_ps(_mm256_mul_ps(bx, cy), _mm256_mul_ps(by, cx));
+
+			const __m256 dt = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, nx), _mm256_mul_ps(ay, ny)), _mm256_mul_ps(az, nz));
+			const __m256 volume = _mm256_div_ps(Abs8(dt), divisor);
+			AddBins8(histograms, ToBin8(Cbrt8(volume), binSize, _binCount));
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD4Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	const kernels::ShapeKernels AVX2_KERNELS = { "avx2", 8, BinA3Avx2, BinD1Avx2, BinD2Avx2, BinD3Avx2, BinD4Avx2 };
+
+	//////////////////////////////////////////////////////////////////////////
+	// AVX-512, 16 tuples per instruction
+	//////////////////////////////////////////////////////////////////////////
+
+	KERNEL_TARGET_AVX512 inline __m512 Load16(const float* _data, int _index) { return _mm512_load_ps(_data + _index); }
+
+	KERNEL_TARGET_AVX512 inline __m512 Length16(__m512 _x, __m512 _y, __m512 _z)
+	{
+		return _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_x, _x), _mm512_mul_ps(_y, _y)), _mm512_mul_ps(_z, _z)));
+	}
+
+	KERNEL_TARGET_AVX512 inline __m512 Abs16(__m512 _x)
+	{
+		// AVX512F has no float and/andnot, clear the sign bit on the integer view instead
+		return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(_x), _mm512_set1_epi32(0x7FFFFFFF)));
+	}
+
+	KERNEL_TARGET_AVX512 inline __m512 Acos16(__m512 _x)
+	{
+		const __m512 ax = Abs16(_x);
+		__m512 poly = _mm512_mul_ps(_mm512_set1_ps(ACOS_C3), ax);
+		poly = _mm512_mul_ps(_mm512_add_ps(poly, _mm512_set1_ps(ACOS_C2)), ax);
+		poly = _mm512_mul_ps(_mm512_add_ps(poly, _mm512_set1_ps(ACOS_C1)), ax);
+		poly = _mm512_add_ps(poly, _mm512_set1_ps(ACOS_C0));
+		const __m512 r = _mm512_mul_ps(_mm512_sqrt_ps(_mm512_sub_ps(_mm512_set1_ps(1.0f), ax)), poly);
+		const __mmask16 negative = _mm512_cmp_ps_mask(_x, _mm512_setzero_ps(), _CMP_LT_OQ);
+		return _mm512_mask_blend_ps(negative, r, _mm512_sub_ps(_mm512_set1_ps(PI_F), r));
+	}
+
+	KERNEL_TARGET_AVX512 inline __m512 Cbrt16(__m512 _x)
+	{
+		const __m512 third = _mm512_set1_ps(ONE_THIRD);
+		__m512i bits = _mm512_castps_si512(_x);
+		bits = _mm512_add_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(bits), third)), _mm512_set1_epi32(CBRT_MAGIC));
+		__m512 y = _mm512_castsi512_ps(bits);
+
+		for (int i = 0; i < CBRT_NEWTON_STEPS; i++)
+			y = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(y, y), _mm512_div_ps(_x, _mm512_mul_ps(y, y))), third);
+		return y;
+	}
+
+	KERNEL_TARGET_AVX512 inline __m512i ToBin16(__m512 _value, __m512 _binSize, int _binCount)
+	{
+		__m512 q = _mm512_div_ps(_value, _binSize);
+		q = _mm512_min_ps(q, _mm512_set1_ps(static_cast<float>(_binCount)));
+		return _mm512_min_epi32(_mm512_cvttps_epi32(q), _mm512_set1_epi32(_binCount - 1));
+	}
+
+	KERNEL_TARGET_AVX512 inline void AddBins16(LaneHistograms<16>& _histograms, __m512i _bins)
+	{
+		alignas(64) int32_t bins[16];
+		_mm512_store_si512(bins, _bins);
+		_histograms.Add(bins);
+	}
+
+	KERNEL_TARGET_AVX512 int BinA3Avx512(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<16> histograms(_binCount);
+		const __m512 binSize = _mm512_set1_ps(_binSize);
+		const __m512 one = _mm512_set1_ps(1.0f);
+		const __m512 minusOne = _mm512_set1_ps(-1.0f);
+		const __m512i invalidBin = _mm512_set1_epi32(_binCount);
+
+		int valid = 0;
+		const int vectorCount = _count & ~15;
+		for (int i = 0; i < vectorCount; i += 16)
+		{
+			const __m512 x1 = Load16(_block.x[1], i), y1 = Load16(_block.y[1], i), z1 = Load16(_block.z[1], i);
+			const __m512 ux = _mm512_sub_ps(Load16(_block.x[0], i), x1);
+			const __m512 uy = _mm512_sub_ps(Load16(_block.y[0], i), y1);
+			const __m512 uz = _mm512_sub_ps(Load16(_block.z[0], i), z1);
+			const __m512 vx = _mm512_sub_ps(Load16(_block.x[2], i), x1);
+			const __m512 vy = _mm512_sub_ps(Load16(_block.y[2], i), y1);
+			const __m512 vz = _mm512_sub_ps(Load16(_block.z[2], i), z1);
+
+			const __m512 length = _mm512_mul_ps(Length16(ux, uy, uz), Length16(vx, vy, vz));
+			const __m512 dt = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ux, vx), _mm512_mul_ps(uy, vy)), _mm512_mul_ps(uz, vz));
+			const __mmask16 validMask = _mm512_cmp_ps_mask(length, _mm512_setzero_ps(), _CMP_GT_OQ);
+
+			__m512 c = _mm512_div_ps(dt, length);
+			c = _mm512_max_ps(_mm512_min_ps(c, one), minusOne);
+
+			const __m512i bins = ToBin16(Acos16(c), binSize, _binCount);
+			AddBins16(histograms, _mm512_mask_blend_epi32(validMask, invalidBin, bins));
+			valid += static_cast<int>(std::bitset<16>(validMask).count());
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return valid + BinA3Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX512 int BinD1Avx512(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<16> histograms(_binCount);
+		const __m512 binSize = _mm512_set1_ps(_binSize);
+
+		const int vectorCount = _count & ~15;
+		for (int i = 0; i < vectorCount; i += 16)
+			AddBins16(histograms, ToBin16(Length16(Load16(_block.x[0], i), Load16(_block.y[0], i), Load16(_block.z[0], i)), binSize, _binCount));
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD1Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX512 int BinD2Avx512(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<16> histograms(_binCount);
+		const __m512 binSize = _mm512_set1_ps(_binSize);
+
+		const int vectorCount = _count & ~15;
+		for (int i = 0; i < vectorCount; i += 16)
+		{
+			const __m512 x = _mm512_sub_ps(Load16(_block.x[0], i), Load16(_block.x[1], i));
+			const __m512 y = _mm512_sub_ps(Load16(_block.y[0], i), Load16(_block.y[1], i));
+			const __m512 z = _mm512_sub_ps(Load16(_block.z[0], i), Load16(_block.z[1], i));
+			AddBins16(histograms, ToBin16(Length16(x, y, z), binSize, _binCount));
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD2Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX512 int BinD3Avx512(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<16> histograms(_binCount);
+		const __m512 binSize = _mm512_set1_ps(_binSize);
+		const __m512 half = _mm512_set1_ps(0.5f);
+
+		const int vectorCount = _count & ~15;
+		for (int i = 0; i < vectorCount; i += 16)
+		{
+			const __m512 x0 = Load16(_block.x[0], i), y0 = Load16(_block.y[0], i), z0 = Load16(_block.z[0], i);
+			const __m512 ax = _mm512_sub_ps(Load16(_block.x[1], i), x0);
+			const __m512 ay = _mm512_sub_ps(Load16(_block.y[1], i), y0);
+			const __m512 az = _mm512_sub_ps(Load16(_block.z[1], i), z0);
+			const __m512 bx = _mm512_sub_ps(Load16(_block.x[2], i), x0);
+			const __m512 by = _mm512_sub_ps(Load16(_block.y[2], i), y0);
+			const __m512 bz = _mm512_sub_ps(Load16(_block.z[2], i), z0);
+
+			const __m512 cx = _mm512_sub_ps(_mm512_mul_ps(ay, bz), _mm512_mul_ps(az, by));
+			const __m512 cy = _mm512_sub_ps(_mm512_mul_ps(az, bx), _mm512_mul_ps(ax, bz));
+			const __m512 cz = _mm512_sub_ps(_mm512_mul_ps(ax, by), _mm512_mul_ps(ay, bx));
+
+			const __m512 area = _mm512_mul_ps(half, Length16(cx, cy, cz));
+			AddBins16(histograms, ToBin16(_mm512_sqrt_ps(area), binSize, _binCount));
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD3Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	KERNEL_TARGET_AVX512 int BinD4Avx512(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins)
+	{
+		LaneHistograms<16> histograms(_binCount);
+		const __m512 binSize = _mm512_set1_ps(_binSize);
+		const __m512 divisor = _mm512_set1_ps(ONE_SIXTH_DIVISOR);
+
+		const int vectorCount = _count & ~15;
+		for (int i = 0; i < vectorCount; i += 16)
+		{
+			const __m512 x3 = Load16(_block.x[3], i), y3 = Load16(_block.y[3], i), z3 = Load16(_block.z[3], i);
+			const __m512 ax = _mm512_sub_ps(Load16(_block.x[0], i), x3);
+			const __m512 ay = _mm512_sub_ps(Load16(_block.y[0], i), y3);
+			const __m512 az = _mm512_sub_ps(Load16(_block.z[0], i), z3);
+			const __m512 bx = _mm512_sub_ps(Load16(_block.x[1], i), x3);
+			const __m512 by = _mm512_sub_ps(Load16(_block.y[1], i), y3);
+			const __m512 bz = _mm512_sub_ps(Load16(_block.z[1], i), z3);
+			const __m512 cx = _mm512_sub_ps(Load16(_block.x[2], i), x3);
+			const __m512 cy = _mm512_sub_ps(Load16(_block.y[2], i), y3);
+			const __m512 cz = _mm512_sub_ps(Load16(_block.z[2], i), z3);
+
+			const __m512 nx = _mm512_sub_ps(_mm512_mul_ps(by, cz), _mm512_mul_ps(bz, cy));
+			const __m512 ny = _mm512_sub_ps(_mm512_mul_ps(bz, cx), _mm512_mul_ps(bx, cz));
+			const __m512 nz = _mm512_sub_ps(_mm512_mul_ps(bx, cy), _mm512_mul_ps(by, cx));
+
+			const __m512 dt = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ax, nx), _mm512_mul_ps(ay, ny)), _mm512_mul_ps(az, nz));
+			const __m512 volume = _mm512_div_ps(Abs16(dt), divisor);
+			AddBins16(histograms, ToBin16(Cbrt16(volume), binSize, _binCount));
+		}
+		histograms.Reduce(_binCount, o_bins);
+
+		return vectorCount + BinD4Scalar(_block, vectorCount, _count, _binSize, _binCount, o_bins);
+	}
+
+	const kernels::ShapeKernels AVX512_KERNELS = { "avx512", 16, BinA3Avx512, BinD1Avx512, BinD2Avx512, BinD3Avx512, BinD4Avx512 };
+
+	/**
+	 * The distance kernels do little arithmetic per sample, so the 16-lane histogram scatter outweighs the wider vectors and their
+	 * AVX2 versions are faster. A3 and D4 spend their time in acos and cbrt and gain from AVX-512.
+	*/
+	const kernels::ShapeKernels AVX512_MIXED_KERNELS = { "avx512+avx2", 16, BinA3Avx512, BinD1Avx2, BinD2Avx2, BinD3Avx2, BinD4Avx512 };
+#endif
+}
+
+namespace kernels
+{
+	const ShapeKernels& GetShapeKernels()
+	{
+#if KERNELS_X86
+		const CpuFeatures& features = GetCpuFeatures();
+		if (features.avx512)
+			return AVX512_MIXED_KERNELS;
+		if (features.avx2)
+			return AVX2_KERNELS;
+#endif
+		return SCALAR_KERNELS;
+	}
+
+	const ShapeKernels& GetScalarShapeKernels()
+	{
+		return SCALAR_KERNELS;
+	}
+
+	std::vector<const ShapeKernels*> GetSupportedShapeKernels()
+	{
+		std::vector<const ShapeKernels*> supported = { &SCALAR_KERNELS };
+#if KERNELS_X86
+		const CpuFeatures& features = GetCpuFeatures();
+		if (features.avx2)
+			supported.push_back(&AVX2_KERNELS);
+		if (features.avx512)
+		{
+			supported.push_back(&AVX512_KERNELS);
+			supported.push_back(&AVX512_MIXED_KERNELS);
+		}
+#endif
+		return supported;
+	}
+}
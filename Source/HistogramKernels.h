@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct SampleBlock;
+
+namespace kernels
+{
+	/** Largest number of histogram bins the kernels support */
+	constexpr int MAX_KERNEL_BINS = 64;
+
+	/**
+	 * @brief Computes one shape distribution value for each of the first _count tuples of a block and adds it to its histogram bin.
+	 * @param _block The block of random vertex tuples.
+	 * @param _count The number of tuples of the block to process.
+	 * @param _binSize The width of a single bin, values past the last bin are clamped into it.
+	 * @param _binCount The number of bins, at most MAX_KERNEL_BINS.
+	 * @param o_bins The histogram the values are counted in.
+	 * @return The number of tuples that produced a valid value, degenerate A3 angles are skipped.
+	*/
+	using BinKernel = int(*)(const SampleBlock& _block, int _count, float _binSize, int _binCount, uint32_t* o_bins);
+
+	/**
+	 * @brief Set of binning kernels for one instruction set.
+	 *
+	 * All implementations evaluate the same approximations with the same operation order, without fused multiply-adds,
+	 * so they produce bit-identical histograms. Compared to the standard library functions:
+	 *  - acos uses Abramowitz & Stegun 4.4.45, the absolute error is below 6.8e-5 radians.
+	 *  - cbrt uses a bit-level estimate refined by three Newton steps, the relative error is below 1e-6.
+	 *  - sqrt and division are correctly rounded IEEE operations.
+	*/
+	struct ShapeKernels
+	{
+		const char* name;
+		/** Largest number of tuples processed per instruction by one of the kernels */
+		int laneCount;
+		BinKernel a3;
+		BinKernel d1;
+		BinKernel d2;
+		BinKernel d3;
+		BinKernel d4;
+	};
+
+	/**
+	 * @brief Returns the fastest kernels supported by the CPU. The CPU features are detected on the first call.
+	*/
+	const ShapeKernels& GetShapeKernels();
+
+	/**
+	 * @brief Returns the portable scalar kernels that every other implementation has to match.
+	*/
+	const ShapeKernels& GetScalarShapeKernels();
+
+	/**
+	 * @brief Returns all kernels the CPU can run, starting with the scalar ones.
+	*/
+	std::vector<const ShapeKernels*> GetSupportedShapeKernels();
+}
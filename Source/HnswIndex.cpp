@@ -0,0 +1,442 @@
+#include "HnswIndex.h"
+
+#include "BinaryStream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <queue>
+
+namespace
+{
+	constexpr uint64_t LEVEL_SEED = 0x4E5357;
+	constexpr char HNSW_MAGIC[4] = { 'H', 'N', 'S', 'W' };
+	constexpr uint32_t HNSW_VERSION = 2;
+	/** Largest M a stored graph can have, larger values in a file are taken as corrupt */
+	constexpr uint64_t MAX_STORED_LINKS = 1 << 16;
+
+	/**
+	 * @brief Whether a vector read from a file holds _count records of _width values, without overflowing for corrupt sizes.
+	*/
+	bool HasRecords(size_t _size, size_t _count, size_t _width)
+	{
+		return _width == 0 ? _size == 0 : _size % _width == 0 && _size / _width == _count;
+	}
+
+	/**
+	 * @brief Marks the nodes a search has visited. Every search starts a new epoch instead of clearing the marks,
+	 *		  and every thread has its own marks so concurrent searches do not interfere.
+	*/
+	class VisitedNodes
+	{
+	public:
+		void Reset(size_t _nodeCount)
+		{
+			if (m_epochs.size() < _nodeCount)
+				m_epochs.resize(_nodeCount, 0);
+			if (++m_epoch == 0)
+			{
+				std::fill(m_epochs.begin(), m_epochs.end(), 0);
+				m_epoch = 1;
+			}
+		}
+
+		/** Marks a node and returns whether it had been visited before */
+		bool Visit(int _node)
+		{
+			const bool visited = m_epochs[_node] == m_epoch;
+			m_epochs[_node] = m_epoch;
+			return visited;
+		}
+
+	private:
+		std::vector<uint32_t> m_epochs;
+		uint32_t m_epoch = 0;
+	};
+
+	thread_local VisitedNodes t_visitedNodes;
+}
+
+HnswIndex::HnswIndex(int _M, int _efConstruction, int _ef) :
+	m_dimension(0),
+	m_maxLinks(std::max(_M, 2)),
+	m_maxBaseLinks(2 * m_maxLinks),
+	m_efConstruction(std::max(_efConstruction, 1)),
+	m_ef(std::max(_ef, 1)),
+	m_levelMultiplier(1.0 / std::log(static_cast<double>(m_maxLinks))),
+	m_generator(LEVEL_SEED),
+	m_removedCount(0),
+	m_entryPoint(-1),
+	m_maxLevel(-1)
+{ }
+
+void HnswIndex::Clear(size_t _dimension)
+{
+	m_dimension = _dimension;
+	m_generator = RandomGenerator(LEVEL_SEED);
+	m_rows.clear();
+	m_levels.clear();
+	m_baseLinks.clear();
+	m_upperLinks.clear();
+	m_removed.clear();
+	m_removedCount = 0;
+	m_entryPoint = -1;
+	m_maxLevel = -1;
+}
+
+void HnswIndex::Build(const FeatureMatrix& _rows)
+{
+	Clear(_rows.GetColumnCount());
+	m_rows.reserve(_rows.GetRowCount() * m_dimension);
+	m_levels.reserve(_rows.GetRowCount());
+	m_baseLinks.reserve(_rows.GetRowCount() * (m_maxBaseLinks + 1));
+	m_upperLinks.reserve(_rows.GetRowCount());
+	for (size_t i = 0; i < _rows.GetRowCount(); i++)
+		Insert(_rows.GetRow(i));
+}
+
+void HnswIndex::Insert(const float* _row)
+{
+	const int node = static_cast<int>(m_levels.size());
+	// The row is copied first since _row may point into the rows that are about to grow
+	const std::vector<float> row(_row, _row + m_dimension);
+
+	// Uniform in (0, 1], so the logarithm is finite
+	const double uniform = 1.0 - static_cast<double>(m_generator.Next() >> 11) / static_cast<double>(1ull << 53);
+	const int level = static_cast<int>(-std::log(uniform) * m_levelMultiplier);
+
+	m_rows.insert(m_rows.end(), row.begin(), row.end());
+	m_levels.push_back(level);
+	m_baseLinks.resize(m_baseLinks.size() + m_maxBaseLinks + 1, 0);
+	m_upperLinks.emplace_back(level * (m_maxLinks + 1), 0);
+	m_removed.push_back(0);
+
+	if (m_entryPoint < 0)
+	{
+		m_entryPoint = node;
+		m_maxLevel = level;
+		return;
+	}
+
+	int entry = m_entryPoint;
+	for (int l = m_maxLevel; l > level; l--)
+		entry = SearchGreedy(row.data(), entry, l);
+
+	for (int l = std::min(level, m_maxLevel); l >= 0; l--)
+	{
+		const std::vector<Neighbour> candidates = SearchLayer(row.data(), entry, m_efConstruction, l);
+		const std::vector<Neighbour> neighbours = SelectNeighbours(candidates, m_maxLinks);
+
+		int* links = GetLinks(node, l);
+		links[0] = static_cast<int>(neighbours.size());
+		for (size_t i = 0; i < neighbours.size(); i++)
+		{
+			links[i + 1] = neighbours[i].index;
+			AddLink(neighbours[i].index, node, l);
+		}
+		entry = candidates.front().index;
+	}
+
+	if (level > m_maxLevel)
+	{
+		m_entryPoint = node;
+		m_maxLevel = level;
+	}
+}
+
+void HnswIndex::Remove(int _id)
+{
+	if (_id < 0 || static_cast<size_t>(_id) >= GetSize() || m_removed[_id])
+		return;
+
+	m_removed[_id] = 1;
+	m_removedCount++;
+}
+
+std::vector<Neighbour> HnswIndex::Search(const float* _query, size_t _k) const
+{
+	if (m_entryPoint < 0 || _k == 0)
+		return {};
+
+	int entry = m_entryPoint;
+	for (int l = m_maxLevel; l > 0; l--)
+		entry = SearchGreedy(_query, entry, l);
+
+	// Removed nodes take up room in the candidate list, so it grows until enough of the nodes it holds are left
+	const size_t liveCount = GetSize() - m_removedCount;
+	size_t ef = std::max(static_cast<size_t>(m_ef), _k);
+	std::vector<Neighbour> neighbours;
+	while (true)
+	{
+		neighbours = SearchLayer(_query, entry, ef, 0);
+		neighbours.erase(std::remove_if(neighbours.begin(), neighbours.end(), [this](const Neighbour& _neighbour) { return m_removed[_neighbour.index] != 0; }), neighbours.end());
+		if (neighbours.size() >= std::min(_k, liveCount) || ef >= GetSize())
+			break;
+		ef = std::min(2 * ef, GetSize());
+	}
+
+	if (neighbours.size() > _k)
+		neighbours.resize(_k);
+	return neighbours;
+}
+
+std::vector<Neighbour> HnswIndex::SearchRadius(const float* _query, float _radius) const
+{
+	// The candidate list grows until it reaches past the radius, or holds every node
+	size_t k = m_ef;
+	std::vector<Neighbour> neighbours = Search(_query, k);
+	while (!neighbours.empty() && neighbours.back().distance <= _radius && k < GetSize() - m_removedCount)
+	{
+		k = std::min(2 * k, GetSize() - m_removedCount);
+		neighbours = Search(_query, k);
+	}
+
+	neighbours.erase(std::find_if(neighbours.begin(), neighbours.end(), [_radius](const Neighbour& _neighbour) { return _neighbour.distance > _radius; }), neighbours.end());
+	return neighbours;
+}
+
+bool HnswIndex::Write(std::ostream& _stream) const
+{
+	_stream.write(HNSW_MAGIC, sizeof(HNSW_MAGIC));
+	util::WriteValue(_stream, HNSW_VERSION);
+	util::WriteValue<uint64_t>(_stream, m_dimension);
+	util::WriteValue<uint64_t>(_stream, m_maxLinks);
+	util::WriteValue<int32_t>(_stream, m_efConstruction);
+	util::WriteValue<int32_t>(_stream, m_entryPoint);
+	util::WriteValue<int32_t>(_stream, m_maxLevel);
+	util::WriteVector(_stream, m_rows);
+	util::WriteVector(_stream, m_levels);
+	util::WriteVector(_stream, m_baseLinks);
+	for (const std::vector<int>& links : m_upperLinks)
+		util::WriteVector(_stream, links);
+	util::WriteVector(_stream, m_removed);
+	return static_cast<bool>(_stream);
+}
+
+bool HnswIndex::Read(std::istream& _stream)
+{
+	char magic[sizeof(HNSW_MAGIC)] = {};
+	uint32_t version = 0;
+	uint64_t dimension = 0;
+	uint64_t maxLinks = 0;
+	int32_t efConstruction = 0;
+	int32_t entryPoint = -1;
+	int32_t maxLevel = -1;
+	_stream.read(magic, sizeof(magic));
+	util::ReadValue(_stream, version);
+	util::ReadValue(_stream, dimension);
+	util::ReadValue(_stream, maxLinks);
+	util::ReadValue(_stream, efConstruction);
+	util::ReadValue(_stream, entryPoint);
+	util::ReadValue(_stream, maxLevel);
+	Clear(0);
+	if (!_stream || std::memcmp(magic, HNSW_MAGIC, sizeof(magic)) != 0 || version != HNSW_VERSION || maxLinks < 2 || maxLinks > MAX_STORED_LINKS)
+		return false;
+
+	// The graph was linked with the M of the _stream, so it replaces the one of the settings
+	m_dimension = dimension;
+	m_maxLinks = maxLinks;
+	m_maxBaseLinks = 2 * maxLinks;
+	m_efConstruction = efConstruction;
+	m_levelMultiplier = 1.0 / std::log(static_cast<double>(m_maxLinks));
+	util::ReadVector(_stream, m_rows);
+	util::ReadVector(_stream, m_levels);
+	util::ReadVector(_stream, m_baseLinks);
+	m_upperLinks.resize(m_levels.size());
+	for (std::vector<int>& links : m_upperLinks)
+		util::ReadVector(_stream, links);
+	util::ReadVector(_stream, m_removed);
+
+	const size_t nodeCount = m_levels.size();
+	m_entryPoint = entryPoint;
+	m_maxLevel = maxLevel;
+	if (!_stream || !HasRecords(m_rows.size(), nodeCount, m_dimension) || !HasRecords(m_baseLinks.size(), nodeCount, m_maxBaseLinks + 1)
+		|| m_removed.size() != nodeCount || !HasValidGraph())
+	{
+		Clear(0);
+		return false;
+	}
+	m_removedCount = std::count_if(m_removed.begin(), m_removed.end(), [](uint8_t _removed) { return _removed != 0; });
+
+	// Later inserts draw their levels as if the loaded nodes had been inserted into this index
+	for (size_t i = 0; i < nodeCount; i++)
+		m_generator.Next();
+	return true;
+}
+
+size_t HnswIndex::GetMemoryUsage() const
+{
+	size_t bytes = m_rows.size() * sizeof(float) + (m_levels.size() + m_baseLinks.size()) * sizeof(int) + m_removed.size();
+	for (const std::vector<int>& links : m_upperLinks)
+		bytes += links.size() * sizeof(int);
+	return bytes;
+}
+
+float HnswIndex::Distance(const float* _query, int _node) const
+{
+	const float* row = GetRow(_node);
+
+	// Four independent sums let the compiler keep the loop in vector registers without reordering a single sum
+	float sums[4] = {};
+	size_t c = 0;
+	for (; c + 4 <= m_dimension; c += 4)
+	{
+		for (int lane = 0; lane < 4; lane++)
+			sums[lane] += std::abs(_query[c + lane] - row[c + lane]);
+	}
+	for (; c < m_dimension; c++)
+		sums[0] += std::abs(_query[c] - row[c]);
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+bool HnswIndex::HasValidGraph() const
+{
+	const size_t nodeCount = m_levels.size();
+	if (nodeCount == 0)
+		return m_entryPoint == -1 && m_maxLevel == -1;
+	if (m_entryPoint < 0 || static_cast<size_t>(m_entryPoint) >= nodeCount || m_maxLevel != m_levels[m_entryPoint])
+		return false;
+
+	// Every layer of every node has to hold at most the links it has room for, and every link has to name a node on that layer
+	for (size_t node = 0; node < nodeCount; node++)
+	{
+		if (m_levels[node] < 0 || m_levels[node] > m_maxLevel || !HasRecords(m_upperLinks[node].size(), m_levels[node], m_maxLinks + 1))
+			return false;
+		for (int level = 0; level <= m_levels[node]; level++)
+		{
+			const int* links = GetLinks(static_cast<int>(node), level);
+			if (links[0] < 0 || static_cast<size_t>(links[0]) > GetMaxLinks(level))
+				return false;
+			if (!std::all_of(links + 1, links + 1 + links[0], [&](int _link) { return _link >= 0 && static_cast<size_t>(_link) < nodeCount && m_levels[_link] >= level; }))
+				return false;
+		}
+	}
+	return true;
+}
+
+int* HnswIndex::GetLinks(int _node, int _level)
+{
+	if (_level == 0)
+		return m_baseLinks.data() + static_cast<size_t>(_node) * (m_maxBaseLinks + 1);
+	return m_upperLinks[_node].data() + static_cast<size_t>(_level - 1) * (m_maxLinks + 1);
+}
+
+const int* HnswIndex::GetLinks(int _node, int _level) const
+{
+	return const_cast<HnswIndex*>(this)->GetLinks(_node, _level);
+}
+
+int HnswIndex::SearchGreedy(const float* _query, int _entry, int _level) const
+{
+	int closest = _entry;
+	float closestDistance = Distance(_query, closest);
+	bool improved = true;
+	while (improved)
+	{
+		improved = false;
+		const int* links = GetLinks(closest, _level);
+		for (int i = 1; i <= links[0]; i++)
+		{
+			const float distance = Distance(_query, links[i]);
+			if (distance < closestDistance || (distance == closestDistance && links[i] < closest))
+			{
+				closest = links[i];
+				closestDistance = distance;
+				improved = true;
+			}
+		}
+	}
+	return closest;
+}
+
+std::vector<Neighbour> HnswIndex::SearchLayer(const float* _query, int _entry, size_t _ef, int _level) const
+{
+	VisitedNodes& visited = t_visitedNodes;
+	visited.Reset(GetSize());
+
+	// Candidates are explored closest first, the results are a max heap whose top is the furthest node kept
+	const auto further = [](const Neighbour& _a, const Neighbour& _b) { return _b < _a; };
+	std::priority_queue<Neighbour, std::vector<Neighbour>, decltype(further)> candidates(further);
+	std::vector<Neighbour> results;
+	results.reserve(_ef + 1);
+
+	const Neighbour entry = { _entry, Distance(_query, _entry) };
+	visited.Visit(_entry);
+	candidates.push(entry);
+	results.push_back(entry);
+
+	while (!candidates.empty())
+	{
+		const Neighbour candidate = candidates.top();
+		if (results.size() >= _ef && results.front() < candidate)
+			break;
+		candidates.pop();
+
+		const int* links = GetLinks(candidate.index, _level);
+		for (int i = 1; i <= links[0]; i++)
+		{
+			if (visited.Visit(links[i]))
+				continue;
+
+			const Neighbour neighbour = { links[i], Distance(_query, links[i]) };
+			if (results.size() < _ef || neighbour < results.front())
+			{
+				candidates.push(neighbour);
+				results.push_back(neighbour);
+				std::push_heap(results.begin(), results.end());
+				if (results.size() > _ef)
+				{
+					std::pop_heap(results.begin(), results.end());
+					results.pop_back();
+				}
+			}
+		}
+	}
+
+	std::sort_heap(results.begin(), results.end());
+	return results;
+}
+
+std::vector<Neighbour> HnswIndex::SelectNeighbours(const std::vector<Neighbour>& _candidates, size_t _maxCount) const
+{
+	std::vector<Neighbour> selected;
+	for (const Neighbour& candidate : _candidates)
+	{
+		if (selected.size() >= _maxCount)
+			break;
+
+		const float* row = GetRow(candidate.index);
+		const bool dominated = std::any_of(selected.begin(), selected.end(), [&](const Neighbour& _selected)
+		{
+			return Distance(row, _selected.index) < candidate.distance;
+		});
+		if (!dominated)
+			selected.push_back(candidate);
+	}
+	return selected;
+}
+
+void HnswIndex::AddLink(int _node, int _neighbour, int _level)
+{
+	int* links = GetLinks(_node, _level);
+	const size_t maxCount = GetMaxLinks(_level);
+	if (static_cast<size_t>(links[0]) < maxCount)
+	{
+		links[++links[0]] = _neighbour;
+		return;
+	}
+
+	const float* row = GetRow(_node);
+	std::vector<Neighbour> candidates(maxCount + 1);
+	for (size_t i = 0; i < maxCount; i++)
+		candidates[i] = { links[i + 1], Distance(row, links[i + 1]) };
+	candidates[maxCount] = { _neighbour, Distance(row, _neighbour) };
+	std::sort(candidates.begin(), candidates.end());
+
+	const std::vector<Neighbour> selected = SelectNeighbours(candidates, maxCount);
+	links[0] = static_cast<int>(selected.size());
+	for (size_t i = 0; i < selected.size(); i++)
+		links[i + 1] = selected[i].index;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "SearchIndex.h"
+#include "VertexSampler.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Hierarchical navigable small world graph (Malkov & Yashunin 2018) under the L1 distance.
+ *		  Every row is a node on the bottom layer and on a random number of layers above it, each layer has exponentially fewer nodes.
+ *		  A search descends greedily through the sparse upper layers and then explores the bottom layer with a bounded candidate list.
+ *		  Inserted nodes are linked to the neighbours a search for them finds, pruned by the heuristic of the paper so links spread
+ *		  over different directions.
+ * @remark Removed nodes are only marked, so the graph stays connected, until the index is built again.
+ *		   Node levels are drawn from a generator with a fixed seed, so building the same rows in the same order gives the same graph.
+*/
+class HnswIndex : public SearchIndex
+{
+public:
+	/**
+	 * @param _M The number of links per node on the upper layers, the bottom layer has 2 * _M.
+	 * @param _efConstruction The number of candidates kept while a node is inserted.
+	 * @param _ef The number of candidates kept while the graph is searched.
+	*/
+	HnswIndex(int _M, int _efConstruction, int _ef);
+
+	const char* GetName() const override { return "hnsw"; }
+	size_t GetSize() const override { return m_levels.size(); }
+	size_t GetDimension() const override { return m_dimension; }
+	size_t GetRemovedCount() const override { return m_removedCount; }
+	size_t GetMemoryUsage() const override;
+
+	void Build(const FeatureMatrix& _rows) override;
+	void Insert(const float* _row) override;
+	/** The node stays in the graph so searches can still pass through it, only the results leave it out */
+	void Remove(int _id) override;
+	std::vector<Neighbour> Search(const float* _query, size_t _k) const override;
+	std::vector<Neighbour> SearchRadius(const float* _query, float _radius) const override;
+	bool Write(std::ostream& _stream) const override;
+	bool Read(std::istream& _stream) override;
+
+	/**
+	 * @brief Changes the size of the candidate list of later searches, the graph stays the same.
+	*/
+	void SetEf(int _ef) { m_ef = _ef; }
+
+private:
+	void Clear(size_t _dimension);
+	const float* GetRow(int _node) const { return m_rows.data() + static_cast<size_t>(_node) * m_dimension; }
+	float Distance(const float* _query, int _node) const;
+
+	/** Links of a node on a layer, the first entry is the number of links */
+	int* GetLinks(int _node, int _level);
+	const int* GetLinks(int _node, int _level) const;
+	size_t GetMaxLinks(int _level) const { return _level == 0 ? m_maxBaseLinks : m_maxLinks; }
+
+	/**
+	 * @brief Whether a graph read from a file can be searched: the entry point is the top node, every node has room for the links
+	 *		  of each of its layers, and every stored link count is in range and every link names a node on its layer.
+	*/
+	bool HasValidGraph() const;
+
+	/**
+	 * @brief Walks to the node closest to the query on one layer, one neighbour at a time.
+	*/
+	int SearchGreedy(const float* _query, int _entry, int _level) const;
+
+	/**
+	 * @brief Explores one layer from an entry node and keeps the _ef closest nodes it finds.
+	 * @return The closest nodes, closest first.
+	*/
+	std::vector<Neighbour> SearchLayer(const float* _query, int _entry, size_t _ef, int _level) const;
+
+	/**
+	 * @brief Keeps candidates that are closer to the query than to every candidate kept so far, closest first.
+	 * @param _candidates Nodes with their distance to the query, closest first.
+	*/
+	std::vector<Neighbour> SelectNeighbours(const std::vector<Neighbour>& _candidates, size_t _maxCount) const;
+
+	/**
+	 * @brief Links a node to a new neighbour, pruning its links with SelectNeighbours when it has too many.
+	*/
+	void AddLink(int _node, int _neighbour, int _level);
+
+	size_t m_dimension;
+	size_t m_maxLinks;
+	size_t m_maxBaseLinks;
+	int m_efConstruction;
+	int m_ef;
+	/** 1 / ln(M), the expected number of nodes shrinks by a factor M per layer */
+	double m_levelMultiplier;
+	RandomGenerator m_generator;
+
+	/** Rows of all nodes, m_dimension floats each */
+	std::vector<float> m_rows;
+	/** Highest layer of every node */
+	std::vector<int> m_levels;
+	/** Bottom layer links, m_maxBaseLinks + 1 entries per node */
+	std::vector<int> m_baseLinks;
+	/** Links on the layers above the bottom one, m_maxLinks + 1 entries per node and layer */
+	std::vector<std::vector<int>> m_upperLinks;
+	/** Whether every node was removed */
+	std::vector<uint8_t> m_removed;
+	size_t m_removedCount;
+	int m_entryPoint;
+	int m_maxLevel;
+};
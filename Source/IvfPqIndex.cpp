@@ -0,0 +1,459 @@
+#include "IvfPqIndex.h"
+
+#include "BinaryStream.h"
+#include "Parallel.h"
+#include "VertexSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <numeric>
+#include <ostream>
+
+namespace
+{
+	/** The quantizers are trained once the index has this many rows */
+	constexpr size_t MIN_TRAINING_ROWS = 1024;
+	/** Larger indexes train on a random sample of this many rows */
+	constexpr size_t MAX_TRAINING_ROWS = 65536;
+	constexpr size_t MAX_CODEWORDS = 256;
+	constexpr int KMEANS_ITERATIONS = 16;
+	constexpr uint64_t TRAINING_SEED = 0x1F4F;
+	/** Number of rows a worker assigns or encodes before it takes the next chunk */
+	constexpr size_t ROW_GRAIN_SIZE = 256;
+
+	constexpr char IVF_PQ_MAGIC[4] = { 'I', 'V', 'P', 'Q' };
+	constexpr uint32_t IVF_PQ_VERSION = 2;
+
+	float SquaredDistance(const float* _a, const float* _b, size_t _dimension)
+	{
+		float distance = 0;
+		for (size_t c = 0; c < _dimension; c++)
+			distance += (_a[c] - _b[c]) * (_a[c] - _b[c]);
+		return distance;
+	}
+
+	float L1Distance(const float* _a, const float* _b, size_t _dimension)
+	{
+		float distance = 0;
+		for (size_t c = 0; c < _dimension; c++)
+			distance += std::abs(_a[c] - _b[c]);
+		return distance;
+	}
+
+	size_t FindNearestCentroid(const float* _row, const std::vector<float>& _centroids, size_t _dimension)
+	{
+		size_t nearest = 0;
+		float nearestDistance = SquaredDistance(_row, _centroids.data(), _dimension);
+		for (size_t c = 1; c < _centroids.size() / _dimension; c++)
+		{
+			const float distance = SquaredDistance(_row, _centroids.data() + c * _dimension, _dimension);
+			if (distance < nearestDistance)
+			{
+				nearest = c;
+				nearestDistance = distance;
+			}
+		}
+		return nearest;
+	}
+
+	/**
+	 * @brief Lloyd's k-means, seeded with distinct random rows. Clusters that run empty are reseeded with a random row.
+	 *		  The assignments are computed in parallel and the centroids summed in row order, so the result only depends on the seed.
+	 * @param _rows The rows to cluster, _dimension floats each.
+	 * @return The centroids, _dimension floats each.
+	*/
+	std::vector<float> TrainKMeans(const std::vector<float>& _rows, size_t _dimension, size_t _clusterCount, uint64_t _seed)
+	{
+		const size_t rowCount = _rows.size() / _dimension;
+		RandomGenerator generator(_seed);
+
+		std::vector<uint32_t> order(rowCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::vector<float> centroids(_clusterCount * _dimension);
+		for (size_t c = 0; c < _clusterCount; c++)
+		{
+			std::swap(order[c], order[c + generator.NextBelow(static_cast<uint32_t>(rowCount - c))]);
+			std::copy_n(_rows.data() + order[c] * _dimension, _dimension, centroids.data() + c * _dimension);
+		}
+
+		std::vector<size_t> assignments(rowCount);
+		std::vector<double> sums(_clusterCount * _dimension);
+		std::vector<size_t> counts(_clusterCount);
+		for (int iteration = 0; iteration < KMEANS_ITERATIONS; iteration++)
+		{
+			util::ParallelFor(rowCount, ROW_GRAIN_SIZE, [&](size_t _begin, size_t _end)
+			{
+				for (size_t r = _begin; r < _end; r++)
+					assignments[r] = FindNearestCentroid(_rows.data() + r * _dimension, centroids, _dimension);
+			});
+
+			std::fill(sums.begin(), sums.end(), 0.0);
+			std::fill(counts.begin(), counts.end(), 0);
+			for (size_t r = 0; r < rowCount; r++)
+			{
+				for (size_t d = 0; d < _dimension; d++)
+					sums[assignments[r] * _dimension + d] += _rows[r * _dimension + d];
+				counts[assignments[r]]++;
+			}
+
+			for (size_t c = 0; c < _clusterCount; c++)
+			{
+				float* centroid = centroids.data() + c * _dimension;
+				if (counts[c] == 0)
+				{
+					std::copy_n(_rows.data() + generator.NextBelow(static_cast<uint32_t>(rowCount)) * _dimension, _dimension, centroid);
+					continue;
+				}
+				for (size_t d = 0; d < _dimension; d++)
+					centroid[d] = static_cast<float>(sums[c * _dimension + d] / counts[c]);
+			}
+		}
+		return centroids;
+	}
+}
+
+IvfPqIndex::IvfPqIndex(int _listCount, int _probeCount, int _subspaceCount) :
+	m_dimension(0),
+	m_size(0),
+	m_listCount(std::max(_listCount, 0)),
+	m_probeCount(std::max(_probeCount, 1)),
+	m_subspaceCount(std::max(_subspaceCount, 1)),
+	m_removedCount(0),
+	m_codewordCount(0)
+{ }
+
+void IvfPqIndex::Build(const FeatureMatrix& _rows)
+{
+	m_dimension = _rows.GetColumnCount();
+	m_size = _rows.GetRowCount();
+	m_removed.assign(m_size, 0);
+	m_removedCount = 0;
+	m_untrainedRows.resize(m_size * m_dimension);
+	for (size_t i = 0; i < m_size; i++)
+		std::copy_n(_rows.GetRow(i), m_dimension, m_untrainedRows.data() + i * m_dimension);
+
+	m_centroids.clear();
+	m_codebooks.clear();
+	m_listIds.clear();
+	m_listCodes.clear();
+	m_codewordCount = 0;
+
+	if (m_size >= MIN_TRAINING_ROWS)
+	{
+		const std::vector<float> rows = std::move(m_untrainedRows);
+		m_untrainedRows.clear();
+		Train(rows);
+	}
+}
+
+void IvfPqIndex::Insert(const float* _row)
+{
+	const int id = static_cast<int>(m_size++);
+	m_removed.push_back(0);
+	if (IsTrained())
+	{
+		std::vector<uint8_t> code(m_subspaceCount);
+		const size_t list = Encode(_row, code.data());
+		Append(list, id, code.data());
+		return;
+	}
+
+	m_untrainedRows.insert(m_untrainedRows.end(), _row, _row + m_dimension);
+	if (m_size >= MIN_TRAINING_ROWS)
+	{
+		const std::vector<float> rows = std::move(m_untrainedRows);
+		m_untrainedRows.clear();
+		Train(rows);
+	}
+}
+
+void IvfPqIndex::Remove(int _id)
+{
+	if (_id < 0 || static_cast<size_t>(_id) >= m_size || m_removed[_id])
+		return;
+
+	m_removed[_id] = 1;
+	m_removedCount++;
+}
+
+void IvfPqIndex::Train(const std::vector<float>& _rows)
+{
+	const size_t rowCount = _rows.size() / m_dimension;
+	m_subspaceCount = std::min(m_subspaceCount, m_dimension);
+	RandomGenerator generator(TRAINING_SEED);
+
+	std::vector<float> sample;
+	if (rowCount > MAX_TRAINING_ROWS)
+	{
+		std::vector<uint32_t> order(rowCount);
+		std::iota(order.begin(), order.end(), 0u);
+		sample.resize(MAX_TRAINING_ROWS * m_dimension);
+		for (size_t i = 0; i < MAX_TRAINING_ROWS; i++)
+		{
+			std::swap(order[i], order[i + generator.NextBelow(static_cast<uint32_t>(rowCount - i))]);
+			std::copy_n(_rows.data() + order[i] * m_dimension, m_dimension, sample.data() + i * m_dimension);
+		}
+	}
+	else
+	{
+		sample = _rows;
+	}
+	const size_t sampleCount = sample.size() / m_dimension;
+
+	const size_t listCount = m_listCount > 0 ? static_cast<size_t>(m_listCount) : static_cast<size_t>(4 * std::sqrt(static_cast<double>(rowCount)));
+	m_centroids = TrainKMeans(sample, m_dimension, std::clamp<size_t>(listCount, 1, sampleCount), TRAINING_SEED + 1);
+
+	m_codewordCount = std::min(MAX_CODEWORDS, sampleCount);
+	m_codebooks.resize(m_codewordCount * m_dimension);
+	for (size_t s = 0; s < m_subspaceCount; s++)
+	{
+		const size_t begin = GetSubspaceBegin(s);
+		const size_t width = GetSubspaceBegin(s + 1) - begin;
+		std::vector<float> subvectors(sampleCount * width);
+		for (size_t i = 0; i < sampleCount; i++)
+			std::copy_n(sample.data() + i * m_dimension + begin, width, subvectors.data() + i * width);
+
+		const std::vector<float> codewords = TrainKMeans(subvectors, width, m_codewordCount, TRAINING_SEED + 2 + s);
+		std::copy(codewords.begin(), codewords.end(), m_codebooks.begin() + m_codewordCount * begin);
+	}
+
+	// Rows are encoded in parallel and appended in id order, so the lists do not depend on the number of threads
+	m_listIds.assign(m_centroids.size() / m_dimension, {});
+	m_listCodes.assign(m_centroids.size() / m_dimension, {});
+	std::vector<size_t> lists(rowCount);
+	std::vector<uint8_t> codes(rowCount * m_subspaceCount);
+	util::ParallelFor(rowCount, ROW_GRAIN_SIZE, [&](size_t _begin, size_t _end)
+	{
+		for (size_t i = _begin; i < _end; i++)
+			lists[i] = Encode(_rows.data() + i * m_dimension, codes.data() + i * m_subspaceCount);
+	});
+	for (size_t i = 0; i < rowCount; i++)
+		Append(lists[i], static_cast<int>(i), codes.data() + i * m_subspaceCount);
+}
+
+size_t IvfPqIndex::Encode(const float* _row, uint8_t* o_code) const
+{
+	for (size_t s = 0; s < m_subspaceCount; s++)
+	{
+		const size_t begin = GetSubspaceBegin(s);
+		const size_t width = GetSubspaceBegin(s + 1) - begin;
+		const float* codewords = m_codebooks.data() + m_codewordCount * begin;
+
+		size_t nearest = 0;
+		float nearestDistance = SquaredDistance(_row + begin, codewords, width);
+		for (size_t c = 1; c < m_codewordCount; c++)
+		{
+			const float distance = SquaredDistance(_row + begin, codewords + c * width, width);
+			if (distance < nearestDistance)
+			{
+				nearest = c;
+				nearestDistance = distance;
+			}
+		}
+		o_code[s] = static_cast<uint8_t>(nearest);
+	}
+	return FindNearestCentroid(_row, m_centroids, m_dimension);
+}
+
+void IvfPqIndex::Append(size_t _list, int _id, const uint8_t* _code)
+{
+	m_listIds[_list].push_back(_id);
+	m_listCodes[_list].insert(m_listCodes[_list].end(), _code, _code + m_subspaceCount);
+}
+
+std::vector<size_t> IvfPqIndex::FindProbedLists(const float* _query) const
+{
+	const size_t listCount = m_centroids.size() / m_dimension;
+	std::vector<std::pair<float, size_t>> lists(listCount);
+	for (size_t l = 0; l < listCount; l++)
+		lists[l] = { SquaredDistance(_query, m_centroids.data() + l * m_dimension, m_dimension), l };
+
+	const size_t probeCount = std::min<size_t>(m_probeCount, listCount);
+	std::partial_sort(lists.begin(), lists.begin() + probeCount, lists.end());
+
+	std::vector<size_t> probed(probeCount);
+	for (size_t i = 0; i < probeCount; i++)
+		probed[i] = lists[i].second;
+	return probed;
+}
+
+void IvfPqIndex::ComputeDistanceTable(const float* _query, std::vector<float>& o_table) const
+{
+	o_table.resize(m_subspaceCount * m_codewordCount);
+	for (size_t s = 0; s < m_subspaceCount; s++)
+	{
+		const size_t begin = GetSubspaceBegin(s);
+		const size_t width = GetSubspaceBegin(s + 1) - begin;
+		const float* codewords = m_codebooks.data() + m_codewordCount * begin;
+		for (size_t c = 0; c < m_codewordCount; c++)
+			o_table[s * m_codewordCount + c] = L1Distance(_query + begin, codewords + c * width, width);
+	}
+}
+
+template<typename Visitor>
+void IvfPqIndex::ScanRows(const float* _query, Visitor&& _visit) const
+{
+	if (!IsTrained())
+	{
+		for (size_t i = 0; i < m_size; i++)
+		{
+			if (!m_removed[i])
+				_visit(static_cast<int>(i), L1Distance(_query, m_untrainedRows.data() + i * m_dimension, m_dimension));
+		}
+		return;
+	}
+
+	std::vector<float> table;
+	ComputeDistanceTable(_query, table);
+	for (size_t list : FindProbedLists(_query))
+	{
+		const std::vector<int>& ids = m_listIds[list];
+		const uint8_t* codes = m_listCodes[list].data();
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			if (m_removed[ids[i]])
+				continue;
+
+			const uint8_t* code = codes + i * m_subspaceCount;
+			float distance = 0;
+			for (size_t s = 0; s < m_subspaceCount; s++)
+				distance += table[s * m_codewordCount + code[s]];
+			_visit(ids[i], distance);
+		}
+	}
+}
+
+std::vector<Neighbour> IvfPqIndex::Search(const float* _query, size_t _k) const
+{
+	// Max heap of the best candidates so far, its top is the candidate that is replaced next
+	std::vector<Neighbour> heap;
+	if (_k == 0)
+		return heap;
+
+	heap.reserve(_k + 1);
+	ScanRows(_query, [&](int _id, float _distance)
+	{
+		const Neighbour candidate = { _id, _distance };
+		if (heap.size() == _k && !(candidate < heap.front()))
+			return;
+
+		heap.push_back(candidate);
+		std::push_heap(heap.begin(), heap.end());
+		if (heap.size() > _k)
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			heap.pop_back();
+		}
+	});
+
+	std::sort_heap(heap.begin(), heap.end());
+	return heap;
+}
+
+std::vector<Neighbour> IvfPqIndex::SearchRadius(const float* _query, float _radius) const
+{
+	std::vector<Neighbour> neighbours;
+	ScanRows(_query, [&](int _id, float _distance)
+	{
+		if (_distance <= _radius)
+			neighbours.push_back({ _id, _distance });
+	});
+	std::sort(neighbours.begin(), neighbours.end());
+	return neighbours;
+}
+
+bool IvfPqIndex::Write(std::ostream& _stream) const
+{
+	_stream.write(IVF_PQ_MAGIC, sizeof(IVF_PQ_MAGIC));
+	util::WriteValue(_stream, IVF_PQ_VERSION);
+	util::WriteValue<uint64_t>(_stream, m_dimension);
+	util::WriteValue<uint64_t>(_stream, m_size);
+	util::WriteValue<uint64_t>(_stream, m_subspaceCount);
+	util::WriteValue<uint64_t>(_stream, m_codewordCount);
+	util::WriteVector(_stream, m_removed);
+	util::WriteVector(_stream, m_untrainedRows);
+	util::WriteVector(_stream, m_centroids);
+	util::WriteVector(_stream, m_codebooks);
+	for (size_t l = 0; l < m_listIds.size(); l++)
+	{
+		util::WriteVector(_stream, m_listIds[l]);
+		util::WriteVector(_stream, m_listCodes[l]);
+	}
+	return static_cast<bool>(_stream);
+}
+
+bool IvfPqIndex::Read(std::istream& _stream)
+{
+	char magic[sizeof(IVF_PQ_MAGIC)] = {};
+	uint32_t version = 0;
+	uint64_t dimension = 0;
+	uint64_t size = 0;
+	uint64_t subspaceCount = 0;
+	uint64_t codewordCount = 0;
+	_stream.read(magic, sizeof(magic));
+	util::ReadValue(_stream, version);
+	util::ReadValue(_stream, dimension);
+	util::ReadValue(_stream, size);
+	util::ReadValue(_stream, subspaceCount);
+	util::ReadValue(_stream, codewordCount);
+
+	m_size = 0;
+	m_removed.clear();
+	m_removedCount = 0;
+	m_untrainedRows.clear();
+	m_centroids.clear();
+	m_codebooks.clear();
+	m_listIds.clear();
+	m_listCodes.clear();
+	if (!_stream || std::memcmp(magic, IVF_PQ_MAGIC, sizeof(magic)) != 0 || version != IVF_PQ_VERSION || dimension == 0 || subspaceCount == 0
+		|| subspaceCount > dimension || codewordCount > MAX_CODEWORDS)
+		return false;
+
+	// The codes were computed with the subspaces of the _stream, so they replace the ones of the settings
+	m_dimension = dimension;
+	m_subspaceCount = subspaceCount;
+	m_codewordCount = codewordCount;
+	util::ReadVector(_stream, m_removed);
+	util::ReadVector(_stream, m_untrainedRows);
+	util::ReadVector(_stream, m_centroids);
+	util::ReadVector(_stream, m_codebooks);
+
+	const size_t listCount = m_centroids.size() / m_dimension;
+	m_listIds.resize(listCount);
+	m_listCodes.resize(listCount);
+	size_t encodedCount = 0;
+	bool valid = static_cast<bool>(_stream) && m_codebooks.size() == m_codewordCount * m_dimension && m_removed.size() == size;
+	for (size_t l = 0; l < listCount && valid; l++)
+	{
+		util::ReadVector(_stream, m_listIds[l]);
+		util::ReadVector(_stream, m_listCodes[l]);
+		valid = _stream && m_listCodes[l].size() == m_listIds[l].size() * m_subspaceCount
+			&& std::all_of(m_listIds[l].begin(), m_listIds[l].end(), [size](int _id) { return _id >= 0 && static_cast<uint64_t>(_id) < size; })
+			&& std::all_of(m_listCodes[l].begin(), m_listCodes[l].end(), [this](uint8_t _code) { return _code < m_codewordCount; });
+		encodedCount += m_listIds[l].size();
+	}
+
+	if (!valid || (IsTrained() ? encodedCount : m_untrainedRows.size() / m_dimension) != size)
+	{
+		m_removed.clear();
+		m_untrainedRows.clear();
+		m_centroids.clear();
+		m_codebooks.clear();
+		m_listIds.clear();
+		m_listCodes.clear();
+		return false;
+	}
+	m_size = size;
+	m_removedCount = std::count_if(m_removed.begin(), m_removed.end(), [](uint8_t _removed) { return _removed != 0; });
+	return true;
+}
+
+size_t IvfPqIndex::GetMemoryUsage() const
+{
+	size_t bytes = (m_untrainedRows.size() + m_centroids.size() + m_codebooks.size()) * sizeof(float) + m_removed.size();
+	for (size_t l = 0; l < m_listIds.size(); l++)
+		bytes += m_listIds[l].size() * sizeof(int) + m_listCodes[l].size();
+	return bytes;
+}
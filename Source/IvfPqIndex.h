@@ -0,0 +1,105 @@
+#pragma once
+
+#include "SearchIndex.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Inverted file index with product quantized rows (Jégou et al. 2011) under the L1 distance.
+ *		  A coarse k-means quantizer splits the rows over lists, and every row is stored in the list of its closest centroid
+ *		  as one byte per subspace, the index of the closest codeword of the row in that subspace. A query only scans the
+ *		  lists of its closest centroids, with a table of the distances from the query to every codeword of every subspace,
+ *		  so the distance to a row is a sum of table lookups. The rows themselves are not kept.
+ * @remark The codes quantize the rows and not their residuals to the centroids as in the paper. The L1 distance to a residual
+ *		   codeword depends on the list, so residuals would need one table per probed list, which costs more than the scan itself.
+ * @remark The quantizers are trained once there are enough rows, until then the rows are kept as they are and scanned linearly.
+ *		   Training is seeded, so building the same rows gives the same index.
+*/
+class IvfPqIndex : public SearchIndex
+{
+public:
+	/**
+	 * @param _listCount The number of coarse centroids, 0 picks 4 * sqrt(row count) when the quantizers are trained.
+	 * @param _probeCount The number of lists a query scans.
+	 * @param _subspaceCount The number of subspaces, which is the number of bytes per row. The columns are split into
+	 *		  ranges of nearly equal size.
+	*/
+	IvfPqIndex(int _listCount, int _probeCount, int _subspaceCount);
+
+	const char* GetName() const override { return "ivf-pq"; }
+	size_t GetSize() const override { return m_size; }
+	size_t GetDimension() const override { return m_dimension; }
+	size_t GetRemovedCount() const override { return m_removedCount; }
+	size_t GetMemoryUsage() const override;
+
+	void Build(const FeatureMatrix& _rows) override;
+	void Insert(const float* _row) override;
+	void Remove(int _id) override;
+	std::vector<Neighbour> Search(const float* _query, size_t _k) const override;
+	std::vector<Neighbour> SearchRadius(const float* _query, float _radius) const override;
+	bool Write(std::ostream& _stream) const override;
+	bool Read(std::istream& _stream) override;
+
+	/**
+	 * @brief Changes the number of lists later searches scan.
+	*/
+	void SetProbeCount(int _probeCount) { m_probeCount = _probeCount; }
+
+private:
+	bool IsTrained() const { return !m_centroids.empty(); }
+	size_t GetSubspaceBegin(size_t _subspace) const { return _subspace * m_dimension / m_subspaceCount; }
+
+	/**
+	 * @brief Trains the coarse quantizer and the codebooks on the rows and encodes all of them.
+	*/
+	void Train(const std::vector<float>& _rows);
+
+	/**
+	 * @brief Finds the list of a row and its codes.
+	 * @param o_code m_subspaceCount bytes.
+	 * @return The list of the row.
+	*/
+	size_t Encode(const float* _row, uint8_t* o_code) const;
+	void Append(size_t _list, int _id, const uint8_t* _code);
+
+	/**
+	 * @brief The lists closest to the query, closest first.
+	*/
+	std::vector<size_t> FindProbedLists(const float* _query) const;
+
+	/**
+	 * @brief Fills the table of L1 distances from the query to every codeword of every subspace.
+	*/
+	void ComputeDistanceTable(const float* _query, std::vector<float>& o_table) const;
+
+	/**
+	 * @brief Calls _visit(id, distance) for every row in the probed lists, or every untrained row.
+	*/
+	template<typename Visitor>
+	void ScanRows(const float* _query, Visitor&& _visit) const;
+
+	size_t m_dimension;
+	size_t m_size;
+	int m_listCount;
+	int m_probeCount;
+	size_t m_subspaceCount;
+
+	/** Whether every id was removed, removed rows keep their codes until the index is built again */
+	std::vector<uint8_t> m_removed;
+	size_t m_removedCount;
+
+	/** Rows inserted before the quantizers were trained, m_dimension floats each, row i has id i */
+	std::vector<float> m_untrainedRows;
+
+	/** Coarse centroids, m_dimension floats each */
+	std::vector<float> m_centroids;
+	/** Number of codewords of every subspace, at most 256 */
+	size_t m_codewordCount;
+	/** Codewords of all subspaces, subspace s starts at m_codewordCount * GetSubspaceBegin(s) */
+	std::vector<float> m_codebooks;
+	/** Ids of the rows in every list */
+	std::vector<std::vector<int>> m_listIds;
+	/** Codes of the rows in every list, m_subspaceCount bytes per row */
+	std::vector<std::vector<uint8_t>> m_listCodes;
+};
@@ -7,8 +7,6 @@
 
 int main(int argc, char** argv)
 {
-	srand(time(nullptr));
-	
 	__noop(argc);
 	__noop(argv);
 
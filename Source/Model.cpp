@@ -2,7 +2,6 @@
 
 #include <iostream>
 #include "FeatureExtraction.h"
-#include "ModelUtil.h"
 
 Mesh::Mesh() :
 	vao(0),
@@ -87,15 +86,11 @@ void Model::markForReupload()
 	m_isUploaded = false;
 }
 
-void Model::CalculateOBB()
+void Model::CalculateOBB(const glm::vec3* eigenVectors)
 {
 	
 	m_orientedPoints.clear();
 
-	glm::vec3 eigenVectors[3];
-	glm::vec3 eigenValues;
-	util::ComputeEigenVectors(*this, eigenVectors[0], eigenVectors[1], eigenVectors[2], eigenValues);
-
 	// project min and max points on each principal axis
 	float min1 = INFINITY, max1 = -INFINITY;
 	float min2 = INFINITY, max2 = -INFINITY;
@@ -63,7 +63,10 @@ public:
 	std::vector<glm::vec3> m_orientedPoints;
 	
 private:
-	void CalculateOBB();
+	/**
+	 * @brief Computes the oriented bounding box points along the given sorted eigenvectors of the model.
+	*/
+	void CalculateOBB(const glm::vec3* _eigenVectors);
 
 	bool m_isUploaded;
 
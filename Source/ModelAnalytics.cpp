@@ -70,13 +70,7 @@ namespace analytics
 		glm::vec3 eigenValues;
 		util::ComputeEigenVectors(model, eigenVectors[0], eigenVectors[1], eigenVectors[2], eigenValues);
 
-		std::vector<int> sortedIndices = { 0, 1, 2 };
-		std::vector<float> sortedEigenValues = { eigenValues.x, eigenValues.y, eigenValues.z };
-		std::sort(std::begin(sortedIndices), std::end(sortedIndices), [&](int i1, int i2) { return sortedEigenValues[i1] > sortedEigenValues[i2]; });
-		
-		glm::vec3 majorEigenVector = eigenVectors[sortedIndices[0]];
-
-		float absCos = abs(glm::dot(majorEigenVector, glm::vec3(1, 0, 0)));
+		float absCos = std::abs(glm::dot(eigenVectors[0], glm::vec3(1, 0, 0)));
 
 		return absCos;
 	}
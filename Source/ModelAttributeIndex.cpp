@@ -0,0 +1,216 @@
+#include "ModelAttributeIndex.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	/**
+	 * @brief Removes a model from a list of models and moves the indices after it up by one.
+	*/
+	void RemoveModelIndex(std::vector<int>& _models, int _model)
+	{
+		_models.erase(std::remove(_models.begin(), _models.end(), _model), _models.end());
+		for (int& model : _models)
+		{
+			if (model > _model)
+				model--;
+		}
+	}
+}
+
+void ModelAttributeIndex::Build(const std::vector<ModelDescriptor>& _models)
+{
+	*this = ModelAttributeIndex();
+	for (const ModelDescriptor& model : _models)
+	{
+		const int index = static_cast<int>(m_names.size());
+		m_names.push_back(model.m_name);
+		m_classes.push_back(model.m_class);
+		m_vertexCounts.push_back(model.m_vertexCount);
+		m_faceCounts.push_back(model.m_faceCount);
+		m_boundsDiagonals.push_back(GetBoundsDiagonal(model));
+		m_modelsByName.emplace(model.m_name, index);
+		m_modelsByClass[model.m_class].push_back(index);
+	}
+
+	for (size_t a = 0; a < m_sortedModels.size(); a++)
+	{
+		const ModelAttribute attribute = static_cast<ModelAttribute>(a);
+		std::vector<int>& sortedModels = m_sortedModels[a];
+		sortedModels.resize(m_names.size());
+		std::iota(sortedModels.begin(), sortedModels.end(), 0);
+		std::stable_sort(sortedModels.begin(), sortedModels.end(), [&](int _left, int _right)
+		{
+			return GetValue(attribute, _left) < GetValue(attribute, _right);
+		});
+	}
+}
+
+void ModelAttributeIndex::Add(const ModelDescriptor& _model)
+{
+	const int index = static_cast<int>(m_names.size());
+	m_names.push_back(_model.m_name);
+	m_classes.push_back(_model.m_class);
+	m_vertexCounts.push_back(_model.m_vertexCount);
+	m_faceCounts.push_back(_model.m_faceCount);
+	m_boundsDiagonals.push_back(GetBoundsDiagonal(_model));
+	m_modelsByName.emplace(_model.m_name, index);
+	m_modelsByClass[_model.m_class].push_back(index);
+
+	// The new model has the largest index, so it goes after every model with the same value
+	for (size_t a = 0; a < m_sortedModels.size(); a++)
+	{
+		const ModelAttribute attribute = static_cast<ModelAttribute>(a);
+		const double value = GetValue(attribute, index);
+		std::vector<int>& sortedModels = m_sortedModels[a];
+		sortedModels.insert(std::upper_bound(sortedModels.begin(), sortedModels.end(), value, [&](double _value, int _model)
+		{
+			return _value < GetValue(attribute, _model);
+		}), index);
+	}
+}
+
+void ModelAttributeIndex::Remove(size_t _model)
+{
+	if (_model >= m_names.size())
+		return;
+
+	const int model = static_cast<int>(_model);
+	for (std::vector<int>& sortedModels : m_sortedModels)
+		RemoveModelIndex(sortedModels, model);
+
+	for (auto& [modelClass, classModels] : m_modelsByClass)
+		RemoveModelIndex(classModels, model);
+	auto classModels = m_modelsByClass.find(m_classes[_model]);
+	if (classModels->second.empty())
+		m_modelsByClass.erase(classModels);
+
+	// Another model with the same name takes over its entry
+	const std::string name = m_names[_model];
+	m_names.erase(m_names.begin() + _model);
+	m_classes.erase(m_classes.begin() + _model);
+	m_vertexCounts.erase(m_vertexCounts.begin() + _model);
+	m_faceCounts.erase(m_faceCounts.begin() + _model);
+	m_boundsDiagonals.erase(m_boundsDiagonals.begin() + _model);
+	for (auto& [modelName, index] : m_modelsByName)
+	{
+		if (index > model)
+			index--;
+	}
+	if (m_modelsByName[name] == model)
+	{
+		auto sameName = std::find(m_names.begin(), m_names.end(), name);
+		if (sameName != m_names.end())
+			m_modelsByName[name] = static_cast<int>(sameName - m_names.begin());
+		else
+			m_modelsByName.erase(name);
+	}
+}
+
+int ModelAttributeIndex::FindModel(const std::string& _name) const
+{
+	auto model = m_modelsByName.find(_name);
+	return model != m_modelsByName.end() ? model->second : -1;
+}
+
+const std::vector<int>& ModelAttributeIndex::GetClassModels(const std::string& _class) const
+{
+	static const std::vector<int> noModels;
+	auto classModels = m_modelsByClass.find(_class);
+	return classModels != m_modelsByClass.end() ? classModels->second : noModels;
+}
+
+bool ModelAttributeIndex::Matches(size_t _model, const ModelFilter& _filter) const
+{
+	return static_cast<int>(_model) != _filter.excludedModel
+		&& (_filter.modelClass.empty() || m_classes[_model] == _filter.modelClass)
+		&& m_vertexCounts[_model] >= _filter.minVertexCount && m_vertexCounts[_model] <= _filter.maxVertexCount
+		&& m_faceCounts[_model] >= _filter.minFaceCount && m_faceCounts[_model] <= _filter.maxFaceCount
+		&& m_boundsDiagonals[_model] >= _filter.minBoundsDiagonal && m_boundsDiagonals[_model] <= _filter.maxBoundsDiagonal;
+}
+
+std::vector<int> ModelAttributeIndex::Select(const ModelFilter& _filter) const
+{
+	// Candidates from the condition that leaves the fewest, every model if there is none
+	using Range = std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator>;
+	const std::vector<int>& allModels = GetSortedModels(ModelAttribute::VERTEX_COUNT);
+	Range candidates(allModels.begin(), allModels.end());
+	bool sortedByIndex = false;
+
+	const Range ranges[] = {
+		GetRange(ModelAttribute::VERTEX_COUNT, static_cast<double>(_filter.minVertexCount), static_cast<double>(_filter.maxVertexCount)),
+		GetRange(ModelAttribute::FACE_COUNT, static_cast<double>(_filter.minFaceCount), static_cast<double>(_filter.maxFaceCount)),
+		GetRange(ModelAttribute::BOUNDS_DIAGONAL, _filter.minBoundsDiagonal, _filter.maxBoundsDiagonal)
+	};
+	for (const Range& range : ranges)
+	{
+		if (range.second - range.first < candidates.second - candidates.first)
+			candidates = range;
+	}
+	if (!_filter.modelClass.empty())
+	{
+		const std::vector<int>& classModels = GetClassModels(_filter.modelClass);
+		if (classModels.size() <= static_cast<size_t>(candidates.second - candidates.first))
+		{
+			candidates = Range(classModels.begin(), classModels.end());
+			sortedByIndex = true;
+		}
+	}
+
+	// When the candidates are most of the models, testing every model in order is faster and needs no sort
+	std::vector<int> models;
+	if (static_cast<size_t>(candidates.second - candidates.first) > m_names.size() / 2)
+	{
+		for (size_t model = 0; model < m_names.size(); model++)
+		{
+			if (Matches(model, _filter))
+				models.push_back(static_cast<int>(model));
+		}
+		return models;
+	}
+
+	for (auto model = candidates.first; model != candidates.second; ++model)
+	{
+		if (Matches(*model, _filter))
+			models.push_back(*model);
+	}
+	if (!sortedByIndex)
+		std::sort(models.begin(), models.end());
+	return models;
+}
+
+float ModelAttributeIndex::GetBoundsDiagonal(const ModelDescriptor& _model)
+{
+	return glm::length(_model.m_bounds.max - _model.m_bounds.min);
+}
+
+double ModelAttributeIndex::GetValue(ModelAttribute _attribute, size_t _model) const
+{
+	switch (_attribute)
+	{
+	case ModelAttribute::VERTEX_COUNT:
+		return static_cast<double>(m_vertexCounts[_model]);
+	case ModelAttribute::FACE_COUNT:
+		return static_cast<double>(m_faceCounts[_model]);
+	case ModelAttribute::BOUNDS_DIAGONAL:
+	default:
+		return m_boundsDiagonals[_model];
+	}
+}
+
+std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator> ModelAttributeIndex::GetRange(ModelAttribute _attribute, double _min, double _max) const
+{
+	const std::vector<int>& sortedModels = GetSortedModels(_attribute);
+	const auto first = std::lower_bound(sortedModels.begin(), sortedModels.end(), _min, [&](int _model, double _value)
+	{
+		return GetValue(_attribute, _model) < _value;
+	});
+	const auto last = std::upper_bound(first, sortedModels.end(), _max, [&](double _value, int _model)
+	{
+		return _value < GetValue(_attribute, _model);
+	});
+	return { first, last };
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ModelDescriptor.h"
+
+#include <array>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Attributes of a model that ModelAttributeIndex keeps the models sorted by.
+*/
+enum class ModelAttribute
+{
+	VERTEX_COUNT,
+	FACE_COUNT,
+	/** Length of the diagonal of the bounds of the model */
+	BOUNDS_DIAGONAL,
+	COUNT
+};
+
+/**
+ * @brief Conditions the models of a filtered search have to meet. Conditions that are left at their default hold for every model.
+*/
+struct ModelFilter
+{
+	/** Only models of this class, any class if empty */
+	std::string modelClass;
+	size_t minVertexCount = 0;
+	size_t maxVertexCount = std::numeric_limits<size_t>::max();
+	size_t minFaceCount = 0;
+	size_t maxFaceCount = std::numeric_limits<size_t>::max();
+	float minBoundsDiagonal = 0;
+	float maxBoundsDiagonal = std::numeric_limits<float>::infinity();
+	/** A model that is left out, e.g. the query itself, -1 for none */
+	int excludedModel = -1;
+};
+
+/**
+ * @brief Secondary indexes over the models of a database, which leave the models and the rows of the feature matrix in place.
+ *		  Models are looked up by name in a hash map, and kept in a list per class and in one list per attribute sorted by its value,
+ *		  so filters select their models with a binary search instead of a scan over all descriptors.
+ * @remark Models are identified by their index in the database. Adding a model inserts it into the sorted lists and removing one
+ *		   shifts the indices after it like the database does, both in linear time.
+*/
+class ModelAttributeIndex
+{
+public:
+	/**
+	 * @brief Replaces the content of the index with the models of a database, model i gets index i.
+	*/
+	void Build(const std::vector<ModelDescriptor>& _models);
+
+	/**
+	 * @brief Adds a model at the end of the database, it gets index GetModelCount().
+	*/
+	void Add(const ModelDescriptor& _model);
+
+	/**
+	 * @brief Removes a model, the models after it move up by one like in the database.
+	*/
+	void Remove(size_t _model);
+
+	size_t GetModelCount() const { return m_names.size(); }
+
+	/**
+	 * @brief Finds a model by name in constant time.
+	 * @return The index of the first model with the name, -1 if there is none.
+	*/
+	int FindModel(const std::string& _name) const;
+
+	/**
+	 * @brief Returns all models sorted by an attribute, ties ordered by index.
+	*/
+	const std::vector<int>& GetSortedModels(ModelAttribute _attribute) const { return m_sortedModels[static_cast<size_t>(_attribute)]; }
+
+	/**
+	 * @brief Returns the models of a class in the order of their index, empty for an unknown class.
+	*/
+	const std::vector<int>& GetClassModels(const std::string& _class) const;
+
+	/**
+	 * @brief Whether a model meets every condition of a filter.
+	*/
+	bool Matches(size_t _model, const ModelFilter& _filter) const;
+
+	/**
+	 * @brief Finds every model that meets a filter. The candidates come from the most selective condition, the class list or
+	 *		  the range of one of the sorted lists, and only they are checked against the other conditions.
+	 * @return The models in the order of their index.
+	*/
+	std::vector<int> Select(const ModelFilter& _filter) const;
+
+	static float GetBoundsDiagonal(const ModelDescriptor& _model);
+
+private:
+	double GetValue(ModelAttribute _attribute, size_t _model) const;
+
+	/**
+	 * @brief The part of the list sorted by an attribute whose values are in [_min, _max].
+	*/
+	std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator> GetRange(ModelAttribute _attribute, double _min, double _max) const;
+
+	std::vector<std::string> m_names;
+	std::vector<std::string> m_classes;
+	std::vector<size_t> m_vertexCounts;
+	std::vector<size_t> m_faceCounts;
+	std::vector<float> m_boundsDiagonals;
+
+	std::unordered_map<std::string, int> m_modelsByName;
+	std::unordered_map<std::string, std::vector<int>> m_modelsByClass;
+	std::array<std::vector<int>, static_cast<size_t>(ModelAttribute::COUNT)> m_sortedModels;
+};
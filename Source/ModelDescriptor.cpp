@@ -2,6 +2,7 @@
 
 #include "FeatureExtraction.h"
 #include "ModelUtil.h"
+#include "VertexSampler.h"
 
 # define M_PI           3.14159265358979323846  /* pi */
 
@@ -41,26 +42,34 @@ void ModelDescriptor::UpdateDescriptorData()
 }
 
 void ModelDescriptor::UpdateFeatures()
+{
+	if (m_model != nullptr)
+		UpdateFeatures(util::ComputeMoments(*m_model));
+}
+
+void ModelDescriptor::UpdateFeatures(const util::MeshMoments& _moments)
 {
 	if (m_model != nullptr)
 	{
-		UpdateDescriptorData();
-		UpdateBounds();
-		util::ComputeEigenVectors(*m_model, m_eigenVectors[0], m_eigenVectors[1], m_eigenVectors[2], m_eigenValues);
-		m_model->CalculateOBB();
+		m_vertexCount = _moments.vertexCount;
+		m_faceCount = _moments.faceCount;
+		m_bounds.min = _moments.min;
+		m_bounds.max = _moments.max;
+		util::ComputeEigenVectors(_moments, m_eigenVectors[0], m_eigenVectors[1], m_eigenVectors[2], m_eigenValues);
+		m_model->CalculateOBB(m_eigenVectors.data());
 
-		m_3DFeatures[SURFACE_AREA_3D] = ExtractSurfaceArea(*this);
-		m_3DFeatures[VOLUME_3D] = ExtractVolume(*this);
+		m_3DFeatures[SURFACE_AREA_3D] = static_cast<float>(_moments.surfaceArea);
+		m_3DFeatures[VOLUME_3D] = static_cast<float>(_moments.volume);
 		m_3DFeatures[BOUNDS_AREA_3D] = ExtractAABBArea(*this);
 		m_3DFeatures[BOUNDS_VOLUME_3D] = ExtractAABBVolume(*this);
 		m_3DFeatures[COMPACTNESS_3D] = (std::pow(M_PI, 1.0 / 3.0) * std::pow((6.0 * m_3DFeatures[VOLUME_3D]), 2.0 / 3.0)) / m_3DFeatures[SURFACE_AREA_3D];
 		m_3DFeatures[ECCENTRICITY_3D] = std::min(m_eigenValues.x / m_eigenValues.z, 5000.0f);
 
-		m_3DFeatures.a3 = ExtractA3(*this);
-		m_3DFeatures.d1 = ExtractD1(*this);
-		m_3DFeatures.d2 = ExtractD2(*this);
-		m_3DFeatures.d3 = ExtractD3(*this);
-		m_3DFeatures.d4 = ExtractD4(*this);
+		// The random streams are seeded by the model name, so the features of a model are
+		// reproducible and do not depend on which thread extracts them or in which order.
+		const VertexSampler sampler(*m_model);
+		const uint64_t seed = RandomGenerator::SeedFromString(m_path.stem().string());
+		ExtractShapeDistributions(sampler, seed, Features3D::shapeDistributionSettings, m_3DFeatures);
 	}
 }
 
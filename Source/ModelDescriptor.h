@@ -10,6 +10,11 @@
 #include <memory>
 #include <vector>
 
+namespace util
+{
+	struct MeshMoments;
+}
+
 enum DescriptorName
 {
 	VOLUME_3D, SURFACE_AREA_3D, COMPACTNESS_3D, BOUNDS_3D, BOUNDS_AREA_3D, BOUNDS_VOLUME_3D, ECCENTRICITY_3D
@@ -24,6 +29,56 @@ struct DescriptorNameHash
 	}
 };
 
+/**
+ * @brief The shape distribution histograms, in the order they are stored in Features3D.
+*/
+enum ShapeDistribution
+{
+	A3_DISTRIBUTION, D1_DISTRIBUTION, D2_DISTRIBUTION, D3_DISTRIBUTION, D4_DISTRIBUTION, SHAPE_DISTRIBUTION_COUNT
+};
+
+/** Number of samples every shape distribution histogram is estimated from unless adaptive sampling stops earlier */
+constexpr int DEFAULT_HISTOGRAM_SAMPLES = 100000;
+
+/**
+ * @brief Smallest and largest number of samples a shape distribution histogram may be estimated from.
+*/
+struct SampleBudget
+{
+	int minSamples;
+	int maxSamples;
+};
+
+/**
+ * @brief Settings for the extraction of the A3, D1, D2, D3 and D4 shape distributions.
+*/
+struct ShapeDistributionSettings
+{
+	/**
+	 * Draw separate tuples for every distribution instead of filling all of them from one shared stream of tuples.
+	 * Slower, but keeps the histograms of a model statistically independent of each other.
+	*/
+	bool independentStreams = false;
+
+	/**
+	 * Stop sampling a distribution once its histogram has converged instead of always drawing the maximum number of samples.
+	 * The normalized histogram is compared at checkpoints that double the sample count, starting at half the minimum budget.
+	*/
+	bool adaptiveSampling = false;
+
+	/** L1 distance between the normalized histograms of two successive checkpoints below which a histogram has converged */
+	float convergenceTolerance = 0.015f;
+
+	/** Sample budget of every distribution, in ShapeDistribution order. Without adaptive sampling the maximum is always drawn */
+	SampleBudget budgets[SHAPE_DISTRIBUTION_COUNT] = {
+		{ 4096, DEFAULT_HISTOGRAM_SAMPLES },
+		{ 4096, DEFAULT_HISTOGRAM_SAMPLES },
+		{ 4096, DEFAULT_HISTOGRAM_SAMPLES },
+		{ 4096, DEFAULT_HISTOGRAM_SAMPLES },
+		{ 4096, DEFAULT_HISTOGRAM_SAMPLES }
+	};
+};
+
 struct Features3D
 {
 	Features3D();
@@ -45,6 +100,9 @@ struct Features3D
 	inline static glm::vec2 globalBoundsD3 = glm::vec2(std::numeric_limits<float>().max(), std::numeric_limits<float>().lowest());
 	inline static glm::vec2 globalBoundsD4 = glm::vec2(std::numeric_limits<float>().max(), std::numeric_limits<float>().lowest());
 
+	/** How the shape distributions of every model are extracted */
+	inline static ShapeDistributionSettings shapeDistributionSettings;
+
 	mutable std::unordered_map<DescriptorName, float, std::hash<int>> m_singleFeatures;
 };
 
@@ -54,6 +112,11 @@ struct ModelDescriptor
 
 	void UpdateDescriptorData();
 	void UpdateFeatures();
+	/**
+	 * @brief Updates the features from moments that are already known for the current model, e.g. because the
+	 *		  normalization derived them, so the vertices and faces do not have to be scanned for them again.
+	*/
+	void UpdateFeatures(const util::MeshMoments& _moments);
 	void UpdateBounds();
 
 	std::string m_name;
@@ -74,5 +137,4 @@ struct ModelDescriptor
 	glm::vec3 m_eigenValues;
 
 	Features3D m_3DFeatures;
-	std::shared_ptr<FeatureVector> m_featureVector;
 };
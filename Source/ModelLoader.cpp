@@ -195,4 +195,12 @@ void ModelLoader::LoadHistogramFeature(HistogramFeature& _feature, std::ifstream
 	nextComma = line.find(',');
 	numberString = line.substr(0, nextComma);
 	_feature.m_max = std::stof(numberString);
+
+	// Databases written before the sample count was recorded end after the max
+	_feature.m_sampleCount = 0;
+	if (nextComma != std::string::npos)
+	{
+		line.erase(0, nextComma + 1);
+		_feature.m_sampleCount = std::stoi(line);
+	}
 }
@@ -1,70 +1,50 @@
 #include "ModelProcessing.h"
 
+#include "Decimation.h"
 #include "ModelDescriptor.h"
 #include "Model.h"
 #include "ModelUtil.h"
-#include "ModelLoader.h"
+#include "Subdivision.h"
 
 #include <glm/gtx/component_wise.hpp>
 
+#include <cmath>
 #include <iostream>
-
-namespace fs = std::filesystem;
+#include <limits>
 
 namespace
 {
-	void CenterModel(Model& _model)
+	/**
+	 * @brief Rotates the eigenvectors of the model onto the axes and moves its barycenter to the origin in one pass: p' = R (p - c).
+	 * @param o_min The minimum of the bounding box of the transformed model.
+	 * @param o_max The maximum of the bounding box of the transformed model.
+	*/
+	void AlignAndCenterModel(Model& _model, const glm::mat3& _rotation, const glm::vec3& _barycenter, glm::vec3& o_min, glm::vec3& o_max)
 	{
-		glm::vec3 mean = util::ComputeBarycenter(_model);
+		const glm::vec3 rotatedBarycenter = _rotation * _barycenter;
+		o_min = glm::vec3(std::numeric_limits<float>::max());
+		o_max = glm::vec3(-std::numeric_limits<float>::max());
 
-		// Subtract mean from each vertex position
-		for (Mesh& mesh : _model.m_meshes)
-			for (glm::vec3& p : mesh.positions)
-				p -= mean;
-	}
-
-	void ScaleModel(Model& _model)
-	{
-		// Find the maximum and minimum value for each of the three axes.
-		glm::vec3 max{ -std::numeric_limits<float>::max() };
-		glm::vec3 min{ std::numeric_limits<float>::max() };
-
-		for (const Mesh& mesh : _model.m_meshes)
-		{
-			for (const glm::vec3& p : mesh.positions)
-			{
-				for (int k = 0; k < 3; k++)
-				{
-					max[k] = std::max(max[k], p[k]);
-					min[k] = std::min(min[k], p[k]);
-				}
-			}
-		}
-
-		// Find the largest difference in one of the three axes.
-		glm::vec3 range = max - min;
-		float largestDiff = glm::compMax(range);
-
-		// Divide each position by the largest difference.
 		for (Mesh& mesh : _model.m_meshes)
 		{
 			for (glm::vec3& p : mesh.positions)
 			{
-				p /= largestDiff;
+				p = _rotation * p - rotatedBarycenter;
+				o_min = glm::min(o_min, p);
+				o_max = glm::max(o_max, p);
 			}
 		}
 	}
 
-	void AlignModel(Model& _model)
-	{
-		util::RotateMajorEigenVectorToXAxis(_model);
-	}
-
 	template <typename T> int sgn(T val) {
 		return (T(0) < val) - (val < T(0));
 	}
 
-	void FlipModel(Model& _model)
+	/**
+	 * @brief Computes per axis whether the model has to be mirrored so most of its mass lies on the positive side.
+	 * @return The sign to multiply every coordinate with, an axis is never collapsed.
+	*/
+	glm::vec3 ComputeFlip(const Model& _model)
 	{
 		glm::vec3 f{ 0,0,0 };
 		for (int l = 0; l < _model.m_meshes.size(); l++)
@@ -85,23 +65,23 @@ namespace
 			}
 		}
 
-		//If we are going to put all vertices on the origin just return
+		//If we are going to put all vertices on the origin do not flip
 		if (glm::length(f) < 0.0001f)
 		{
-			return;
+			return glm::vec3(1);
 		}
 
-		glm::mat<3, 3, float, glm::defaultp> flip{ sgn(f.x), 0, 0,
-						  0, sgn(f.y), 0,
-						  0, 0, sgn(f.z) };
+		return glm::vec3(f.x < 0 ? -1 : 1, f.y < 0 ? -1 : 1, f.z < 0 ? -1 : 1);
+	}
 
-		for (int l = 0; l < _model.m_meshes.size(); l++)
-		{
-			for (int j = 0; j < _model.m_meshes[l].positions.size(); j++)
-			{
-				_model.m_meshes[l].positions[j] = _model.m_meshes[l].positions[j] * flip;
-			}
-		}
+	/**
+	 * @brief Mirrors the model and divides it by the largest extent of its bounding box in one pass.
+	*/
+	void FlipAndScaleModel(Model& _model, const glm::vec3& _flip, float _scale)
+	{
+		for (Mesh& mesh : _model.m_meshes)
+			for (glm::vec3& p : mesh.positions)
+				p = (p * _flip) / _scale;
 	}
 }
 
@@ -109,103 +89,109 @@ namespace proc
 {
 	void Normalize(ModelDescriptor& _modelDescriptor)
 	{
-		AlignModel(*_modelDescriptor.m_model);
-		CenterModel(*_modelDescriptor.m_model);
-		FlipModel(*_modelDescriptor.m_model);
-		ScaleModel(*_modelDescriptor.m_model);
+		Model& model = *_modelDescriptor.m_model;
+		util::MeshMoments moments = util::ComputeMoments(model);
+
+		// Align the major eigenvector to the x axis and center the model
+		glm::vec3 majorEigenVector, medianEigenVector, minorEigenVector, eigenValues;
+		util::ComputeEigenVectors(moments, majorEigenVector, medianEigenVector, minorEigenVector, eigenValues);
+		const glm::mat3 rotation{ majorEigenVector.x, medianEigenVector.x, minorEigenVector.x,
+								  majorEigenVector.y, medianEigenVector.y, minorEigenVector.y,
+								  majorEigenVector.z, medianEigenVector.z, minorEigenVector.z };
+
+		glm::vec3 min, max;
+		AlignAndCenterModel(model, rotation, moments.barycenter, min, max);
+
+		// Flip the heavy side to positive and scale the largest axis of the bounding box to unit length
+		const glm::vec3 flip = ComputeFlip(model);
+		const float scale = glm::compMax(max - min);
+		FlipAndScaleModel(model, flip, scale);
+
+		// Every step is a similarity transform, so the moments of the normalized model follow from the original ones
+		const glm::dmat3 transform = glm::dmat3(glm::mat3(flip.x, 0, 0, 0, flip.y, 0, 0, 0, flip.z) * rotation) / static_cast<double>(scale);
+		const double scale2 = static_cast<double>(scale) * scale;
+		const double scale3 = scale2 * scale;
+		moments.barycenter = glm::vec3(0);
+		moments.covariance = transform * moments.covariance * glm::transpose(transform);
+		moments.surfaceArea /= scale2;
+		moments.volume /= scale3;
+		moments.signedVolume *= glm::determinant(transform);
+		for (int k = 0; k < 3; k++)
+		{
+			moments.min[k] = (flip[k] < 0 ? -max[k] : min[k]) / scale;
+			moments.max[k] = (flip[k] < 0 ? -min[k] : max[k]) / scale;
+		}
 
-		_modelDescriptor.UpdateBounds();
-		_modelDescriptor.UpdateFeatures();
+		_modelDescriptor.UpdateFeatures(moments);
 		_modelDescriptor.m_model->markForReupload();
 	}
 
 
-	void Remesh(ModelDescriptor& _modelDescriptor)
+	void Remesh(ModelDescriptor& _modelDescriptor, const RemeshSettings& _settings)
 	{
-		//The folder where we will save the remeshed mesh
-		fs::path modifiedMeshesPath = fs::path("SavedMeshes");
-
-		auto outputPath = modifiedMeshesPath;
-		outputPath /= _modelDescriptor.m_path.filename();
-		outputPath = outputPath.replace_extension(".ply");
-		fs::path inputPath;
-
-		if (fs::exists(outputPath))
-			inputPath = outputPath;
-		else
-			inputPath = _modelDescriptor.m_path;
-
-		int error = system(("Scripts\\meshlabserver.exe -s \\Scripts\\RM.mlx -i " + inputPath.string() + " -o " + outputPath.string()).c_str());
-		if (error != 0)
-		{
-			std::cerr << "Failed to remesh" << "\n";
+		if (_modelDescriptor.m_model == nullptr)
 			return;
-		}
+		Model& model = *_modelDescriptor.m_model;
 
-		std::shared_ptr<Model> mdl = ModelLoader::LoadModel(outputPath);
-		if (mdl != nullptr)
+		// The edge length follows from the whole model, so all of its meshes get the same resolution
+		const util::MeshMoments moments = util::ComputeMoments(model);
+		float targetEdgeLength;
+		if (_settings.targetVertexCount > 0)
 		{
-			_modelDescriptor.m_model = mdl;
+			// A closed mesh of equilateral triangles has twice as many faces as vertices, each with an area of sqrt(3)/4 l^2
+			targetEdgeLength = static_cast<float>(std::sqrt(2.0 * moments.surfaceArea / (std::sqrt(3.0) * _settings.targetVertexCount)));
 		}
 		else
 		{
-			std::cerr << "Failed to remesh" << "\n";
+			targetEdgeLength = _settings.relativeEdgeLength * glm::compMax(moments.max - moments.min);
 		}
+
+		if (!(targetEdgeLength > 0))
+		{
+			std::cerr << "Failed to remesh " << _modelDescriptor.m_name << ", the model has no surface" << "\n";
+			return;
+		}
+
+		for (Mesh& mesh : model.m_meshes)
+			IsotropicRemesh(mesh, targetEdgeLength, _settings);
+
+		_modelDescriptor.UpdateDescriptorData();
+		model.markForReupload();
 	}
 
-	void SubdivideModel(ModelDescriptor& _modelDescriptor)
+	void SubdivideModel(ModelDescriptor& _modelDescriptor, unsigned int _minElementCount, SubdivisionScheme _scheme)
 	{
-		//The folder where we will save the subdivided mesh
-		fs::path modifiedMeshesPath = fs::path("SavedMeshes");
+		if (_modelDescriptor.m_model == nullptr)
+			return;
 
-		//check if we need to subdivide.
-		bool subdivide = false;
-		for (const Mesh& mesh : _modelDescriptor.m_model->m_meshes)
-		{
-			if (mesh.positions.size() < 1000 || mesh.faces.size() < 1000)
-			{
-				subdivide = true;
-				std::cerr << "Not enough verts/faces in model with name: " << _modelDescriptor.m_name << std::endl;
-			}
-		}
+		bool subdivided = false;
+		for (Mesh& mesh : _modelDescriptor.m_model->m_meshes)
+			subdivided |= Subdivide(mesh, _minElementCount, _scheme) > 0;
 
-		//If we do need to subdivide: call the script and load the model, then recall this method to see if the
-		//new model has enough verts/faces. If not do this again. Once this recursive call is returned swap the
-		//new model with the old one so that we immediately have access to the higher fidelity model.
-		if (subdivide)
+		if (subdivided)
 		{
-			auto newPath = modifiedMeshesPath;
-
-			newPath /= _modelDescriptor.m_path.filename();
-			newPath.replace_extension(".ply");
-			
-			auto command = ("Scripts\\meshlabserver.exe -s Scripts\\SubdivOnce.mlx -i " + _modelDescriptor.m_path.string() + " -o " + newPath.string());
-			int error = system(command.c_str());
-			if (error != 0)
-			{
-				std::cerr << "Subdivision failed', using backup subdivision" << "\n";
-				system(("Scripts\\mesh_filter.exe " + _modelDescriptor.m_path.string() + " -subdiv " + newPath.string()).c_str());
-			}
-
-			_modelDescriptor.m_model = ModelLoader::LoadModel(newPath);
+			_modelDescriptor.UpdateDescriptorData();
+			_modelDescriptor.m_model->markForReupload();
 		}
 	}
 
-	void CrunchModel(ModelDescriptor& _modelDescriptor)
+	void CrunchModel(ModelDescriptor& _modelDescriptor, unsigned int _maxFaceCount)
 	{
-		//The folder where we will save the crunched mesh
-		fs::path modifiedMeshesPath = fs::path("SavedMeshes");
+		if (_modelDescriptor.m_model == nullptr)
+			return;
 
-		for (const Mesh& mesh : _modelDescriptor.m_model->m_meshes)
-		{
-			if (mesh.positions.size() > 40000 || mesh.faces.size() > 40000)
-			{
-				auto newPath = modifiedMeshesPath;
-				newPath /= _modelDescriptor.m_path.filename();
-				system(("Scripts\\mesh_crunch.exe " + _modelDescriptor.m_path.string() + " " + newPath.string()).c_str());
+		Model& model = *_modelDescriptor.m_model;
+		size_t faceCount = 0;
+		for (const Mesh& mesh : model.m_meshes)
+			faceCount += mesh.faces.size();
+		if (faceCount <= _maxFaceCount)
+			return;
 
-				_modelDescriptor.m_model = ModelLoader::LoadModel(newPath);
-			}
-		}
+		// Every mesh keeps its share of the budget, so small parts are not collapsed away entirely
+		for (Mesh& mesh : model.m_meshes)
+			DecimateQuadric(mesh, mesh.faces.size() * _maxFaceCount / faceCount);
+
+		_modelDescriptor.UpdateDescriptorData();
+		model.markForReupload();
 	}
 }
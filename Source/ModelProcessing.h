@@ -1,6 +1,9 @@
 #pragma once
 
-class ModelDescriptor;
+#include "Remeshing.h"
+#include "Subdivision.h"
+
+struct ModelDescriptor;
 
 namespace proc
 {
@@ -10,9 +13,25 @@ namespace proc
 	*/
 	void Normalize(ModelDescriptor& _modelDescriptor);
 
-	void Remesh(ModelDescriptor& _modelDescriptor);
+	/**
+	 * @brief Remeshes every mesh of a model in memory to a uniform edge length, see IsotropicRemesh.
+	 * @param _modelDescriptor The model to remesh, nothing happens if it is not loaded.
+	 * @param _settings The target vertex count or relative edge length and the remeshing parameters.
+	*/
+	void Remesh(ModelDescriptor& _modelDescriptor, const RemeshSettings& _settings = RemeshSettings());
 
-	void SubdivideModel(ModelDescriptor& _modelDescriptor);
+	/**
+	 * @brief Subdivides every mesh of a model in memory that has too few vertices or faces, see Subdivide.
+	 * @param _modelDescriptor The model to subdivide, nothing happens if it is not loaded.
+	 * @param _minElementCount The number of vertices and faces every mesh should have at least.
+	 * @param _scheme Whether the new vertices sit on the edge midpoints or are smoothed with Loop's rules.
+	*/
+	void SubdivideModel(ModelDescriptor& _modelDescriptor, unsigned int _minElementCount = 1000, SubdivisionScheme _scheme = SubdivisionScheme::MIDPOINT);
 
-	void CrunchModel(ModelDescriptor& _modelDescriptor);
+	/**
+	 * @brief Simplifies a model in memory if it has more faces than the budget, see DecimateQuadric.
+	 * @param _modelDescriptor The model to simplify, nothing happens if it is not loaded.
+	 * @param _maxFaceCount The face budget of the whole model, which is shared by its meshes in proportion to their face counts.
+	*/
+	void CrunchModel(ModelDescriptor& _modelDescriptor, unsigned int _maxFaceCount = 40000);
 }
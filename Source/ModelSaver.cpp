@@ -1,5 +1,6 @@
 #include "ModelSaver.h"
 
+#include "FeatureStore.h"
 #include "ModelDescriptor.h"
 
 #include <assimp/postprocess.h>
@@ -11,11 +12,12 @@
 #include <limits>
 #include <iostream>
 #include <fstream>
+#include <mutex>
 #include <glm/gtx/string_cast.hpp>
 
 namespace fs = std::filesystem;
 
-void ModelSaver::SavePly(ModelDescriptor& _modelDescriptor, fs::path _filePath)
+void ModelSaver::SavePly(ModelDescriptor& _modelDescriptor, fs::path _filePath, bool _updateFeatures)
 {
 	const Model& model = *_modelDescriptor.m_model;
 
@@ -71,81 +73,24 @@ void ModelSaver::SavePly(ModelDescriptor& _modelDescriptor, fs::path _filePath)
 	//Change the filepath to be the new path.
 	_modelDescriptor.m_path = _filePath;
 
-	SaveFeatures(_modelDescriptor);
-	SaveDescriptorData(_modelDescriptor);
+	SaveFeatures(_modelDescriptor, _updateFeatures);
 }
 
-void ModelSaver::SaveFeatures(ModelDescriptor& _modelDescriptor)
+void ModelSaver::SaveFeatures(ModelDescriptor& _modelDescriptor, bool _updateFeatures)
 {
-	const fs::path featuresDatabasePath("FeatureDatabase");
-	fs::create_directory(featuresDatabasePath);
-
-	fs::path featuresPath = featuresDatabasePath / _modelDescriptor.m_path.filename().replace_extension(".csv");
-
-	std::ofstream featuresStream(featuresPath.string());
-	if(!featuresStream.is_open())
-	{
-		std::cerr << "Could not save " << featuresPath;
-		return;
-	}
-	_modelDescriptor.UpdateFeatures();
-	Features3D features = _modelDescriptor.m_3DFeatures;
-	
-	featuresStream << "volume, " << features[VOLUME_3D] << "\n";
-	featuresStream << "surfaceArea, " << features[SURFACE_AREA_3D] << "\n";
-	featuresStream << "compactness, " << features[COMPACTNESS_3D] << "\n";
-	featuresStream << "boundsArea, " << features[BOUNDS_AREA_3D] << "\n";
-	featuresStream << "boundsVolume, " << features[BOUNDS_VOLUME_3D] << "\n";
-	featuresStream << "eccentricity, " << features[ECCENTRICITY_3D] << "\n";
-
-	featuresStream << "a3, ";
-	SaveHistogramFeatures(features.a3, featuresStream);
-
-	featuresStream << "d1, ";
-	SaveHistogramFeatures(features.d1, featuresStream);
-
-	featuresStream << "d2, ";
-	SaveHistogramFeatures(features.d2, featuresStream);
-
-	featuresStream << "d3, ";
-	SaveHistogramFeatures(features.d3, featuresStream);
-
-	featuresStream << "d4, ";
-	SaveHistogramFeatures(features.d4, featuresStream);
-	
-	featuresStream.close();
-}
-
-void ModelSaver::SaveDescriptorData(ModelDescriptor& _modelDescriptor)
-{
-	const fs::path descriptorDatabasePath("DescriptorDatabase");
-	fs::create_directory(descriptorDatabasePath);
-
-	if(_modelDescriptor.m_model != nullptr)
-	{
-		_modelDescriptor.UpdateDescriptorData();
-
-		fs::path descriptorsPath = descriptorDatabasePath / _modelDescriptor.m_path.filename().replace_extension(".csv");
-
-		std::ofstream descriptorsStream(descriptorsPath.string());
-		if (!descriptorsStream.is_open())
-		{
-			std::cerr << "Could not save " << descriptorsPath;
-			return;
-		}
-
-		descriptorsStream << _modelDescriptor.m_vertexCount << ", ";
-		descriptorsStream << _modelDescriptor.m_faceCount;
-	}
-}
-
-void ModelSaver::SaveHistogramFeatures(HistogramFeature _feature, std::ofstream& _stream)
-{
-	_stream << _feature.m_numBins << " ";
-	for(int i = 0; i < _feature.m_numBins; i++)
-	{
-		_stream << _feature[i] << ", ";
-	}
-	_stream << _feature.m_min << ", " << _feature.m_max;
-	_stream << "\n";
+	if (_updateFeatures)
+		_modelDescriptor.UpdateFeatures();
+	_modelDescriptor.UpdateDescriptorData();
+
+	io::FeatureRecord record;
+	record.key = io::GetFeatureKey(_modelDescriptor.m_path);
+	record.vertexCount = static_cast<int>(_modelDescriptor.m_vertexCount);
+	record.faceCount = static_cast<int>(_modelDescriptor.m_faceCount);
+	record.features = _modelDescriptor.m_3DFeatures;
+
+	// Models are saved from several worker threads at once, the store takes one append at a time
+	static std::mutex storeMutex;
+	std::lock_guard<std::mutex> lock(storeMutex);
+	if (!io::FeatureStore(io::FEATURE_STORE_DIRECTORY).Append({ record }))
+		std::cerr << "Could not save the features of " << record.key << std::endl;
 }
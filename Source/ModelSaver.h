@@ -5,7 +5,6 @@
 #include <map>
 
 struct ModelDescriptor;
-class HistogramFeature;
 
 /**
  * \brief Class that saves a model
@@ -18,12 +17,14 @@ public:
 	 * \brief Saves the model in ply format to the given file path.
 	 * \param _model The mode to be saved
 	 * \param _filePath The filepath to save the model to. The m_path property will be changed to this path in _model 
+	 * \param _updateFeatures Whether to extract the features before saving them, false if they are known to match the model already
 	 */
-	static void SavePly(ModelDescriptor& _modelDescriptor, std::filesystem::path _filePath);
+	static void SavePly(ModelDescriptor& _modelDescriptor, std::filesystem::path _filePath, bool _updateFeatures = true);
 
 private:
 
-	static void SaveFeatures(ModelDescriptor& _modelDescriptor);
-	static void SaveDescriptorData(ModelDescriptor& _modelDescriptor);
-	static void SaveHistogramFeatures(HistogramFeature _feature, std::ofstream& _stream);
+	/**
+	 * \brief Appends the descriptor data and features of the model to the feature store, see io::FeatureStore.
+	 */
+	static void SaveFeatures(ModelDescriptor& _modelDescriptor, bool _updateFeatures);
 };
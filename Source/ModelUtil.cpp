@@ -1,13 +1,242 @@
 #include "ModelUtil.h"
 
 #include "Model.h"
-#include <Eigen/Core>
-#include <Eigen/Eigenvalues>
+#include "Parallel.h"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	/** The Jacobi iteration converges quadratically, a 3x3 matrix needs around five sweeps to reach double precision */
+	constexpr int MAX_JACOBI_SWEEPS = 32;
+
+	/** Number of vertices or faces per work item. Fixed, so the order of the reduction does not depend on the thread count */
+	constexpr size_t MOMENTS_CHUNK_SIZE = 1 << 15;
+
+	/**
+	 * @brief A range of vertices or faces of one mesh.
+	*/
+	struct MomentsChunk
+	{
+		size_t mesh;
+		size_t begin;
+		size_t end;
+		bool faces;
+	};
+
+	/**
+	 * @brief Sums of one chunk. Vertex positions are accumulated relative to a reference point close to the model,
+	 *		  which keeps the single pass covariance free of cancellation for models far from the origin.
+	*/
+	struct PartialMoments
+	{
+		glm::dvec3 sum = glm::dvec3(0);
+		glm::dmat3 outerSum = glm::dmat3(0);
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+		double surfaceArea = 0;
+		/** Sum of the triple products of the faces, six times their signed volume relative to the origin */
+		double tripleProductSum = 0;
+		/** Sum of the cross products that move the volume from the origin to another reference point */
+		glm::dvec3 crossProductSum = glm::dvec3(0);
+	};
+
+	void AccumulateVertices(const Mesh& _mesh, size_t _begin, size_t _end, const glm::dvec3& _reference, PartialMoments& o_moments)
+	{
+		for (size_t i = _begin; i < _end; i++)
+		{
+			const glm::vec3& p = _mesh.positions[i];
+			const glm::dvec3 d = glm::dvec3(p) - _reference;
+			o_moments.sum += d;
+			o_moments.outerSum += glm::outerProduct(d, d);
+			o_moments.min = glm::min(o_moments.min, p);
+			o_moments.max = glm::max(o_moments.max, p);
+		}
+	}
+
+	void AccumulateFaces(const Mesh& _mesh, size_t _begin, size_t _end, PartialMoments& o_moments)
+	{
+		for (size_t i = _begin; i < _end; i++)
+		{
+			const unsigned int* indices = _mesh.faces[i].indices;
+			const glm::vec3& v0 = _mesh.positions[indices[0]];
+			const glm::vec3& v1 = _mesh.positions[indices[1]];
+			const glm::vec3& v2 = _mesh.positions[indices[2]];
+
+			o_moments.surfaceArea += 0.5f * glm::length(glm::cross(v1 - v0, v2 - v0));
+
+			// [v0-c, v1-c, v2-c] = [v0, v1, v2] - c . (v1 x v2 + v2 x v0 + v0 x v1), so the volume relative to the
+			// barycenter c can be found once c is known, without a second pass
+			const glm::vec3 cross12 = glm::cross(v1, v2);
+			o_moments.tripleProductSum += glm::dot(v0, cross12);
+			o_moments.crossProductSum += glm::dvec3(cross12 + glm::cross(v2, v0) + glm::cross(v0, v1));
+		}
+	}
+
+	/**
+	 * @brief Flips the vector so its component with the largest magnitude is positive, the first one wins a tie.
+	*/
+	glm::vec3 CanonicalSign(const glm::vec3& _vector)
+	{
+		int largest = 0;
+		for (int k = 1; k < 3; k++)
+			if (std::abs(_vector[k]) > std::abs(_vector[largest]))
+				largest = k;
+		return _vector[largest] < 0 ? -_vector : _vector;
+	}
+}
+
 namespace util
 {
+	MeshMoments ComputeMoments(const Model& model)
+	{
+		MeshMoments moments;
+
+		std::vector<MomentsChunk> chunks;
+		glm::dvec3 reference(0);
+		bool hasReference = false;
+		for (size_t m = 0; m < model.m_meshes.size(); m++)
+		{
+			const Mesh& mesh = model.m_meshes[m];
+			for (size_t begin = 0; begin < mesh.positions.size(); begin += MOMENTS_CHUNK_SIZE)
+				chunks.push_back({ m, begin, std::min(begin + MOMENTS_CHUNK_SIZE, mesh.positions.size()), false });
+			for (size_t begin = 0; begin < mesh.faces.size(); begin += MOMENTS_CHUNK_SIZE)
+				chunks.push_back({ m, begin, std::min(begin + MOMENTS_CHUNK_SIZE, mesh.faces.size()), true });
+
+			if (!hasReference && !mesh.positions.empty())
+			{
+				reference = glm::dvec3(mesh.positions[0]);
+				hasReference = true;
+			}
+			moments.vertexCount += mesh.positions.size();
+			moments.faceCount += mesh.faces.size();
+		}
+
+		std::vector<PartialMoments> partials(chunks.size());
+		ParallelFor(chunks.size(), 1, [&](size_t _begin, size_t _end)
+		{
+			for (size_t c = _begin; c < _end; c++)
+			{
+				const MomentsChunk& chunk = chunks[c];
+				if (chunk.faces)
+					AccumulateFaces(model.m_meshes[chunk.mesh], chunk.begin, chunk.end, partials[c]);
+				else
+					AccumulateVertices(model.m_meshes[chunk.mesh], chunk.begin, chunk.end, reference, partials[c]);
+			}
+		});
+
+		// Reduce in chunk order, keeping the face sums of every mesh apart for the volume descriptor
+		PartialMoments total;
+		std::vector<PartialMoments> meshTotals(model.m_meshes.size());
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			const PartialMoments& partial = partials[c];
+			total.sum += partial.sum;
+			total.outerSum += partial.outerSum;
+			total.min = glm::min(total.min, partial.min);
+			total.max = glm::max(total.max, partial.max);
+			total.surfaceArea += partial.surfaceArea;
+			meshTotals[chunks[c].mesh].tripleProductSum += partial.tripleProductSum;
+			meshTotals[chunks[c].mesh].crossProductSum += partial.crossProductSum;
+		}
+
+		moments.surfaceArea = total.surfaceArea;
+		if (moments.vertexCount == 0)
+			return moments;
+
+		const glm::dvec3 mean = total.sum / static_cast<double>(moments.vertexCount);
+		const glm::dvec3 barycenter = reference + mean;
+		moments.barycenter = glm::vec3(barycenter);
+		moments.min = total.min;
+		moments.max = total.max;
+		moments.covariance = total.outerSum / static_cast<double>(moments.vertexCount) - glm::outerProduct(mean, mean);
+
+		for (const PartialMoments& meshTotal : meshTotals)
+		{
+			const double meshVolume = (meshTotal.tripleProductSum - glm::dot(barycenter, meshTotal.crossProductSum)) / 6.0;
+			moments.signedVolume += meshVolume;
+			moments.volume += std::abs(meshVolume);
+		}
+
+		return moments;
+	}
+
+	void SolveSymmetricEigen(const glm::dmat3& _matrix, glm::dvec3& o_eigenValues, glm::dmat3& o_eigenVectors)
+	{
+		// a[row][column], only the matrix is symmetric so the storage order of glm does not matter
+		double a[3][3];
+		double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				a[i][j] = _matrix[j][i];
+
+		const double norm = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2]
+			+ 2 * (a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2]);
+		const double tolerance = norm * std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon();
+
+		constexpr int PAIRS[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+		for (int sweep = 0; sweep < MAX_JACOBI_SWEEPS; sweep++)
+		{
+			const double offDiagonal = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+			if (offDiagonal <= tolerance)
+				break;
+
+			for (const auto& pair : PAIRS)
+			{
+				const int p = pair[0];
+				const int q = pair[1];
+				if (a[p][q] == 0)
+					continue;
+
+				// Rotation A' = J^T A J that zeroes a[p][q], using the smaller root of t^2 + 2 theta t - 1 = 0 for stability
+				const double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+				const double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+				const double c = 1 / std::sqrt(t * t + 1);
+				const double s = t * c;
+
+				for (int k = 0; k < 3; k++)
+				{
+					const double akp = a[k][p];
+					const double akq = a[k][q];
+					a[k][p] = c * akp - s * akq;
+					a[k][q] = s * akp + c * akq;
+
+					const double vkp = v[k][p];
+					const double vkq = v[k][q];
+					v[k][p] = c * vkp - s * vkq;
+					v[k][q] = s * vkp + c * vkq;
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					const double apk = a[p][k];
+					const double aqk = a[q][k];
+					a[p][k] = c * apk - s * aqk;
+					a[q][k] = s * apk + c * aqk;
+				}
+				a[p][q] = 0;
+				a[q][p] = 0;
+			}
+		}
+
+		// Sort descending with a fixed sorting network, a stable order for equal eigenvalues
+		int order[3] = { 0, 1, 2 };
+		if (a[order[1]][order[1]] > a[order[0]][order[0]]) std::swap(order[0], order[1]);
+		if (a[order[2]][order[2]] > a[order[1]][order[1]]) std::swap(order[1], order[2]);
+		if (a[order[1]][order[1]] > a[order[0]][order[0]]) std::swap(order[0], order[1]);
+
+		for (int i = 0; i < 3; i++)
+		{
+			o_eigenValues[i] = a[order[i]][order[i]];
+			o_eigenVectors[i] = glm::dvec3(v[0][order[i]], v[1][order[i]], v[2][order[i]]);
+		}
+	}
+
 	glm::vec3 ComputeBarycenter(const Model& model)
 	{
 		glm::vec3 barycenter(0, 0, 0);
@@ -44,60 +273,27 @@ namespace util
 
 	void ComputeEigenVectors(const Model& model, glm::vec3& _majorEigenVector, glm::vec3& _medianEigenVector, glm::vec3& _minorEigenVector, glm::vec3& _eigenValues)
 	{
-		glm::vec3 barycenter = ComputeBarycenter(model);
+		ComputeEigenVectors(ComputeMoments(model), _majorEigenVector, _medianEigenVector, _minorEigenVector, _eigenValues);
+	}
 
-		Eigen::Matrix3d covariance;
-		covariance.setZero();
-		unsigned int vertexCount = 0;
-		for (const Mesh& mesh : model.m_meshes)
-		{
-			for (const glm::vec3& p : mesh.positions)
-			{
-				glm::vec3 dev = p - barycenter;
-				Eigen::Vector3d eigenDev = Eigen::Vector3d{ dev.x, dev.y, dev.z };
-				covariance += eigenDev * eigenDev.transpose();
-			}
-			vertexCount += mesh.positions.size();
-		}
-		covariance /= (double)vertexCount;
-
-		// Compute eigenvectors for the covariance matrix
-		Eigen::EigenSolver<Eigen::Matrix3d> solver(covariance);
-		Eigen::Matrix3d eVectors = solver.eigenvectors().real();
-		Eigen::Vector3d eValues = solver.eigenvalues().real();
-
-		// Extract to glm vectors
-		std::vector<glm::vec3> eigenVectors(3);
-		eigenVectors[0] = glm::vec3(eVectors.col(0).x(), eVectors.col(0).y(), eVectors.col(0).z());
-		eigenVectors[1] = glm::vec3(eVectors.col(1).x(), eVectors.col(1).y(), eVectors.col(1).z());
-		eigenVectors[2] = glm::vec3(eVectors.col(2).x(), eVectors.col(2).y(), eVectors.col(2).z());
-		glm::vec3 eigenValues = glm::vec3(eValues.x(), eValues.y(), eValues.z());
-
-		// Sort eigenvectors and eigenvalues
-		std::vector<int> sortedIndices = { 0, 1, 2 };
-		std::vector<float> sortedEigenValues = { eigenValues.x, eigenValues.y, eigenValues.z };
-		std::sort(std::begin(sortedIndices), std::end(sortedIndices), [&](int i1, int i2) { return sortedEigenValues[i1] > sortedEigenValues[i2]; });
-
-		_majorEigenVector = eigenVectors[sortedIndices[0]];
-		_medianEigenVector = eigenVectors[sortedIndices[1]];
+	void ComputeEigenVectors(const MeshMoments& moments, glm::vec3& _majorEigenVector, glm::vec3& _medianEigenVector, glm::vec3& _minorEigenVector, glm::vec3& _eigenValues)
+	{
+		glm::dvec3 eigenValues;
+		glm::dmat3 eigenVectors;
+		SolveSymmetricEigen(moments.covariance, eigenValues, eigenVectors);
+
+		_majorEigenVector = CanonicalSign(glm::vec3(eigenVectors[0]));
+		_medianEigenVector = CanonicalSign(glm::vec3(eigenVectors[1]));
 		_minorEigenVector = glm::cross(_majorEigenVector, _medianEigenVector);
-		_eigenValues = glm::vec3(sortedEigenValues[0], sortedEigenValues[1], sortedEigenValues[2]);
+		_eigenValues = glm::vec3(eigenValues);
 	}
 
 	void RotateMajorEigenVectorToXAxis(Model& model)
 	{
-		glm::vec3 eigenVectors[3];
-		glm::vec3 eigenValues;
-		util::ComputeEigenVectors(model, eigenVectors[0], eigenVectors[1], eigenVectors[2], eigenValues);
-
-		std::vector<int> sortedIndices = { 0, 1, 2 };
-		std::vector<float> sortedEigenValues = { eigenValues.x, eigenValues.y, eigenValues.z };
-		std::sort(std::begin(sortedIndices), std::end(sortedIndices), [&](int i1, int i2) { return sortedEigenValues[i1] > sortedEigenValues[i2]; });
-
 		glm::vec3 majorEigenVector;
 		glm::vec3 medianEigenVector;
 		glm::vec3 minorEigenVector;
-
+		glm::vec3 eigenValues;
 		ComputeEigenVectors(model, majorEigenVector, medianEigenVector, minorEigenVector, eigenValues);
 		
 		glm::mat3x3 rotMat{ majorEigenVector.x, medianEigenVector.x, minorEigenVector.x,
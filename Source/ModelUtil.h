@@ -1,17 +1,64 @@
 #pragma once
 
-#include <glm/fwd.hpp>
+#include <glm/glm.hpp>
+
+#include <cstddef>
 
 class Model;
 
 namespace util
 {
+	/**
+	 * @brief Statistics of a model that are gathered together in a single sweep over its vertices and faces.
+	*/
+	struct MeshMoments
+	{
+		size_t vertexCount = 0;
+		size_t faceCount = 0;
+		/** Mean of the vertex positions */
+		glm::vec3 barycenter = glm::vec3(0);
+		/** Axis aligned bounding box of the vertices, zero for a model without vertices */
+		glm::vec3 min = glm::vec3(0);
+		glm::vec3 max = glm::vec3(0);
+		/** Covariance of the vertex positions, divided by the vertex count */
+		glm::dmat3 covariance = glm::dmat3(0);
+		double surfaceArea = 0;
+		/**
+		 * Signed volume enclosed by all faces, positive if the faces are oriented outwards. Measured relative to the barycenter,
+		 * which makes it independent of the position of the model even for meshes that are not closed.
+		*/
+		double signedVolume = 0;
+		/** Sum of the absolute signed volumes of the separate meshes relative to the barycenter, the volume descriptor of the model */
+		double volume = 0;
+	};
+
+	/**
+	 * @brief Computes the barycenter, bounding box, covariance, surface area and volume of a model in one pass.
+	 *		  Large models are split into fixed size chunks that are processed in parallel and reduced in a fixed order,
+	 *		  so the result does not depend on the number of threads.
+	*/
+	MeshMoments ComputeMoments(const Model& model);
+
 	glm::vec3 ComputeBarycenter(const Model& model);
 
 	void ComputeAABB(const Model& model, glm::vec3& min, glm::vec3& max);
 
+	/**
+	 * @brief Computes the eigenvalues and eigenvectors of a symmetric 3x3 matrix with cyclic Jacobi rotations, without allocating.
+	 * @param o_eigenValues The eigenvalues, sorted in descending order. Equal eigenvalues keep the order in which they were found.
+	 * @param o_eigenVectors The unit eigenvectors as columns, in the order of the eigenvalues.
+	*/
+	void SolveSymmetricEigen(const glm::dmat3& _matrix, glm::dvec3& o_eigenValues, glm::dmat3& o_eigenVectors);
+
 	void ComputeEigenVectors(const Model& model, glm::vec3& eVec1, glm::vec3& eVec2, glm::vec3& eVec3, glm::vec3& eValues);
 
+	/**
+	 * @brief Computes the eigenvectors of the covariance matrix of already computed moments, sorted by descending eigenvalue.
+	 *		  The largest component of the major and median eigenvectors is positive and the minor eigenvector is their cross product,
+	 *		  so the same covariance always gives the same right handed frame.
+	*/
+	void ComputeEigenVectors(const MeshMoments& moments, glm::vec3& eVec1, glm::vec3& eVec2, glm::vec3& eVec3, glm::vec3& eValues);
+
 	void RotateMajorEigenVectorToXAxis(Model& model);
 
 	void GetSortedEigenValues(const Model& model, glm::vec3& eigenValues);
@@ -5,7 +5,7 @@
 
 #include <filesystem>
 #include <fstream>
-#include "ModelLoader.h"
+#include <iostream>
 
 namespace fs = std::filesystem;
 
@@ -28,8 +28,6 @@ namespace
 
 	void ReadPSBClassificationFile(fs::path _modelDirectoryPath, fs::path _filePath, Database& _database)
 	{
-		const fs::path descriptorDatabasePath("DescriptorDatabase");
-		
 		std::string cls = "NO_CLASS_DETECTED!";
 
 		int counter = 0;
@@ -69,11 +67,7 @@ namespace
 					descriptor.m_name = cls + line;
 					descriptor.m_path = modelPath;
 
-					int vertexCount, faceCount;
-					ModelLoader::LoadDescriptorData(descriptorDatabasePath / modelPath.filename().replace_extension("csv"), vertexCount, faceCount);
-					descriptor.m_faceCount = vertexCount;
-					descriptor.m_vertexCount = faceCount;
-
+					// The vertex and face counts are read from the feature store with the features
 					_database.AddModel(descriptor);
 					std::cout << "Added model: " << descriptor.m_name << std::endl;
 				}
@@ -120,9 +114,18 @@ namespace io
 		fs::path modelDirectoryPath(_PSBDirectory / "db");
 		fs::path testClassificationPath = _PSBDirectory / "classification" / "v1" / "coarse1" / "coarse1Test.cla";
 		fs::path trainClassificationPath = _PSBDirectory / "classification" / "v1" / "coarse1" / "coarse1Train.cla";
+
+		// Parsing every model and building the index again is only needed when a file the snapshot was made from changed
+		const fs::path snapshotPath("DatabaseSnapshot.bin");
+		const std::vector<fs::path> sourceFiles = { testClassificationPath, trainClassificationPath };
+		if (_database.LoadSnapshot(snapshotPath, sourceFiles))
+			return;
+
 		ReadPSBClassificationFile(modelDirectoryPath, testClassificationPath, _database);
 		ReadPSBClassificationFile(modelDirectoryPath, trainClassificationPath, _database);
 
 		_database.LoadFeatureDatabase();
+		if (_database.GetFeatureMatrix().GetColumnCount() != 0)
+			_database.SaveSnapshot(snapshotPath, sourceFiles);
 	}
 }
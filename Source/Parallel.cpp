@@ -0,0 +1,87 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	thread_local bool t_isParallelWorker = false;
+}
+
+namespace util
+{
+	unsigned int DefaultThreadCount()
+	{
+		unsigned int threadCount = std::thread::hardware_concurrency();
+		return threadCount == 0 ? 1 : threadCount;
+	}
+
+	bool IsParallelWorker()
+	{
+		return t_isParallelWorker;
+	}
+
+	void ParallelFor(size_t _count, size_t _grainSize, const std::function<void(size_t, size_t)>& _body, unsigned int _threadCount)
+	{
+		if (_count == 0)
+			return;
+
+		_grainSize = std::max<size_t>(_grainSize, 1);
+		const size_t chunkCount = (_count + _grainSize - 1) / _grainSize;
+
+		unsigned int threadCount = _threadCount == 0 ? DefaultThreadCount() : _threadCount;
+		threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, chunkCount));
+
+		// Run on the calling thread if there is nothing to gain from spawning workers
+		if (threadCount <= 1 || t_isParallelWorker)
+		{
+			for (size_t begin = 0; begin < _count; begin += _grainSize)
+				_body(begin, std::min(begin + _grainSize, _count));
+			return;
+		}
+
+		std::atomic<size_t> nextChunk(0);
+		std::exception_ptr exception;
+		std::mutex exceptionMutex;
+
+		auto worker = [&]()
+		{
+			t_isParallelWorker = true;
+			for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+			{
+				try
+				{
+					size_t begin = chunk * _grainSize;
+					_body(begin, std::min(begin + _grainSize, _count));
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(exceptionMutex);
+					if (!exception)
+						exception = std::current_exception();
+					// Stop handing out new chunks
+					nextChunk = chunkCount;
+				}
+			}
+			t_isParallelWorker = false;
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (unsigned int i = 0; i < threadCount - 1; i++)
+			threads.emplace_back(worker);
+
+		// The calling thread does its share of the work as well
+		worker();
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace util
+{
+	/**
+	 * @brief Returns the number of threads to use when no explicit thread count is requested.
+	 * @return The hardware concurrency of the machine, or 1 if it could not be determined.
+	*/
+	unsigned int DefaultThreadCount();
+
+	/**
+	 * @brief Returns whether the calling thread is a worker spawned by ParallelFor.
+	*/
+	bool IsParallelWorker();
+
+	/**
+	 * @brief Splits the range [0, _count) into chunks of _grainSize elements and calls _body(begin, end) for each chunk
+	 *		  on a set of worker threads. Chunks are handed out dynamically so uneven workloads balance themselves.
+	 * @param _count The number of elements in the range.
+	 * @param _grainSize The number of elements in each chunk.
+	 * @param _body The function to call for every chunk.
+	 * @param _threadCount The number of worker threads, 0 picks DefaultThreadCount().
+	 * @note Nested calls from inside a worker run serially on the calling thread so pools never oversubscribe.
+	 *		 The first exception thrown by _body is rethrown on the calling thread once all workers have finished.
+	*/
+	void ParallelFor(size_t _count, size_t _grainSize, const std::function<void(size_t, size_t)>& _body, unsigned int _threadCount = 0);
+}
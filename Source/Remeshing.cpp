@@ -0,0 +1,266 @@
+#include "Remeshing.h"
+
+#include "HalfEdgeMesh.h"
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	/** Long edges are halved at most this many times per round, further splits are left to the next round */
+	constexpr int MAX_SPLIT_PASSES = 10;
+
+	/**
+	 * @brief State of one remeshing run, the half-edge mesh and which of its edges are sharp features.
+	*/
+	class Remesher
+	{
+	public:
+		Remesher(const Mesh& _mesh, float _targetEdgeLength, float _featureAngle) :
+			m_mesh(_mesh),
+			m_maxLength2(std::pow(4.0f / 3.0f * _targetEdgeLength, 2.0f)),
+			m_minLength2(std::pow(4.0f / 5.0f * _targetEdgeLength, 2.0f))
+		{
+			// An edge is a feature if its faces meet at more than the feature angle, boundaries always are
+			const float cosFeatureAngle = std::cos(glm::radians(_featureAngle));
+			m_features.resize(m_mesh.GetEdgeCount());
+			for (int e = 0; e < m_mesh.GetEdgeCount(); e++)
+			{
+				if (m_mesh.IsBoundaryEdge(e))
+				{
+					m_features[e] = 1;
+					continue;
+				}
+				const glm::vec3 n0 = m_mesh.FaceAreaNormal(m_mesh.Face(2 * e));
+				const glm::vec3 n1 = m_mesh.FaceAreaNormal(m_mesh.Face(2 * e + 1));
+				m_features[e] = glm::dot(n0, n1) < cosFeatureAngle * glm::length(n0) * glm::length(n1);
+			}
+		}
+
+		void SplitLongEdges()
+		{
+			// Each pass only visits the edges that existed before it, so every pass halves the long edges once
+			for (int pass = 0; pass < MAX_SPLIT_PASSES; pass++)
+			{
+				bool split = false;
+				const int edgeCount = m_mesh.GetEdgeCount();
+				for (int e = 0; e < edgeCount; e++)
+				{
+					if (m_mesh.IsDeletedEdge(e) || EdgeLength2(e) <= m_maxLength2)
+						continue;
+
+					const int firstNewEdge = m_mesh.GetEdgeCount();
+					const glm::vec3 midpoint = 0.5f * (m_mesh.Position(m_mesh.Source(2 * e)) + m_mesh.Position(m_mesh.Target(2 * e)));
+					m_mesh.SplitEdge(e, midpoint);
+					split = true;
+
+					// The second half of the edge continues its feature, the edges to the opposite vertices are new
+					m_features.resize(m_mesh.GetEdgeCount(), 0);
+					m_features[firstNewEdge] = m_features[e];
+				}
+				if (!split)
+					break;
+			}
+		}
+
+		void CollapseShortEdges()
+		{
+			for (int e = 0; e < m_mesh.GetEdgeCount(); e++)
+			{
+				if (m_mesh.IsDeletedEdge(e) || EdgeLength2(e) >= m_minLength2)
+					continue;
+
+				for (int halfEdge = 2 * e; halfEdge <= 2 * e + 1; halfEdge++)
+				{
+					if (CanCollapse(halfEdge))
+					{
+						Collapse(halfEdge);
+						break;
+					}
+				}
+			}
+		}
+
+		void EqualizeValences()
+		{
+			for (int e = 0; e < m_mesh.GetEdgeCount(); e++)
+			{
+				if (m_features[e] || !m_mesh.IsFlipOk(e))
+					continue;
+
+				const int h = 2 * e;
+				const int o = h + 1;
+				const int a = m_mesh.Source(h);
+				const int b = m_mesh.Target(h);
+				const int c = m_mesh.Target(m_mesh.Next(h));
+				const int d = m_mesh.Target(m_mesh.Next(o));
+
+				const int valenceA = m_mesh.Valence(a);
+				const int valenceB = m_mesh.Valence(b);
+				if (valenceA <= 3 || valenceB <= 3)
+					continue;
+				const int valenceC = m_mesh.Valence(c);
+				const int valenceD = m_mesh.Valence(d);
+
+				const int deviation = ValenceDeviation(a, valenceA) + ValenceDeviation(b, valenceB) + ValenceDeviation(c, valenceC) + ValenceDeviation(d, valenceD);
+				const int flippedDeviation = ValenceDeviation(a, valenceA - 1) + ValenceDeviation(b, valenceB - 1) + ValenceDeviation(c, valenceC + 1) + ValenceDeviation(d, valenceD + 1);
+				if (flippedDeviation >= deviation)
+					continue;
+
+				// Only flip if the quad is convex enough that both new faces keep the orientation of the old ones
+				const glm::vec3& pa = m_mesh.Position(a);
+				const glm::vec3& pb = m_mesh.Position(b);
+				const glm::vec3& pc = m_mesh.Position(c);
+				const glm::vec3& pd = m_mesh.Position(d);
+				const glm::vec3 normal = glm::cross(pb - pa, pc - pa) + glm::cross(pa - pb, pd - pb);
+				if (glm::dot(glm::cross(pc - pd, pa - pd), normal) <= 0 || glm::dot(glm::cross(pd - pc, pb - pc), normal) <= 0)
+					continue;
+
+				m_mesh.Flip(e);
+			}
+		}
+
+		void RelaxTangentially()
+		{
+			// Positions are updated all at once, so the result does not depend on the order of the vertices
+			std::vector<glm::vec3> relaxed(m_mesh.GetVertexCount());
+			for (int v = 0; v < m_mesh.GetVertexCount(); v++)
+			{
+				if (m_mesh.IsDeletedVertex(v))
+					continue;
+
+				relaxed[v] = m_mesh.Position(v);
+				if (FeatureDegree(v) > 0)
+					continue;
+
+				glm::vec3 centroid(0);
+				int neighbourCount = 0;
+				m_mesh.ForEachOutgoing(v, [&](int _halfEdge)
+				{
+					centroid += m_mesh.Position(m_mesh.Target(_halfEdge));
+					neighbourCount++;
+				});
+				centroid /= static_cast<float>(neighbourCount);
+
+				// Move to the centroid, but only within the tangent plane so the surface keeps its shape
+				const glm::vec3 normal = m_mesh.VertexNormal(v);
+				relaxed[v] = centroid + glm::dot(normal, m_mesh.Position(v) - centroid) * normal;
+			}
+
+			for (int v = 0; v < m_mesh.GetVertexCount(); v++)
+				if (!m_mesh.IsDeletedVertex(v))
+					m_mesh.Position(v) = relaxed[v];
+		}
+
+		void ToMesh(Mesh& o_mesh) const
+		{
+			m_mesh.ToMesh(o_mesh);
+		}
+
+	private:
+		float EdgeLength2(int _edge) const
+		{
+			const glm::vec3 edge = m_mesh.Position(m_mesh.Target(2 * _edge)) - m_mesh.Position(m_mesh.Source(2 * _edge));
+			return glm::dot(edge, edge);
+		}
+
+		int FeatureDegree(int _vertex) const
+		{
+			int degree = 0;
+			m_mesh.ForEachOutgoing(_vertex, [&](int _halfEdge) { degree += m_features[_halfEdge / 2]; });
+			return degree;
+		}
+
+		int ValenceDeviation(int _vertex, int _valence) const
+		{
+			return std::abs(_valence - (m_mesh.IsBoundaryVertex(_vertex) ? 4 : 6));
+		}
+
+		/**
+		 * @brief Whether the source of the half-edge can be merged into its target without losing a feature,
+		 *		  creating an edge that would be split again or turning over one of the remaining faces.
+		*/
+		bool CanCollapse(int _halfEdge) const
+		{
+			const int removed = m_mesh.Source(_halfEdge);
+			const int kept = m_mesh.Target(_halfEdge);
+
+			// A feature vertex may only slide along its feature line, corners stay where they are
+			const int featureDegree = FeatureDegree(removed);
+			if (featureDegree > 0 && (featureDegree != 2 || !m_features[_halfEdge / 2]))
+				return false;
+
+			if (!m_mesh.IsCollapseOk(_halfEdge))
+				return false;
+
+			const glm::vec3& keptPosition = m_mesh.Position(kept);
+			const glm::vec3& removedPosition = m_mesh.Position(removed);
+			bool ok = true;
+			m_mesh.ForEachOutgoing(removed, [&](int _outgoing)
+			{
+				const int neighbour = m_mesh.Target(_outgoing);
+				if (!ok || neighbour == kept)
+					return;
+
+				const glm::vec3 edge = m_mesh.Position(neighbour) - keptPosition;
+				if (glm::dot(edge, edge) > m_maxLength2)
+				{
+					ok = false;
+					return;
+				}
+
+				// Faces around the removed vertex that survive the collapse may not turn over when it moves
+				if (m_mesh.IsBoundaryHalfEdge(_outgoing))
+					return;
+				const int next = m_mesh.Target(m_mesh.Next(_outgoing));
+				if (next == kept)
+					return;
+				const glm::vec3& p1 = m_mesh.Position(neighbour);
+				const glm::vec3& p2 = m_mesh.Position(next);
+				const glm::vec3 before = glm::cross(p1 - removedPosition, p2 - removedPosition);
+				const glm::vec3 after = glm::cross(p1 - keptPosition, p2 - keptPosition);
+				ok = glm::dot(before, after) > 0;
+			});
+			return ok;
+		}
+
+		void Collapse(int _halfEdge)
+		{
+			// Each face next to the edge merges two of its edges into one, which stays a feature if either was
+			const int h = _halfEdge;
+			const int o = m_mesh.Twin(h);
+			if (!m_mesh.IsBoundaryHalfEdge(h))
+				m_features[m_mesh.Next(h) / 2] |= m_features[m_mesh.Prev(h) / 2];
+			if (!m_mesh.IsBoundaryHalfEdge(o))
+				m_features[m_mesh.Prev(o) / 2] |= m_features[m_mesh.Next(o) / 2];
+
+			m_mesh.Collapse(h);
+		}
+
+		HalfEdgeMesh m_mesh;
+		std::vector<uint8_t> m_features;
+		float m_maxLength2;
+		float m_minLength2;
+	};
+}
+
+namespace proc
+{
+	void IsotropicRemesh(Mesh& _mesh, float _targetEdgeLength, const RemeshSettings& _settings)
+	{
+		Remesher remesher(_mesh, _targetEdgeLength, _settings.featureAngle);
+		for (int i = 0; i < _settings.iterations; i++)
+		{
+			remesher.SplitLongEdges();
+			remesher.CollapseShortEdges();
+			remesher.EqualizeValences();
+			remesher.RelaxTangentially();
+		}
+		remesher.ToMesh(_mesh);
+	}
+}
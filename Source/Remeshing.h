@@ -0,0 +1,33 @@
+#pragma once
+
+struct Mesh;
+
+namespace proc
+{
+	/**
+	 * @brief Settings for the isotropic remeshing of the models in the database.
+	*/
+	struct RemeshSettings
+	{
+		/** Number of vertices the remeshed model should get, 0 derives the edge length from relativeEdgeLength instead */
+		unsigned int targetVertexCount = 0;
+		/** Target edge length relative to the longest side of the bounding box of the model */
+		float relativeEdgeLength = 0.02f;
+		/** Number of split, collapse, flip and relaxation rounds */
+		int iterations = 3;
+		/** Edges where the faces meet at a larger angle, in degrees, are kept as sharp features */
+		float featureAngle = 30.0f;
+	};
+
+	/**
+	 * @brief Remeshes a mesh so its edges approach the target length and its vertices approach valence 6 (Botsch & Kobbelt 2004).
+	 *		  Every round splits edges longer than 4/3 of the target length, collapses edges shorter than 4/5 of it,
+	 *		  flips edges that improve the valences and moves every vertex towards the centroid of its neighbours
+	 *		  within its tangent plane. Boundaries and feature edges are never flipped or moved off their feature line.
+	 * @param _mesh The mesh to remesh. Duplicate vertices are welded first, the result has vertex normals but no texture coordinates.
+	 * @param _targetEdgeLength The edge length to aim for, in the units of the mesh.
+	 * @param _settings The number of rounds and the feature angle.
+	 * @remark Only touches the given mesh, so separate meshes can be remeshed concurrently.
+	*/
+	void IsotropicRemesh(Mesh& _mesh, float _targetEdgeLength, const RemeshSettings& _settings = RemeshSettings());
+}
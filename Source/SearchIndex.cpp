@@ -0,0 +1,226 @@
+#include "SearchIndex.h"
+
+#include "BinaryStream.h"
+#include "HnswIndex.h"
+#include "IvfPqIndex.h"
+
+#include <flann/flann.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	constexpr char KD_FOREST_MAGIC[4] = { 'K', 'D', 'F', 'I' };
+	constexpr uint32_t KD_FOREST_VERSION = 3;
+
+	std::vector<Neighbour> ToNeighbours(const std::vector<int>& _indices, const std::vector<float>& _distances)
+	{
+		// FLANN pads the results with -1 when it finds fewer rows than requested
+		std::vector<Neighbour> neighbours;
+		for (size_t i = 0; i < _indices.size(); i++)
+		{
+			if (_indices[i] >= 0)
+				neighbours.push_back({ _indices[i], _distances[i] });
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		return neighbours;
+	}
+
+	/**
+	 * @brief FLANN's randomized kd-trees, searched with a fixed number of leaf checks.
+	*/
+	class KdForestIndex : public SearchIndex
+	{
+	public:
+		KdForestIndex(int _treeCount, int _checks) :
+			m_treeCount(_treeCount),
+			m_checks(_checks),
+			m_dimension(0),
+			m_size(0),
+			m_removedCount(0)
+		{ }
+
+		const char* GetName() const override { return "kd-forest"; }
+		size_t GetSize() const override { return m_size; }
+		size_t GetDimension() const override { return m_dimension; }
+		size_t GetRemovedCount() const override { return m_removedCount; }
+		size_t GetMemoryUsage() const override { return m_size * m_dimension * sizeof(float) + (m_index ? m_index->usedMemory() : 0); }
+
+		void Build(const FeatureMatrix& _rows) override
+		{
+			m_index.reset();
+			m_blocks.clear();
+			m_blockSizes.clear();
+			m_removed.clear();
+			m_dimension = _rows.GetColumnCount();
+			m_size = 0;
+			m_removedCount = 0;
+			if (_rows.GetRowCount() > 0)
+				AddBlock(_rows.GetRow(0), _rows.GetRowCount(), _rows.GetStride());
+		}
+
+		void Insert(const float* _row) override
+		{
+			AddBlock(_row, 1, m_dimension);
+		}
+
+		void Remove(int _id) override
+		{
+			if (_id < 0 || static_cast<size_t>(_id) >= m_size || m_removed[_id])
+				return;
+
+			// FLANN skips removed rows while searching and drops them from the trees when it rebuilds them
+			m_index->removePoint(_id);
+			m_removed[_id] = 1;
+			m_removedCount++;
+		}
+
+		std::vector<Neighbour> Search(const float* _query, size_t _k) const override
+		{
+			if (!m_index || _k == 0 || m_removedCount == m_size)
+				return {};
+
+			flann::Matrix<float> query(const_cast<float*>(_query), 1, m_dimension);
+			std::vector<std::vector<int>> indices;
+			std::vector<std::vector<float>> dists;
+			m_index->knnSearch(query, indices, dists, std::min(_k, m_size - m_removedCount), flann::SearchParams(m_checks));
+			return ToNeighbours(indices[0], dists[0]);
+		}
+
+		std::vector<Neighbour> SearchRadius(const float* _query, float _radius) const override
+		{
+			if (!m_index)
+				return {};
+
+			flann::Matrix<float> query(const_cast<float*>(_query), 1, m_dimension);
+			std::vector<std::vector<int>> indices;
+			std::vector<std::vector<float>> dists;
+			m_index->radiusSearch(query, indices, dists, _radius, flann::SearchParams(m_checks));
+			return ToNeighbours(indices[0], dists[0]);
+		}
+
+		/** Only the rows and the removed ids are written, the trees are cheap enough to rebuild when the file is loaded */
+		bool Write(std::ostream& _stream) const override
+		{
+			_stream.write(KD_FOREST_MAGIC, sizeof(KD_FOREST_MAGIC));
+			util::WriteValue(_stream, KD_FOREST_VERSION);
+			util::WriteValue<uint64_t>(_stream, m_dimension);
+			util::WriteValue<uint64_t>(_stream, m_size);
+			std::vector<float> rows;
+			rows.reserve(m_size * m_dimension);
+			for (size_t b = 0; b < m_blocks.size(); b++)
+				rows.insert(rows.end(), m_blocks[b].get(), m_blocks[b].get() + m_blockSizes[b] * m_dimension);
+			util::WriteVector(_stream, rows);
+			util::WriteVector(_stream, m_removed);
+			return static_cast<bool>(_stream);
+		}
+
+		bool Read(std::istream& _stream) override
+		{
+			m_index.reset();
+			m_blocks.clear();
+			m_blockSizes.clear();
+			m_removed.clear();
+			m_size = 0;
+			m_removedCount = 0;
+
+			char magic[sizeof(KD_FOREST_MAGIC)] = {};
+			uint32_t version = 0;
+			uint64_t dimension = 0;
+			uint64_t size = 0;
+			_stream.read(magic, sizeof(magic));
+			util::ReadValue(_stream, version);
+			util::ReadValue(_stream, dimension);
+			util::ReadValue(_stream, size);
+			if (!_stream || std::memcmp(magic, KD_FOREST_MAGIC, sizeof(magic)) != 0 || version != KD_FOREST_VERSION)
+				return false;
+
+			std::vector<float> rows;
+			std::vector<uint8_t> removed;
+			util::ReadVector(_stream, rows);
+			util::ReadVector(_stream, removed);
+			// Compared by division, size * dimension from a corrupt file can overflow
+			const bool validRows = size > 0 ? dimension > 0 && rows.size() % size == 0 && rows.size() / size == dimension : rows.empty();
+			if (!_stream || !validRows || removed.size() != size)
+				return false;
+
+			m_dimension = dimension;
+			if (size > 0)
+				AddBlock(rows.data(), size, dimension);
+			for (size_t i = 0; i < size; i++)
+			{
+				if (removed[i])
+					Remove(static_cast<int>(i));
+			}
+			return true;
+		}
+
+	private:
+		/**
+		 * @brief FLANN keeps pointers to the rows it indexes, so every block of rows is copied to memory the index owns.
+		 *		  Added rows go into the existing trees, which FLANN rebuilds once the number of rows has doubled.
+		*/
+		void AddBlock(const float* _rows, size_t _count, size_t _stride)
+		{
+			std::unique_ptr<float[]> block(new float[_count * m_dimension]);
+			for (size_t i = 0; i < _count; i++)
+				std::copy(_rows + i * _stride, _rows + i * _stride + m_dimension, block.get() + i * m_dimension);
+
+			flann::Matrix<float> points(block.get(), _count, m_dimension);
+			if (m_index)
+			{
+				m_index->addPoints(points);
+			}
+			else
+			{
+				m_index = std::make_unique<flann::Index<flann::L1<float>>>(points, flann::KDTreeIndexParams(m_treeCount));
+				m_index->buildIndex();
+			}
+
+			m_blocks.push_back(std::move(block));
+			m_blockSizes.push_back(_count);
+			m_removed.resize(m_size + _count, 0);
+			m_size += _count;
+		}
+
+		int m_treeCount;
+		int m_checks;
+		size_t m_dimension;
+		size_t m_size;
+		std::vector<std::unique_ptr<float[]>> m_blocks;
+		std::vector<size_t> m_blockSizes;
+		/** Whether every id was removed */
+		std::vector<uint8_t> m_removed;
+		size_t m_removedCount;
+		std::unique_ptr<flann::Index<flann::L1<float>>> m_index;
+	};
+}
+
+bool SearchIndex::Save(const std::filesystem::path& _path) const
+{
+	std::ofstream file(_path, std::ios::binary);
+	return Write(file);
+}
+
+bool SearchIndex::Load(const std::filesystem::path& _path)
+{
+	std::ifstream file(_path, std::ios::binary);
+	return Read(file);
+}
+
+std::unique_ptr<SearchIndex> CreateSearchIndex(const IndexSettings& _settings)
+{
+	switch (_settings.backend)
+	{
+	case IndexBackend::KD_FOREST:
+		return std::make_unique<KdForestIndex>(_settings.treeCount, _settings.checks);
+	case IndexBackend::IVF_PQ:
+		return std::make_unique<IvfPqIndex>(_settings.listCount, _settings.probeCount, _settings.subspaceCount);
+	case IndexBackend::HNSW:
+	default:
+		return std::make_unique<HnswIndex>(_settings.M, _settings.efConstruction, _settings.ef);
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "FeatureMatrix.h"
+
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The data structures a SearchIndex can be built on.
+*/
+enum class IndexBackend
+{
+	/** FLANN's randomized kd-trees */
+	KD_FOREST,
+	/** Hierarchical navigable small world graph (Malkov & Yashunin 2018) */
+	HNSW,
+	/** Inverted file with product quantized residuals, about one byte per subspace and row instead of the rows */
+	IVF_PQ
+};
+
+/**
+ * @brief Which backend an index uses and how it trades recall for speed.
+*/
+struct IndexSettings
+{
+	IndexBackend backend = IndexBackend::HNSW;
+	/** Number of randomized kd-trees of the kd-forest */
+	int treeCount = 4;
+	/** Number of leaves the kd-forest checks per query */
+	int checks = 128;
+	/** Number of links per node of the HNSW graph, the bottom layer has twice as many */
+	int M = 16;
+	/** Number of candidates the HNSW graph keeps while a node is inserted */
+	int efConstruction = 200;
+	/** Number of candidates the HNSW graph keeps while it is searched, raised to the number of requested neighbours */
+	int ef = 64;
+	/** Number of coarse lists of the IVF-PQ index, 0 picks 4 * sqrt(row count) */
+	int listCount = 0;
+	/** Number of lists the IVF-PQ index scans per query */
+	int probeCount = 16;
+	/** Number of product quantizer subspaces, which is the number of bytes per row of the IVF-PQ index */
+	int subspaceCount = 17;
+	/** Fraction of the rows that can be inserted or removed after the index is built before the database rebuilds it in the background */
+	float rebuildThreshold = 0.25f;
+};
+
+/**
+ * @brief Approximate nearest neighbour index over rows of floats under the L1 distance.
+ *		  The database indexes the rows of EmbedCumulative, so the index distance approximates the composite distance from below.
+ * @remark Searches only read the index, so they can run concurrently. Building, inserting and loading cannot.
+*/
+class SearchIndex
+{
+public:
+	virtual ~SearchIndex() = default;
+
+	virtual const char* GetName() const = 0;
+	/** Number of rows in the index including removed ones, the ids of the rows are 0 up to this number */
+	virtual size_t GetSize() const = 0;
+	/** Number of floats per row */
+	virtual size_t GetDimension() const = 0;
+	/** Number of rows that were removed since the index was built */
+	virtual size_t GetRemovedCount() const = 0;
+	/** Number of bytes held by the rows, or their codes, and the search structure */
+	virtual size_t GetMemoryUsage() const = 0;
+
+	/**
+	 * @brief Replaces the content of the index with the rows of a matrix, row i gets id i.
+	 *		  An empty matrix gives an empty index with the dimension of the matrix, which rows can be inserted into.
+	*/
+	virtual void Build(const FeatureMatrix& _rows) = 0;
+
+	/**
+	 * @brief Adds a row with the dimension of the index, it gets id GetSize().
+	*/
+	virtual void Insert(const float* _row) = 0;
+
+	/**
+	 * @brief Leaves a row out of later search results. Its id is not reused, and the index may still hold the row
+	 *		  until it is built again.
+	*/
+	virtual void Remove(int _id) = 0;
+
+	/**
+	 * @brief Finds the rows closest to the query.
+	 * @return At most _k rows and their L1 distance to the query, closest first.
+	*/
+	virtual std::vector<Neighbour> Search(const float* _query, size_t _k) const = 0;
+
+	/**
+	 * @brief Finds the rows within a distance of the query.
+	 * @return The rows and their L1 distance to the query, closest first.
+	*/
+	virtual std::vector<Neighbour> SearchRadius(const float* _query, float _radius) const = 0;
+
+	/**
+	 * @brief Writes the rows and the structure of the index to a binary stream, e.g. as one section of a larger file.
+	 * @return Whether the stream could be written.
+	*/
+	virtual bool Write(std::ostream& _stream) const = 0;
+
+	/**
+	 * @brief Replaces the content of the index with what Write of the same backend wrote, reading nothing past it.
+	 * @return Whether the stream could be read, the index is left empty otherwise.
+	*/
+	virtual bool Read(std::istream& _stream) = 0;
+
+	/**
+	 * @brief Writes the index to its own binary file, see Write.
+	*/
+	bool Save(const std::filesystem::path& _path) const;
+
+	/**
+	 * @brief Replaces the content of the index with a file written by Save of the same backend, see Read.
+	*/
+	bool Load(const std::filesystem::path& _path);
+};
+
+/**
+ * @brief Creates an empty index of the backend in the settings.
+*/
+std::unique_ptr<SearchIndex> CreateSearchIndex(const IndexSettings& _settings);
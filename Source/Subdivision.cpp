@@ -0,0 +1,262 @@
+#include "Subdivision.h"
+
+#include "Model.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	/** Every level quadruples the number of faces, so this caps the growth of degenerate inputs at 4^8 */
+	constexpr int MAX_SUBDIVISION_LEVELS = 8;
+
+	/**
+	 * @brief The unique edges of a triangle mesh and the faces around them.
+	*/
+	struct EdgeTable
+	{
+		/** End points of every edge, smallest index first */
+		std::vector<glm::uvec2> endPoints;
+		/** Vertex opposite the edge in the first two faces that use it */
+		std::vector<glm::uvec2> opposite;
+		/** Number of faces that use every edge, 1 on boundaries and more than 2 on non-manifold edges */
+		std::vector<unsigned int> faceCount;
+		/** Edge k of every face runs from its corner k to corner k + 1 */
+		std::vector<unsigned int> faceEdges;
+	};
+
+	/**
+	 * @brief Merges vertices with identical positions and drops the faces that become degenerate.
+	 *		  Sorting instead of hashing keeps the new vertex order independent of the platform.
+	*/
+	void WeldVertices(Mesh& _mesh)
+	{
+		const std::vector<glm::vec3>& positions = _mesh.positions;
+		std::vector<unsigned int> order(positions.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [&](unsigned int _a, unsigned int _b)
+		{
+			const glm::vec3& a = positions[_a];
+			const glm::vec3& b = positions[_b];
+			return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+		});
+
+		std::vector<glm::vec3> welded;
+		welded.reserve(positions.size());
+		std::vector<unsigned int> remap(positions.size());
+		for (unsigned int index : order)
+		{
+			if (welded.empty() || welded.back() != positions[index])
+				welded.push_back(positions[index]);
+			remap[index] = static_cast<unsigned int>(welded.size() - 1);
+		}
+
+		std::vector<Face> faces;
+		faces.reserve(_mesh.faces.size());
+		for (Face face : _mesh.faces)
+		{
+			for (unsigned int& index : face.indices)
+				index = remap[index];
+			if (face.indices[0] != face.indices[1] && face.indices[1] != face.indices[2] && face.indices[2] != face.indices[0])
+				faces.push_back(face);
+		}
+
+		_mesh.positions = std::move(welded);
+		_mesh.faces = std::move(faces);
+		_mesh.texCoords.clear();
+		_mesh.normals.clear();
+	}
+
+	EdgeTable BuildEdgeTable(const Mesh& _mesh)
+	{
+		EdgeTable edges;
+		edges.faceEdges.resize(3 * _mesh.faces.size());
+
+		// A closed mesh has 3/2 edges per face
+		std::unordered_map<uint64_t, unsigned int> edgeIndices;
+		edgeIndices.reserve(3 * _mesh.faces.size() / 2 + 1);
+		for (size_t f = 0; f < _mesh.faces.size(); f++)
+		{
+			const Face& face = _mesh.faces[f];
+			for (int k = 0; k < 3; k++)
+			{
+				const unsigned int a = std::min(face.indices[k], face.indices[(k + 1) % 3]);
+				const unsigned int b = std::max(face.indices[k], face.indices[(k + 1) % 3]);
+				const unsigned int opposite = face.indices[(k + 2) % 3];
+
+				const auto inserted = edgeIndices.emplace((static_cast<uint64_t>(a) << 32) | b, static_cast<unsigned int>(edges.endPoints.size()));
+				const unsigned int edge = inserted.first->second;
+				if (inserted.second)
+				{
+					edges.endPoints.emplace_back(a, b);
+					edges.opposite.emplace_back(opposite, opposite);
+					edges.faceCount.push_back(0);
+				}
+				else if (edges.faceCount[edge] == 1)
+				{
+					edges.opposite[edge].y = opposite;
+				}
+				edges.faceCount[edge]++;
+				edges.faceEdges[3 * f + k] = edge;
+			}
+		}
+		return edges;
+	}
+
+	/**
+	 * @brief Number of levels until there are enough vertices and faces. Every level adds one vertex per edge,
+	 *		  splits every edge in two and adds three edges and three faces inside every face.
+	*/
+	int CountLevels(size_t _vertexCount, size_t _edgeCount, size_t _faceCount, size_t _minElementCount)
+	{
+		int levels = 0;
+		while ((_vertexCount < _minElementCount || _faceCount < _minElementCount) && _faceCount > 0 && levels < MAX_SUBDIVISION_LEVELS)
+		{
+			_vertexCount += _edgeCount;
+			_edgeCount = 2 * _edgeCount + 3 * _faceCount;
+			_faceCount *= 4;
+			levels++;
+		}
+		return levels;
+	}
+
+	/**
+	 * @brief Loop's rules for the old vertices: interior vertices are smoothed with all their neighbours,
+	 *		  vertices on a single crease only along the crease and corners where creases meet stay in place.
+	*/
+	void SmoothVertices(const std::vector<glm::vec3>& _positions, const EdgeTable& _edges, std::vector<glm::vec3>& o_positions)
+	{
+		const size_t vertexCount = _positions.size();
+		std::vector<glm::vec3> neighbourSum(vertexCount, glm::vec3(0));
+		std::vector<glm::vec3> creaseSum(vertexCount, glm::vec3(0));
+		std::vector<unsigned int> valence(vertexCount, 0);
+		std::vector<unsigned int> creaseCount(vertexCount, 0);
+		for (size_t e = 0; e < _edges.endPoints.size(); e++)
+		{
+			const unsigned int a = _edges.endPoints[e].x;
+			const unsigned int b = _edges.endPoints[e].y;
+			neighbourSum[a] += _positions[b];
+			neighbourSum[b] += _positions[a];
+			valence[a]++;
+			valence[b]++;
+			if (_edges.faceCount[e] != 2)
+			{
+				creaseSum[a] += _positions[b];
+				creaseSum[b] += _positions[a];
+				creaseCount[a]++;
+				creaseCount[b]++;
+			}
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (creaseCount[v] == 2)
+			{
+				o_positions[v] = 0.75f * _positions[v] + 0.125f * creaseSum[v];
+			}
+			else if (creaseCount[v] == 0 && valence[v] > 0)
+			{
+				const float n = static_cast<float>(valence[v]);
+				const float weight = 0.375f + 0.25f * std::cos(glm::two_pi<float>() / n);
+				const float beta = (0.625f - weight * weight) / n;
+				o_positions[v] = (1.0f - n * beta) * _positions[v] + beta * neighbourSum[v];
+			}
+			else
+			{
+				o_positions[v] = _positions[v];
+			}
+		}
+	}
+
+	void SubdivideOnce(Mesh& _mesh, const EdgeTable& _edges, proc::SubdivisionScheme _scheme)
+	{
+		const std::vector<glm::vec3>& positions = _mesh.positions;
+		const unsigned int vertexCount = static_cast<unsigned int>(positions.size());
+		std::vector<glm::vec3> subdivided(positions.size() + _edges.endPoints.size());
+
+		if (_scheme == proc::SubdivisionScheme::LOOP)
+			SmoothVertices(positions, _edges, subdivided);
+		else
+			std::copy(positions.begin(), positions.end(), subdivided.begin());
+
+		// The vertex of edge e gets index vertexCount + e
+		for (size_t e = 0; e < _edges.endPoints.size(); e++)
+		{
+			const glm::vec3 midpoint = 0.5f * (positions[_edges.endPoints[e].x] + positions[_edges.endPoints[e].y]);
+			if (_scheme == proc::SubdivisionScheme::LOOP && _edges.faceCount[e] == 2)
+			{
+				const glm::vec3 oppositeMidpoint = 0.5f * (positions[_edges.opposite[e].x] + positions[_edges.opposite[e].y]);
+				subdivided[vertexCount + e] = 0.75f * midpoint + 0.25f * oppositeMidpoint;
+			}
+			else
+			{
+				subdivided[vertexCount + e] = midpoint;
+			}
+		}
+
+		std::vector<Face> faces(4 * _mesh.faces.size());
+		for (size_t f = 0; f < _mesh.faces.size(); f++)
+		{
+			const unsigned int* corners = _mesh.faces[f].indices;
+			const unsigned int m0 = vertexCount + _edges.faceEdges[3 * f];
+			const unsigned int m1 = vertexCount + _edges.faceEdges[3 * f + 1];
+			const unsigned int m2 = vertexCount + _edges.faceEdges[3 * f + 2];
+			faces[4 * f] = { { corners[0], m0, m2 } };
+			faces[4 * f + 1] = { { m0, corners[1], m1 } };
+			faces[4 * f + 2] = { { m2, m1, corners[2] } };
+			faces[4 * f + 3] = { { m0, m1, m2 } };
+		}
+
+		_mesh.positions = std::move(subdivided);
+		_mesh.faces = std::move(faces);
+	}
+
+	void ComputeVertexNormals(Mesh& _mesh)
+	{
+		_mesh.normals.assign(_mesh.positions.size(), glm::vec3(0));
+		for (const Face& face : _mesh.faces)
+		{
+			const glm::vec3& p0 = _mesh.positions[face.indices[0]];
+			const glm::vec3 normal = glm::cross(_mesh.positions[face.indices[1]] - p0, _mesh.positions[face.indices[2]] - p0);
+			for (unsigned int index : face.indices)
+				_mesh.normals[index] += normal;
+		}
+
+		for (glm::vec3& normal : _mesh.normals)
+		{
+			const float length = glm::length(normal);
+			if (length > 0)
+				normal /= length;
+		}
+	}
+}
+
+namespace proc
+{
+	int Subdivide(Mesh& _mesh, size_t _minElementCount, SubdivisionScheme _scheme)
+	{
+		if (_mesh.positions.size() >= _minElementCount && _mesh.faces.size() >= _minElementCount)
+			return 0;
+
+		WeldVertices(_mesh);
+		EdgeTable edges = BuildEdgeTable(_mesh);
+		const int levels = CountLevels(_mesh.positions.size(), edges.endPoints.size(), _mesh.faces.size(), _minElementCount);
+		for (int level = 0; level < levels; level++)
+		{
+			if (level > 0)
+				edges = BuildEdgeTable(_mesh);
+			SubdivideOnce(_mesh, edges, _scheme);
+		}
+
+		ComputeVertexNormals(_mesh);
+		return levels;
+	}
+}
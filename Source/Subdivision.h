@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+struct Mesh;
+
+namespace proc
+{
+	/**
+	 * @brief How the positions of a subdivided mesh are computed.
+	*/
+	enum class SubdivisionScheme
+	{
+		/** New vertices sit on the midpoints of the edges and old vertices stay where they are, so the shape does not change */
+		MIDPOINT,
+		/** Loop subdivision, which smooths the surface towards its limit surface. Boundaries and non-manifold edges are kept as creases */
+		LOOP
+	};
+
+	/**
+	 * @brief Splits every triangle into four until the mesh has at least the given number of vertices and faces.
+	 *		  The number of levels is computed up front from the edge count, every level creates one vertex per edge,
+	 *		  which is shared by the faces on both sides of the edge.
+	 * @param _mesh The mesh to subdivide. Duplicate vertices are welded first, the result has vertex normals but no texture coordinates.
+	 * @param _minElementCount The number of vertices and faces the mesh should have at least.
+	 * @param _scheme Where the old and new vertices are placed.
+	 * @return The number of levels that were applied, 0 if the mesh already had enough vertices and faces, in which case it is left untouched.
+	 * @remark Only touches the given mesh, so separate meshes can be subdivided concurrently.
+	*/
+	int Subdivide(Mesh& _mesh, size_t _minElementCount, SubdivisionScheme _scheme = SubdivisionScheme::MIDPOINT);
+}
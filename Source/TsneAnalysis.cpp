@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <cassert>
+#include <cstring>
 
 #include <QWindow>
 #include <QOpenGLContext>
@@ -136,6 +137,52 @@ void TsneAnalysis::initWithProbDist(const int numPoints, const int numDimensions
 	_probabilityDistribution = probDist;
 }
 
+void TsneAnalysis::initWithNeighbours(const NeighbourMatrix& neighbours, const int numDimensions)
+{
+	unsigned int numPoints = neighbours.GetQueryCount();
+	qDebug() << "Variables set. Num dims: " << numDimensions << " Num data points: " << numPoints << " Num neighbours: " << neighbours.GetK();
+
+	_numPoints = numPoints;
+	_numDimensions = numDimensions;
+
+	hdi::dr::HDJointProbabilityGenerator<float>::Parameters probGenParams;
+	probGenParams._perplexity = _perplexity;
+	probGenParams._perplexity_multiplier = 3;
+
+	// The generator expects every point to be its own first neighbour, at a squared distance of 0
+	const int nn = neighbours.GetK() + 1;
+	std::vector<float> distancesSquared(numPoints * nn);
+	std::vector<int> indices(numPoints * nn);
+	for (unsigned int i = 0; i < numPoints; i++)
+	{
+		indices[i * nn] = i;
+		distancesSquared[i * nn] = 0;
+		for (int k = 1; k < nn; k++)
+		{
+			indices[i * nn + k] = neighbours.GetIndices(i)[k - 1];
+			distancesSquared[i * nn + k] = neighbours.GetDistances(i)[k - 1] * neighbours.GetDistances(i)[k - 1];
+		}
+	}
+
+	_probabilityDistribution.clear();
+	_probabilityDistribution.resize(numPoints);
+	hdi::dr::HDJointProbabilityGenerator<float> probabilityGenerator;
+	probabilityGenerator.computeGaussianDistributions(distancesSquared, indices, nn, _probabilityDistribution, probGenParams);
+
+	// The generator only symmetrizes the distributions of the neighbours it searched for itself
+	for (unsigned int j = 0; j < numPoints; j++)
+	{
+		for (auto& e : _probabilityDistribution[j])
+		{
+			const unsigned int i = e.first;
+			const float jointProbability = (_probabilityDistribution[j][i] + _probabilityDistribution[i][j]) * 0.5f;
+			_probabilityDistribution[j][i] = jointProbability;
+			_probabilityDistribution[i][j] = jointProbability;
+		}
+	}
+	qDebug() << "Probability distributions calculated.";
+}
+
 void TsneAnalysis::initGradientDescent()
 {
 	_continueFromIteration = 0;
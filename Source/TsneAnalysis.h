@@ -40,6 +40,12 @@ public:
 
     void initTSNE(std::vector<float>& data, const int numDimensions);
     void initWithProbDist(const int numPoints, const int numDimensions, const std::vector<hdi::data::MapMemEff<uint32_t, float>>& probDist);
+    /**
+     * @brief Computes the high dimensional similarities from precomputed neighbours instead of searching the data with FLANN.
+     * @param neighbours Row i holds the closest points of point i, without point i itself. Every row has to be full.
+     * @param numDimensions The dimensionality of the data the neighbours were found in.
+    */
+    void initWithNeighbours(const NeighbourMatrix& neighbours, const int numDimensions);
     void stopGradientDescent();
     void markForDeletion();
 
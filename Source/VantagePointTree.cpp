@@ -0,0 +1,351 @@
+#include "VantagePointTree.h"
+
+#include "BinaryStream.h"
+#include "DistanceKernels.h"
+#include "Parallel.h"
+#include "VertexSampler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <numeric>
+#include <ostream>
+
+namespace
+{
+	constexpr uint64_t VANTAGE_SEED = 0x565054;
+	constexpr char VP_TREE_MAGIC[4] = { 'V', 'P', 'T', 'R' };
+	constexpr uint32_t VP_TREE_VERSION = 1;
+	/** Nodes with at most this many rows are leaves, which are scanned in one batch */
+	constexpr size_t LEAF_SIZE = 16;
+	/** Number of rows a worker computes the distance to the vantage row for before it takes the next chunk */
+	constexpr size_t DISTANCE_GRAIN_SIZE = 1024;
+	/**
+	 * Slack of the triangle inequality, relative to the distances it combines. The inequality holds for real numbers,
+	 * the slack covers the rounding of the distances the kernels compute, so a search never skips a row it should return
+	 */
+	constexpr float METRIC_SLACK = 1e-4f;
+
+	/**
+	 * @brief Keeps the _k closest rows in a max heap, so the k-th best distance is the threshold of the search.
+	*/
+	class NearestCollector
+	{
+	public:
+		explicit NearestCollector(size_t _k) :
+			m_k(_k)
+		{
+			m_heap.reserve(_k + 1);
+		}
+
+		float GetThreshold() const { return m_heap.size() == m_k ? m_heap.front().distance : std::numeric_limits<float>::infinity(); }
+
+		void Offer(const Neighbour& _candidate)
+		{
+			if (m_heap.size() == m_k && !(_candidate < m_heap.front()))
+				return;
+
+			m_heap.push_back(_candidate);
+			std::push_heap(m_heap.begin(), m_heap.end());
+			if (m_heap.size() > m_k)
+			{
+				std::pop_heap(m_heap.begin(), m_heap.end());
+				m_heap.pop_back();
+			}
+		}
+
+		std::vector<Neighbour> TakeNeighbours()
+		{
+			std::sort_heap(m_heap.begin(), m_heap.end());
+			return std::move(m_heap);
+		}
+
+	private:
+		size_t m_k;
+		std::vector<Neighbour> m_heap;
+	};
+
+	/**
+	 * @brief Keeps every row within a fixed radius.
+	*/
+	class RadiusCollector
+	{
+	public:
+		explicit RadiusCollector(float _radius) :
+			m_radius(_radius)
+		{ }
+
+		float GetThreshold() const { return m_radius; }
+
+		void Offer(const Neighbour& _candidate)
+		{
+			if (_candidate.distance <= m_radius)
+				m_neighbours.push_back(_candidate);
+		}
+
+		std::vector<Neighbour> TakeNeighbours()
+		{
+			std::sort(m_neighbours.begin(), m_neighbours.end());
+			return std::move(m_neighbours);
+		}
+
+	private:
+		float m_radius;
+		std::vector<Neighbour> m_neighbours;
+	};
+}
+
+VantagePointTree::VantagePointTree()
+{ }
+
+size_t VantagePointTree::GetMemoryUsage() const
+{
+	return m_rows.GetRowCount() * m_rows.GetStride() * sizeof(float)
+		+ m_order.size() * sizeof(int) + (m_innerRadii.size() + m_outerRadii.size()) * sizeof(float);
+}
+
+void VantagePointTree::Build(const FeatureMatrix& _rows, const FeatureWeights& _weights, unsigned int _threadCount)
+{
+	const size_t rowCount = _rows.GetRowCount();
+	const unsigned int threadCount = _threadCount == 0 ? util::DefaultThreadCount() : _threadCount;
+
+	m_weights = _weights;
+	m_order.resize(rowCount);
+	std::iota(m_order.begin(), m_order.end(), 0);
+	m_innerRadii.assign(rowCount, 0.0f);
+	m_outerRadii.assign(rowCount, 0.0f);
+
+	// Nodes only touch their own range of the order and of the distances, so the nodes of a level are split independently
+	std::vector<Neighbour> distances(rowCount);
+	std::vector<std::pair<size_t, size_t>> level;
+	if (rowCount > LEAF_SIZE)
+		level.push_back({ 0, rowCount });
+	while (!level.empty())
+	{
+		if (level.size() >= threadCount)
+		{
+			util::ParallelFor(level.size(), 1, [&](size_t _begin, size_t _end)
+			{
+				for (size_t n = _begin; n < _end; n++)
+					SplitNode(_rows, level[n].first, level[n].second, distances, 1);
+			}, threadCount);
+		}
+		else
+		{
+			for (const auto& [begin, end] : level)
+				SplitNode(_rows, begin, end, distances, threadCount);
+		}
+
+		std::vector<std::pair<size_t, size_t>> nextLevel;
+		for (const auto& [begin, end] : level)
+		{
+			const size_t middle = begin + 1 + (end - begin - 1) / 2;
+			if (middle - (begin + 1) > LEAF_SIZE)
+				nextLevel.push_back({ begin + 1, middle });
+			if (end - middle > LEAF_SIZE)
+				nextLevel.push_back({ middle, end });
+		}
+		level = std::move(nextLevel);
+	}
+
+	m_rows = FeatureMatrix(rowCount, _rows.GetLayout());
+	for (size_t i = 0; i < rowCount; i++)
+		std::copy_n(_rows.GetRow(m_order[i]), _rows.GetColumnCount(), m_rows.GetRow(i));
+}
+
+void VantagePointTree::SplitNode(const FeatureMatrix& _rows, size_t _begin, size_t _end, std::vector<Neighbour>& _distances, unsigned int _threadCount)
+{
+	const kernels::DistanceKernels& distanceKernels = kernels::GetDistanceKernels();
+
+	// Every node draws from its own stream, so the tree does not depend on the order the nodes are split in
+	RandomGenerator generator(VANTAGE_SEED, _begin);
+	std::swap(m_order[_begin], m_order[_begin + generator.NextBelow(static_cast<uint32_t>(_end - _begin))]);
+	const float* vantage = _rows.GetRow(m_order[_begin]);
+
+	util::ParallelFor(_end - _begin - 1, DISTANCE_GRAIN_SIZE, [&](size_t _chunkBegin, size_t _chunkEnd)
+	{
+		for (size_t i = _begin + 1 + _chunkBegin; i < _begin + 1 + _chunkEnd; i++)
+		{
+			float distance;
+			distanceKernels.composite(_rows.GetRow(m_order[i]), _rows.GetStride(), 1, _rows.GetLayout(), vantage, m_weights, &distance);
+			_distances[i] = { m_order[i], distance };
+		}
+	}, _threadCount);
+
+	// Ties at the median are ordered by index, so the halves are the same however the rows were ordered before
+	const auto first = _distances.begin() + _begin + 1;
+	const auto middle = _distances.begin() + _begin + 1 + (_end - _begin - 1) / 2;
+	const auto last = _distances.begin() + _end;
+	std::nth_element(first, middle, last);
+
+	float innerRadius = 0;
+	for (auto it = first; it != middle; ++it)
+		innerRadius = std::max(innerRadius, it->distance);
+	m_innerRadii[_begin] = innerRadius;
+	m_outerRadii[_begin] = middle->distance;
+
+	for (auto it = first; it != last; ++it)
+		m_order[it - _distances.begin()] = it->index;
+}
+
+template<typename Collector>
+void VantagePointTree::SearchNode(const float* _query, size_t _begin, size_t _end, Collector& _collector, size_t& o_distanceCount) const
+{
+	const kernels::DistanceKernels& distanceKernels = kernels::GetDistanceKernels();
+	const size_t count = _end - _begin;
+	if (count <= LEAF_SIZE)
+	{
+		float distances[LEAF_SIZE];
+		distanceKernels.composite(m_rows.GetRow(_begin), m_rows.GetStride(), count, m_rows.GetLayout(), _query, m_weights, distances);
+		o_distanceCount += count;
+		for (size_t i = 0; i < count; i++)
+			_collector.Offer({ m_order[_begin + i], distances[i] });
+		return;
+	}
+
+	float distance;
+	distanceKernels.composite(m_rows.GetRow(_begin), m_rows.GetStride(), 1, m_rows.GetLayout(), _query, m_weights, &distance);
+	o_distanceCount++;
+	_collector.Offer({ m_order[_begin], distance });
+
+	// Lower bounds of the distance from the query to every row of the inner and of the outer half
+	const size_t middle = _begin + 1 + (count - 1) / 2;
+	const float innerRadius = m_innerRadii[_begin];
+	const float outerRadius = m_outerRadii[_begin];
+	const float innerBound = distance - innerRadius - METRIC_SLACK * (1 + distance + innerRadius);
+	const float outerBound = outerRadius - distance - METRIC_SLACK * (1 + distance + outerRadius);
+
+	// The half the query is more likely in goes first, so the threshold is tight when the other one is checked
+	const auto searchInner = [&]()
+	{
+		if (innerBound <= _collector.GetThreshold())
+			SearchNode(_query, _begin + 1, middle, _collector, o_distanceCount);
+	};
+	const auto searchOuter = [&]()
+	{
+		if (outerBound <= _collector.GetThreshold())
+			SearchNode(_query, middle, _end, _collector, o_distanceCount);
+	};
+	if (innerBound <= outerBound)
+	{
+		searchInner();
+		searchOuter();
+	}
+	else
+	{
+		searchOuter();
+		searchInner();
+	}
+}
+
+std::vector<Neighbour> VantagePointTree::Search(const float* _query, size_t _k, size_t* o_distanceCount) const
+{
+	if (_k == 0 || GetSize() == 0)
+		return {};
+
+	NearestCollector collector(_k);
+	size_t distanceCount = 0;
+	SearchNode(_query, 0, GetSize(), collector, distanceCount);
+	if (o_distanceCount != nullptr)
+		*o_distanceCount += distanceCount;
+	return collector.TakeNeighbours();
+}
+
+std::vector<Neighbour> VantagePointTree::SearchRadius(const float* _query, float _radius, size_t* o_distanceCount) const
+{
+	if (GetSize() == 0)
+		return {};
+
+	RadiusCollector collector(_radius);
+	size_t distanceCount = 0;
+	SearchNode(_query, 0, GetSize(), collector, distanceCount);
+	if (o_distanceCount != nullptr)
+		*o_distanceCount += distanceCount;
+	return collector.TakeNeighbours();
+}
+
+bool VantagePointTree::Write(std::ostream& _stream) const
+{
+	const FeatureLayout& layout = m_rows.GetLayout();
+	_stream.write(VP_TREE_MAGIC, sizeof(VP_TREE_MAGIC));
+	util::WriteValue(_stream, VP_TREE_VERSION);
+	util::WriteValue<int32_t>(_stream, layout.scalarCount);
+	util::WriteValue<int32_t>(_stream, layout.histogramCount);
+	util::WriteValue<int32_t>(_stream, layout.binCount);
+	util::WriteValue(_stream, m_weights.scalar);
+	util::WriteVector(_stream, m_weights.histograms);
+
+	// The rows are written without their padding
+	std::vector<float> rows(GetSize() * m_rows.GetColumnCount());
+	for (size_t i = 0; i < GetSize(); i++)
+		std::copy_n(m_rows.GetRow(i), m_rows.GetColumnCount(), rows.begin() + i * m_rows.GetColumnCount());
+	util::WriteVector(_stream, rows);
+	util::WriteVector(_stream, m_order);
+	util::WriteVector(_stream, m_innerRadii);
+	util::WriteVector(_stream, m_outerRadii);
+	return static_cast<bool>(_stream);
+}
+
+bool VantagePointTree::Read(std::istream& _stream)
+{
+	*this = VantagePointTree();
+
+	char magic[sizeof(VP_TREE_MAGIC)] = {};
+	uint32_t version = 0;
+	int32_t scalarCount = 0;
+	int32_t histogramCount = 0;
+	int32_t binCount = 0;
+	FeatureWeights weights;
+	std::vector<float> rows;
+	std::vector<int> order;
+	std::vector<float> innerRadii;
+	std::vector<float> outerRadii;
+	_stream.read(magic, sizeof(magic));
+	util::ReadValue(_stream, version);
+	if (!_stream || !std::equal(magic, magic + sizeof(magic), VP_TREE_MAGIC) || version != VP_TREE_VERSION)
+		return false;
+
+	util::ReadValue(_stream, scalarCount);
+	util::ReadValue(_stream, histogramCount);
+	util::ReadValue(_stream, binCount);
+	util::ReadValue(_stream, weights.scalar);
+	util::ReadVector(_stream, weights.histograms);
+	util::ReadVector(_stream, rows);
+	util::ReadVector(_stream, order);
+	util::ReadVector(_stream, innerRadii);
+	util::ReadVector(_stream, outerRadii);
+	if (!_stream || scalarCount < 0 || histogramCount < 0 || binCount < 0 || weights.histograms.size() != static_cast<size_t>(histogramCount))
+		return false;
+
+	FeatureLayout layout;
+	layout.scalarCount = scalarCount;
+	layout.histogramCount = histogramCount;
+	layout.binCount = binCount;
+	const size_t columnCount = static_cast<size_t>(layout.GetColumnCount());
+	const size_t rowCount = order.size();
+	if (rows.size() != rowCount * columnCount || innerRadii.size() != rowCount || outerRadii.size() != rowCount
+		|| std::any_of(order.begin(), order.end(), [rowCount](int _index) { return _index < 0 || static_cast<size_t>(_index) >= rowCount; }))
+		return false;
+
+	m_rows = FeatureMatrix(rowCount, layout);
+	for (size_t i = 0; i < rowCount; i++)
+		std::copy_n(rows.begin() + i * columnCount, columnCount, m_rows.GetRow(i));
+	m_weights = std::move(weights);
+	m_order = std::move(order);
+	m_innerRadii = std::move(innerRadii);
+	m_outerRadii = std::move(outerRadii);
+	return true;
+}
+
+bool VantagePointTree::Save(const std::filesystem::path& _path) const
+{
+	std::ofstream file(_path, std::ios::binary);
+	return Write(file);
+}
+
+bool VantagePointTree::Load(const std::filesystem::path& _path)
+{
+	std::ifstream file(_path, std::ios::binary);
+	return Read(file);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "FeatureMatrix.h"
+
+#include <filesystem>
+#include <iosfwd>
+#include <vector>
+
+/**
+ * @brief Exact metric index over the composite distance of feature vectors (Yianilos 1993).
+ *		  Every node picks a vantage row and splits the rest of its rows at the median of their distance to it, into an inner and an
+ *		  outer half. The largest distance in the inner half and the smallest in the outer half bound the distance of a query to every
+ *		  row of a half by the triangle inequality, so a search skips every half that cannot hold a row closer than the k-th best so far.
+ *		  The composite distance is a sum of a Euclidean and weighted L1 distances, so it is a metric for any non-negative weights.
+ * @remark The rows are stored in the order of the tree, so every node and every leaf is a contiguous range of rows that the
+ *		   distance kernels scan in one batch. The tree is built for fixed rows and weights and has to be built again when they change.
+ *		   Searches only read the tree, so they can run concurrently.
+*/
+class VantagePointTree
+{
+public:
+	VantagePointTree();
+
+	size_t GetSize() const { return m_rows.GetRowCount(); }
+	const FeatureLayout& GetLayout() const { return m_rows.GetLayout(); }
+	const FeatureWeights& GetWeights() const { return m_weights; }
+	/** Number of bytes held by the rows and the tree */
+	size_t GetMemoryUsage() const;
+
+	/**
+	 * @brief Replaces the content of the tree with the rows of a matrix, row i is returned as index i by the searches.
+	 *		  The levels of the tree are built one after another, the nodes of a level in parallel, and the distances
+	 *		  of the nodes near the root, which are fewer than the threads, in parallel as well.
+	 * @param _weights The weights of the distance the tree is searched with.
+	 * @param _threadCount The number of worker threads, 0 picks util::DefaultThreadCount().
+	*/
+	void Build(const FeatureMatrix& _rows, const FeatureWeights& _weights, unsigned int _threadCount = 0);
+
+	/**
+	 * @brief Finds the same neighbours with the same distances as FindNearestNeighbours with the weights of the tree.
+	 * @param o_distanceCount Incremented by the number of distances that were computed, at most the size of the tree, may be null.
+	 * @return The min(_k, size) closest rows, closest first, ties ordered by index.
+	*/
+	std::vector<Neighbour> Search(const float* _query, size_t _k, size_t* o_distanceCount = nullptr) const;
+
+	/**
+	 * @brief Finds every row within a composite distance of the query.
+	 * @param o_distanceCount Incremented by the number of distances that were computed, may be null.
+	 * @return The rows and their distance to the query, closest first, ties ordered by index.
+	*/
+	std::vector<Neighbour> SearchRadius(const float* _query, float _radius, size_t* o_distanceCount = nullptr) const;
+
+	/**
+	 * @brief Writes the rows, the weights and the tree to a binary stream, e.g. as one section of a larger file.
+	 * @return Whether the stream could be written.
+	*/
+	bool Write(std::ostream& _stream) const;
+
+	/**
+	 * @brief Replaces the content of the tree with what Write wrote, reading nothing past it.
+	 * @return Whether the stream could be read, the tree is left empty otherwise.
+	*/
+	bool Read(std::istream& _stream);
+
+	/**
+	 * @brief Writes the tree to its own binary file, see Write.
+	*/
+	bool Save(const std::filesystem::path& _path) const;
+
+	/**
+	 * @brief Replaces the content of the tree with a file written by Save, see Read.
+	*/
+	bool Load(const std::filesystem::path& _path);
+
+private:
+	/**
+	 * @brief Picks the vantage row of the rows [_begin, _end) of m_order, moves it to the front and sorts the others into the inner and outer half.
+	 * @param _distances Scratch space with one distance per row.
+	 * @param _threadCount The number of threads the distances to the vantage row are computed with.
+	*/
+	void SplitNode(const FeatureMatrix& _rows, size_t _begin, size_t _end, std::vector<Neighbour>& _distances, unsigned int _threadCount);
+
+	/**
+	 * @brief Visits the rows [_begin, _end) of the tree that can be within the threshold of the collector, see Search.
+	*/
+	template<typename Collector>
+	void SearchNode(const float* _query, size_t _begin, size_t _end, Collector& _collector, size_t& o_distanceCount) const;
+
+	/** Rows in the order of the tree, every node is a range with the vantage row first, then its inner half, then its outer half */
+	FeatureMatrix m_rows;
+	FeatureWeights m_weights;
+	/** Index of every row of the tree in the matrix it was built from */
+	std::vector<int> m_order;
+	/** Largest distance from the vantage row of a node to its inner half, stored at the position of the vantage row */
+	std::vector<float> m_innerRadii;
+	/** Smallest distance from the vantage row of a node to its outer half, stored at the position of the vantage row */
+	std::vector<float> m_outerRadii;
+};
@@ -0,0 +1,137 @@
+#include "VertexSampler.h"
+
+#include "Model.h"
+
+#include <cassert>
+
+namespace
+{
+	uint64_t SplitMix64(uint64_t& _state)
+	{
+		uint64_t z = (_state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t RotateLeft(uint64_t _x, int _k)
+	{
+		return (_x << _k) | (_x >> (64 - _k));
+	}
+}
+
+RandomGenerator::RandomGenerator(uint64_t _seed, uint64_t _stream)
+{
+	// Expand the seed and stream into the full state with splitmix64, as recommended by the xoshiro authors
+	uint64_t seedState = _seed ^ SplitMix64(_stream);
+	for (uint64_t& s : m_state)
+		s = SplitMix64(seedState);
+}
+
+uint64_t RandomGenerator::Next()
+{
+	const uint64_t result = RotateLeft(m_state[1] * 5, 7) * 9;
+	const uint64_t t = m_state[1] << 17;
+
+	m_state[2] ^= m_state[0];
+	m_state[3] ^= m_state[1];
+	m_state[1] ^= m_state[2];
+	m_state[0] ^= m_state[3];
+	m_state[2] ^= t;
+	m_state[3] = RotateLeft(m_state[3], 45);
+
+	return result;
+}
+
+uint32_t RandomGenerator::NextBelow(uint32_t _bound)
+{
+	assert(_bound > 0);
+
+	// Lemire's multiply-shift, with rejection of the few values that would introduce a bias
+	uint64_t product = (Next() >> 32) * static_cast<uint64_t>(_bound);
+	uint32_t low = static_cast<uint32_t>(product);
+	if (low < _bound)
+	{
+		const uint32_t threshold = (0u - _bound) % _bound;
+		while (low < threshold)
+		{
+			product = (Next() >> 32) * static_cast<uint64_t>(_bound);
+			low = static_cast<uint32_t>(product);
+		}
+	}
+	return static_cast<uint32_t>(product >> 32);
+}
+
+uint64_t RandomGenerator::SeedFromString(const std::string& _string)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (unsigned char c : _string)
+	{
+		hash ^= c;
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+VertexSampler::VertexSampler(const Model& _model) :
+	m_positions(nullptr),
+	m_vertexCount(0)
+{
+	if (_model.m_meshes.size() == 1)
+	{
+		m_positions = _model.m_meshes[0].positions.data();
+		m_vertexCount = _model.m_meshes[0].positions.size();
+		return;
+	}
+
+	for (const Mesh& mesh : _model.m_meshes)
+		m_vertexCount += mesh.positions.size();
+
+	m_flatPositions.reserve(m_vertexCount);
+	for (const Mesh& mesh : _model.m_meshes)
+		m_flatPositions.insert(m_flatPositions.end(), mesh.positions.begin(), mesh.positions.end());
+
+	m_positions = m_flatPositions.data();
+}
+
+void VertexSampler::Sample(RandomGenerator& _generator, int _count, glm::vec3* o_vertices) const
+{
+	assert(_count <= 4 && m_vertexCount > 0);
+
+	const uint32_t vertexCount = static_cast<uint32_t>(m_vertexCount);
+	const bool allowRepeats = m_vertexCount < static_cast<size_t>(_count);
+
+	uint32_t indices[4];
+	for (int i = 0; i < _count; i++)
+	{
+		// Redraw until the index differs from the previously drawn ones, which is almost always the first try
+		bool unique;
+		do
+		{
+			indices[i] = _generator.NextBelow(vertexCount);
+			unique = true;
+			for (int j = 0; j < i && !allowRepeats; j++)
+				unique &= indices[i] != indices[j];
+		} while (!unique);
+
+		o_vertices[i] = m_positions[indices[i]];
+	}
+}
+
+void VertexSampler::FillBlock(RandomGenerator& _generator, int _tupleSize, int _tupleCount, SampleBlock& o_block) const
+{
+	assert(_tupleCount <= SAMPLE_BLOCK_SIZE);
+
+	glm::vec3 tuple[4];
+	for (int i = 0; i < _tupleCount; i++)
+	{
+		Sample(_generator, _tupleSize, tuple);
+		for (int j = 0; j < _tupleSize; j++)
+		{
+			o_block.x[j][i] = tuple[j].x;
+			o_block.y[j][i] = tuple[j].y;
+			o_block.z[j][i] = tuple[j].z;
+		}
+	}
+	o_block.count = _tupleCount;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Model;
+
+/** Number of tuples in a SampleBlock */
+constexpr int SAMPLE_BLOCK_SIZE = 256;
+
+/**
+ * @brief Block of random vertex tuples in structure-of-arrays layout, x[j][i] is the x coordinate of the j-th vertex of tuple i.
+*/
+struct SampleBlock
+{
+	alignas(64) float x[4][SAMPLE_BLOCK_SIZE];
+	alignas(64) float y[4][SAMPLE_BLOCK_SIZE];
+	alignas(64) float z[4][SAMPLE_BLOCK_SIZE];
+	/** Number of tuples in the block */
+	int count;
+};
+
+/**
+ * @brief Seedable xoshiro256** pseudo random number generator.
+ *		  The state is tiny and owned by the instance, so every thread or descriptor can use its own generator
+ *		  and the produced sequence only depends on the seed.
+*/
+class RandomGenerator
+{
+public:
+	/**
+	 * @brief Creates a generator for the given seed. Different stream ids give statistically independent sequences for the same seed.
+	 * @param _seed The seed of the generator.
+	 * @param _stream The id of the stream.
+	*/
+	RandomGenerator(uint64_t _seed, uint64_t _stream = 0);
+
+	/**
+	 * @brief Returns the next 64 random bits.
+	*/
+	uint64_t Next();
+
+	/**
+	 * @brief Returns a uniformly distributed integer in [0, _bound) without modulo bias.
+	 * @param _bound The exclusive upper bound, must be larger than 0.
+	*/
+	uint32_t NextBelow(uint32_t _bound);
+
+	/**
+	 * @brief Hashes a string to a seed (FNV-1a), so seeds derived from model names are the same on every platform.
+	*/
+	static uint64_t SeedFromString(const std::string& _string);
+
+private:
+	uint64_t m_state[4];
+};
+
+/**
+ * @brief Flat view over all vertices of a model that draws random vertices in constant time.
+ * @remark The sampler references the vertex data of the model it was created from, so the model has to outlive it.
+*/
+class VertexSampler
+{
+public:
+	VertexSampler(const Model& _model);
+
+	size_t GetVertexCount() const { return m_vertexCount; }
+	const glm::vec3& GetVertex(size_t _index) const { return m_positions[_index]; }
+
+	/**
+	 * @brief Draws _count distinct random vertices. If the model has fewer than _count vertices some will be repeated.
+	 * @param _generator The generator to draw the vertex indices from.
+	 * @param _count The number of vertices to draw, at most 4.
+	 * @param o_vertices The array the drawn vertices are written to.
+	*/
+	void Sample(RandomGenerator& _generator, int _count, glm::vec3* o_vertices) const;
+
+	/**
+	 * @brief Fills a block with random tuples of distinct vertices.
+	 * @param _generator The generator to draw the vertex indices from.
+	 * @param _tupleSize The number of vertices per tuple, at most 4.
+	 * @param _tupleCount The number of tuples to draw, at most SAMPLE_BLOCK_SIZE.
+	 * @param o_block The block the tuples are written to.
+	*/
+	void FillBlock(RandomGenerator& _generator, int _tupleSize, int _tupleCount, SampleBlock& o_block) const;
+
+private:
+	/** Concatenated positions of all meshes, only filled if the model consists of more than one mesh */
+	std::vector<glm::vec3> m_flatPositions;
+	const glm::vec3* m_positions;
+	size_t m_vertexCount;
+};